@@ -80,7 +80,8 @@ static const UTF8 *poolnames[] =
     T("Pcaches"),
     T("Lbufrefs"),
     T("Regrefs"),
-    T("Strings")
+    T("Strings"),
+    T("Tblocks")
 };
 
 /*! \brief Initialize a buffer pool.
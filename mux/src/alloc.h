@@ -18,7 +18,8 @@
 #define POOL_LBUFREF 7
 #define POOL_REGREF  8
 #define POOL_STRING  9
-#define NUM_POOLS    10
+#define POOL_TBLOCK  10
+#define NUM_POOLS    11
 
 #ifdef FIRANMUX
 #define LBUF_SIZE   24000   // Large
@@ -7,9 +7,10 @@
  * disk-based mode. It's not used in memory-based builds. The lower-level
  * cache is managed in svdhash.cpp
  *
- * The upper-level cache is organized by a CHashTable and a linked list. The
- * former allows random access while the linked list helps find the
- * least-recently-used attribute.
+ * The upper-level cache is organized by a CHashTable and three linked lists.
+ * The former allows random access while the linked lists implement a
+ * segmented LRU: probationary, protected, and negative (non-existent)
+ * attributes.
  */
 
 #include "copyright.h"
@@ -17,6 +18,9 @@
 #include "config.h"
 #include "externs.h"
 
+#include "interface.h"
+#include "mathutil.h"
+
 #if !defined(MEMORY_BASED)
 
 static CHashFile hfAttributeFile;
@@ -38,17 +42,294 @@ typedef struct tagAttrRecord
 
 static ATTR_RECORD TempRecord;
 
+// The cache is a segmented LRU.  New values start out on the probationary
+// list, and a value that is read again while still cached moves to the
+// protected list.  Entries fall out of the protected list back onto the
+// probationary one, and only the probationary list is normally trimmed, so a
+// single pass over many attributes (a large @search or @dolist) only
+// displaces other values which have been read once.  Attributes which are
+// known not to exist are kept on a third list with a much smaller budget.
+//
+// The same attribute is often read several times while handling a single
+// reference to it (checking its flags and then fetching its value, say).
+// Those reads are not a sign of reuse, so a probationary entry is only
+// promoted by a read at least CACHE_CORRELATED lookups after it was cached.
+//
+#define CACHE_CORRELATED 32
+
+#define CACHE_PROBATION 0
+#define CACHE_PROTECTED 1
+#define CACHE_NEGATIVE  2
+#define CACHE_SEGMENTS  3
+
 typedef struct tagCacheEntryHeader
 {
     struct tagCacheEntryHeader *pPrevEntry;
     struct tagCacheEntryHeader *pNextEntry;
     Aname attrKey;
     size_t nSize;
+    int    iSegment;
+    UINT32 nStamp;      // nCacheLookups when the entry was cached.
 } CENT_HDR, *PCENT_HDR;
 
-static PCENT_HDR pCacheHead = 0;
-static PCENT_HDR pCacheTail = 0;
+typedef struct
+{
+    PCENT_HDR pHead;
+    PCENT_HDR pTail;
+    size_t    nSize;
+    int       nEntries;
+    INT64     nHits;
+    INT64     nEvictions;
+} CACHE_SEGMENT;
+
+static CACHE_SEGMENT aCacheSegments[CACHE_SEGMENTS];
 static size_t CacheSize = 0;
+static INT64  nCacheMisses = 0;
+static UINT32 nCacheLookups = 0;
+
+// The redo log keeps attribute writes durable between checkpoints.  Each
+// cache_put() and cache_del() appends a record to an in-memory buffer, and
+// once per pass through the main loop, cache_commit() writes the buffer out
+// and waits on it with a single fdatasync().  A checkpoint (cache_sync)
+// flushes the page file and empties the log.  After a crash, cache_init()
+// re-applies whatever the log still holds.
+//
+// Records are idempotent (a write replaces the whole value), so replaying a
+// log which had already reached the page file is harmless.  Replay stops at
+// the first record which is incomplete or fails its CRC.
+//
+#define WAL_MAGIC       0x314C4157UL    // "WAL1"
+#define WAL_BUFFER_SIZE 65536
+
+typedef struct
+{
+    UINT32 nMagic;
+    UINT32 nCRC;        // Covers attrKey, nLength, and the text.
+    Aname  attrKey;
+    UINT32 nLength;     // Zero for a deleted attribute.
+} WAL_HEADER;
+
+static int    hWalFile = MUX_OPEN_INVALID_HANDLE_VALUE;
+static UTF8  *pWalName = nullptr;
+static char   aWalBuffer[WAL_BUFFER_SIZE];
+static size_t nWalBuffer = 0;
+static bool   bWalUnsynced = false;
+static bool   bWalSyncFailed = false;
+static UINT32 nWalRecords = 0;
+static UINT32 nWalCommits = 0;
+
+// Online compaction.  CHashPage::Defrag() reclaims space within a page, but
+// pages are never merged, so the page file only grows.  @dump/compact
+// rebuilds it by re-inserting every record into a scratch copy, walking the
+// original in hash order a few pages per step.  Hashes below nCompactNext
+// have been copied, so writes to them are applied to both files.  When the
+// walk finishes, the copy is synced and swapped in for the original.
+//
+static CHashFile hfCompact;
+static bool   bCompacting = false;
+static UINT32 nCompactNext = 0;
+static UINT32 nCompactPagesBefore = 0;
+static UINT32 nCompactPagesRead = 0;
+static UINT32 nLastCompactBefore = 0;
+static UINT32 nLastCompactAfter = 0;
+static UTF8  *pCompactDir = nullptr;
+static UTF8  *pCompactPag = nullptr;
+static UTF8  *pBackupDir = nullptr;
+static UTF8  *pBackupPag = nullptr;
+
+// Needed to re-open the page file after a compaction.
+//
+static UTF8  *pGameDir = nullptr;
+static UTF8  *pGamePag = nullptr;
+static int    nGameCachePages = 0;
+
+static UINT32 wal_crc(const WAL_HEADER *pwh, const void *pText)
+{
+    UINT32 nCRC = CRC32_ProcessBuffer(0, &pwh->attrKey, sizeof(pwh->attrKey));
+    nCRC = CRC32_ProcessBuffer(nCRC, &pwh->nLength, sizeof(pwh->nLength));
+    return CRC32_ProcessBuffer(nCRC, pText, pwh->nLength);
+}
+
+static void wal_flush(void)
+{
+    const char *p = aWalBuffer;
+    size_t n = nWalBuffer;
+    while (0 < n)
+    {
+        int cc = mux_write(hWalFile, p, static_cast<unsigned int>(n));
+        if (cc <= 0)
+        {
+            Log.tinyprintf(T("Attribute redo log write failed with errno of %u." ENDLINE), errno);
+            break;
+        }
+        p += cc;
+        n -= cc;
+    }
+    nWalBuffer = 0;
+    bWalUnsynced = true;
+}
+
+static void wal_append(const Aname *nam, const UTF8 *pText, size_t nLength)
+{
+    if (  MUX_OPEN_INVALID_HANDLE_VALUE == hWalFile
+       || mudstate.bStandAlone)
+    {
+        return;
+    }
+
+    WAL_HEADER wh;
+    wh.nMagic  = WAL_MAGIC;
+    wh.attrKey = *nam;
+    wh.nLength = static_cast<UINT32>(nLength);
+    wh.nCRC    = wal_crc(&wh, pText);
+
+    if (WAL_BUFFER_SIZE < nWalBuffer + sizeof(wh) + nLength)
+    {
+        wal_flush();
+    }
+    memcpy(aWalBuffer + nWalBuffer, &wh, sizeof(wh));
+    nWalBuffer += sizeof(wh);
+    memcpy(aWalBuffer + nWalBuffer, pText, nLength);
+    nWalBuffer += nLength;
+    nWalRecords++;
+}
+
+// Empty the log.  This is only safe once the page file holds every change
+// the log describes.
+//
+static void wal_reset(void)
+{
+    if (MUX_OPEN_INVALID_HANDLE_VALUE != hWalFile)
+    {
+        mux_close(hWalFile);
+        hWalFile = MUX_OPEN_INVALID_HANDLE_VALUE;
+    }
+    nWalBuffer = 0;
+    bWalUnsynced = false;
+    bWalSyncFailed = false;
+
+    if (  nullptr != pWalName
+       && !mux_open(&hWalFile, pWalName, O_RDWR|O_BINARY|O_CREAT|O_TRUNC))
+    {
+        Log.tinyprintf(T("Couldn\xE2\x80\x99t open attribute redo log %s. Writes since the last checkpoint can be lost." ENDLINE),
+            pWalName);
+        hWalFile = MUX_OPEN_INVALID_HANDLE_VALUE;
+    }
+}
+
+static void cache_remove(CHashFile &hf, Aname *nam, UINT32 nHash);
+
+static void wal_replay(int hFile)
+{
+    UTF8 *pText = (UTF8 *)MEMALLOC(sizeof(TempRecord.attrText));
+    ISOUTOFMEMORY(pText);
+
+    int nApplied = 0;
+    WAL_HEADER wh;
+    while (  sizeof(wh) == mux_read(hFile, &wh, sizeof(wh))
+          && WAL_MAGIC == wh.nMagic
+          && wh.nLength <= sizeof(TempRecord.attrText)
+          && static_cast<int>(wh.nLength) == mux_read(hFile, pText, wh.nLength)
+          && wal_crc(&wh, pText) == wh.nCRC)
+    {
+        UINT32 nHash = CRC32_ProcessInteger2(wh.attrKey.object, wh.attrKey.attrnum);
+        cache_remove(hfAttributeFile, &wh.attrKey, nHash);
+        if (0 < wh.nLength)
+        {
+            TempRecord.attrKey = wh.attrKey;
+            memcpy(TempRecord.attrText, pText, wh.nLength);
+            if (!hfAttributeFile.Insert((HP_HEAPLENGTH)(wh.nLength+sizeof(Aname)), nHash, &TempRecord))
+            {
+                Log.tinyprintf(T("cache_init: replay of (%d,%d) failed" ENDLINE),
+                    wh.attrKey.object, wh.attrKey.attrnum);
+            }
+        }
+        nApplied++;
+    }
+    MEMFREE(pText);
+    pText = nullptr;
+
+    if (0 < nApplied)
+    {
+        hfAttributeFile.Sync();
+        Log.tinyprintf(T("Replayed %d attribute writes from %s." ENDLINE),
+            nApplied, pWalName);
+    }
+}
+
+// The log lives beside the page file: netmux.pag is paired with netmux.wal.
+//
+static void wal_open(const UTF8 *game_pag_file, bool bNew)
+{
+    size_t n = strlen((const char *)game_pag_file);
+    if (  4 <= n
+       && memcmp(game_pag_file + n - 4, ".pag", 4) == 0)
+    {
+        n -= 4;
+    }
+    pWalName = (UTF8 *)MEMALLOC(n + sizeof(".wal"));
+    ISOUTOFMEMORY(pWalName);
+    memcpy(pWalName, game_pag_file, n);
+    memcpy(pWalName + n, ".wal", sizeof(".wal"));
+
+    // A log left beside a new page file belongs to some earlier database.
+    //
+    int hFile;
+    if (  !bNew
+       && mux_open(&hFile, pWalName, O_RDONLY|O_BINARY))
+    {
+        wal_replay(hFile);
+        mux_close(hFile);
+    }
+    wal_reset();
+}
+
+/*! \brief Makes the attribute writes since the last commit durable.
+ *
+ * Called once per pass through the main loop, so that all the writes done
+ * by one pass share a single fdatasync().
+ *
+ * \return        None.
+ */
+
+void cache_commit(void)
+{
+    if (MUX_OPEN_INVALID_HANDLE_VALUE == hWalFile)
+    {
+        return;
+    }
+
+    if (0 < nWalBuffer)
+    {
+        wal_flush();
+    }
+
+    if (bWalUnsynced)
+    {
+#if defined(WINDOWS_FILES)
+        int cc = _commit(hWalFile);
+#elif defined(HAVE_FDATASYNC)
+        int cc = fdatasync(hWalFile);
+#else
+        int cc = fsync(hWalFile);
+#endif // HAVE_FDATASYNC
+        if (0 != cc)
+        {
+            // Leave the log marked unsynced so the next pass tries again.
+            // Only the first failure in a row is logged.
+            //
+            if (!bWalSyncFailed)
+            {
+                log_perror(T("DMP"), T("FAIL"), T("attribute redo log"), pWalName);
+                bWalSyncFailed = true;
+            }
+            return;
+        }
+        bWalSyncFailed = false;
+        bWalUnsynced = false;
+        nWalCommits++;
+    }
+}
 
 int cache_init(const UTF8 *game_dir_file, const UTF8 *game_pag_file,
     int nCachePages)
@@ -58,9 +339,40 @@ int cache_init(const UTF8 *game_dir_file, const UTF8 *game_pag_file,
         return HF_OPEN_STATUS_ERROR;
     }
 
-    int cc = hfAttributeFile.Open(game_dir_file, game_pag_file, nCachePages);
+    // A crash in the middle of a compaction may have left the original page
+    // file only under its backup name.
+    //
+    UTF8 *pPrevDir = StringClone(tprintf(T("%s.precompact"), game_dir_file));
+    UTF8 *pPrevPag = StringClone(tprintf(T("%s.precompact"), game_pag_file));
+    int h;
+    if (mux_open(&h, game_pag_file, O_RDONLY|O_BINARY))
+    {
+        mux_close(h);
+    }
+    else if (mux_open(&h, pPrevPag, O_RDONLY|O_BINARY))
+    {
+        mux_close(h);
+        UTF8 *pDir = StringClone(game_dir_file);
+        UTF8 *pPag = StringClone(game_pag_file);
+        RemoveFile(pDir);
+        ReplaceFile(pPrevPag, pPag);
+        ReplaceFile(pPrevDir, pDir);
+        MEMFREE(pDir);
+        MEMFREE(pPag);
+        Log.WriteString(T("Restored the page file saved by an unfinished compaction." ENDLINE));
+    }
+    MEMFREE(pPrevDir);
+    MEMFREE(pPrevPag);
+
+    int cc = hfAttributeFile.Open(game_dir_file, game_pag_file, nCachePages,
+        mudconf.cache_mmap);
     if (cc != HF_OPEN_STATUS_ERROR)
     {
+        wal_open(game_pag_file, HF_OPEN_STATUS_NEW == cc);
+        pGameDir = StringClone(game_dir_file);
+        pGamePag = StringClone(game_pag_file);
+        nGameCachePages = nCachePages;
+
         // Mark caching system live
         //
         cache_initted = true;
@@ -131,9 +443,40 @@ void cache_cleanup(void)
     }
 }
 
+static void compact_abort(const UTF8 *pReason);
+
 void cache_close(void)
 {
+    if (bCompacting)
+    {
+        compact_abort(T("shutting down"));
+    }
+    bool bSynced = hfAttributeFile.Sync();
     hfAttributeFile.CloseAll();
+    if (bSynced)
+    {
+        wal_reset();
+    }
+    if (MUX_OPEN_INVALID_HANDLE_VALUE != hWalFile)
+    {
+        mux_close(hWalFile);
+        hWalFile = MUX_OPEN_INVALID_HANDLE_VALUE;
+    }
+    if (nullptr != pWalName)
+    {
+        MEMFREE(pWalName);
+        pWalName = nullptr;
+    }
+    if (nullptr != pGameDir)
+    {
+        MEMFREE(pGameDir);
+        pGameDir = nullptr;
+    }
+    if (nullptr != pGamePag)
+    {
+        MEMFREE(pGamePag);
+        pGamePag = nullptr;
+    }
     cache_initted = false;
 }
 
@@ -142,98 +485,123 @@ void cache_tick(void)
     hfAttributeFile.Tick();
 }
 
+// Start reading the page file ahead of preloading, which fetches most of
+// the attributes in the database.
+//
+void cache_prefetch(void)
+{
+    hfAttributeFile.Prefetch();
+}
+
 static void REMOVE_ENTRY(PCENT_HDR pEntry)
 {
-    // How is X positioned?
-    //
-    if (pEntry == pCacheHead)
+    CACHE_SEGMENT *pSeg = &aCacheSegments[pEntry->iSegment];
+
+    if (pEntry->pPrevEntry)
     {
-        if (pEntry == pCacheTail)
-        {
-            // HEAD --> X --> 0
-            //    0 <--  <-- TAIL
-            //
-            // ASSERT: pEntry->pNextEntry == 0;
-            // ASSERT: pEntry->pPrevEntry == 0;
-            //
-            pCacheHead = pCacheTail = 0;
-        }
-        else
-        {
-            // HEAD  --> X --> Y --> 0
-            //    0 <--   <--   <--  TAIL
-            //
-            // ASSERT: pEntry->pNextEntry != 0;
-            // ASSERT: pEntry->pPrevEntry == 0;
-            //
-            pCacheHead = pEntry->pNextEntry;
-            pCacheHead->pPrevEntry = 0;
-            pEntry->pNextEntry = 0;
-        }
+        pEntry->pPrevEntry->pNextEntry = pEntry->pNextEntry;
     }
-    else if (pEntry == pCacheTail)
+    else
     {
-        // HEAD  --> Y --> X --> 0
-        //    0 <--   <--   <-- TAIL
-        //
-        // ASSERT: pEntry->pNextEntry == 0;
-        // ASSERT: pEntry->pPrevEntry != 0;
-        //
-        pCacheTail = pEntry->pPrevEntry;
-        pCacheTail->pNextEntry = 0;
-        pEntry->pPrevEntry = 0;
+        pSeg->pHead = pEntry->pNextEntry;
     }
-    else
+
+    if (pEntry->pNextEntry)
     {
-        // HEAD  --> Y --> X --> Z --> 0
-        //    0 <--   <--   <--   <-- TAIL
-        //
-        // ASSERT: pEntry->pNextEntry != 0;
-        // ASSERT: pEntry->pNextEntry != 0;
-        //
         pEntry->pNextEntry->pPrevEntry = pEntry->pPrevEntry;
-        pEntry->pPrevEntry->pNextEntry = pEntry->pNextEntry;
-        pEntry->pNextEntry = 0;
-        pEntry->pPrevEntry = 0;
     }
+    else
+    {
+        pSeg->pTail = pEntry->pPrevEntry;
+    }
+
+    pEntry->pNextEntry = 0;
+    pEntry->pPrevEntry = 0;
+    pSeg->nSize -= pEntry->nSize;
+    pSeg->nEntries--;
+    CacheSize -= pEntry->nSize;
 }
 
-static void ADD_ENTRY(PCENT_HDR pEntry)
+static void ADD_ENTRY(PCENT_HDR pEntry, int iSegment)
 {
-    if (pCacheHead)
+    CACHE_SEGMENT *pSeg = &aCacheSegments[iSegment];
+
+    if (pSeg->pHead)
     {
-        pCacheHead->pPrevEntry = pEntry;
+        pSeg->pHead->pPrevEntry = pEntry;
     }
-    pEntry->pNextEntry = pCacheHead;
+    pEntry->pNextEntry = pSeg->pHead;
     pEntry->pPrevEntry = 0;
-    pCacheHead = pEntry;
-    if (!pCacheTail)
+    pEntry->iSegment = iSegment;
+    pSeg->pHead = pEntry;
+    if (!pSeg->pTail)
+    {
+        pSeg->pTail = pEntry;
+    }
+    pSeg->nSize += pEntry->nSize;
+    pSeg->nEntries++;
+    CacheSize += pEntry->nSize;
+}
+
+static void DELETE_ENTRY(PCENT_HDR pEntry)
+{
+    REMOVE_ENTRY(pEntry);
+    hashdeleteLEN(&(pEntry->attrKey), sizeof(Aname), &mudstate.acache_htab);
+    MEMFREE(pEntry);
+}
+
+// The protected list may use up to 80% of the cache.  Its oldest entries get
+// another chance on the probationary list.
+//
+static void DemoteProtected(void)
+{
+    CACHE_SEGMENT *pProt = &aCacheSegments[CACHE_PROTECTED];
+    while (  pProt->pTail
+          && (mudconf.max_cache_size/5)*4 < pProt->nSize)
     {
-        pCacheTail = pCacheHead;
+        PCENT_HDR pEntry = pProt->pTail;
+        REMOVE_ENTRY(pEntry);
+        ADD_ENTRY(pEntry, CACHE_PROBATION);
     }
 }
 
 static void TrimCache(void)
 {
+    // Negative entries have their own budget of 1/16th of the cache.
+    //
+    CACHE_SEGMENT *pNeg = &aCacheSegments[CACHE_NEGATIVE];
+    while (  pNeg->pTail
+          && mudconf.max_cache_size/16 < pNeg->nSize)
+    {
+        pNeg->nEvictions++;
+        DELETE_ENTRY(pNeg->pTail);
+    }
+
+    DemoteProtected();
+
     // Check to see if the cache needs to be trimmed.
     //
     while (CacheSize > mudconf.max_cache_size)
     {
         // Blow something away.
         //
-        PCENT_HDR pCacheEntry = pCacheTail;
-        if (!pCacheEntry)
+        int iSegment;
+        for (iSegment = 0; iSegment < CACHE_SEGMENTS; iSegment++)
+        {
+            if (aCacheSegments[iSegment].pTail)
+            {
+                break;
+            }
+        }
+
+        if (CACHE_SEGMENTS == iSegment)
         {
             CacheSize = 0;
             break;
         }
 
-        REMOVE_ENTRY(pCacheEntry);
-        CacheSize -= pCacheEntry->nSize;
-        hashdeleteLEN(&(pCacheEntry->attrKey), sizeof(Aname),
-            &mudstate.acache_htab);
-        MEMFREE(pCacheEntry);
-        pCacheEntry = nullptr;
+        aCacheSegments[iSegment].nEvictions++;
+        DELETE_ENTRY(aCacheSegments[iSegment].pTail);
     }
 }
 
@@ -251,15 +619,30 @@ const UTF8 *cache_get(Aname *nam, size_t *pLen)
     {
         // Check the cache, first.
         //
+        nCacheLookups++;
         pCacheEntry = (PCENT_HDR)hashfindLEN(nam, sizeof(Aname),
             &mudstate.acache_htab);
         if (pCacheEntry)
         {
-            // It was in the cache, so move this entry to the head of the queue.
-            // and return a pointer to it.
+            // It was in the cache.  A second read promotes a probationary
+            // entry to the protected list.  Otherwise, move this entry to the
+            // head of its list.
             //
-            REMOVE_ENTRY(pCacheEntry);
-            ADD_ENTRY(pCacheEntry);
+            int iSegment = pCacheEntry->iSegment;
+            aCacheSegments[iSegment].nHits++;
+            if (  CACHE_PROBATION == iSegment
+               && CACHE_CORRELATED <= nCacheLookups - pCacheEntry->nStamp)
+            {
+                REMOVE_ENTRY(pCacheEntry);
+                ADD_ENTRY(pCacheEntry, CACHE_PROTECTED);
+                DemoteProtected();
+            }
+            else if (aCacheSegments[iSegment].pHead != pCacheEntry)
+            {
+                REMOVE_ENTRY(pCacheEntry);
+                ADD_ENTRY(pCacheEntry, iSegment);
+            }
+
             if (sizeof(CENT_HDR) < pCacheEntry->nSize)
             {
                 *pLen = pCacheEntry->nSize - sizeof(CENT_HDR);
@@ -273,6 +656,11 @@ const UTF8 *cache_get(Aname *nam, size_t *pLen)
         }
     }
 
+    if (!mudstate.bStandAlone)
+    {
+        nCacheMisses++;
+    }
+
     UINT32 nHash = CRC32_ProcessInteger2(nam->object, nam->attrnum);
     UINT32 iDir = hfAttributeFile.FindFirstKey(nHash);
 
@@ -295,9 +683,9 @@ const UTF8 *cache_get(Aname *nam, size_t *pLen)
                 {
                     pCacheEntry->attrKey = *nam;
                     pCacheEntry->nSize = nLength + sizeof(CENT_HDR);
-                    CacheSize += pCacheEntry->nSize;
+                    pCacheEntry->nStamp = nCacheLookups;
                     memcpy((char *)(pCacheEntry+1), TempRecord.attrText, nLength);
-                    ADD_ENTRY(pCacheEntry);
+                    ADD_ENTRY(pCacheEntry, CACHE_PROBATION);
                     hashaddLEN(nam, sizeof(Aname), pCacheEntry,
                         &mudstate.acache_htab);
 
@@ -320,8 +708,8 @@ const UTF8 *cache_get(Aname *nam, size_t *pLen)
         {
             pCacheEntry->attrKey = *nam;
             pCacheEntry->nSize = sizeof(CENT_HDR);
-            CacheSize += pCacheEntry->nSize;
-            ADD_ENTRY(pCacheEntry);
+            pCacheEntry->nStamp = nCacheLookups;
+            ADD_ENTRY(pCacheEntry, CACHE_NEGATIVE);
             hashaddLEN(nam, sizeof(Aname), pCacheEntry,
                 &mudstate.acache_htab);
 
@@ -333,6 +721,31 @@ const UTF8 *cache_get(Aname *nam, size_t *pLen)
     return nullptr;
 }
 
+// Remove every record for this attribute from a page file.
+//
+static void cache_remove(CHashFile &hf, Aname *nam, UINT32 nHash)
+{
+    UINT32 iDir = hf.FindFirstKey(nHash);
+    while (iDir != HF_FIND_END)
+    {
+        HP_HEAPLENGTH nRecord;
+        hf.Copy(iDir, &nRecord, &TempRecord);
+
+        if (  TempRecord.attrKey.attrnum == nam->attrnum
+           && TempRecord.attrKey.object  == nam->object)
+        {
+            hf.Remove(iDir);
+        }
+        iDir = hf.FindNextKey(iDir, nHash);
+    }
+}
+
+// Whether a write to this hash must also be applied to the compaction copy.
+//
+static bool compact_covers(UINT32 nHash)
+{
+    return bCompacting && nHash < nCompactNext;
+}
 
 // cache_put no longer frees the pointer.
 //
@@ -376,23 +789,17 @@ bool cache_put(Aname *nam, const UTF8 *value, size_t len)
         return true;
     }
 
-    UINT32 iDir = hfAttributeFile.FindFirstKey(nHash);
-    while (iDir != HF_FIND_END)
+    cache_remove(hfAttributeFile, nam, nHash);
+    bool bMirror = compact_covers(nHash);
+    if (bMirror)
     {
-        HP_HEAPLENGTH nRecord;
-        hfAttributeFile.Copy(iDir, &nRecord, &TempRecord);
-
-        if (  TempRecord.attrKey.attrnum == nam->attrnum
-           && TempRecord.attrKey.object  == nam->object)
-        {
-            hfAttributeFile.Remove(iDir);
-        }
-        iDir = hfAttributeFile.FindNextKey(iDir, nHash);
+        cache_remove(hfCompact, nam, nHash);
     }
 
     TempRecord.attrKey = *nam;
     memcpy(TempRecord.attrText, value, len);
     TempRecord.attrText[len-1] = '\0';
+    wal_append(nam, TempRecord.attrText, len);
 
     // Insertion into DB.
     //
@@ -401,21 +808,29 @@ bool cache_put(Aname *nam, const UTF8 *value, size_t len)
         Log.tinyprintf(T("cache_put((%d,%d), \xE2\x80\x98%s\xE2\x80\x99, %u) failed" ENDLINE),
             nam->object, nam->attrnum, value, len);
     }
+    if (  bMirror
+       && !hfCompact.Insert((HP_HEAPLENGTH)(len+sizeof(Aname)), nHash, &TempRecord))
+    {
+        compact_abort(T("the copy could not be updated"));
+    }
 
     if (!mudstate.bStandAlone)
     {
         // Update cache.
         //
+        int iSegment = CACHE_PROBATION;
         PCENT_HDR pCacheEntry = (PCENT_HDR)hashfindLEN(nam, sizeof(Aname),
             &mudstate.acache_htab);
         if (pCacheEntry)
         {
-            // It was in the cache, so delete it.
+            // It was in the cache, so delete it.  A protected value stays
+            // protected.
             //
-            REMOVE_ENTRY(pCacheEntry);
-            CacheSize -= pCacheEntry->nSize;
-            hashdeleteLEN((char *)nam, sizeof(Aname), &mudstate.acache_htab);
-            MEMFREE(pCacheEntry);
+            if (CACHE_PROTECTED == pCacheEntry->iSegment)
+            {
+                iSegment = CACHE_PROTECTED;
+            }
+            DELETE_ENTRY(pCacheEntry);
             pCacheEntry = nullptr;
         }
 
@@ -427,9 +842,9 @@ bool cache_put(Aname *nam, const UTF8 *value, size_t len)
         {
             pCacheEntry->attrKey = *nam;
             pCacheEntry->nSize = nSizeOfEntry;
-            CacheSize += pCacheEntry->nSize;
+            pCacheEntry->nStamp = nCacheLookups;
             memcpy((char *)(pCacheEntry+1), TempRecord.attrText, len);
-            ADD_ENTRY(pCacheEntry);
+            ADD_ENTRY(pCacheEntry, iSegment);
             hashaddLEN(nam, sizeof(Aname), pCacheEntry,
                 &mudstate.acache_htab);
 
@@ -439,9 +854,71 @@ bool cache_put(Aname *nam, const UTF8 *value, size_t len)
     return true;
 }
 
+/*! \brief Reports the size and hit rate of each attribute cache segment.
+ *
+ * \param player  Who to tell.
+ * \return        None.
+ */
+
+void cache_list(dbref player)
+{
+    static const UTF8 *aSegmentNames[CACHE_SEGMENTS] =
+    {
+        T("Probationary"),
+        T("Protected"),
+        T("Negative")
+    };
+
+    UTF8 buff[MBUF_SIZE];
+    UTF8 *p;
+    INT64 nHits = 0;
+    raw_notify(player, T("Attr. Cache   Entries        Bytes          Hits     Evictions"));
+    for (int i = 0; i < CACHE_SEGMENTS; i++)
+    {
+        CACHE_SEGMENT *pSeg = &aCacheSegments[i];
+        p = buff;
+        p += LeftJustifyString(p,  12, aSegmentNames[i]);     *p++ = ' ';
+        p += RightJustifyNumber(p,  8, pSeg->nEntries, ' ');  *p++ = ' ';
+        p += RightJustifyNumber(p, 12, pSeg->nSize, ' ');     *p++ = ' ';
+        p += RightJustifyNumber(p, 13, pSeg->nHits, ' ');     *p++ = ' ';
+        p += RightJustifyNumber(p, 13, pSeg->nEvictions, ' '); *p = '\0';
+        raw_notify(player, buff);
+        nHits += pSeg->nHits;
+    }
+
+    INT64 nLookups = nHits + nCacheMisses;
+    int iPercent = 0;
+    if (0 < nLookups)
+    {
+        iPercent = static_cast<int>((100 * nHits) / nLookups);
+    }
+    raw_notify(player, tprintf(T("\nSize %llu of %u bytes.  Misses %s.  Hit rate %d%%."),
+        static_cast<UINT64>(CacheSize), mudconf.max_cache_size, mux_i64toa_t(nCacheMisses),
+        iPercent));
+    if (MUX_OPEN_INVALID_HANDLE_VALUE != hWalFile)
+    {
+        raw_notify(player, tprintf(T("Redo log: %u records in %u commits."),
+            nWalRecords, nWalCommits));
+    }
+}
+
 bool cache_sync(void)
 {
-    hfAttributeFile.Sync();
+    if (!hfAttributeFile.Sync())
+    {
+        // The log is still the only durable copy of some writes, so it is
+        // kept until a later checkpoint succeeds.
+        //
+        Log.WriteString(T("Checkpoint could not sync the page file. Keeping the redo log." ENDLINE));
+        return false;
+    }
+
+    // The page file now holds everything in the log.
+    //
+    if (MUX_OPEN_INVALID_HANDLE_VALUE != hWalFile)
+    {
+        wal_reset();
+    }
     return true;
 }
 
@@ -465,20 +942,12 @@ void cache_del(Aname *nam)
 #endif // HAVE_WORKING_FORK
 
     UINT32 nHash = CRC32_ProcessInteger2(nam->object, nam->attrnum);
-    UINT32 iDir = hfAttributeFile.FindFirstKey(nHash);
-
-    while (iDir != HF_FIND_END)
+    cache_remove(hfAttributeFile, nam, nHash);
+    if (compact_covers(nHash))
     {
-        HP_HEAPLENGTH nRecord;
-        hfAttributeFile.Copy(iDir, &nRecord, &TempRecord);
-
-        if (  TempRecord.attrKey.attrnum == nam->attrnum
-           && TempRecord.attrKey.object == nam->object)
-        {
-            hfAttributeFile.Remove(iDir);
-        }
-        iDir = hfAttributeFile.FindNextKey(iDir, nHash);
+        cache_remove(hfCompact, nam, nHash);
     }
+    wal_append(nam, T(""), 0);
 
     if (!mudstate.bStandAlone)
     {
@@ -490,13 +959,285 @@ void cache_del(Aname *nam)
         {
             // It was in the cache, so delete it.
             //
-            REMOVE_ENTRY(pCacheEntry);
-            CacheSize -= pCacheEntry->nSize;;
-            hashdeleteLEN((char *)nam, sizeof(Aname), &mudstate.acache_htab);
-            MEMFREE(pCacheEntry);
+            DELETE_ENTRY(pCacheEntry);
             pCacheEntry = nullptr;
         }
     }
 }
 
+static void compact_abort(const UTF8 *pReason)
+{
+    hfCompact.CloseAll();
+    RemoveFile(pCompactDir);
+    RemoveFile(pCompactPag);
+    bCompacting = false;
+
+    STARTLOG(LOG_ALWAYS, "DMP", "CMPCT");
+    log_text(T("Compaction of the page file abandoned: "));
+    log_text(pReason);
+    ENDLOG;
+}
+
+// Make the renames in the directory holding the page file durable.
+//
+static void compact_sync_directory(void)
+{
+#if defined(UNIX_FILES)
+    UTF8 *pDirName = StringClone(pGamePag);
+    UTF8 *p = (UTF8 *)strrchr((char *)pDirName, '/');
+    if (nullptr == p)
+    {
+        pDirName[0] = '.';
+        pDirName[1] = '\0';
+    }
+    else if (p == pDirName)
+    {
+        p[1] = '\0';
+    }
+    else
+    {
+        p[0] = '\0';
+    }
+
+    int h;
+    if (mux_open(&h, pDirName, O_RDONLY))
+    {
+        if (0 != fsync(h))
+        {
+            Log.tinyprintf(T("Compaction could not sync the directory %s (errno %d)." ENDLINE),
+                pDirName, errno);
+        }
+        mux_close(h);
+    }
+    MEMFREE(pDirName);
+#endif // UNIX_FILES
+}
+
+// The copy holds every record, so it replaces the original.  The original
+// pair is first moved aside under its backup names, directory file first: at
+// any point, a crash leaves either a page file without a directory (which is
+// rebuilt on startup), a matched pair, or the original pair under its backup
+// names (which cache_init() puts back).  Returns how many of the four renames
+// succeeded.
+//
+static int compact_swap(void)
+{
+    RemoveFile(pBackupDir);
+    RemoveFile(pBackupPag);
+    if (0 != ReplaceFile(pGameDir, pBackupDir))
+    {
+        return 0;
+    }
+    if (0 != ReplaceFile(pGamePag, pBackupPag))
+    {
+        return 1;
+    }
+    if (0 != ReplaceFile(pCompactPag, pGamePag))
+    {
+        return 2;
+    }
+    if (0 != ReplaceFile(pCompactDir, pGameDir))
+    {
+        return 3;
+    }
+    return 4;
+}
+
+// Undo the first nSwapped renames of compact_swap().
+//
+static void compact_unswap(int nSwapped)
+{
+    if (4 <= nSwapped)
+    {
+        RemoveFile(pGameDir);
+    }
+    if (3 <= nSwapped)
+    {
+        RemoveFile(pGamePag);
+    }
+    if (2 <= nSwapped)
+    {
+        ReplaceFile(pBackupPag, pGamePag);
+    }
+    if (1 <= nSwapped)
+    {
+        ReplaceFile(pBackupDir, pGameDir);
+    }
+    RemoveFile(pCompactDir);
+    RemoveFile(pCompactPag);
+}
+
+static void compact_finish(void)
+{
+    if (!hfCompact.Sync())
+    {
+        compact_abort(T("the new page file could not be synced"));
+        return;
+    }
+    UINT32 nAfter = hfCompact.GetPageCount();
+    hfCompact.CloseAll();
+    hfAttributeFile.CloseAll();
+    bCompacting = false;
+
+    int nSwapped = compact_swap();
+    int cc = HF_OPEN_STATUS_ERROR;
+    if (4 == nSwapped)
+    {
+        compact_sync_directory();
+        cc = hfAttributeFile.Open(pGameDir, pGamePag, nGameCachePages,
+            mudconf.cache_mmap);
+    }
+    if (HF_OPEN_STATUS_ERROR == cc)
+    {
+        // Go back to the original page file.  The redo log still holds
+        // everything written since it was last synced.
+        //
+        compact_unswap(nSwapped);
+        compact_sync_directory();
+        cc = hfAttributeFile.Open(pGameDir, pGamePag, nGameCachePages,
+            mudconf.cache_mmap);
+        if (HF_OPEN_STATUS_ERROR == cc)
+        {
+            Log.WriteString(T("Compaction could not re-open the original page file either. Aborting." ENDLINE));
+            Log.Flush();
+            abort();
+        }
+        STARTLOG(LOG_ALWAYS, "DMP", "CMPCT");
+        log_text(T("Compaction could not put the new page file into place. The original was restored."));
+        ENDLOG;
+        return;
+    }
+    RemoveFile(pBackupDir);
+    RemoveFile(pBackupPag);
+
+    // The new page file has been synced, so the redo log can be emptied.
+    //
+    wal_reset();
+
+    nLastCompactBefore = nCompactPagesBefore;
+    nLastCompactAfter  = nAfter;
+    STARTLOG(LOG_ALWAYS, "DMP", "CMPCT");
+    log_printf(T("Compacted the page file from %u pages to %u pages."),
+        nCompactPagesBefore, nAfter);
+    ENDLOG;
+}
+
+static void dispatch_CompactStep(void *pUnused, int iUnused)
+{
+    UNUSED_PARAMETER(pUnused);
+    UNUSED_PARAMETER(iUnused);
+
+    if (!bCompacting)
+    {
+        return;
+    }
+
+    // A forked dump may still be reading the original, so the swap waits
+    // until it is done.
+    //
+    if (!mudstate.dumping)
+    {
+        // A step that copies nothing would reschedule itself forever.
+        //
+        int nPages = mudconf.cache_compact_pages;
+        if (nPages < 1)
+        {
+            nPages = 1;
+        }
+
+        const UTF8 *cmdsave = mudstate.debug_cmd;
+        mudstate.debug_cmd = T("< compact >");
+        for (int i = 0; i < nPages; i++)
+        {
+            UINT32 nNext;
+            bool bLast;
+            if (!hfAttributeFile.CopyPage(nCompactNext, hfCompact, &nNext, &bLast))
+            {
+                compact_abort(T("a page could not be copied"));
+                mudstate.debug_cmd = cmdsave;
+                return;
+            }
+            nCompactPagesRead++;
+            if (bLast)
+            {
+                compact_finish();
+                mudstate.debug_cmd = cmdsave;
+                return;
+            }
+            nCompactNext = nNext;
+        }
+        mudstate.debug_cmd = cmdsave;
+    }
+
+    CLinearTimeAbsolute ltaNextTime;
+    ltaNextTime.GetUTC();
+    ltaNextTime += time_250ms;
+    scheduler.DeferTask(ltaNextTime, PRIORITY_SYSTEM, dispatch_CompactStep, 0, 0);
+}
+
+/*! \brief Starts compacting the attribute page file in the background.
+ *
+ * \param player  Who to tell.
+ * \return        None.
+ */
+
+void cache_compact(dbref player)
+{
+    if (  !cache_initted
+       || mudstate.bStandAlone)
+    {
+        return;
+    }
+    if (bCompacting)
+    {
+        notify(player, T("The page file is already being compacted."));
+        return;
+    }
+
+    if (nullptr == pCompactDir)
+    {
+        pCompactDir = StringClone(tprintf(T("%s.compact"), pGameDir));
+        pCompactPag = StringClone(tprintf(T("%s.compact"), pGamePag));
+        pBackupDir = StringClone(tprintf(T("%s.precompact"), pGameDir));
+        pBackupPag = StringClone(tprintf(T("%s.precompact"), pGamePag));
+    }
+    RemoveFile(pCompactDir);
+    RemoveFile(pCompactPag);
+
+    hfCompact.SetScratch(true);
+    if (HF_OPEN_STATUS_NEW != hfCompact.Open(pCompactDir, pCompactPag, 8, false))
+    {
+        hfCompact.CloseAll();
+        notify(player, T("Could not create the compacted page file."));
+        return;
+    }
+
+    bCompacting = true;
+    nCompactNext = 0;
+    nCompactPagesRead = 0;
+    nCompactPagesBefore = hfAttributeFile.GetPageCount();
+
+    CLinearTimeAbsolute ltaNextTime;
+    ltaNextTime.GetUTC();
+    scheduler.DeferTask(ltaNextTime, PRIORITY_SYSTEM, dispatch_CompactStep, 0, 0);
+    notify(player, tprintf(T("Compacting the page file (%u pages)."),
+        nCompactPagesBefore));
+}
+
+void cache_list_compaction(dbref player)
+{
+    if (bCompacting)
+    {
+        int iPercent = static_cast<int>((100 * static_cast<UINT64>(nCompactNext)) >> 32);
+        raw_notify(player, tprintf(T("\nCompaction %11d%%  (%u of about %u pages read, %u written)"),
+            iPercent, nCompactPagesRead, nCompactPagesBefore,
+            hfCompact.GetPageCount()));
+    }
+    else if (0 < nLastCompactBefore)
+    {
+        raw_notify(player, tprintf(T("\nCompaction   last run went from %u pages to %u."),
+            nLastCompactBefore, nLastCompactAfter));
+    }
+}
+
 #endif // MEMORY_BASED
@@ -20,7 +20,12 @@ extern int  cache_init(const UTF8 *game_dir_file, const UTF8 *game_pag_file,
     int nCachePages);
 extern void cache_close(void);
 extern void cache_tick(void);
+extern void cache_prefetch(void);
 extern bool cache_sync(void);
+extern void cache_commit(void);
 extern void cache_del(Aname *nam);
+extern void cache_list(dbref player);
+extern void cache_compact(dbref player);
+extern void cache_list_compaction(dbref player);
 
 #endif // !_ATTRCACHE_H
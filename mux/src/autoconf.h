@@ -28,6 +28,12 @@
 /* Define to 1 if you have the `crypt' function. */
 #define HAVE_CRYPT 1
 
+/* Define to 1 if you have the <crypt.h> header file. */
+#define HAVE_CRYPT_H 1
+
+/* Define to 1 if you have the `crypt_r' function. */
+#define HAVE_CRYPT_R 1
+
 /* define if the compiler supports basic C++11 syntax */
 #define HAVE_CXX11 1
 
@@ -67,6 +73,9 @@
 /* Define to 1 if you have the <fcntl.h> header file. */
 #define HAVE_FCNTL_H 1
 
+/* Define to 1 if you have the `fdatasync' function. */
+#define HAVE_FDATASYNC 1
+
 /* Define if fegetprec is available. */
 /* #undef HAVE_FEGETPREC */
 
@@ -148,9 +157,15 @@
 /* Define to 1 if you have the `mysqlclient' library (-lmysqlclient). */
 /* #undef HAVE_LIBMYSQLCLIENT */
 
+/* Define to 1 if you have the `pthread' library (-lpthread). */
+#define HAVE_LIBPTHREAD 1
+
 /* Define to 1 if you have the `ssl' library (-lssl). */
 /* #undef HAVE_LIBSSL */
 
+/* Define to 1 if you have the `z' library (-lz). */
+#define HAVE_LIBZ 1
+
 /* Define to 1 if you have the <limits.h> header file. */
 #define HAVE_LIMITS_H 1
 
@@ -163,12 +178,21 @@
 /* Define to 1 if you have the `log2' function. */
 #define HAVE_LOG2 1
 
+/* Define to 1 if you have the `madvise' function. */
+#define HAVE_MADVISE 1
+
 /* Define to 1 if you have the <malloc.h> header file. */
 #define HAVE_MALLOC_H 1
 
 /* Define to 1 if you have the <memory.h> header file. */
 #define HAVE_MEMORY_H 1
 
+/* Define to 1 if you have the `mmap' function. */
+#define HAVE_MMAP 1
+
+/* Define to 1 if you have the `msync' function. */
+#define HAVE_MSYNC 1
+
 /* Define if mysql exists. */
 /* #undef HAVE_MYSQL */
 
@@ -193,6 +217,9 @@
 /* Define if pwrite exists. */
 #define HAVE_PWRITE /**/
 
+/* Define to 1 if you have the <pthread.h> header file. */
+#define HAVE_PTHREAD_H 1
+
 /* Define to 1 if you have the `select' function. */
 #define HAVE_SELECT 1
 
@@ -257,6 +284,9 @@
 /* Define to 1 if you have the <sys/ioctl.h> header file. */
 #define HAVE_SYS_IOCTL_H 1
 
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#define HAVE_SYS_MMAN_H 1
+
 /* Define to 1 if you have the <sys/ndir.h> header file, and it defines `DIR'.
    */
 /* #undef HAVE_SYS_NDIR_H */
@@ -317,6 +347,9 @@
 /* Define to 1 if `vfork' works. */
 #define HAVE_WORKING_VFORK 1
 
+/* Define to 1 if you have the <zlib.h> header file. */
+#define HAVE_ZLIB_H 1
+
 /* Define is ieeefp.h is useable. */
 /* #undef IEEEFP_H_USEABLE */
 
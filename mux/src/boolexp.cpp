@@ -19,6 +19,11 @@
 
 static bool parsing_internal = false;
 
+// Set by the parser when the result depends on the player doing the parsing
+// or on database state that can change without touching the lock itself.
+//
+static bool parsing_uncacheable = false;
+
 /* ---------------------------------------------------------------------------
  * check_attr: indicate if attribute ATTR on player passes key when checked by
  * the object lockobj
@@ -66,7 +71,6 @@ bool eval_boolexp(dbref player, dbref thing, dbref from, BOOLEXP *b)
     dbref aowner, obj, source;
     int aflags;
     UTF8 *buff, *buff2, *bp;
-    UTF8 *key;
     ATTR *a;
     bool bCheck, c;
 
@@ -129,9 +133,7 @@ bool eval_boolexp(dbref player, dbref thing, dbref from, BOOLEXP *b)
             mudstate.lock_nest_lev--;
             return false;
         }
-        key = atr_get("boolexp.130", b->sub1->thing, A_LOCK, &aowner, &aflags);
-        c = eval_boolexp_atr(player, b->sub1->thing, from, key);
-        free_lbuf(key);
+        c = eval_boolexp_lock(player, b->sub1->thing, from, A_LOCK);
         mudstate.lock_nest_lev--;
         return c;
 
@@ -287,6 +289,131 @@ bool eval_boolexp_atr(dbref player, dbref thing, dbref from, UTF8 *key)
     return ret_value;
 }
 
+/* ---------------------------------------------------------------------------
+ * Parsed lock cache.
+ *
+ * Parsed lock trees are kept in lock_htab keyed by object and lock attribute
+ * number, and lock_cache_clear() drops an entry whenever its attribute is
+ * written.  A lock may rewrite itself while it is being evaluated, so an
+ * entry in use is only unlinked and is freed after its last evaluation.
+ */
+
+typedef struct
+{
+    dbref thing;
+    int   atr;
+} LOCK_KEY;
+
+typedef struct
+{
+    BOOLEXP *b;
+    int      nRefs;     // Evaluations currently using b.
+    bool     bStale;    // Unlinked from lock_htab while in use.
+} LOCK_ENTRY;
+
+// Lock attributes which have ever been cached.  This keeps other attribute
+// writes from probing lock_htab.
+//
+static bool abLockCached[A_USER_START];
+
+static void lock_entry_free(LOCK_ENTRY *ple)
+{
+    free_boolexp(ple->b);
+    MEMFREE(ple);
+}
+
+void lock_cache_clear(dbref thing, int atr)
+{
+    if (  atr < 0
+       || A_USER_START <= atr
+       || !abLockCached[atr])
+    {
+        return;
+    }
+
+    LOCK_KEY key;
+    key.thing = thing;
+    key.atr   = atr;
+    LOCK_ENTRY *ple = (LOCK_ENTRY *)hashfindLEN(&key, sizeof(key),
+        &mudstate.lock_htab);
+    if (nullptr != ple)
+    {
+        hashdeleteLEN(&key, sizeof(key), &mudstate.lock_htab);
+        if (0 < ple->nRefs)
+        {
+            ple->bStale = true;
+        }
+        else
+        {
+            lock_entry_free(ple);
+        }
+    }
+}
+
+bool eval_boolexp_lock(dbref player, dbref thing, dbref from, int locknum)
+{
+    dbref aowner;
+    int   aflags;
+    UTF8 *text;
+
+    if (  locknum < 0
+       || A_USER_START <= locknum)
+    {
+        text = atr_get("eval_boolexp_lock.user", thing, locknum, &aowner, &aflags);
+        bool bResult = eval_boolexp_atr(player, thing, from, text);
+        free_lbuf(text);
+        return bResult;
+    }
+
+    LOCK_KEY key;
+    key.thing = thing;
+    key.atr   = locknum;
+    LOCK_ENTRY *ple = (LOCK_ENTRY *)hashfindLEN(&key, sizeof(key),
+        &mudstate.lock_htab);
+    if (nullptr == ple)
+    {
+        text = atr_get("eval_boolexp_lock", thing, locknum, &aowner, &aflags);
+        parsing_uncacheable = false;
+        BOOLEXP *b = parse_boolexp(player, text, true);
+        free_lbuf(text);
+
+        if (!parsing_uncacheable)
+        {
+            ple = (LOCK_ENTRY *)MEMALLOC(sizeof(LOCK_ENTRY));
+            ISOUTOFMEMORY(ple);
+            ple->b      = b;
+            ple->nRefs  = 0;
+            ple->bStale = false;
+            if (hashaddLEN(&key, sizeof(key), ple, &mudstate.lock_htab))
+            {
+                abLockCached[locknum] = true;
+            }
+            else
+            {
+                MEMFREE(ple);
+                ple = nullptr;
+            }
+        }
+
+        if (nullptr == ple)
+        {
+            bool bResult = eval_boolexp(player, thing, from, b);
+            free_boolexp(b);
+            return bResult;
+        }
+    }
+
+    ple->nRefs++;
+    bool bResult = eval_boolexp(player, thing, from, ple->b);
+    ple->nRefs--;
+    if (  ple->bStale
+       && 0 == ple->nRefs)
+    {
+        lock_entry_free(ple);
+    }
+    return bResult;
+}
+
 // If the parser returns TRUE_BOOLEXP, you lose
 // TRUE_BOOLEXP cannot be typed in by the user; use @unlock instead
 //
@@ -343,6 +470,7 @@ static BOOLEXP *test_atr(UTF8 *s)
     {
         // Only #1 can lock on numbers
         //
+        parsing_uncacheable = true;
         if (!God(parse_player))
         {
             free_lbuf(buff);
@@ -457,6 +585,7 @@ static BOOLEXP *parse_boolexp_L(void)
                 b->thing = mux_atol(&buf[1]);
                 if (!Good_dbref(b->thing))
                 {
+                    parsing_uncacheable = true;
                     free_lbuf(buf);
                     free_bool(b);
                     return TRUE_BOOLEXP;
@@ -16,7 +16,19 @@
 #include <sys/ioctl.h>
 #endif // HAVE_SYS_IOCTL_H
 
+#if defined(UNIX_NETWORKING)
+#include <sys/uio.h>
+
+// Number of output blocks gathered into one writev() call. POSIX guarantees
+// that IOV_MAX is at least this large.
+//
+#define OUTPUT_IOV_MAX 16
+#endif // UNIX_NETWORKING
+
 #include <csignal>
+#if defined(UNIX_THREADS)
+#include <atomic>
+#endif // UNIX_THREADS
 
 #include "attrs.h"
 #include "command.h"
@@ -55,6 +67,9 @@ static DESC *new_connection(PortInfo *Port, int *piError);
 #endif
 static bool process_input(DESC *);
 static int make_nonblocking(SOCKET s);
+#if defined(UNIX_ZLIB)
+static void mccp_end(DESC *d, bool bFinish);
+#endif // UNIX_ZLIB
 
 pid_t game_pid;
 
@@ -356,6 +371,547 @@ static int get_slave_result(void)
 int maxd = 0;
 #endif // UNIX_NETWORKING_SELECT
 
+#if defined(UNIX_NETWORKING_EPOLL)
+
+// Sockets are registered with epoll once and stay registered until they are
+// closed.  The data pointer of each event identifies the source: network
+// descriptors use their DESC, listening ports use their PortInfo, and the
+// slave sockets use the address of the variable that holds them.
+//
+#define EPOLL_MAX_EVENTS 256
+
+static int epoll_fd = -1;
+static struct epoll_event aEpollEvents[EPOLL_MAX_EVENTS];
+static int nEpollEvents = 0;
+static int iEpollEvent = 0;
+
+/*! \brief Change the set of events epoll reports for a socket.
+ *
+ * A socket with no events of interest is removed from the epoll set
+ * entirely. Otherwise, a peer hang-up would be reported on every pass even
+ * though we are not ready to read from it.
+ *
+ * \param s          Socket.
+ * \param p          Pointer returned with events for this socket.
+ * \param oldEvents  Events currently registered.
+ * \param newEvents  Events to register.
+ * \return           None.
+ */
+
+static void epoll_change(SOCKET s, void *p, UINT32 oldEvents, UINT32 newEvents)
+{
+    if (  epoll_fd < 0
+       || IS_INVALID_SOCKET(s)
+       || oldEvents == newEvents)
+    {
+        return;
+    }
+
+    int op;
+    if (0 == oldEvents)
+    {
+        op = EPOLL_CTL_ADD;
+    }
+    else if (0 == newEvents)
+    {
+        op = EPOLL_CTL_DEL;
+    }
+    else
+    {
+        op = EPOLL_CTL_MOD;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = newEvents;
+    ev.data.ptr = p;
+    if (  epoll_ctl(epoll_fd, op, s, &ev) < 0
+       && (  EPOLL_CTL_ADD != op
+          || EEXIST != errno
+          || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s, &ev) < 0))
+    {
+        log_perror(T("NET"), T("FAIL"), nullptr, T("epoll_ctl"));
+    }
+}
+
+/*! \brief Discard events not yet handled for a source which is going away.
+ *
+ * Events are handled in batches, and handling one event can close another
+ * socket whose event is still waiting later in the same batch.
+ *
+ * \param p          Pointer identifying the source.
+ * \return           None.
+ */
+
+static void epoll_forget(const void *p)
+{
+    for (int i = iEpollEvent + 1; i < nEpollEvents; i++)
+    {
+        if (aEpollEvents[i].data.ptr == p)
+        {
+            aEpollEvents[i].data.ptr = nullptr;
+        }
+    }
+}
+
+/*! \brief Bring the epoll registration of a network descriptor up to date.
+ *
+ * Input is only requested while the descriptor has no unprocessed commands,
+ * and output is only requested while the output queue is non-empty. This
+ * should be called whenever input_head or output_head changes between empty
+ * and non-empty.
+ *
+ * \param d          Network descriptor state.
+ * \return           None.
+ */
+
+void update_desc_events(DESC *d)
+{
+    UINT32 events = 0;
+    if (nullptr == d->input_head)
+    {
+        events |= EPOLLIN;
+    }
+    if (nullptr != d->output_head)
+    {
+        events |= EPOLLOUT;
+    }
+
+    if (  0 <= epoll_fd
+       && !IS_INVALID_SOCKET(d->descriptor))
+    {
+        epoll_change(d->descriptor, d, d->epoll_events, events);
+        d->epoll_events = events;
+    }
+}
+
+#endif // UNIX_NETWORKING_EPOLL
+
+#if defined(UNIX_THREADS)
+
+// Helper threads finish their work while the game thread may be waiting in
+// select() or epoll_wait().  They wake it by writing to a pipe which the main
+// loop watches.  Only one byte is outstanding at a time.
+//
+static int aWakePipe[2] = { -1, -1 };
+static std::atomic<bool> bWakePosted(false);
+
+/*! \brief Create the pipe used to wake the game thread.
+ *
+ * It is safe to call this more than once.  Called on the game thread.
+ *
+ * \return  true if the pipe is ready.
+ */
+
+bool wake_init(void)
+{
+    if (0 <= aWakePipe[0])
+    {
+        return true;
+    }
+
+    int aPipe[2];
+    if (0 != pipe(aPipe))
+    {
+        log_perror(T("NET"), T("FAIL"), T("wake pipe"), T("pipe"));
+        return false;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(aPipe[i], F_SETFD, FD_CLOEXEC);
+        make_nonblocking(aPipe[i]);
+    }
+    aWakePipe[0] = aPipe[0];
+    aWakePipe[1] = aPipe[1];
+
+#if defined(UNIX_NETWORKING_SELECT)
+    if (maxd <= aWakePipe[0])
+    {
+        maxd = aWakePipe[0] + 1;
+    }
+#elif defined(UNIX_NETWORKING_EPOLL)
+    epoll_change(aWakePipe[0], aWakePipe, 0, EPOLLIN);
+#endif // UNIX_NETWORKING_EPOLL
+    return true;
+}
+
+/*! \brief Wake the game thread.
+ *
+ * May be called from any thread.
+ *
+ * \return  None.
+ */
+
+void wake_game_thread(void)
+{
+    if (  0 <= aWakePipe[1]
+       && !bWakePosted.exchange(true))
+    {
+        const char ch = 0;
+        if (write(aWakePipe[1], &ch, 1) < 0)
+        {
+            ; // The pipe is full, so a wake-up is already pending.
+        }
+    }
+}
+
+#endif // UNIX_THREADS
+
+/*! \brief Record a host name found for an address.
+ *
+ * Every descriptor still showing the address is given the name.  If it is
+ * connected, the player's LASTSITE and LASTIP are brought up to date.
+ *
+ * \param host_address  Address as text.
+ * \param host_name     Name found for it.
+ * \return              None.
+ */
+
+static void update_host_name(const UTF8 *host_address, const UTF8 *host_name)
+{
+    DESC *d;
+    DESC_ITER_ALL(d)
+    {
+        if (strcmp((char *)d->addr, (char *)host_address) != 0)
+        {
+            continue;
+        }
+
+        mux_strncpy(d->addr, host_name, sizeof(d->addr)-1);
+        if (d->player != 0)
+        {
+            if (d->username[0])
+            {
+                atr_add_raw(d->player, A_LASTSITE, tprintf(T("%s@%s"),
+                    d->username, d->addr));
+            }
+            else
+            {
+                atr_add_raw(d->player, A_LASTSITE, d->addr);
+            }
+            atr_add_raw(d->player, A_LASTIP, host_address);
+        }
+    }
+}
+
+#if defined(UNIX_THREADS)
+
+// Reverse lookups are made by a pool of threads inside the server, so a slow
+// lookup only ties up one of them.  Results are kept in a cache keyed by the
+// address text: names for resolver_cache_ttl seconds, and failures for
+// resolver_negative_ttl seconds.  Connections from an address already being
+// looked up wait for that lookup instead of starting another.  A finished
+// lookup wakes the game thread and is applied from the scheduler.
+//
+// The threads use getnameinfo(), so /etc/hosts and the nameservers in
+// resolv.conf apply as they do for any other program.
+//
+#define RESOLVER_MAX_THREADS 64
+#define RESOLVER_CACHE_MAX   4096
+
+typedef struct resolver_entry RESOLVER_ENTRY;
+struct resolver_entry
+{
+    RESOLVER_ENTRY     *pNext;          // Job queue or finished list.
+    mux_sockaddr        msa;
+    bool                bPending;       // A lookup is queued or running.
+    bool                bFound;         // aName is valid.
+    CLinearTimeAbsolute ltaExpires;
+    UTF8                aAddress[SBUF_SIZE];
+    UTF8                aName[MBUF_SIZE];
+};
+
+static CHashTable       htabResolver;
+static int              nResolverEntries = 0;
+static int              nResolverThreads = 0;
+static bool             bResolverStarted = false;
+static pthread_mutex_t  mtxResolver = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   cvResolver = PTHREAD_COND_INITIALIZER;
+static RESOLVER_ENTRY  *pResolverHead = nullptr;      // Guarded by mtxResolver.
+static RESOLVER_ENTRY  *pResolverTail = nullptr;
+static RESOLVER_ENTRY  *pResolverDone = nullptr;      // Guarded by mtxResolver.
+
+static void *resolver_thread(void *pArg)
+{
+    UNUSED_PARAMETER(pArg);
+
+    pthread_mutex_lock(&mtxResolver);
+    for (;;)
+    {
+        RESOLVER_ENTRY *pe = pResolverHead;
+        if (nullptr == pe)
+        {
+            pthread_cond_wait(&cvResolver, &mtxResolver);
+            continue;
+        }
+        pResolverHead = pe->pNext;
+        if (nullptr == pResolverHead)
+        {
+            pResolverTail = nullptr;
+        }
+        pthread_mutex_unlock(&mtxResolver);
+
+        // Only this thread touches the entry until it is handed back.
+        //
+        char host[NI_MAXHOST];
+        pe->bFound = (  0 == getnameinfo(pe->msa.saro(), pe->msa.salen(),
+                                         host, sizeof(host), nullptr, 0, NI_NAMEREQD)
+                     && strlen(host) < sizeof(pe->aName));
+        if (pe->bFound)
+        {
+            mux_strncpy(pe->aName, (UTF8 *)host, sizeof(pe->aName)-1);
+        }
+
+        pthread_mutex_lock(&mtxResolver);
+        pe->pNext = pResolverDone;
+        pResolverDone = pe;
+        wake_game_thread();
+    }
+    return nullptr;
+}
+
+static bool resolver_start(void)
+{
+    if (bResolverStarted)
+    {
+        return (0 < nResolverThreads);
+    }
+    bResolverStarted = true;
+
+    int nWanted = mudconf.resolver_threads;
+    if (RESOLVER_MAX_THREADS < nWanted)
+    {
+        nWanted = RESOLVER_MAX_THREADS;
+    }
+    if (  nWanted <= 0
+       || !wake_init())
+    {
+        return false;
+    }
+
+    // The threads should never see the game's signals.
+    //
+    sigset_t sigAll, sigSave;
+    sigfillset(&sigAll);
+    pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+    while (nResolverThreads < nWanted)
+    {
+        pthread_t thread;
+        if (0 != pthread_create(&thread, nullptr, resolver_thread, nullptr))
+        {
+            break;
+        }
+        pthread_detach(thread);
+        nResolverThreads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
+
+    STARTLOG(LOG_STARTUP, "NET", "DNS");
+    log_printf(T("Started %d of %d resolver threads."), nResolverThreads, nWanted);
+    ENDLOG;
+    return (0 < nResolverThreads);
+}
+
+/*! \brief Make room in the resolver cache.
+ *
+ * Expired entries are dropped first.  If that is not enough, the entry
+ * closest to expiring goes.  Entries with a lookup running are kept.
+ *
+ * \param bAll  Drop every entry which is not being looked up.
+ * \return      None.
+ */
+
+static void resolver_trim(bool bAll)
+{
+    CLinearTimeAbsolute ltaNow;
+    ltaNow.GetUTC();
+
+    // Collect the victims first.  The table cannot be changed while it is
+    // being walked.
+    //
+    RESOLVER_ENTRY **apVictims = (RESOLVER_ENTRY **)MEMALLOC((nResolverEntries + 1) * sizeof(RESOLVER_ENTRY *));
+    ISOUTOFMEMORY(apVictims);
+    int nVictims = 0;
+
+    RESOLVER_ENTRY *pOldest = nullptr;
+    for (RESOLVER_ENTRY *pe = (RESOLVER_ENTRY *)hash_firstentry(&htabResolver);
+         nullptr != pe;
+         pe = (RESOLVER_ENTRY *)hash_nextentry(&htabResolver))
+    {
+        if (pe->bPending)
+        {
+            continue;
+        }
+        else if (  bAll
+                || pe->ltaExpires <= ltaNow)
+        {
+            apVictims[nVictims++] = pe;
+        }
+        else if (  nullptr == pOldest
+                || pe->ltaExpires < pOldest->ltaExpires)
+        {
+            pOldest = pe;
+        }
+    }
+
+    if (  RESOLVER_CACHE_MAX <= nResolverEntries - nVictims
+       && nullptr != pOldest)
+    {
+        apVictims[nVictims++] = pOldest;
+    }
+
+    for (int i = 0; i < nVictims; i++)
+    {
+        RESOLVER_ENTRY *pe = apVictims[i];
+        hashdeleteLEN(pe->aAddress, strlen((char *)pe->aAddress), &htabResolver);
+        delete pe;
+        nResolverEntries--;
+    }
+    MEMFREE(apVictims);
+}
+
+/*! \brief Look up the host name for a new connection.
+ *
+ * A cached name is applied at once.  Otherwise, the name is applied to the
+ * descriptor when the lookup finishes.
+ *
+ * \param d  Network descriptor.
+ * \return   None.
+ */
+
+static void resolver_lookup(DESC *d)
+{
+    if (  !mudconf.use_hostname
+       || !resolver_start())
+    {
+        return;
+    }
+
+    size_t nAddress = strlen((char *)d->addr);
+    if (  0 == nAddress
+       || SBUF_SIZE <= nAddress)
+    {
+        return;
+    }
+
+    CLinearTimeAbsolute ltaNow;
+    ltaNow.GetUTC();
+
+    RESOLVER_ENTRY *pe = (RESOLVER_ENTRY *)hashfindLEN(d->addr, nAddress, &htabResolver);
+    if (nullptr != pe)
+    {
+        if (pe->bPending)
+        {
+            // The running lookup will take care of this descriptor, too.
+            //
+            return;
+        }
+        else if (ltaNow < pe->ltaExpires)
+        {
+            if (pe->bFound)
+            {
+                update_host_name(pe->aAddress, pe->aName);
+            }
+            return;
+        }
+    }
+    else
+    {
+        if (RESOLVER_CACHE_MAX <= nResolverEntries)
+        {
+            resolver_trim(false);
+        }
+        pe = nullptr;
+        try
+        {
+            pe = new RESOLVER_ENTRY();
+        }
+        catch (...)
+        {
+            ; // Nothing.
+        }
+        ISOUTOFMEMORY(pe);
+        mux_strncpy(pe->aAddress, d->addr, sizeof(pe->aAddress)-1);
+        hashaddLEN(pe->aAddress, nAddress, pe, &htabResolver);
+        nResolverEntries++;
+    }
+
+    pe->msa = d->address;
+    pe->bPending = true;
+    pe->bFound = false;
+    pe->aName[0] = '\0';
+    pe->pNext = nullptr;
+
+    pthread_mutex_lock(&mtxResolver);
+    if (nullptr == pResolverTail)
+    {
+        pResolverHead = pe;
+    }
+    else
+    {
+        pResolverTail->pNext = pe;
+    }
+    pResolverTail = pe;
+    pthread_cond_signal(&cvResolver);
+    pthread_mutex_unlock(&mtxResolver);
+}
+
+static void Task_ResolverDone(void *arg_voidptr, int arg_iInteger)
+{
+    UNUSED_PARAMETER(arg_iInteger);
+
+    RESOLVER_ENTRY *pe = (RESOLVER_ENTRY *)arg_voidptr;
+    pe->bPending = false;
+
+    CLinearTimeDelta ltd;
+    ltd.SetSeconds(pe->bFound ? mudconf.resolver_cache_ttl : mudconf.resolver_negative_ttl);
+    pe->ltaExpires.GetUTC();
+    pe->ltaExpires += ltd;
+
+    if (  pe->bFound
+       && mudconf.use_hostname)
+    {
+        update_host_name(pe->aAddress, pe->aName);
+    }
+}
+
+/*! \brief Hand finished lookups to the scheduler.
+ *
+ * \return  None.
+ */
+
+static void resolver_reap(void)
+{
+    pthread_mutex_lock(&mtxResolver);
+    RESOLVER_ENTRY *pe = pResolverDone;
+    pResolverDone = nullptr;
+    pthread_mutex_unlock(&mtxResolver);
+
+    while (nullptr != pe)
+    {
+        RESOLVER_ENTRY *pNext = pe->pNext;
+        pe->pNext = nullptr;
+        scheduler.DeferImmediateTask(PRIORITY_SYSTEM, Task_ResolverDone, pe, 0);
+        pe = pNext;
+    }
+}
+
+#endif // UNIX_THREADS
+
+#if defined(UNIX_THREADS)
+static void wake_run(void)
+{
+    char buf[64];
+    while (0 < read(aWakePipe[0], buf, sizeof(buf)))
+    {
+        ; // Nothing.
+    }
+    bWakePosted = false;
+    pass_reap();
+    resolver_reap();
+}
+#endif // UNIX_THREADS
+
 #if defined(HAVE_WORKING_FORK)
 
 pid_t slave_pid = 0;
@@ -363,12 +919,19 @@ int slave_socket = INVALID_SOCKET;
 #ifdef STUB_SLAVE
 pid_t stubslave_pid = 0;
 int stubslave_socket = INVALID_SOCKET;
+#if defined(UNIX_NETWORKING_EPOLL)
+static UINT32 stubslave_events = 0;
+#endif // UNIX_NETWORKING_EPOLL
 #endif // STUB_SLAVE
 
 void CleanUpSlaveSocket(void)
 {
     if (!IS_INVALID_SOCKET(slave_socket))
     {
+#if defined(UNIX_NETWORKING_EPOLL)
+        epoll_change(slave_socket, &slave_socket, EPOLLIN, 0);
+        epoll_forget(&slave_socket);
+#endif // UNIX_NETWORKING_EPOLL
         shutdown(slave_socket, SD_BOTH);
         if (0 == SOCKET_CLOSE(slave_socket))
         {
@@ -393,6 +956,11 @@ void CleanUpStubSlaveSocket(void)
 {
     if (!IS_INVALID_SOCKET(stubslave_socket))
     {
+#if defined(UNIX_NETWORKING_EPOLL)
+        epoll_change(stubslave_socket, &stubslave_socket, stubslave_events, 0);
+        stubslave_events = 0;
+        epoll_forget(&stubslave_socket);
+#endif // UNIX_NETWORKING_EPOLL
         shutdown(stubslave_socket, SD_BOTH);
         if (0 == SOCKET_CLOSE(stubslave_socket))
         {
@@ -513,11 +1081,13 @@ void boot_stubslave(dbref executor, dbref caller, dbref enactor, int)
         CleanUpStubSlaveSocket();
         goto failure;
     }
+#if defined(UNIX_NETWORKING_SELECT)
     if (  !IS_INVALID_SOCKET(stubslave_socket)
        && maxd <= stubslave_socket)
     {
         maxd = stubslave_socket + 1;
     }
+#endif // UNIX_NETWORKING_SELECT
 
     STARTLOG(LOG_ALWAYS, "NET", "STUB");
     log_text(T("Stub slave started on fd "));
@@ -626,6 +1196,9 @@ static int StubSlaveWrite(void)
  * bi-directional communiocation path between that process and this
  * process. Any existing slave process is killed.
  *
+ * With threads, lookups are made inside the server, and this clears the
+ * resolver cache instead.
+ *
  * \param executor dbref of Executor.
  * \param caller   dbref of Caller.
  * \param enactor  dbref of Enactor.
@@ -640,6 +1213,18 @@ void boot_slave(dbref executor, dbref caller, dbref enactor, int eval, int key)
     UNUSED_PARAMETER(eval);
     UNUSED_PARAMETER(key);
 
+#if defined(UNIX_THREADS)
+    // Lookups are made by the resolver threads, so there is no slave to
+    // start.  Begin again with an empty cache instead.
+    //
+    if (0 < nResolverEntries)
+    {
+        resolver_trim(true);
+        STARTLOG(LOG_ALWAYS, "NET", "DNS");
+        log_text(T("Resolver cache cleared."));
+        ENDLOG;
+    }
+#else // UNIX_THREADS
     const char *pFailedFunc = nullptr;
     int sv[2];
     int i;
@@ -736,6 +1321,10 @@ void boot_slave(dbref executor, dbref caller, dbref enactor, int eval, int key)
     }
 #endif // UNIX_NETWORKING_SELECT
 
+#if defined(UNIX_NETWORKING_EPOLL)
+    epoll_change(slave_socket, &slave_socket, 0, EPOLLIN);
+#endif // UNIX_NETWORKING_EPOLL
+
     STARTLOG(LOG_ALWAYS, "NET", "SLAVE");
     log_text(T("DNS lookup slave started on fd "));
     log_number(slave_socket);
@@ -749,14 +1338,13 @@ failure:
     log_text((UTF8 *)pFailedFunc);
     log_number(errno);
     ENDLOG;
+#endif // UNIX_THREADS
 }
 
 // Get a result from the slave
 //
 static int get_slave_result(void)
 {
-    DESC *d;
-
     UTF8 *buf = alloc_lbuf("slave_buf");
 
     int len = mux_read(slave_socket, buf, LBUF_SIZE-1);
@@ -801,29 +1389,7 @@ static int get_slave_result(void)
     *p = '\0';
     if (mudconf.use_hostname)
     {
-        for (d = descriptor_list; d; d = d->next)
-        {
-            if (strcmp((char *)d->addr, (char *)host_address) != 0)
-            {
-                continue;
-            }
-
-            strncpy((char *)d->addr, (char *)host_name, 50);
-            d->addr[50] = '\0';
-            if (d->player != 0)
-            {
-                if (d->username[0])
-                {
-                    atr_add_raw(d->player, A_LASTSITE, tprintf(T("%s@%s"),
-                        d->username, d->addr));
-                }
-                else
-                {
-                    atr_add_raw(d->player, A_LASTSITE, d->addr);
-                }
-                atr_add_raw(d->player, A_LASTIP, host_address);
-            }
-        }
+        update_host_name(host_address, host_name);
     }
 
 Done:
@@ -1186,6 +1752,29 @@ void SetupPorts(int *pnPorts, PortInfo aPorts[], IntArray *pia, IntArray *piaSSL
     }
 #endif
 
+#if defined(UNIX_NETWORKING_EPOLL)
+    // The main loop cannot run without an epoll descriptor, so find out now
+    // rather than after we have started listening.
+    //
+    if (epoll_fd < 0)
+    {
+        epoll_fd = epoll_create(EPOLL_MAX_EVENTS);
+        if (epoll_fd < 0)
+        {
+            log_perror(T("NET"), T("FAIL"), nullptr, T("epoll_create"));
+            STARTLOG(LOG_ALWAYS, "NET", "FAIL");
+            log_text(T("Cannot wait on network events. Shutting down."));
+            ENDLOG;
+            exit(1);
+        }
+
+        // Do not leak the epoll descriptor into the slaves or across
+        // @restart.
+        //
+        fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif // UNIX_NETWORKING_EPOLL
+
     for (int i = 0; i < *pnPorts; i++)
     {
         aPorts[i].fMatched = false;
@@ -1354,6 +1943,11 @@ void shovechars(int nPorts, PortInfo aPorts[])
             ltaWakeUp = ltaCurrent;
         }
 
+        // Make this pass's attribute writes durable with one commit before
+        // any output which reports them goes out.
+        //
+        COMMIT;
+
         // The following kick-starts asynchronous writes to the sockets going
         // if they are not already going. Doing it this way is better than:
         //
@@ -1444,6 +2038,11 @@ void shovechars(int nPorts, PortInfo aPorts[])
             ltaWakeUp = ltaCurrent + ltd;
         }
 
+        // Make this pass's attribute writes durable with one commit before
+        // any output which reports them goes out.
+        //
+        COMMIT;
+
         if (mudstate.shutdown_flag)
         {
             break;
@@ -1484,6 +2083,15 @@ void shovechars(int nPorts, PortInfo aPorts[])
         }
 #endif // HAVE_WORKING_FORK
 
+#if defined(UNIX_THREADS)
+        // Listen for helper threads.
+        //
+        if (0 <= aWakePipe[0])
+        {
+            FD_SET(aWakePipe[0], &input_set);
+        }
+#endif // UNIX_THREADS
+
         // Mark sockets that we want to test for change in status.
         //
         DESC_ITER_ALL(d)
@@ -1573,6 +2181,16 @@ void shovechars(int nPorts, PortInfo aPorts[])
             continue;
         }
 
+#if defined(UNIX_THREADS)
+        // Collect work finished by helper threads.
+        //
+        if (  0 <= aWakePipe[0]
+           && CheckInput(aWakePipe[0]))
+        {
+            wake_run();
+        }
+#endif // UNIX_THREADS
+
 #if defined(HAVE_WORKING_FORK)
         // Get usernames and hostnames.
         //
@@ -1654,6 +2272,7 @@ void shovechars(int nPorts, PortInfo aPorts[])
                     {
                         d1->flags &= ~DS_AUTODARK;
                     }
+                    s_Dirty(d->player);
                     db[d->player].fs.word[FLAG_WORD1] &= ~DARK;
                 }
 
@@ -1666,17 +2285,287 @@ void shovechars(int nPorts, PortInfo aPorts[])
                 }
             }
 
-            // Process output for sockets with pending output.
+            // Process output for sockets with pending output.
+            //
+            if (CheckOutput(d->descriptor))
+            {
+                process_output(d, true);
+            }
+        }
+    }
+}
+
+#endif // UNIX_NETWORKING_SELECT
+
+#if defined(UNIX_NETWORKING_EPOLL)
+
+static void ProcessDescriptorEvents(DESC *d, UINT32 events)
+{
+    // A hang-up or error is reported whether we asked for it or not. Let
+    // whichever of input or output we are waiting on discover it.
+    //
+    if (events & (EPOLLHUP|EPOLLERR))
+    {
+        events |= d->epoll_events;
+    }
+
+    // Process input from sockets with pending input.
+    //
+    if (  (events & EPOLLIN)
+       && (d->epoll_events & EPOLLIN))
+    {
+        // Undo autodark
+        //
+        if (d->flags & DS_AUTODARK)
+        {
+            // Clear the DS_AUTODARK on every related session.
+            //
+            DESC *d1;
+            DESC_ITER_PLAYER(d->player, d1)
+            {
+                d1->flags &= ~DS_AUTODARK;
+            }
+            s_Dirty(d->player);
+            db[d->player].fs.word[FLAG_WORD1] &= ~DARK;
+        }
+
+        // Process received data.
+        //
+        if (!process_input(d))
+        {
+            shutdownsock(d, R_SOCKDIED);
+            return;
+        }
+    }
+
+    // Process output for sockets with pending output.
+    //
+    if (  (events & EPOLLOUT)
+       && nullptr != d->output_head)
+    {
+        process_output(d, true);
+    }
+}
+
+void shovechars(int nPorts, PortInfo aPorts[])
+{
+    DESC *d;
+    unsigned int avail_descriptors;
+    int maxfds;
+    int i;
+
+    mudstate.debug_cmd = T("< shovechars_epoll >");
+
+    CLinearTimeAbsolute ltaLastSlice;
+    ltaLastSlice.GetUTC();
+
+#ifdef HAVE_GETDTABLESIZE
+    maxfds = getdtablesize();
+#else // HAVE_GETDTABLESIZE
+    maxfds = sysconf(_SC_OPEN_MAX);
+#endif // HAVE_GETDTABLESIZE
+
+    avail_descriptors = maxfds - 7;
+
+    // SetupPorts() has already created the epoll descriptor.
+    //
+    mux_assert(0 <= epoll_fd);
+
+    // Register everything which existed before the loop started: the slave
+    // and any descriptors carried across a @restart.  Some of these may
+    // already be registered, which epoll_change() tolerates.  Listening
+    // ports are registered below while there are free descriptors.
+    //
+#if defined(HAVE_WORKING_FORK)
+    epoll_change(slave_socket, &slave_socket, 0, EPOLLIN);
+#endif // HAVE_WORKING_FORK
+#if defined(UNIX_THREADS)
+    if (0 <= aWakePipe[0])
+    {
+        epoll_change(aWakePipe[0], aWakePipe, 0, EPOLLIN);
+    }
+#endif // UNIX_THREADS
+
+    DESC_ITER_ALL(d)
+    {
+        d->epoll_events = 0;
+        update_desc_events(d);
+    }
+
+    bool fPortsWatched = false;
+
+    while (!mudstate.shutdown_flag)
+    {
+        CLinearTimeAbsolute ltaCurrent;
+        ltaCurrent.GetUTC();
+        update_quotas(ltaLastSlice, ltaCurrent);
+
+        // Check the scheduler.
+        //
+        scheduler.RunTasks(ltaCurrent);
+        CLinearTimeAbsolute ltaWakeUp;
+        if (scheduler.WhenNext(&ltaWakeUp))
+        {
+            if (ltaWakeUp < ltaCurrent)
+            {
+                ltaWakeUp = ltaCurrent;
+            }
+        }
+        else
+        {
+            CLinearTimeDelta ltd = time_30m;
+            ltaWakeUp = ltaCurrent + ltd;
+        }
+
+        // Make this pass's attribute writes durable with one commit before
+        // any output which reports them goes out.
+        //
+        COMMIT;
+
+        if (mudstate.shutdown_flag)
+        {
+            break;
+        }
+
+        // Listen for new connections only if there are free descriptors.
+        //
+        const bool fWantPorts = (ndescriptors < avail_descriptors);
+        if (fWantPorts != fPortsWatched)
+        {
+            const UINT32 oldEvents = fPortsWatched ? static_cast<UINT32>(EPOLLIN) : 0U;
+            const UINT32 newEvents = fWantPorts ? static_cast<UINT32>(EPOLLIN) : 0U;
+            for (i = 0; i < nPorts; i++)
+            {
+                epoll_change(aPorts[i].socket, &aPorts[i], oldEvents, newEvents);
+            }
+            fPortsWatched = fWantPorts;
+        }
+
+#if defined(HAVE_WORKING_FORK) && defined(STUB_SLAVE)
+        // Listen for replies from the stubslave socket, and wait to write
+        // to it only when we have something to say.
+        //
+        if (!IS_INVALID_SOCKET(stubslave_socket))
+        {
+            UINT32 events = EPOLLIN;
+            if (0 < Pipe_QueueLength(&Queue_Out))
+            {
+                events |= EPOLLOUT;
+            }
+            epoll_change(stubslave_socket, &stubslave_socket, stubslave_events, events);
+            stubslave_events = events;
+        }
+#endif // HAVE_WORKING_FORK && STUB_SLAVE
+
+        // Wait for something to happen.  Round the timeout up so that we do
+        // not spin while a task is less than a millisecond away.
+        //
+        CLinearTimeDelta ltdTimeout = ltaWakeUp - ltaCurrent;
+        const long msTimeout = ltdTimeout.ReturnMilliseconds();
+        CLinearTimeDelta ltdWhole;
+        ltdWhole.SetMilliseconds(msTimeout);
+        nEpollEvents = epoll_wait(epoll_fd, aEpollEvents, EPOLL_MAX_EVENTS,
+            static_cast<int>(ltdWhole < ltdTimeout ? msTimeout + 1 : msTimeout));
+
+        if (nEpollEvents < 0)
+        {
+            nEpollEvents = 0;
+            if (SOCKET_EINTR != SOCKET_LAST_ERROR)
+            {
+                log_perror(T("NET"), T("FAIL"), T("checking for activity"), T("epoll_wait"));
+            }
+            continue;
+        }
+
+        for (iEpollEvent = 0; iEpollEvent < nEpollEvents; iEpollEvent++)
+        {
+            void *p = aEpollEvents[iEpollEvent].data.ptr;
+            const UINT32 events = aEpollEvents[iEpollEvent].events;
+
+            if (nullptr == p)
+            {
+                // The source was closed earlier in this batch.
+                //
+                continue;
+            }
+
+#if defined(UNIX_THREADS)
+            // Collect work finished by helper threads.
+            //
+            if (aWakePipe == p)
+            {
+                wake_run();
+                continue;
+            }
+#endif // UNIX_THREADS
+
+#if defined(HAVE_WORKING_FORK)
+            // Get usernames and hostnames.
+            //
+            if (&slave_socket == p)
+            {
+                while (0 == get_slave_result())
+                {
+                    ; // Nothing.
+                }
+                continue;
+            }
+
+#if defined(STUB_SLAVE)
+            // Get data from and send data to the stubslave.
+            //
+            if (&stubslave_socket == p)
+            {
+                if (events & (EPOLLIN|EPOLLHUP|EPOLLERR))
+                {
+                    while (0 == StubSlaveRead())
+                    {
+                        ; // Nothing.
+                    }
+                }
+
+                Pipe_DecodeFrames(CHANNEL_INVALID, &Queue_Out);
+
+                if (  !IS_INVALID_SOCKET(stubslave_socket)
+                   && (events & EPOLLOUT))
+                {
+                    StubSlaveWrite();
+                }
+                continue;
+            }
+#endif // STUB_SLAVE
+#endif // HAVE_WORKING_FORK
+
+            // Check for new connection requests.
+            //
+            if (  static_cast<void *>(aPorts) <= p
+               && p < static_cast<void *>(aPorts + nPorts))
+            {
+                int iSocketError;
+                PortInfo *pPort = static_cast<PortInfo *>(p);
+                DESC *newd = new_connection(pPort, &iSocketError);
+                if (  !newd
+                   && iSocketError
+                   && iSocketError != SOCKET_EINTR)
+                {
+                    log_perror(T("NET"), T("FAIL"), nullptr, T("new_connection"));
+                }
+                continue;
+            }
+
+            // Check for activity on user sockets.
             //
-            if (CheckOutput(d->descriptor))
-            {
-                process_output(d, true);
-            }
+            ProcessDescriptorEvents(static_cast<DESC *>(p), events);
         }
+        nEpollEvents = 0;
+        iEpollEvent = 0;
     }
+
+    mux_close(epoll_fd);
+    epoll_fd = -1;
 }
 
-#endif // UNIX_NETWORKING_SELECT
+#endif // UNIX_NETWORKING_EPOLL
 
 #if defined(HAVE_WORKING_FORK) && defined(STUB_SLAVE)
 extern "C" MUX_RESULT DCL_API pipepump(void)
@@ -1705,7 +2594,7 @@ extern "C" MUX_RESULT DCL_API pipepump(void)
 
     // Wait for something to happen.
     //
-    found = select(maxd, &input_set, &output_set, (fd_set *) nullptr, nullptr);
+    found = select(stubslave_socket + 1, &input_set, &output_set, (fd_set *) nullptr, nullptr);
 
     if (IS_SOCKET_ERROR(found))
     {
@@ -1732,7 +2621,7 @@ extern "C" MUX_RESULT DCL_API pipepump(void)
 
     // Get data from from stubslave.
     //
-    if (CheckInput(stubslave_socket))
+    if (FD_ISSET(stubslave_socket, &input_set))
     {
         while (0 == StubSlaveRead())
         {
@@ -1742,7 +2631,7 @@ extern "C" MUX_RESULT DCL_API pipepump(void)
 
     if (!IS_INVALID_SOCKET(stubslave_socket))
     {
-        if (CheckOutput(stubslave_socket))
+        if (FD_ISSET(stubslave_socket, &output_set))
         {
             StubSlaveWrite();
         }
@@ -1875,6 +2764,10 @@ DESC *new_connection(PortInfo *Port, int *piSocketError)
         d->ssl_session = ssl_session;
 #endif
 
+#if defined(UNIX_THREADS)
+        resolver_lookup(d);
+#endif // UNIX_THREADS
+
         telnet_setup(d);
 
         // Initialize everything before sending the sitemon info, so that we
@@ -2120,6 +3013,15 @@ void shutdownsock(DESC *d, int reason)
         //
         scheduler.CancelTask(Task_ProcessCommand, d, 0);
 
+        // A password check still running for this descriptor finishes
+        // without it.
+        //
+        if (nullptr != d->pending_connect)
+        {
+            d->pending_connect->d = nullptr;
+            d->pending_connect = nullptr;
+        }
+
 #if defined(WINDOWS_NETWORKING)
         // Don't close down the socket twice.
         //
@@ -2163,6 +3065,16 @@ void shutdownsock(DESC *d, int reason)
         }
 #endif
 
+#if defined(UNIX_ZLIB)
+        mccp_end(d, false);
+#endif // UNIX_ZLIB
+
+#if defined(UNIX_NETWORKING_EPOLL)
+        epoll_change(d->descriptor, d, d->epoll_events, 0);
+        d->epoll_events = 0;
+        epoll_forget(d);
+#endif // UNIX_NETWORKING_EPOLL
+
         shutdown(d->descriptor, SD_BOTH);
         if (0 == SOCKET_CLOSE(d->descriptor))
         {
@@ -2340,6 +3252,15 @@ DESC *initializesock(SOCKET s, MUX_SOCKADDR *msa)
 #ifdef UNIX_SSL
     d->ssl_session = nullptr;
 #endif
+#if defined(UNIX_NETWORKING_EPOLL)
+    d->epoll_events = 0;
+#endif // UNIX_NETWORKING_EPOLL
+#if defined(UNIX_ZLIB)
+    d->mccp = nullptr;
+    d->mccp_in = 0;
+    d->mccp_out = 0;
+#endif // UNIX_ZLIB
+    d->pending_connect = nullptr;
 
     // Be sure #0 isn't wizard. Shouldn't be.
     //
@@ -2416,6 +3337,10 @@ DESC *initializesock(SOCKET s, MUX_SOCKADDR *msa)
     d->bConnectionDropped = false; // not dropped yet
     d->bCallProcessOutputLater = false;
 #endif // WINDOWS_NETWORKING
+
+#if defined(UNIX_NETWORKING_EPOLL)
+    update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
     return d;
 }
 
@@ -2470,7 +3395,7 @@ void process_output_socket(DESC *d, int bHandleShutdown)
     {
         auto save = tb;
         tb = tb->hdr.nxt;
-        MEMFREE(save);
+        free_tblock(save);
         save = nullptr;
         d->output_head = tb;
         if (nullptr == tb)
@@ -2557,6 +3482,9 @@ void process_output_socket(DESC *d, int bHandleShutdown)
  * not being called by the task queue, but it is in a form that is callable by
  * the task queue.
  *
+ * As much of the output queue as possible is handed to a single writev()
+ * call.
+ *
  * \param dvoid             Network descriptor state.
  * \param bHandleShutdown   Whether the shutdownsock() call is being handled..
  * \return                  None.
@@ -2567,12 +3495,26 @@ void process_output_socket(DESC *d, int bHandleShutdown)
     const UTF8 *cmdsave = mudstate.debug_cmd;
     mudstate.debug_cmd = T("< process_output >");
 
-    TBLOCK *tb = d->output_head;
-    while (nullptr != tb)
+    while (nullptr != d->output_head)
     {
-        while (0 < tb->hdr.nchars)
+        // Gather as much of the output queue as we can into a single write.
+        //
+        struct iovec aiov[OUTPUT_IOV_MAX];
+        int niov = 0;
+        for (TBLOCK *tb = d->output_head; nullptr != tb && niov < OUTPUT_IOV_MAX; tb = tb->hdr.nxt)
+        {
+            if (0 < tb->hdr.nchars)
+            {
+                aiov[niov].iov_base = tb->hdr.start;
+                aiov[niov].iov_len  = tb->hdr.nchars;
+                niov++;
+            }
+        }
+
+        size_t nWritten = 0;
+        if (0 < niov)
         {
-            int cnt = SOCKET_WRITE(d->descriptor, reinterpret_cast<char *>(tb->hdr.start), tb->hdr.nchars, 0);
+            ssize_t cnt = writev(d->descriptor, aiov, niov);
             if (IS_SOCKET_ERROR(cnt))
             {
                 int iSocketError = SOCKET_LAST_ERROR;
@@ -2585,10 +3527,10 @@ void process_output_socket(DESC *d, int bHandleShutdown)
                 )
                 {
                     // The call would have blocked, so we need to mark the
-                    // buffer we used as read-only and try again later with
-                    // the exactly same buffer.
+                    // buffer at the head of the queue as read-only and try
+                    // again later.
                     //
-                    tb->hdr.flags |= TBLK_FLAG_LOCKED;
+                    d->output_head->hdr.flags |= TBLK_FLAG_LOCKED;
                 }
                 else if (bHandleShutdown)
                 {
@@ -2596,18 +3538,40 @@ void process_output_socket(DESC *d, int bHandleShutdown)
                 }
                 return;
             }
-            d->output_size -= cnt;
-            tb->hdr.nchars -= cnt;
-            tb->hdr.start += cnt;
+            nWritten = static_cast<size_t>(cnt);
+            d->output_size -= nWritten;
         }
-        TBLOCK *save = tb;
-        tb = tb->hdr.nxt;
-        MEMFREE(save);
-        save = nullptr;
-        d->output_head = tb;
-        if (tb == nullptr)
+
+        // Consume what was written, and free the blocks which are now empty.
+        //
+        TBLOCK *tb = d->output_head;
+        while (nullptr != tb)
         {
-            d->output_tail = nullptr;
+            size_t n = tb->hdr.nchars;
+            if (nWritten < n)
+            {
+                n = nWritten;
+            }
+            tb->hdr.nchars -= n;
+            tb->hdr.start  += n;
+            nWritten       -= n;
+            if (0 < tb->hdr.nchars)
+            {
+                break;
+            }
+
+            TBLOCK *save = tb;
+            tb = tb->hdr.nxt;
+            free_tblock(save);
+            save = nullptr;
+            d->output_head = tb;
+            if (tb == nullptr)
+            {
+                d->output_tail = nullptr;
+#if defined(UNIX_NETWORKING_EPOLL)
+                update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
+            }
         }
     }
 
@@ -2657,12 +3621,15 @@ void process_output_ssl(DESC *d, int bHandleShutdown)
         }
         TBLOCK *save = tb;
         tb = tb->hdr.nxt;
-        MEMFREE(save);
+        free_tblock(save);
         save = nullptr;
         d->output_head = tb;
         if (tb == nullptr)
         {
             d->output_tail = nullptr;
+#if defined(UNIX_NETWORKING_EPOLL)
+            update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
         }
     }
 
@@ -2672,8 +3639,348 @@ void process_output_ssl(DESC *d, int bHandleShutdown)
 
 #endif // UNIX_NETWORKING
 
+#if defined(UNIX_ZLIB)
+
+/*! \brief Append a fresh wire-form block to the output queue.
+ *
+ * \param d         Network descriptor state.
+ * \return          The new block.
+ */
+
+static TBLOCK *mccp_new_block(DESC *d)
+{
+    TBLOCK *tp = alloc_tblock("mccp_new_block");
+    ISOUTOFMEMORY(tp);
+    tp->hdr.nxt = nullptr;
+    tp->hdr.start = tp->data;
+    tp->hdr.end = tp->data;
+    tp->hdr.nchars = 0;
+    tp->hdr.flags = TBLK_FLAG_COMPRESSED;
+
+    if (nullptr == d->output_tail)
+    {
+        d->output_head = tp;
+#if defined(UNIX_NETWORKING_EPOLL)
+        update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
+    }
+    else
+    {
+        d->output_tail->hdr.nxt = tp;
+    }
+    d->output_tail = tp;
+    return tp;
+}
+
+/*! \brief Run the deflate stream and append what it produces to the queue.
+ *
+ * \param d         Network descriptor state.
+ * \param ppOut     Block currently receiving compressed output.
+ * \param iFlush    Flush mode to pass to deflate().
+ * \return          None.
+ */
+
+static void mccp_deflate(DESC *d, TBLOCK **ppOut, int iFlush)
+{
+    z_stream *pz = d->mccp;
+    for (;;)
+    {
+        TBLOCK *tp = *ppOut;
+        size_t left = OUTPUT_BLOCK_SIZE - (tp->hdr.end - (UTF8 *)tp + 1);
+        if (0 == left)
+        {
+            tp = mccp_new_block(d);
+            *ppOut = tp;
+            left = OUTPUT_BLOCK_SIZE - (tp->hdr.end - (UTF8 *)tp + 1);
+        }
+
+        pz->next_out = tp->hdr.end;
+        pz->avail_out = static_cast<uInt>(left);
+        int zr = deflate(pz, iFlush);
+
+        size_t nProduced = left - pz->avail_out;
+        tp->hdr.end    += nProduced;
+        tp->hdr.nchars += nProduced;
+        d->output_size += nProduced;
+        d->mccp_out    += nProduced;
+
+        if (Z_FINISH == iFlush)
+        {
+            if (Z_STREAM_END == zr)
+            {
+                return;
+            }
+        }
+        else if (  0 < pz->avail_out
+                && 0 == pz->avail_in)
+        {
+            return;
+        }
+
+        if (  Z_OK != zr
+           && Z_BUF_ERROR != zr)
+        {
+            return;
+        }
+    }
+}
+
+/*! \brief Compress the uncompressed tail of a descriptor's output queue.
+ *
+ * The queue consists of blocks already in wire form (compressed, or sent
+ * ahead of the start of compression) followed by the text queued since the
+ * last pass.  That text is replaced with its deflated form so that the
+ * writers below never need to know whether compression is on.
+ *
+ * \param d         Network descriptor state.
+ * \param iFlush    Z_SYNC_FLUSH, or Z_FINISH to end the stream.
+ * \return          None.
+ */
+
+static void mccp_compress(DESC *d, int iFlush)
+{
+    // Find the first block which still needs compressing.
+    //
+    TBLOCK *prev = nullptr;
+    TBLOCK *tb = d->output_head;
+    while (  nullptr != tb
+          && 0 != (tb->hdr.flags & TBLK_FLAG_COMPRESSED))
+    {
+        prev = tb;
+        tb = tb->hdr.nxt;
+    }
+
+    if (  nullptr == tb
+       && Z_FINISH != iFlush)
+    {
+        return;
+    }
+
+    // Detach the uncompressed blocks, and feed them through the stream.
+    //
+    if (nullptr == prev)
+    {
+        d->output_head = nullptr;
+    }
+    else
+    {
+        prev->hdr.nxt = nullptr;
+    }
+    d->output_tail = prev;
+
+    TBLOCK *pOut = mccp_new_block(d);
+    while (nullptr != tb)
+    {
+        d->mccp->next_in = tb->hdr.start;
+        d->mccp->avail_in = static_cast<uInt>(tb->hdr.nchars);
+        d->output_size -= tb->hdr.nchars;
+        d->mccp_in     += tb->hdr.nchars;
+        mccp_deflate(d, &pOut, Z_NO_FLUSH);
+
+        TBLOCK *save = tb;
+        tb = tb->hdr.nxt;
+        free_tblock(save);
+        save = nullptr;
+    }
+    mccp_deflate(d, &pOut, iFlush);
+}
+
+/*! \brief Begin MCCP2 compression of a descriptor's output.
+ *
+ * Everything already queued, including the IAC SB COMPRESS2 IAC SE marker,
+ * is sent as-is, and everything after it is compressed.
+ *
+ * \param d         Network descriptor state.
+ * \return          true if compression was started.
+ */
+
+static bool mccp_start(DESC *d)
+{
+    if (nullptr != d->mccp)
+    {
+        return true;
+    }
+
+    z_stream *pz = reinterpret_cast<z_stream *>(MEMALLOC(sizeof(z_stream)));
+    ISOUTOFMEMORY(pz);
+    memset(pz, 0, sizeof(z_stream));
+    if (Z_OK != deflateInit(pz, Z_DEFAULT_COMPRESSION))
+    {
+        MEMFREE(pz);
+        pz = nullptr;
+
+        STARTLOG(LOG_PROBLEMS, "NET", "MCCP");
+        log_printf(T("[%u/%s] Unable to initialize compression."), d->descriptor, d->addr);
+        ENDLOG;
+        return false;
+    }
+
+    UTF8 aStart[5] = { NVT_IAC, NVT_SB, TELNET_COMPRESS2, NVT_IAC, NVT_SE };
+    queue_write_LEN(d, aStart, sizeof(aStart));
+    for (TBLOCK *tb = d->output_head; nullptr != tb; tb = tb->hdr.nxt)
+    {
+        tb->hdr.flags |= TBLK_FLAG_COMPRESSED;
+    }
+    d->mccp = pz;
+    return true;
+}
+
+/*! \brief Release a descriptor's deflate stream.
+ *
+ * \param d         Network descriptor state.
+ * \param bFinish   Whether to end the stream cleanly so that the client
+ *                  resumes reading uncompressed text.
+ * \return          None.
+ */
+
+static void mccp_end(DESC *d, bool bFinish)
+{
+    if (nullptr == d->mccp)
+    {
+        return;
+    }
+
+    if (bFinish)
+    {
+        mccp_compress(d, Z_FINISH);
+    }
+    deflateEnd(d->mccp);
+    MEMFREE(d->mccp);
+    d->mccp = nullptr;
+}
+
+/*! \brief End compression on every descriptor.
+ *
+ * Deflate streams do not survive @restart, so clients are returned to
+ * uncompressed text beforehand.  The option is left enabled so that
+ * load_restart_db() knows to offer it again.
+ *
+ * \return          None.
+ */
+
+void CleanUpCompression(void)
+{
+    // The new process cannot continue a deflate stream, so the end of each
+    // one must reach the client before the descriptor is handed across.
+    // Sockets which do not drain are given a few seconds in all.
+    //
+    CLinearTimeAbsolute ltaDeadline;
+    ltaDeadline.GetUTC();
+    ltaDeadline += time_5s;
+
+    DESC *d;
+    DESC_ITER_ALL(d)
+    {
+        if (nullptr == d->mccp)
+        {
+            continue;
+        }
+
+        mccp_end(d, true);
+        process_output(d, false);
+        if (nullptr == d->output_head)
+        {
+            continue;
+        }
+
+        CLinearTimeAbsolute ltaNow;
+        ltaNow.GetUTC();
+        if (ltaDeadline <= ltaNow)
+        {
+            continue;
+        }
+
+        // Wait for the socket to take the rest.
+        //
+        CLinearTimeDelta ltdLeft = ltaDeadline - ltaNow;
+        struct timeval tv;
+        ltdLeft.ReturnTimeValueStruct(&tv);
+        setsockopt(d->descriptor, SOL_SOCKET, SO_SNDTIMEO,
+            reinterpret_cast<char *>(&tv), sizeof(tv));
+        int fl = fcntl(d->descriptor, F_GETFL, 0);
+        fcntl(d->descriptor, F_SETFL, fl & ~O_NONBLOCK);
+
+        size_t nBefore;
+        do
+        {
+            nBefore = d->output_size;
+            process_output(d, false);
+        } while (  nullptr != d->output_head
+                && d->output_size < nBefore);
+
+        fcntl(d->descriptor, F_SETFL, fl);
+        tv.tv_sec = 0;
+        tv.tv_usec = 0;
+        setsockopt(d->descriptor, SOL_SOCKET, SO_SNDTIMEO,
+            reinterpret_cast<char *>(&tv), sizeof(tv));
+    }
+}
+
+/*! \brief Write out what is already compressed.
+ *
+ * Text queued since the last pass is left uncompressed so that it can still
+ * be discarded a block at a time if the output queue overflows.
+ *
+ * \param d         Network descriptor state.
+ * \return          None.
+ */
+
+void process_output_compressed(DESC *d)
+{
+    TBLOCK *prev = nullptr;
+    TBLOCK *tb = d->output_head;
+    while (  nullptr != tb
+          && 0 != (tb->hdr.flags & TBLK_FLAG_COMPRESSED))
+    {
+        prev = tb;
+        tb = tb->hdr.nxt;
+    }
+
+    if (nullptr == prev)
+    {
+        return;
+    }
+
+    // Detach the uncompressed blocks while the rest is written.
+    //
+    TBLOCK *pTail = d->output_tail;
+    prev->hdr.nxt = nullptr;
+    d->output_tail = prev;
+
+#ifdef UNIX_SSL
+    if (d->ssl_session) process_output_ssl(d, false);
+    else
+#endif
+        process_output_socket(d, false);
+
+    if (nullptr != tb)
+    {
+        if (nullptr == d->output_tail)
+        {
+            d->output_head = tb;
+#if defined(UNIX_NETWORKING_EPOLL)
+            update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
+        }
+        else
+        {
+            d->output_tail->hdr.nxt = tb;
+        }
+        d->output_tail = pTail;
+    }
+}
+
+#endif // UNIX_ZLIB
+
 void process_output(DESC *d, int bHandleShutdown)
 {
+#if defined(UNIX_ZLIB)
+    if (nullptr != d->mccp)
+    {
+        mccp_compress(d, Z_SYNC_FLUSH);
+    }
+#endif // UNIX_ZLIB
+
 #ifdef UNIX_SSL
     if (d->ssl_session) process_output_ssl(d, bHandleShutdown);
     else
@@ -3019,6 +4326,16 @@ static void set_us_state(DESC *d, unsigned char chOption, int iUsState)
         {
             send_charset_request(d);
         }
+#if defined(UNIX_ZLIB)
+        else if (TELNET_COMPRESS2 == chOption)
+        {
+            if (!mccp_start(d))
+            {
+                d->nvt_us_state[chOption] = OPTION_NO;
+                send_wont(d, chOption);
+            }
+        }
+#endif // UNIX_ZLIB
     }
     else if (OPTION_NO == iUsState)
     {
@@ -3030,6 +4347,12 @@ static void set_us_state(DESC *d, unsigned char chOption, int iUsState)
         {
             defacto_charset_check(d);
         }
+#if defined(UNIX_ZLIB)
+        else if (TELNET_COMPRESS2 == chOption)
+        {
+            mccp_end(d, true);
+        }
+#endif // UNIX_ZLIB
     }
 }
 
@@ -3075,7 +4398,11 @@ static bool desired_him_option(DESC *d, unsigned char chOption)
 static bool desired_us_option(DESC *d, unsigned char chOption)
 {
     return TELNET_EOR == chOption || TELNET_BINARY == chOption || TELNET_CHARSET == chOption || (TELNET_SGA == chOption
-        && OPTION_YES == us_state(d, TELNET_EOR));
+        && OPTION_YES == us_state(d, TELNET_EOR))
+#if defined(UNIX_ZLIB)
+        || TELNET_COMPRESS2 == chOption
+#endif // UNIX_ZLIB
+        ;
 }
 
 /*! \brief Start the process of negotiating the enablement of an option on
@@ -3224,6 +4551,9 @@ void telnet_setup(DESC *d)
 //    EnableHim(d, TELNET_OLDENV);
     enable_us(d, TELNET_CHARSET);
     enable_him(d, TELNET_CHARSET);
+#if defined(UNIX_ZLIB)
+    enable_us(d, TELNET_COMPRESS2);
+#endif // UNIX_ZLIB
 #ifdef UNIX_SSL
     if (!d->ssl_session && (tls_ctx != nullptr))
     {
@@ -3232,6 +4562,46 @@ void telnet_setup(DESC *d)
 #endif
 }
 
+/*! \brief Measure a run of printable 7-bit ASCII.
+ *
+ * Bytes from 0x20 to 0x7E need no Telnet processing, are complete code points
+ * in every supported encoding, and map to themselves in UTF-8.  Eight bytes
+ * are examined at a time.  A byte outside that range makes a word fail
+ * whichever check it falls in: its high bit is set, subtracting 0x20 borrows
+ * out of it, or it equals 0x7F.
+ *
+ * \param pBytes   Received bytes.
+ * \param nBytes   Number of bytes available.
+ * \return         Number of leading bytes which are printable ASCII.
+ */
+
+static size_t ascii_run_length(const char *pBytes, size_t nBytes)
+{
+    const UINT64 ones  = UINT64_C(0x0101010101010101);
+    const UINT64 highs = UINT64_C(0x8080808080808080);
+
+    size_t i = 0;
+    while (i + sizeof(UINT64) <= nBytes)
+    {
+        UINT64 w;
+        memcpy(&w, pBytes + i, sizeof(w));
+        const UINT64 x = w ^ (ones * 0x7F);
+        if (0 != ((w | (w - ones * 0x20) | ((x - ones) & ~x)) & highs))
+        {
+            break;
+        }
+        i += sizeof(UINT64);
+    }
+
+    while (  i < nBytes
+          && 0x20 <= static_cast<unsigned char>(pBytes[i])
+          && static_cast<unsigned char>(pBytes[i]) < 0x7F)
+    {
+        i++;
+    }
+    return i;
+}
+
 /*! \brief Parse raw data from network connection into command lines and
  * Telnet indications.
  *
@@ -3280,6 +4650,37 @@ static void process_input_helper(DESC *d, char *pBytes, int nBytes)
     auto n = nBytes;
     while (n--)
     {
+        // Runs of printable ASCII are copied directly. They would be accepted
+        // one byte at a time below without changing any state.
+        //
+        if (  NVT_IS_NORMAL == d->raw_input_state
+           && (  CHARSET_UTF8 != d->encoding
+              || CL_PRINT_START_STATE == d->raw_codepoint_state))
+        {
+            const size_t nRun = ascii_run_length(pBytes, static_cast<size_t>(n) + 1);
+            if (0 < nRun)
+            {
+                // The paths for the 8-bit character sets below always leave
+                // one byte unused at the end of the buffer.
+                //
+                size_t nRoom = pend - p;
+                if (  CHARSET_UTF8 != d->encoding
+                   && CHARSET_ASCII != d->encoding
+                   && 0 < nRoom)
+                {
+                    nRoom--;
+                }
+                const size_t nCopy = (nRun < nRoom) ? nRun : nRoom;
+                memcpy(p, pBytes, nCopy);
+                p += nCopy;
+                nInputBytes += nCopy;
+                nLostBytes  += nRun - nCopy;
+                pBytes += nRun;
+                n -= static_cast<int>(nRun - 1);
+                continue;
+            }
+        }
+
         const auto ch = static_cast<unsigned char>(*pBytes);
         const auto iAction = nvt_input_action_table[d->raw_input_state][nvt_input_xlat_table[ch]];
         switch (iAction)
@@ -3650,8 +5051,11 @@ static void process_input_helper(DESC *d, char *pBytes, int nBytes)
             case OPTION_NO:
                 if (desired_us_option(d, ch))
                 {
-                    set_us_state(d, ch, OPTION_YES);
+                    // WILL must be sent first. Enabling some options (e.g.,
+                    // COMPRESS2) changes how everything after it is sent.
+                    //
                     send_will(d, ch);
+                    set_us_state(d, ch, OPTION_YES);
                 }
                 else
                 {
@@ -4222,6 +5626,10 @@ void close_sockets(bool emergency, const UTF8 *message)
 void emergency_shutdown(void)
 {
     close_sockets(true, T("Going down - Bye"));
+
+    // Get the log onto disk before the panic dump starts.
+    //
+    Log.WriteThrough();
 }
 
 
@@ -4778,10 +6186,11 @@ static void DCL_CDECL sighandler(int sig)
 #endif // SIGSYS
 #endif // UNIX_SIGNALS
 
-        // Panic save + restart.
+        // Panic save + restart.  Panicking must be set first so that the
+        // flush writes directly instead of waiting on the log writer.
         //
-        Log.Flush();
         check_panicking(sig);
+        Log.Flush();
         log_signal(sig);
         report();
 
@@ -5251,7 +6660,7 @@ void process_windows_tcp(DWORD dwTimeout)
 
                 TBLOCK *save = tb;
                 tb = tb->hdr.nxt;
-                MEMFREE(save);
+                free_tblock(save);
                 save = nullptr;
                 d->output_head = tb;
                 if (nullptr == tb)
@@ -5307,6 +6716,7 @@ void process_windows_tcp(DWORD dwTimeout)
                 {
                     d1->flags &= ~DS_AUTODARK;
                 }
+                s_Dirty(d->player);
                 db[d->player].fs.word[FLAG_WORD1] &= ~DARK;
             }
 
@@ -167,6 +167,7 @@ static NAMETAB drop_sw[] =
 
 static NAMETAB dump_sw[] =
 {
+    {T("compact"),         1,  CA_WIZARD,  DUMP_COMPACT},
     {T("flatfile"),        1,  CA_WIZARD,  DUMP_FLATFILE|SW_MULTIPLE},
     {T("structure"),       1,  CA_WIZARD,  DUMP_STRUCT|SW_MULTIPLE},
     {T("text"),            1,  CA_WIZARD,  DUMP_TEXT|SW_MULTIPLE},
@@ -3164,6 +3165,16 @@ CF_HAND(cf_attr_access)
         }
 
         perm->wildcard = StringClone(str);
+        UTF8 *pCompiled = alloc_lbuf("cf_attr_access");
+        if (0 != wild_compile(str, pCompiled, LBUF_SIZE))
+        {
+            perm->compiled = StringClone(pCompiled);
+        }
+        else
+        {
+            perm->compiled = nullptr;
+        }
+        free_lbuf(pCompiled);
         perm->flags = 0;
 
         ATTRPERM *head = *ppv;
@@ -3659,6 +3670,13 @@ static void list_vattrs(dbref player, UTF8 *s_mask)
                    && s_mask[0] != '\0';
 
     UTF8 *buff = alloc_lbuf("list_vattrs");
+    UTF8 *pCompiled = nullptr;
+    bool bCompiled = false;
+    if (wild_mtch)
+    {
+        pCompiled = alloc_lbuf("list_vattrs.glob");
+        bCompiled = (0 != wild_compile(s_mask, pCompiled, LBUF_SIZE));
+    }
 
     // If wild_match, then only list attributes that match wildcard(s)
     //
@@ -3678,8 +3696,8 @@ static void list_vattrs(dbref player, UTF8 *s_mask)
             //
             if (wild_mtch)
             {
-                mudstate.wild_invk_ctr = 0;
-                if (!quick_wild(s_mask, va->name))
+                if (  !bCompiled
+                   || !quick_wild_compiled(pCompiled, va->name))
                 {
                     continue;
                 }
@@ -3701,6 +3719,10 @@ static void list_vattrs(dbref player, UTF8 *s_mask)
     }
     raw_notify(player, p);
     free_lbuf(buff);
+    if (nullptr != pCompiled)
+    {
+        free_lbuf(pCompiled);
+    }
 }
 
 size_t LeftJustifyString(UTF8 *field, size_t nWidth, const UTF8 *value)
@@ -3775,6 +3797,9 @@ static void list_hashstats(dbref player)
     list_hashstat(player, T("Player Names"), &mudstate.player_htab);
     list_hashstat(player, T("Net Descr."), &mudstate.desc_htab);
     list_hashstat(player, T("Fwd. lists"), &mudstate.fwdlist_htab);
+    list_hashstat(player, T("Parsed Locks"), &mudstate.lock_htab);
+    list_hashstat(player, T("Regexps"), &mudstate.regexp_htab);
+    list_hashstat(player, T("Queue Index"), &mudstate.queue_htab);
     list_hashstat(player, T("Excl. $-cmds"), &mudstate.parent_htab);
     list_hashstat(player, T("Mail Messages"), &mudstate.mail_htab);
     list_hashstat(player, T("Channel Names"), &mudstate.channel_htab);
@@ -3806,6 +3831,7 @@ static void list_db_stats(dbref player)
     raw_notify(player, tprintf(T("Syncs      %12d"), cs_syncs));
     raw_notify(player, tprintf(T("I/O        %12d%12d"), cs_dbwrites, cs_dbreads));
     raw_notify(player, tprintf(T("Cache Hits %12d%12d"), cs_whits, cs_rhits));
+    cache_list_compaction(player);
 #endif // MEMORY_BASED
 }
 
@@ -3882,6 +3908,35 @@ static void list_process(dbref player)
     raw_notify(player,
            tprintf(T("Descs avail: %10d"), maxfds));
 #endif // HAVE_GETRUSAGE
+
+#if defined(UNIX_ZLIB)
+    // MCCP2 compression achieved on each descriptor which has used it.
+    //
+    long nIn = 0;
+    long nOut = 0;
+    DESC *d;
+    DESC_ITER_ALL(d)
+    {
+        if (0 < d->mccp_out)
+        {
+            long nRatio = static_cast<long>(10 * d->mccp_in / d->mccp_out);
+            raw_notify(player,
+                   tprintf(T("MCCP desc %-4u%10ld in     %10ld out    %4ld.%ld:1%s"),
+                       d->descriptor, static_cast<long>(d->mccp_in),
+                       static_cast<long>(d->mccp_out), nRatio / 10, nRatio % 10,
+                       (nullptr == d->mccp) ? T(" (ended)") : T("")));
+            nIn  += static_cast<long>(d->mccp_in);
+            nOut += static_cast<long>(d->mccp_out);
+        }
+    }
+    if (0 < nOut)
+    {
+        long nRatio = 10 * nIn / nOut;
+        raw_notify(player,
+               tprintf(T("MCCP total:  %10ld in     %10ld out    %4ld.%ld:1"),
+                   nIn, nOut, nRatio / 10, nRatio % 10));
+    }
+#endif // UNIX_ZLIB
 }
 
 //----------------------------------------------------------------------------
@@ -3974,6 +4029,7 @@ static void list_rlevels(dbref player)
 #ifdef REALITY_LVLS
 #define LIST_RLEVELS    26
 #endif
+#define LIST_CACHE      27
 
 NAMETAB list_names[] =
 {
@@ -3982,6 +4038,7 @@ NAMETAB list_names[] =
     {T("attributes"),         2,  CA_PUBLIC,  LIST_ATTRIBUTES},
     {T("bad_names"),          2,  CA_WIZARD,  LIST_BADNAMES},
     {T("buffers"),            2,  CA_WIZARD,  LIST_BUFTRACE},
+    {T("cache"),              2,  CA_WIZARD,  LIST_CACHE},
     {T("commands"),           3,  CA_PUBLIC,  LIST_COMMANDS},
     {T("config_permissions"), 3,  CA_GOD,     LIST_CONF_PERMS},
     {T("costs"),              3,  CA_PUBLIC,  LIST_COSTS},
@@ -4104,6 +4161,13 @@ void do_list(dbref executor, dbref caller, dbref enactor, int eval, int key,
     case LIST_DB_STATS:
         list_db_stats(executor);
         break;
+    case LIST_CACHE:
+#if defined(MEMORY_BASED)
+        raw_notify(executor, T("Database is memory based."));
+#else // MEMORY_BASED
+        cache_list(executor);
+#endif // MEMORY_BASED
+        break;
     case LIST_PROCESS:
         list_process(executor);
         break;
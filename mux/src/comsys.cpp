@@ -1521,25 +1521,51 @@ void SendChannelMessage
     bool bSpoof = ((ch->type & CHANNEL_SPOOF) != 0);
     ch->num_messages++;
 
-    struct comuser *user;
-    for (user = ch->on_users; user; user = user->on_next)
+    // Both forms of the message are converted once and shared by every
+    // listener.
+    //
+    mux_string *sNormal = new mux_string(msgNormal);
+    mux_string *sNoComtitle = nullptr;
+    if (  nullptr != msgNoComtitle
+       && msgNoComtitle != msgNormal)
+    {
+        sNoComtitle = new mux_string(msgNoComtitle);
+    }
+    else
+    {
+        sNoComtitle = sNormal;
+    }
+
     {
-        if (  user->bUserIsOn
-           && test_receive_access(user->who, ch))
+        mux_render_cache rcNormal(*sNormal);
+        mux_render_cache rcNoComtitle(*sNoComtitle);
+
+        struct comuser *user;
+        for (user = ch->on_users; user; user = user->on_next)
         {
-            if (  user->ComTitleStatus
-               || bSpoof
-               || msgNoComtitle == nullptr)
+            if (  user->bUserIsOn
+               && test_receive_access(user->who, ch))
             {
-                notify_comsys(user->who, executor, msgNormal);
-            }
-            else
-            {
-                notify_comsys(user->who, executor, msgNoComtitle);
+                if (  user->ComTitleStatus
+                   || bSpoof
+                   || msgNoComtitle == nullptr)
+                {
+                    notify_comsys(user->who, executor, *sNormal);
+                }
+                else
+                {
+                    notify_comsys(user->who, executor, *sNoComtitle);
+                }
             }
         }
     }
 
+    if (sNoComtitle != sNormal)
+    {
+        delete sNoComtitle;
+    }
+    delete sNormal;
+
     // Handle logging.
     //
     dbref obj = ch->chan_obj;
@@ -2472,15 +2498,15 @@ static void do_listchannels(dbref player, UTF8 *pattern)
         raw_notify(player, T("Warning: Only public channels and your channels will be shown."));
     }
 
-    bool bWild;
+    bool bWild = false;
+    bool bCompiled = false;
+    UTF8 *pCompiled = nullptr;
     if (  nullptr != pattern
        && '\0' != *pattern)
     {
         bWild = true;
-    }
-    else
-    {
-        bWild = false;
+        pCompiled = alloc_lbuf("do_listchannels");
+        bCompiled = (0 != wild_compile(pattern, pCompiled, LBUF_SIZE));
     }
 
     raw_notify(player, T("*** Channel      --Flags--    Obj     Own   Charge  Balance  Users   Messages"));
@@ -2493,7 +2519,8 @@ static void do_listchannels(dbref player, UTF8 *pattern)
            || Controls(player, ch->charge_who))
         {
             if (  !bWild
-               || quick_wild(pattern, ch->name))
+               || (  bCompiled
+                  && quick_wild_compiled(pCompiled, ch->name)))
             {
 
                 mux_sprintf(temp, sizeof(temp),
@@ -2516,6 +2543,10 @@ static void do_listchannels(dbref player, UTF8 *pattern)
         }
     }
     raw_notify(player, T("-- End of list of Channels --"));
+    if (nullptr != pCompiled)
+    {
+        free_lbuf(pCompiled);
+    }
 }
 
 void do_comtitle
@@ -2620,15 +2651,15 @@ void do_comlist
         return;
     }
 
-    bool bWild;
+    bool bWild = false;
+    bool bCompiled = false;
+    UTF8 *pCompiled = nullptr;
     if (  nullptr != pattern
        && '\0' != *pattern)
     {
         bWild = true;
-    }
-    else
-    {
-        bWild = false;
+        pCompiled = alloc_lbuf("do_comlist");
+        bCompiled = (0 != wild_compile(pattern, pCompiled, LBUF_SIZE));
     }
 
     raw_notify(executor, T("Alias           Channel            Status   Title"));
@@ -2641,7 +2672,8 @@ void do_comlist
         if (user)
         {
             if (  !bWild
-               || quick_wild(pattern, c->channels[i]))
+               || (  bCompiled
+                  && quick_wild_compiled(pCompiled, c->channels[i])))
             {
                 UTF8 *p =
                     tprintf(T("%-15.15s %-18.18s %s %s %s"),
@@ -2659,6 +2691,10 @@ void do_comlist
         }
     }
     raw_notify(executor, T("-- End of comlist --"));
+    if (nullptr != pCompiled)
+    {
+        free_lbuf(pCompiled);
+    }
 }
 
 // Cleanup channels owned by the player.
@@ -3651,15 +3687,15 @@ void do_chanlist
         raw_notify(executor, T("*** Channel       Owner           Description"));
     }
 
-    bool bWild;
+    bool bWild = false;
+    bool bCompiled = false;
+    UTF8 *pCompiled = nullptr;
     if (  nullptr != pattern
        && '\0' != *pattern)
     {
         bWild = true;
-    }
-    else
-    {
-        bWild = false;
+        pCompiled = alloc_lbuf("do_chanlist");
+        bCompiled = (0 != wild_compile(pattern, pCompiled, LBUF_SIZE));
     }
 
 #define MAX_SUPPORTED_NUM_ENTRIES 10000
@@ -3688,7 +3724,8 @@ void do_chanlist
                    ch = (struct channel *)hash_nextentry(&mudstate.channel_htab))
             {
                 if (  !bWild
-                   || quick_wild(pattern, ch->name))
+                   || (  bCompiled
+                      && quick_wild_compiled(pCompiled, ch->name)))
                 {
                     charray[actualEntries].name = ch->name;
                     charray[actualEntries].ptr = ch;
@@ -3769,6 +3806,10 @@ void do_chanlist
         }
     }
     raw_notify(executor, T("-- End of list of Channels --"));
+    if (nullptr != pCompiled)
+    {
+        free_lbuf(pCompiled);
+    }
 }
 
 // Returns a player's comtitle for a named channel.
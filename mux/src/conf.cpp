@@ -56,6 +56,9 @@ void cf_init(void)
     mudconf.comsys_db = StringClone(T("comsys.db"));
 
     mudconf.compress_db = false;
+    mudconf.compress_level = 0;
+    mudconf.snapshot_db = false;
+    mudconf.load_threads = 0;
     mudconf.compress = StringClone(T("gzip"));
     mudconf.uncompress = StringClone(T("gzip -d"));
     mudconf.status_file = StringClone(T("shutdown.status"));
@@ -149,6 +152,8 @@ void cf_init(void)
     mudconf.check_interval = 600;
     mudconf.events_daily_hour = 7;
     mudconf.dump_offset = 0;
+    mudconf.dump_slice = 1000;
+    mudconf.incremental_dumps = 0;
     mudconf.check_offset = 300;
     mudconf.idle_timeout = 3600;
     mudconf.conn_timeout = 120;
@@ -268,6 +273,8 @@ void cf_init(void)
     mudconf.rpt_cmdsecs.SetSeconds(120);
     mudconf.max_cmdsecs.SetSeconds(60);
     mudconf.cache_tick_period.SetSeconds(30);
+    mudconf.log_buffer_size = 0;
+    mudconf.log_flush_interval.SetSeconds(1);
     mudconf.control_flags = 0xffffffff; // Everything for now...
     mudconf.log_options = LOG_ALWAYS | LOG_BUGS | LOG_SECURITY |
         LOG_NET | LOG_LOGIN | LOG_DBSAVES | LOG_CONFIGMODS |
@@ -284,13 +291,13 @@ void cf_init(void)
     mudconf.markdata[7] = 0x80;
     mudconf.func_nest_lim = 500;
     mudconf.func_invk_lim = 25000;
-    mudconf.wild_invk_lim = 100000;
     mudconf.ntfy_nest_lim = 20;
     mudconf.lock_nest_lim = 20;
     mudconf.parent_nest_lim = 10;
     mudconf.zone_nest_lim = 20;
     mudconf.stack_limit = 50;
     mudconf.cache_names = true;
+    mudconf.cache_mmap = false;
     mudconf.toad_recipient = -1;
     mudconf.eval_comtitle = true;
     mudconf.run_startup = true;
@@ -301,6 +308,7 @@ void cf_init(void)
     mudconf.help_executor = NOTHING;
     mudconf.global_error_obj = NOTHING;
     mudconf.cache_pages = 40;
+    mudconf.cache_compact_pages = 16;
     mudconf.mail_per_hour = 50;
     mudconf.vattr_per_hour = 5000;
     mudconf.references_per_hour = 500;
@@ -312,12 +320,17 @@ void cf_init(void)
     mudconf.room_name_charset = 0;
     mudconf.thing_name_charset = 0;
     mudconf.password_methods = CRYPT_DEFAULT;
+    mudconf.password_threads = 2;
+    mudconf.resolver_threads = 8;
+    mudconf.resolver_cache_ttl = 3600;
+    mudconf.resolver_negative_ttl = 300;
     mudconf.default_charset = CHARSET_LATIN1;
 
     mudstate.events_flag = 0;
     mudstate.bReadingConfiguration = false;
     mudstate.bCanRestart = false;
     mudstate.panicking = false;
+    mudstate.bJournal = false;
     mudstate.asserting = 0;
     mudstate.logging = 0;
     mudstate.epoch = 0;
@@ -357,7 +370,7 @@ void cf_init(void)
     mudstate.markbits = nullptr;
     mudstate.func_nest_lev = 0;
     mudstate.func_invk_ctr = 0;
-    mudstate.wild_invk_ctr = 0;
+    mudstate.func_generation = 0;
     mudstate.ntfy_nest_lev = 0;
     mudstate.train_nest_lev = 0;
     mudstate.lock_nest_lev = 0;
@@ -834,6 +847,10 @@ static CF_HAND(cf_alias)
         if (!hashfindLEN(pCased, nCased, (CHashTable *) vp))
         {
             hashaddLEN(pCased, nCased, cp, (CHashTable *) vp);
+            if ((CHashTable *)vp == &mudstate.func_htab)
+            {
+                mudstate.func_generation++;
+            }
         }
         return 0;
     }
@@ -876,6 +893,10 @@ static CF_HAND(cf_name)
         {
             hashaddLEN(pCased, nCased, cp, (CHashTable *) vp);
             hashdeleteLEN(Buffer, bCased, (CHashTable *) vp);
+            if ((CHashTable *)vp == &mudstate.func_htab)
+            {
+                mudstate.func_generation++;
+            }
             return 0;
         }
     }
@@ -1769,7 +1790,9 @@ static CONFPARM conftable[] =
     {T("autozone"),                  cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.autozone,        nullptr,            0},
     {T("bad_name"),                  cf_badname,     CA_GOD,    CA_DISABLED, nullptr,                         nullptr,            0},
     {T("badsite_file"),              cf_string_dyn,  CA_STATIC, CA_GOD,      (int *)&mudconf.site_file,       nullptr, SIZEOF_PATHNAME},
+    {T("cache_mmap"),                cf_bool,        CA_STATIC, CA_WIZARD,   (int *)&mudconf.cache_mmap,      nullptr,            0},
     {T("cache_names"),               cf_bool,        CA_STATIC, CA_GOD,      (int *)&mudconf.cache_names,     nullptr,            0},
+    {T("cache_compact_pages"),       cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.cache_compact_pages,    nullptr,            0},
     {T("cache_pages"),               cf_int,         CA_STATIC, CA_WIZARD,   &mudconf.cache_pages,            nullptr,            0},
     {T("cache_tick_period"),         cf_seconds,     CA_GOD,    CA_WIZARD,   (int *)&mudconf.cache_tick_period, nullptr,          0},
     {T("check_interval"),            cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.check_interval,         nullptr,            0},
@@ -1779,6 +1802,7 @@ static CONFPARM conftable[] =
     {T("command_quota_max"),         cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.cmd_quota_max,          nullptr,            0},
     {T("compress_program"),          cf_string_dyn,  CA_STATIC, CA_GOD,      (int *)&mudconf.compress,        nullptr, SIZEOF_PATHNAME},
     {T("compression"),               cf_bool,        CA_GOD,    CA_GOD,      (int *)&mudconf.compress_db,     nullptr,            0},
+    {T("compression_level"),         cf_int,         CA_GOD,    CA_GOD,      &mudconf.compress_level,         nullptr,            0},
     {T("comsys_database"),           cf_string_dyn,  CA_STATIC, CA_GOD,      (int *)&mudconf.comsys_db,       nullptr, SIZEOF_PATHNAME},
     {T("config_access"),             cf_cf_access,   CA_GOD,    CA_DISABLED, nullptr,                         access_nametab,     0},
     {T("conn_timeout"),              cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.conn_timeout,           nullptr,            0},
@@ -1799,6 +1823,7 @@ static CONFPARM conftable[] =
     {T("dump_interval"),             cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.dump_interval,          nullptr,            0},
     {T("dump_message"),              cf_string,      CA_GOD,    CA_WIZARD,   (int *)mudconf.dump_msg,         nullptr,          256},
     {T("dump_offset"),               cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.dump_offset,            nullptr,            0},
+    {T("dump_slice"),                cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.dump_slice,             nullptr,            0},
     {T("earn_limit"),                cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.paylimit,               nullptr,            0},
     {T("eval_comtitle"),             cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.eval_comtitle,   nullptr,            0},
     {T("events_daily_hour"),         cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.events_daily_hour,      nullptr,            0},
@@ -1850,6 +1875,7 @@ static CONFPARM conftable[] =
     {T("idle_timeout"),              cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.idle_timeout,           nullptr,            0},
     {T("idle_wiz_dark"),             cf_bool,        CA_GOD,    CA_WIZARD,   (int *)&mudconf.idle_wiz_dark,   nullptr,            0},
     {T("include"),                   cf_include,     CA_STATIC, CA_DISABLED, nullptr,                         nullptr,            0},
+    {T("incremental_dumps"),         cf_int,         CA_STATIC, CA_WIZARD,   &mudconf.incremental_dumps,      nullptr,            0},
     {T("indent_desc"),               cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.indent_desc,     nullptr,            0},
     {T("initial_size"),              cf_int,         CA_STATIC, CA_WIZARD,   &mudconf.init_size,              nullptr,            0},
     {T("input_database"),            cf_string_dyn,  CA_STATIC, CA_GOD,      (int *)&mudconf.indb,            nullptr, SIZEOF_PATHNAME},
@@ -1862,8 +1888,11 @@ static CONFPARM conftable[] =
     {T("lbuf_size"),                 cf_int,       CA_DISABLED, CA_PUBLIC,   (int *)&mudconf.lbuf_size,       nullptr,            0},
     {T("link_cost"),                 cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.linkcost,               nullptr,            0},
     {T("list_access"),               cf_ntab_access, CA_GOD,    CA_DISABLED, (int *)list_names,               access_nametab,     0},
+    {T("load_threads"),              cf_int,         CA_STATIC, CA_GOD,      &mudconf.load_threads,           nullptr,            0},
     {T("lock_recursion_limit"),      cf_int,         CA_WIZARD, CA_PUBLIC,   &mudconf.lock_nest_lim,          nullptr,            0},
     {T("log"),                       cf_modify_bits, CA_GOD,    CA_DISABLED, &mudconf.log_options,            logoptions_nametab, 0},
+    {T("log_buffer_size"),           cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.log_buffer_size,        nullptr,            0},
+    {T("log_flush_interval"),        cf_seconds,     CA_GOD,    CA_WIZARD,   (int *)&mudconf.log_flush_interval, nullptr,         0},
     {T("log_options"),               cf_modify_bits, CA_GOD,    CA_DISABLED, &mudconf.log_info,               logdata_nametab,    0},
     {T("logout_cmd_access"),         cf_ntab_access, CA_GOD,    CA_DISABLED, (int *)logout_cmdtable,          access_nametab,     0},
     {T("logout_cmd_alias"),          cf_alias,       CA_GOD,    CA_DISABLED, (int *)&mudstate.logout_cmd_htab,nullptr,            0},
@@ -1895,6 +1924,7 @@ static CONFPARM conftable[] =
     {T("paranoid_allocate"),         cf_bool,        CA_GOD,    CA_WIZARD,   (int *)&mudconf.paranoid_alloc,  nullptr,            0},
     {T("parent_recursion_limit"),    cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.parent_nest_lim,        nullptr,            0},
     {T("password_methods"),          cf_modify_bits, CA_GOD,    CA_PUBLIC,   &mudconf.password_methods,       method_nametab,     0},
+    {T("password_threads"),          cf_int,         CA_STATIC, CA_GOD,      &mudconf.password_threads,       nullptr,            0},
     {T("paycheck"),                  cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.paycheck,               nullptr,            0},
     {T("pemit_any_object"),          cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.pemit_any,       nullptr,            0},
     {T("pemit_far_players"),         cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.pemit_players,   nullptr,            0},
@@ -1934,6 +1964,9 @@ static CONFPARM conftable[] =
     {T("register_site"),             cf_site,        CA_GOD,    CA_DISABLED, (int *)&mudstate.access_list,    nullptr,  HC_REGISTER},
     {T("reset_players"),             cf_bool,        CA_GOD,    CA_DISABLED, (int *)&mudconf.reset_players,   nullptr,            0},
     {T("reset_site"),                cf_site,        CA_GOD,    CA_DISABLED, (int *)&mudstate.access_list,    nullptr,     HC_RESET},
+    {T("resolver_cache_ttl"),        cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.resolver_cache_ttl,     nullptr,            0},
+    {T("resolver_negative_ttl"),     cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.resolver_negative_ttl,  nullptr,            0},
+    {T("resolver_threads"),          cf_int,         CA_STATIC, CA_GOD,      &mudconf.resolver_threads,       nullptr,            0},
     {T("restrict_home"),             cf_bool,        CA_GOD,    CA_DISABLED, (int *)&mudconf.restrict_home,   nullptr,            0},
     {T("retry_limit"),               cf_int,         CA_GOD,    CA_WIZARD,   &mudconf.retry_limit,            nullptr,            0},
     {T("robot_cost"),                cf_int,         CA_GOD,    CA_PUBLIC,   &mudconf.robotcost,              nullptr,            0},
@@ -1953,6 +1986,7 @@ static CONFPARM conftable[] =
     {T("signal_action"),             cf_option,      CA_STATIC, CA_GOD,      &mudconf.sig_action,             sigactions_nametab, 0},
     {T("site_chars"),                cf_int,         CA_GOD,    CA_WIZARD,   (int *)&mudconf.site_chars,      nullptr,            0},
     {T("sitemon_site"),              cf_site,        CA_GOD,    CA_DISABLED, (int *)&mudstate.access_list,    nullptr,   HC_SITEMON},
+    {T("snapshot_db"),               cf_bool,        CA_GOD,    CA_GOD,      (int *)&mudconf.snapshot_db,     nullptr,            0},
     {T("space_compress"),            cf_bool,        CA_GOD,    CA_PUBLIC,   (int *)&mudconf.space_compress,  nullptr,            0},
 #ifdef UNIX_SSL
     {T("ssl_certificate_file"),      cf_string,      CA_STATIC, CA_DISABLED, (int *)mudconf.ssl_certificate_file,nullptr,       128},
@@ -71,6 +71,27 @@
 #define UNIX_SSL
 #define UNIX_DIGEST
 #endif // SSL_ENABLED
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#define UNIX_ZLIB
+#endif // HAVE_LIBZ && HAVE_ZLIB_H
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE_PTHREAD_H)
+#define UNIX_THREADS
+#endif // HAVE_LIBPTHREAD && HAVE_PTHREAD_H
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MSYNC)
+#define UNIX_MMAP
+#endif // HAVE_SYS_MMAN_H && HAVE_MMAP && HAVE_MSYNC
+
+// Prefer epoll() where the platform provides it. The select()-based loop
+// remains available everywhere else.
+//
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE) \
+    && defined(HAVE_EPOLL_CTL) && defined(HAVE_EPOLL_WAIT)
+#define UNIX_NETWORKING_EPOLL
+#elif defined(HAVE_SYS_SELECT_H) && defined(HAVE_SELECT)
+#define UNIX_NETWORKING_SELECT
+#else
+#error Platform does not provide epoll() or select().
+#endif
 
 #endif // WIN32
 
@@ -187,6 +208,22 @@ extern int getdtablesize(void);
 #include <openssl/ssl.h>
 #endif
 
+#if defined(UNIX_ZLIB)
+#include <zlib.h>
+#endif // UNIX_ZLIB
+
+#if defined(UNIX_THREADS)
+#include <pthread.h>
+#endif // UNIX_THREADS
+
+#if defined(UNIX_CRYPT) && defined(HAVE_CRYPT_H)
+#include <crypt.h>
+#endif // UNIX_CRYPT && HAVE_CRYPT_H
+
+#if defined(UNIX_MMAP)
+#include <sys/mman.h>
+#endif // UNIX_MMAP
+
 #ifdef HAVE_GETPAGESIZE
 
 #ifdef NEED_GETPAGESIZE_DECL
@@ -435,11 +472,6 @@ typedef unsigned __int64 UINT64;
 
 #else // WIN32
 
-#if defined(HAVE_SYS_SELECT_H) && defined(HAVE_SELECT)
-#define UNIX_NETWORKING_SELECT
-#else
-#error Platform does not provide select().
-#endif
 
 #define DCL_CDECL
 #define DCL_EXPORT
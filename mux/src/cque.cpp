@@ -77,14 +77,205 @@ static int add_to(dbref executor, int am, int attrnum)
     return num;
 }
 
-// This Task assumes that pEntry is already unlinked from any lists it may
-// have been related to.
+// ---------------------------------------------------------------------------
+// Queue index: Every queue entry is on a list of all entries, a list for its
+// executor, and a list for the owner of its executor.  A semaphore entry is
+// also on a list for its semaphore object and a list for its semaphore
+// attribute.  The lists are kept in queue_htab and appended to at the tail,
+// so each one is in the order the entries were queued.  @halt, @notify, and
+// @ps only visit the entries on one list instead of every task in the
+// scheduler.
+//
+typedef struct
+{
+    int   iIndex;
+    dbref thing;
+    int   attr;
+} QUEUE_KEY;
+
+typedef struct
+{
+    BQUE *pHead;
+    BQUE *pTail;
+    int   nEntries;
+} QUEUE_LIST;
+
+static int s_anQueued[QK_COUNT];
+
+static QUEUE_LIST *que_list(int iIndex, dbref thing, int attr, bool bCreate)
+{
+    QUEUE_KEY key;
+    key.iIndex = iIndex;
+    key.thing  = thing;
+    key.attr   = attr;
+
+    QUEUE_LIST *pql = (QUEUE_LIST *)hashfindLEN(&key, sizeof(key), &mudstate.queue_htab);
+    if (  nullptr == pql
+       && bCreate)
+    {
+        pql = (QUEUE_LIST *)MEMALLOC(sizeof(QUEUE_LIST));
+        ISOUTOFMEMORY(pql);
+        pql->pHead = nullptr;
+        pql->pTail = nullptr;
+        pql->nEntries = 0;
+        if (!hashaddLEN(&key, sizeof(key), pql, &mudstate.queue_htab))
+        {
+            MEMFREE(pql);
+            pql = nullptr;
+        }
+    }
+    return pql;
+}
+
+static void que_link(BQUE *point, int iIndex, dbref thing, int attr)
+{
+    point->next[iIndex] = nullptr;
+    point->prev[iIndex] = nullptr;
+
+    QUEUE_LIST *pql = que_list(iIndex, thing, attr, true);
+    if (nullptr == pql)
+    {
+        return;
+    }
+
+    point->prev[iIndex] = pql->pTail;
+    if (nullptr == pql->pTail)
+    {
+        pql->pHead = point;
+    }
+    else
+    {
+        pql->pTail->next[iIndex] = point;
+    }
+    pql->pTail = point;
+    pql->nEntries++;
+}
+
+static void que_unlink(BQUE *point, int iIndex, dbref thing, int attr)
+{
+    QUEUE_LIST *pql = que_list(iIndex, thing, attr, false);
+    if (  nullptr == pql
+       || (  nullptr == point->prev[iIndex]
+          && pql->pHead != point))
+    {
+        // The entry never made it onto this list.
+        //
+        return;
+    }
+
+    if (nullptr == point->prev[iIndex])
+    {
+        pql->pHead = point->next[iIndex];
+    }
+    else
+    {
+        point->prev[iIndex]->next[iIndex] = point->next[iIndex];
+    }
+
+    if (nullptr == point->next[iIndex])
+    {
+        pql->pTail = point->prev[iIndex];
+    }
+    else
+    {
+        point->next[iIndex]->prev[iIndex] = point->prev[iIndex];
+    }
+    point->next[iIndex] = nullptr;
+    point->prev[iIndex] = nullptr;
+
+    pql->nEntries--;
+    if (0 == pql->nEntries)
+    {
+        QUEUE_KEY key;
+        key.iIndex = iIndex;
+        key.thing  = thing;
+        key.attr   = attr;
+        hashdeleteLEN(&key, sizeof(key), &mudstate.queue_htab);
+        MEMFREE(pql);
+    }
+}
+
+static void que_index(BQUE *point, int kind)
+{
+    point->kind  = kind;
+    point->owner = Owner(point->executor);
+    que_link(point, QI_ALL, NOTHING, 0);
+    que_link(point, QI_EXECUTOR, point->executor, 0);
+    que_link(point, QI_OWNER, point->owner, 0);
+    if (QK_SEMAPHORE == kind)
+    {
+        que_link(point, QI_SEMOBJ, point->u.s.sem, 0);
+        que_link(point, QI_SEMAPHORE, point->u.s.sem, point->u.s.attr);
+    }
+    s_anQueued[kind]++;
+}
+
+// Changes what kind of entry this is.  Only a semaphore can become something
+// else, and only by becoming an ordinary wait.
+//
+static void que_rekind(BQUE *point, int kind)
+{
+    if (QK_SEMAPHORE == point->kind)
+    {
+        que_unlink(point, QI_SEMAPHORE, point->u.s.sem, point->u.s.attr);
+        que_unlink(point, QI_SEMOBJ, point->u.s.sem, 0);
+    }
+    s_anQueued[point->kind]--;
+    point->kind = kind;
+    s_anQueued[kind]++;
+}
+
+static void que_unindex(BQUE *point)
+{
+    if (QK_NONE == point->kind)
+    {
+        return;
+    }
+
+    if (QK_SEMAPHORE == point->kind)
+    {
+        que_unlink(point, QI_SEMAPHORE, point->u.s.sem, point->u.s.attr);
+        que_unlink(point, QI_SEMOBJ, point->u.s.sem, 0);
+    }
+    que_unlink(point, QI_OWNER, point->owner, 0);
+    que_unlink(point, QI_EXECUTOR, point->executor, 0);
+    que_unlink(point, QI_ALL, NOTHING, 0);
+    s_anQueued[point->kind]--;
+    point->kind  = QK_NONE;
+    point->pTask = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// chown_que: Move an object's queue entries to the list of its new owner.
+//
+void chown_que(dbref thing)
+{
+    QUEUE_LIST *pql = que_list(QI_EXECUTOR, thing, 0, false);
+    if (nullptr == pql)
+    {
+        return;
+    }
+
+    dbref owner = Owner(thing);
+    for (BQUE *point = pql->pHead; nullptr != point; point = point->next[QI_EXECUTOR])
+    {
+        if (point->owner != owner)
+        {
+            que_unlink(point, QI_OWNER, point->owner, 0);
+            point->owner = owner;
+            que_link(point, QI_OWNER, owner, 0);
+        }
+    }
+}
+
+// This Task removes pEntry from the queue index before running it.
 //
 static void Task_RunQueueEntry(void *pEntry, int iUnused)
 {
     UNUSED_PARAMETER(iUnused);
 
     BQUE *point = (BQUE *)pEntry;
+    que_unindex(point);
     dbref executor = point->executor;
 
     if (  Good_obj(executor)
@@ -272,6 +463,77 @@ static bool que_want(BQUE *entry, dbref ptarg, dbref otarg)
            || otarg == entry->executor);
 }
 
+// ---------------------------------------------------------------------------
+// que_collect: Gather the queue entries that match (ptarg, otarg).
+//
+// The list for the object or owner is walked instead of every entry, and the
+// matches are copied so that the caller may free entries as it goes.  The
+// array is in the order the entries were queued and must be freed with
+// MEMFREE.
+//
+static BQUE **que_collect(dbref ptarg, dbref otarg, int *pnEntries)
+{
+    int iIndex;
+    QUEUE_LIST *pql;
+    if (NOTHING != otarg)
+    {
+        iIndex = QI_EXECUTOR;
+        pql = que_list(iIndex, otarg, 0, false);
+    }
+    else if (NOTHING != ptarg)
+    {
+        iIndex = QI_OWNER;
+        pql = que_list(iIndex, ptarg, 0, false);
+    }
+    else
+    {
+        iIndex = QI_ALL;
+        pql = que_list(iIndex, NOTHING, 0, false);
+    }
+
+    *pnEntries = 0;
+    if (nullptr == pql)
+    {
+        return nullptr;
+    }
+
+    BQUE **aEntries = (BQUE **)MEMALLOC(pql->nEntries * sizeof(BQUE *));
+    ISOUTOFMEMORY(aEntries);
+
+    int nEntries = 0;
+    for (BQUE *point = pql->pHead; nullptr != point; point = point->next[iIndex])
+    {
+        if (que_want(point, ptarg, otarg))
+        {
+            aEntries[nEntries++] = point;
+        }
+    }
+    *pnEntries = nEntries;
+    return aEntries;
+}
+
+// ---------------------------------------------------------------------------
+// que_discard: Cancel a queue entry without running it.
+//
+static void que_discard(BQUE *point)
+{
+    scheduler.CancelTask(point->pTask);
+    que_unindex(point);
+
+    for (int i = 0; i < MAX_GLOBAL_REGS; i++)
+    {
+        if (point->scr[i])
+        {
+            RegRelease(point->scr[i]);
+            point->scr[i] = nullptr;
+        }
+    }
+
+    MEMFREE(point->text);
+    point->text = nullptr;
+    free_qentry(point);
+}
+
 static void Task_SemaphoreTimeout(void *pExpired, int iUnused)
 {
     UNUSED_PARAMETER(iUnused);
@@ -279,6 +541,7 @@ static void Task_SemaphoreTimeout(void *pExpired, int iUnused)
     // A semaphore has timed out.
     //
     BQUE *point = (BQUE *)pExpired;
+    que_unindex(point);
     add_to(point->u.s.sem, -1, point->u.s.attr);
     point->u.s.sem = NOTHING;
     Task_RunQueueEntry(point, 0);
@@ -291,68 +554,10 @@ void Task_SQLTimeout(void *pExpired, int iUnused)
     // A SQL Query has timed out.  Actually, this isn't supported.
     //
     BQUE *point = (BQUE *)pExpired;
+    que_unindex(point);
     Task_RunQueueEntry(point, 0);
 }
 
-static dbref Halt_Player_Target;
-static dbref Halt_Object_Target;
-static int   Halt_Entries;
-static dbref Halt_Player_Run;
-static dbref Halt_Entries_Run;
-
-static int CallBack_HaltQueue(PTASK_RECORD p)
-{
-    if (  p->fpTask == Task_RunQueueEntry
-       || p->fpTask == Task_SQLTimeout
-       || p->fpTask == Task_SemaphoreTimeout)
-    {
-        // This is a @wait, timed Semaphore Task, or timed SQL Query.
-        //
-        BQUE *point = (BQUE *)(p->arg_voidptr);
-        if (que_want(point, Halt_Player_Target, Halt_Object_Target))
-        {
-            // Accounting for pennies and queue quota.
-            //
-            dbref dbOwner = point->executor;
-            if (!isPlayer(dbOwner))
-            {
-                dbOwner = Owner(dbOwner);
-            }
-            if (dbOwner != Halt_Player_Run)
-            {
-                if (Halt_Player_Run != NOTHING)
-                {
-                    giveto(Halt_Player_Run, mudconf.waitcost * Halt_Entries_Run);
-                    a_Queue(Halt_Player_Run, -Halt_Entries_Run);
-                }
-                Halt_Player_Run = dbOwner;
-                Halt_Entries_Run = 0;
-            }
-            Halt_Entries++;
-            Halt_Entries_Run++;
-            if (p->fpTask == Task_SemaphoreTimeout)
-            {
-                add_to(point->u.s.sem, -1, point->u.s.attr);
-            }
-
-            for (int i = 0; i < MAX_GLOBAL_REGS; i++)
-            {
-                if (point->scr[i])
-                {
-                    RegRelease(point->scr[i]);
-                    point->scr[i] = nullptr;
-                }
-            }
-
-            MEMFREE(point->text);
-            point->text = nullptr;
-            free_qentry(point);
-            return IU_REMOVE_TASK;
-        }
-    }
-    return IU_NEXT_TASK;
-}
-
 // ------------------------------------------------------------------
 //
 // halt_que: Remove all queued commands that match (executor, object).
@@ -365,23 +570,51 @@ static int CallBack_HaltQueue(PTASK_RECORD p)
 //
 int halt_que(dbref executor, dbref object)
 {
-    Halt_Player_Target = executor;
-    Halt_Object_Target = object;
-    Halt_Entries       = 0;
-    Halt_Player_Run    = NOTHING;
-    Halt_Entries_Run   = 0;
+    int   nEntries;
+    BQUE **aEntries = que_collect(executor, object, &nEntries);
 
-    // Process @wait, timed semaphores, and untimed semaphores.
-    //
-    scheduler.TraverseUnordered(CallBack_HaltQueue);
+    dbref dbRun    = NOTHING;
+    int   nRun     = 0;
+    for (int i = 0; i < nEntries; i++)
+    {
+        BQUE *point = aEntries[i];
 
-    if (Halt_Player_Run != NOTHING)
+        // Accounting for pennies and queue quota.
+        //
+        dbref dbOwner = point->executor;
+        if (!isPlayer(dbOwner))
+        {
+            dbOwner = Owner(dbOwner);
+        }
+        if (dbOwner != dbRun)
+        {
+            if (dbRun != NOTHING)
+            {
+                giveto(dbRun, mudconf.waitcost * nRun);
+                a_Queue(dbRun, -nRun);
+            }
+            dbRun = dbOwner;
+            nRun  = 0;
+        }
+        nRun++;
+        if (QK_SEMAPHORE == point->kind)
+        {
+            add_to(point->u.s.sem, -1, point->u.s.attr);
+        }
+        que_discard(point);
+    }
+
+    if (dbRun != NOTHING)
     {
-        giveto(Halt_Player_Run, mudconf.waitcost * Halt_Entries_Run);
-        a_Queue(Halt_Player_Run, -Halt_Entries_Run);
-        Halt_Player_Run = NOTHING;
+        giveto(dbRun, mudconf.waitcost * nRun);
+        a_Queue(dbRun, -nRun);
     }
-    return Halt_Entries;
+
+    if (nullptr != aEntries)
+    {
+        MEMFREE(aEntries);
+    }
+    return nEntries;
 }
 
 // ---------------------------------------------------------------------------
@@ -459,53 +692,64 @@ void do_halt(dbref executor, dbref caller, dbref enactor, int eval, int key, UTF
     notify(Owner(executor), tprintf(T("%d queue entr%s removed."), numhalted, numhalted == 1 ? "y" : "ies"));
 }
 
-static int Notify_Key;
-static int Notify_Num_Done;
-static int Notify_Num_Max;
-static int Notify_Sem;
-static int Notify_Attr;
-
-// NFY_DRAIN or NFY_NFYALL
+// ---------------------------------------------------------------------------
+// nfy_que: Notify commands from the queue and perform or discard them.
+//
+// Waiters are visited in the order they were queued.
 //
-static int CallBack_NotifySemaphoreDrainOrAll(PTASK_RECORD p)
+int nfy_que(dbref sem, int attr, int key, int count)
 {
-    if (p->fpTask == Task_SemaphoreTimeout)
+    int cSemaphore = 1;
+    if (attr)
     {
-        // This represents a semaphore.
-        //
-        BQUE *point = (BQUE *)(p->arg_voidptr);
-        if (  point->u.s.sem == Notify_Sem
-           && (  point->u.s.attr == Notify_Attr
-              || !Notify_Attr))
+        int   aflags;
+        dbref aowner;
+        UTF8 *str = atr_get("nfy_que.562", sem, attr, &aowner, &aflags);
+        cSemaphore = mux_atol(str);
+        free_lbuf(str);
+    }
+
+    int nDone = 0;
+    if (0 < cSemaphore)
+    {
+        int iIndex;
+        QUEUE_LIST *pql;
+        if (attr)
+        {
+            iIndex = QI_SEMAPHORE;
+            pql = que_list(iIndex, sem, attr, false);
+        }
+        else
         {
-            Notify_Num_Done++;
-            if (NFY_DRAIN == (Notify_Key & NFY_MASK))
+            iIndex = QI_SEMOBJ;
+            pql = que_list(iIndex, sem, 0, false);
+        }
+
+        BQUE *point = (nullptr == pql) ? nullptr : pql->pHead;
+        while (  nullptr != point
+              && (  NFY_NFY != (key & NFY_MASK)
+                 || nDone < count))
+        {
+            // The list may be freed along with its last entry.
+            //
+            BQUE *next = point->next[iIndex];
+            nDone++;
+            if (NFY_DRAIN == (key & NFY_MASK))
             {
                 // Discard the command
                 //
                 giveto(point->executor, mudconf.waitcost);
                 a_Queue(Owner(point->executor), -1);
-
-                for (int i = 0; i < MAX_GLOBAL_REGS; i++)
-                {
-                    if (point->scr[i])
-                    {
-                        RegRelease(point->scr[i]);
-                        point->scr[i] = nullptr;
-                    }
-                }
-
-                MEMFREE(point->text);
-                point->text = nullptr;
-                free_qentry(point);
-
-                return IU_REMOVE_TASK;
+                que_discard(point);
             }
             else
             {
                 // Allow the command to run. The priority may have been
                 // PRIORITY_SUSPEND, so we need to change it.
                 //
+                que_rekind(point, QK_WAIT);
+
+                PTASK_RECORD p = point->pTask;
                 if (isPlayer(point->enactor))
                 {
                     p->iPriority = PRIORITY_PLAYER;
@@ -516,84 +760,9 @@ static int CallBack_NotifySemaphoreDrainOrAll(PTASK_RECORD p)
                 }
                 p->ltaWhen.GetUTC();
                 p->fpTask = Task_RunQueueEntry;
-                return IU_UPDATE_TASK;
+                scheduler.UpdateTask(p);
             }
-        }
-    }
-    return IU_NEXT_TASK;
-}
-
-// NFY_NFY
-//
-static int CallBack_NotifySemaphoreFirst(PTASK_RECORD p)
-{
-    // If we've notified enough, exit.
-    //
-    if (  NFY_NFY == (Notify_Key & NFY_MASK)
-       && Notify_Num_Done >= Notify_Num_Max)
-    {
-        return IU_DONE;
-    }
-
-    if (p->fpTask == Task_SemaphoreTimeout)
-    {
-        // This represents a semaphore.
-        //
-        BQUE *point = (BQUE *)(p->arg_voidptr);
-        if (  point->u.s.sem == Notify_Sem
-           && (  point->u.s.attr == Notify_Attr
-              || !Notify_Attr))
-        {
-            Notify_Num_Done++;
-
-            // Allow the command to run. The priority may have been
-            // PRIORITY_SUSPEND, so we need to change it.
-            //
-            if (isPlayer(point->enactor))
-            {
-                p->iPriority = PRIORITY_PLAYER;
-            }
-            else
-            {
-                p->iPriority = PRIORITY_OBJECT;
-            }
-            p->ltaWhen.GetUTC();
-            p->fpTask = Task_RunQueueEntry;
-            return IU_UPDATE_TASK;
-        }
-    }
-    return IU_NEXT_TASK;
-}
-
-// ---------------------------------------------------------------------------
-// nfy_que: Notify commands from the queue and perform or discard them.
-
-int nfy_que(dbref sem, int attr, int key, int count)
-{
-    int cSemaphore = 1;
-    if (attr)
-    {
-        int   aflags;
-        dbref aowner;
-        UTF8 *str = atr_get("nfy_que.562", sem, attr, &aowner, &aflags);
-        cSemaphore = mux_atol(str);
-        free_lbuf(str);
-    }
-
-    Notify_Num_Done = 0;
-    if (0 < cSemaphore)
-    {
-        Notify_Key     = key;
-        Notify_Sem     = sem;
-        Notify_Attr    = attr;
-        Notify_Num_Max = count;
-        if (NFY_NFY == (key & NFY_MASK))
-        {
-            scheduler.TraverseOrdered(CallBack_NotifySemaphoreFirst);
-        }
-        else
-        {
-            scheduler.TraverseUnordered(CallBack_NotifySemaphoreDrainOrAll);
+            point = next;
         }
     }
 
@@ -608,7 +777,7 @@ int nfy_que(dbref sem, int attr, int key, int count)
         atr_clr(sem, attr);
     }
 
-    return Notify_Num_Done;
+    return nDone;
 }
 
 // ---------------------------------------------------------------------------
@@ -858,6 +1027,14 @@ static BQUE *setup_que
     tmp->caller = caller;
     tmp->eval = eval;
     tmp->nargs = nargs;
+    tmp->kind = QK_NONE;
+    tmp->owner = NOTHING;
+    tmp->pTask = nullptr;
+    for (a = 0; a < QI_COUNT; a++)
+    {
+        tmp->next[a] = nullptr;
+        tmp->prev[a] = nullptr;
+    }
     return tmp;
 }
 
@@ -910,6 +1087,8 @@ void wait_que
     tmp->u.s.sem = sem;
     tmp->u.s.attr = attr;
 
+    PTASK_RECORD pTask;
+    int kind;
     if (sem == NOTHING)
     {
         // Not a semaphore, so let it run it immediately or put it on
@@ -917,12 +1096,13 @@ void wait_que
         //
         if (tmp->IsTimed)
         {
-            scheduler.DeferTask(tmp->waittime, iPriority, Task_RunQueueEntry, tmp, 0);
+            pTask = scheduler.DeferTask(tmp->waittime, iPriority, Task_RunQueueEntry, tmp, 0);
         }
         else
         {
-            scheduler.DeferImmediateTask(iPriority, Task_RunQueueEntry, tmp, 0);
+            pTask = scheduler.DeferImmediateTask(iPriority, Task_RunQueueEntry, tmp, 0);
         }
+        kind = QK_WAIT;
     }
     else
     {
@@ -934,7 +1114,14 @@ void wait_que
             //
             iPriority = PRIORITY_SUSPEND;
         }
-        scheduler.DeferTask(tmp->waittime, iPriority, Task_SemaphoreTimeout, tmp, 0);
+        pTask = scheduler.DeferTask(tmp->waittime, iPriority, Task_SemaphoreTimeout, tmp, 0);
+        kind = QK_SEMAPHORE;
+    }
+
+    if (nullptr != pTask)
+    {
+        tmp->pTask = pTask;
+        que_index(tmp, kind);
     }
 }
 
@@ -960,6 +1147,7 @@ static int CallBack_QueryComplete(PTASK_RECORD p)
             p->iPriority = PRIORITY_OBJECT;
             p->ltaWhen.GetUTC();
             p->fpTask    = Task_RunQueueEntry;
+            que_rekind(point, QK_WAIT);
 
             point->u.s.sem    = NOTHING;
             point->u.s.attr   = 0;
@@ -1041,11 +1229,20 @@ void sql_que
 
     tmp->u.hQuery = hQuery;
 
-    scheduler.DeferTask(tmp->waittime, PRIORITY_SUSPEND, Task_SQLTimeout, tmp, 0);
+    PTASK_RECORD pTask = scheduler.DeferTask(tmp->waittime, PRIORITY_SUSPEND, Task_SQLTimeout, tmp, 0);
+    if (nullptr != pTask)
+    {
+        tmp->pTask = pTask;
+        que_index(tmp, QK_SQL);
+    }
+
     MUX_RESULT mr = mudstate.pIQueryControl->Query(hQuery, dbname, query);
-    if (MUX_FAILED(mr))
+    if (  MUX_FAILED(mr)
+       && nullptr != pTask)
     {
-        scheduler.CancelTask(Task_SQLTimeout, tmp, next_handle);
+        giveto(executor, mudconf.waitcost);
+        a_Queue(Owner(executor), -1);
+        que_discard(tmp);
     }
 }
 
@@ -1235,18 +1432,11 @@ void do_query
 
 static CLinearTimeAbsolute Show_lsaNow;
 static int Total_SystemTasks;
-static int Total_RunQueueEntry;
-static int Shown_RunQueueEntry;
-static int Total_SemaphoreTimeout;
-static int Shown_SemaphoreTimeout;
-static dbref Show_Player_Target;
-static dbref Show_Object_Target;
 static int Show_Key;
 static dbref Show_Player;
-static int Show_bFirstLine;
-
-int Total_SQLTimeout;
-int Shown_SQLTimeout;
+static PTASK_RECORD *Show_aTasks;
+static int Show_nTasks;
+static int Show_nTasksAlloc;
 
 static int CallBack_ShowDispatches(PTASK_RECORD p)
 {
@@ -1278,6 +1468,10 @@ static int CallBack_ShowDispatches(PTASK_RECORD p)
         notify(Show_Player, tprintf(T("[%d]Database cache tick"), ltd.ReturnSeconds()));
     }
 #endif
+    else if (p->fpTask == dispatch_LogFlush)
+    {
+        notify(Show_Player, tprintf(T("[%d]Log flush"), ltd.ReturnSeconds()));
+    }
     else if (p->fpTask == Task_ProcessCommand)
     {
         notify(Show_Player, tprintf(T("[%d]Further command quota"), ltd.ReturnSeconds()));
@@ -1342,82 +1536,48 @@ static void ShowPsLine(BQUE *tmp)
     free_lbuf(bufp);
 }
 
-static int CallBack_ShowWait(PTASK_RECORD p)
-{
-    if (p->fpTask != Task_RunQueueEntry)
-    {
-        return IU_NEXT_TASK;
-    }
-
-    Total_RunQueueEntry++;
-    BQUE *tmp = (BQUE *)(p->arg_voidptr);
-    if (que_want(tmp, Show_Player_Target, Show_Object_Target))
-    {
-        Shown_RunQueueEntry++;
-        if (Show_Key == PS_SUMM)
-        {
-            return IU_NEXT_TASK;
-        }
-        if (Show_bFirstLine)
-        {
-            notify(Show_Player, T("----- Wait Queue -----"));
-            Show_bFirstLine = false;
-        }
-        ShowPsLine(tmp);
-    }
-    return IU_NEXT_TASK;
-}
-
-static int CallBack_ShowSemaphore(PTASK_RECORD p)
+// Gathers the tasks which are not queue entries.
+//
+static int CallBack_CollectDispatches(PTASK_RECORD p)
 {
-    if (p->fpTask != Task_SemaphoreTimeout)
+    if (  p->fpTask == Task_RunQueueEntry
+       || p->fpTask == Task_SQLTimeout
+       || p->fpTask == Task_SemaphoreTimeout)
     {
         return IU_NEXT_TASK;
     }
 
-    Total_SemaphoreTimeout++;
-    BQUE *tmp = (BQUE *)(p->arg_voidptr);
-    if (que_want(tmp, Show_Player_Target, Show_Object_Target))
+    if (Show_nTasks == Show_nTasksAlloc)
     {
-        Shown_SemaphoreTimeout++;
-        if (Show_Key == PS_SUMM)
-        {
-            return IU_NEXT_TASK;
-        }
-        if (Show_bFirstLine)
-        {
-            notify(Show_Player, T("----- Semaphore Queue -----"));
-            Show_bFirstLine = false;
-        }
-        ShowPsLine(tmp);
+        Show_nTasksAlloc = (0 == Show_nTasksAlloc) ? 16 : 2 * Show_nTasksAlloc;
+        Show_aTasks = (PTASK_RECORD *)MEMREALLOC(Show_aTasks, Show_nTasksAlloc * sizeof(PTASK_RECORD));
+        ISOUTOFMEMORY(Show_aTasks);
     }
+    Show_aTasks[Show_nTasks++] = p;
     return IU_NEXT_TASK;
 }
 
-int CallBack_ShowSQLQueries(PTASK_RECORD p)
+// Shows the entries of one kind and returns how many there were.
+//
+static int ShowQueue(BQUE *aEntries[], int nEntries, int kind, const UTF8 *pHeader)
 {
-    if (p->fpTask != Task_SQLTimeout)
+    int nShown = 0;
+    for (int i = 0; i < nEntries; i++)
     {
-        return IU_NEXT_TASK;
-    }
-
-    Total_SQLTimeout++;
-    BQUE *tmp = (BQUE *)(p->arg_voidptr);
-    if (que_want(tmp, Show_Player_Target, Show_Object_Target))
-    {
-        Shown_SQLTimeout++;
-        if (Show_Key == PS_SUMM)
-        {
-            return IU_NEXT_TASK;
-        }
-        if (Show_bFirstLine)
+        if (kind == aEntries[i]->kind)
         {
-            notify(Show_Player, T("----- SQL Queries -----"));
-            Show_bFirstLine = false;
+            nShown++;
+            if (Show_Key != PS_SUMM)
+            {
+                if (1 == nShown)
+                {
+                    notify(Show_Player, pHeader);
+                }
+                ShowPsLine(aEntries[i]);
+            }
         }
-        ShowPsLine(tmp);
     }
-    return IU_NEXT_TASK;
+    return nShown;
 }
 
 // ---------------------------------------------------------------------------
@@ -1491,36 +1651,65 @@ void do_ps(dbref executor, dbref caller, dbref enactor, int eval, int key, UTF8
     }
 
     Show_lsaNow.GetUTC();
-    Total_SystemTasks = 0;
-    Total_RunQueueEntry = 0;
-    Shown_RunQueueEntry = 0;
-    Total_SemaphoreTimeout = 0;
-    Shown_SemaphoreTimeout = 0;
-    Total_SQLTimeout = 0;
-    Shown_SQLTimeout = 0;
-    Show_Player_Target = executor_targ;
-    Show_Object_Target = obj_targ;
     Show_Key = key;
     Show_Player = executor;
-    Show_bFirstLine = true;
-    scheduler.TraverseOrdered(CallBack_ShowWait);
-    Show_bFirstLine = true;
-    scheduler.TraverseOrdered(CallBack_ShowSemaphore);
-    Show_bFirstLine = true;
-    scheduler.TraverseOrdered(CallBack_ShowSQLQueries);
+
+    int nEntries;
+    BQUE **aEntries = que_collect(executor_targ, obj_targ, &nEntries);
+    if (  key != PS_SUMM
+       && 0 < nEntries)
+    {
+        // Show the entries in the order the scheduler would run them.
+        //
+        PTASK_RECORD *aTasks = (PTASK_RECORD *)MEMALLOC(nEntries * sizeof(PTASK_RECORD));
+        ISOUTOFMEMORY(aTasks);
+        for (int i = 0; i < nEntries; i++)
+        {
+            aTasks[i] = aEntries[i]->pTask;
+        }
+        scheduler.Sort(aTasks, nEntries);
+        for (int i = 0; i < nEntries; i++)
+        {
+            aEntries[i] = (BQUE *)(aTasks[i]->arg_voidptr);
+        }
+        MEMFREE(aTasks);
+    }
+
+    int nWait = ShowQueue(aEntries, nEntries, QK_WAIT, T("----- Wait Queue -----"));
+    int nSemaphore = ShowQueue(aEntries, nEntries, QK_SEMAPHORE, T("----- Semaphore Queue -----"));
+    int nSQL = ShowQueue(aEntries, nEntries, QK_SQL, T("----- SQL Queries -----"));
+    if (nullptr != aEntries)
+    {
+        MEMFREE(aEntries);
+    }
+
+    Total_SystemTasks = 0;
     if (Wizard(executor))
     {
         notify(executor, T("----- System Queue -----"));
-        scheduler.TraverseOrdered(CallBack_ShowDispatches);
+        Show_aTasks = nullptr;
+        Show_nTasks = 0;
+        Show_nTasksAlloc = 0;
+        scheduler.TraverseUnordered(CallBack_CollectDispatches);
+        if (nullptr != Show_aTasks)
+        {
+            scheduler.Sort(Show_aTasks, Show_nTasks);
+            for (int i = 0; i < Show_nTasks; i++)
+            {
+                CallBack_ShowDispatches(Show_aTasks[i]);
+            }
+            MEMFREE(Show_aTasks);
+            Show_aTasks = nullptr;
+        }
     }
 
     // Display stats.
     //
     bufp = alloc_mbuf("do_ps");
     mux_sprintf(bufp, MBUF_SIZE, T("Totals: Wait Queue...%d/%d  Semaphores...%d/%d  SQL %d/%d"),
-        Shown_RunQueueEntry, Total_RunQueueEntry,
-        Shown_SemaphoreTimeout, Total_SemaphoreTimeout,
-        Shown_SQLTimeout, Total_SQLTimeout);
+        nWait, s_anQueued[QK_WAIT],
+        nSemaphore, s_anQueued[QK_SEMAPHORE],
+        nSQL, s_anQueued[QK_SQL]);
     notify(executor, bufp);
     if (Wizard(executor))
     {
@@ -229,6 +229,7 @@ static void link_exit(dbref player, dbref exit, dbref dest)
         giveto(Owner(exit), mudconf.opencost);
         add_quota(Owner(exit), quot);
         s_Owner(exit, Owner(player));
+        s_Dirty(exit);
         db[exit].fs.word[FLAG_WORD1] &= ~(INHERIT | WIZARD);
         db[exit].fs.word[FLAG_WORD1] |= HALT;
     }
@@ -1020,6 +1020,7 @@ void do_fixdb
     case FIXDB_OWNER:
 
         s_Owner(thing, res);
+        chown_que(thing);
         if (!Quiet(executor))
             notify(executor, tprintf(T("Owner set to #%d"), res));
         break;
@@ -1731,6 +1732,133 @@ bool Commer(dbref thing)
     return false;
 }
 
+/* ---------------------------------------------------------------------------
+ * amatch_index: Return the compiled $-command and ^-listen index for an
+ * object, building it from the attribute list if necessary.
+ */
+
+const AMATCH_INDEX *amatch_index(dbref thing)
+{
+    if (nullptr != db[thing].pAMatch)
+    {
+        return db[thing].pAMatch;
+    }
+
+    int nEntries = 0;
+    int nEntriesAlloc = 0;
+    AMATCH_ENTRY *aEntries = nullptr;
+
+    size_t nText = 0;
+    size_t nTextAlloc = 0;
+    UTF8 *pText = nullptr;
+
+    atr_push();
+    UTF8 *buff = alloc_lbuf("amatch_index");
+    UTF8 *glob = alloc_lbuf("amatch_index.glob");
+    unsigned char *as;
+    for (int atr = atr_head(thing, &as); atr; atr = atr_next(&as))
+    {
+        if (nEntries == nEntriesAlloc)
+        {
+            nEntriesAlloc = GrowFiftyPercent(nEntriesAlloc, 8, INT_MAX);
+            aEntries = (AMATCH_ENTRY *)MEMREALLOC(aEntries,
+                nEntriesAlloc * sizeof(AMATCH_ENTRY));
+            ISOUTOFMEMORY(aEntries);
+        }
+
+        AMATCH_ENTRY *pEntry = aEntries + nEntries++;
+        pEntry->atr = atr;
+        pEntry->iPattern = -1;
+        pEntry->iAction = -1;
+        pEntry->iGlob = -1;
+
+        dbref  aowner;
+        size_t nLen;
+        atr_get_str_LEN(buff, thing, atr, &aowner, &pEntry->aflags, &nLen);
+
+        if (  0 != (pEntry->aflags & AF_NOPROG)
+           || (  AMATCH_CMD    != buff[0]
+              && AMATCH_LISTEN != buff[0]))
+        {
+            continue;
+        }
+
+        UTF8 *s = (UTF8 *)strchr((char *)buff+1, ':');
+        if (nullptr == s)
+        {
+            continue;
+        }
+
+        // Keep the leadin, the pattern, and the action back-to-back with the
+        // ':' replaced by a terminator.
+        //
+        if (nTextAlloc < nText + nLen + 1)
+        {
+            nTextAlloc = nText + nLen + 1 + LBUF_SIZE;
+            pText = (UTF8 *)MEMREALLOC(pText, nTextAlloc);
+            ISOUTOFMEMORY(pText);
+        }
+        memcpy(pText + nText, buff, nLen + 1);
+        pText[nText + (s - buff)] = '\0';
+        pEntry->iPattern = static_cast<int>(nText);
+        pEntry->iAction  = static_cast<int>(nText + (s - buff) + 1);
+        nText += nLen + 1;
+
+        // Wildcard patterns are also kept compiled.
+        //
+        if (0 == (pEntry->aflags & AF_REGEXP))
+        {
+            size_t nGlob = wild_compile(pText + pEntry->iPattern + 1, glob,
+                LBUF_SIZE);
+            if (0 != nGlob)
+            {
+                if (nTextAlloc < nText + nGlob)
+                {
+                    nTextAlloc = nText + nGlob + LBUF_SIZE;
+                    pText = (UTF8 *)MEMREALLOC(pText, nTextAlloc);
+                    ISOUTOFMEMORY(pText);
+                }
+                memcpy(pText + nText, glob, nGlob);
+                pEntry->iGlob = static_cast<int>(nText);
+                nText += nGlob;
+            }
+        }
+    }
+    free_lbuf(glob);
+    free_lbuf(buff);
+    atr_pop();
+
+    AMATCH_INDEX *pIndex = (AMATCH_INDEX *)MEMALLOC(sizeof(AMATCH_INDEX));
+    ISOUTOFMEMORY(pIndex);
+    pIndex->nEntries = nEntries;
+    pIndex->aEntries = aEntries;
+    pIndex->pText    = pText;
+    db[thing].pAMatch = pIndex;
+    return pIndex;
+}
+
+/* ---------------------------------------------------------------------------
+ * amatch_index_clear: Discard the compiled index for an object.
+ */
+
+void amatch_index_clear(dbref thing)
+{
+    AMATCH_INDEX *pIndex = db[thing].pAMatch;
+    if (nullptr != pIndex)
+    {
+        if (nullptr != pIndex->aEntries)
+        {
+            MEMFREE(pIndex->aEntries);
+        }
+        if (nullptr != pIndex->pText)
+        {
+            MEMFREE(pIndex->pText);
+        }
+        MEMFREE(pIndex);
+        db[thing].pAMatch = nullptr;
+    }
+}
+
 // routines to handle object attribute lists
 //
 
@@ -2030,6 +2158,9 @@ static void atr_decode_LEN(const UTF8 *iattr, size_t nLen, UTF8 *oattr,
 
 void atr_clr(dbref thing, int atr)
 {
+    amatch_index_clear(thing);
+    lock_cache_clear(thing, atr);
+
 #ifdef MEMORY_BASED
 
     if (  !db[thing].nALUsed
@@ -2059,6 +2190,10 @@ void atr_clr(dbref thing, int atr)
         }
         else // (list[mid].number == atr)
         {
+            if (mudstate.bJournal)
+            {
+                journal_attr(thing, atr);
+            }
             MEMFREE(list[mid].data);
             list[mid].data = nullptr;
             db[thing].nALUsed--;
@@ -2083,16 +2218,19 @@ void atr_clr(dbref thing, int atr)
     {
     case A_STARTUP:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD1] &= ~HAS_STARTUP;
         break;
 
     case A_DAILY:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] &= ~HAS_DAILY;
         break;
 
     case A_FORWARDLIST:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] &= ~HAS_FWDLIST;
         if (!mudstate.bStandAlone)
         {
@@ -2104,6 +2242,7 @@ void atr_clr(dbref thing, int atr)
 
     case A_LISTEN:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] &= ~HAS_LISTEN;
         break;
 
@@ -2134,6 +2273,9 @@ void atr_clr(dbref thing, int atr)
 
 void atr_add_raw_LEN(dbref thing, int atr, const UTF8 *szValue, size_t nValue)
 {
+    amatch_index_clear(thing);
+    lock_cache_clear(thing, atr);
+
     if (  !szValue
        || '\0' == szValue[0])
     {
@@ -2142,6 +2284,11 @@ void atr_add_raw_LEN(dbref thing, int atr, const UTF8 *szValue, size_t nValue)
     }
 
 #ifdef MEMORY_BASED
+    if (mudstate.bJournal)
+    {
+        journal_attr(thing, atr);
+    }
+
     ATRLIST *list = db[thing].pALHead;
     UTF8 *text = StringCloneLen(szValue, nValue);
 
@@ -2274,21 +2421,25 @@ FoundAttribute:
     {
     case A_STARTUP:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD1] |= HAS_STARTUP;
         break;
 
     case A_DAILY:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] |= HAS_DAILY;
         break;
 
     case A_FORWARDLIST:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] |= HAS_FWDLIST;
         break;
 
     case A_LISTEN:
 
+        s_Dirty(thing);
         db[thing].fs.word[FLAG_WORD2] |= HAS_LISTEN;
         break;
 
@@ -2579,8 +2730,16 @@ bool atr_pget_info(dbref thing, int atr, dbref *owner, int *flags)
 void atr_free(dbref thing)
 {
 #ifdef MEMORY_BASED
+    if (mudstate.bJournal)
+    {
+        journal_attr(thing, 0);
+    }
     if (db[thing].pALHead)
     {
+        for (int i = 0; i < db[thing].nALUsed; i++)
+        {
+            lock_cache_clear(thing, db[thing].pALHead[i].number);
+        }
         MEMFREE(db[thing].pALHead);
     }
     db[thing].pALHead  = nullptr;
@@ -2601,6 +2760,7 @@ void atr_free(dbref thing)
     atr_clr(thing, A_LIST);
 #endif // MEMORY_BASED
 
+    amatch_index_clear(thing);
     mudstate.bfCommands.Clear(thing);
     mudstate.bfNoCommands.Set(thing);
     mudstate.bfListens.Clear(thing);
@@ -2937,6 +3097,7 @@ static void initialize_objects(dbref first, dbref last)
 #endif // MEMORY_BASED
         db[thing].purename = nullptr;
         db[thing].moniker = nullptr;
+        db[thing].pAMatch = nullptr;
     }
 }
 
@@ -2946,6 +3107,10 @@ void db_grow(dbref newtop)
     mudstate.bfNoCommands.Resize(newtop);
     mudstate.bfListens.Resize(newtop);
     mudstate.bfNoListens.Resize(newtop);
+    if (mudstate.bJournal)
+    {
+        mudstate.bfDirty.Resize(newtop);
+    }
 
     int delta;
     if (mudstate.bStandAlone)
@@ -3054,6 +3219,10 @@ void db_free(void)
 
     if (db != nullptr)
     {
+        for (dbref thing = 0; thing < mudstate.db_top; thing++)
+        {
+            amatch_index_clear(thing);
+        }
         db -= SIZE_HACK;
         char *cp = (char *)db;
         MEMFREE(cp);
@@ -3788,6 +3957,15 @@ void load_restart_db(void)
 #ifdef UNIX_SSL
         d->ssl_session = nullptr;
 #endif
+#if defined(UNIX_NETWORKING_EPOLL)
+        d->epoll_events = 0;
+#endif // UNIX_NETWORKING_EPOLL
+#if defined(UNIX_ZLIB)
+        d->mccp = nullptr;
+        d->mccp_in = 0;
+        d->mccp_out = 0;
+#endif // UNIX_ZLIB
+        d->pending_connect = nullptr;
         if (3 <= version)
         {
             d->raw_input_state              = getref(f);
@@ -3976,6 +4154,16 @@ void load_restart_db(void)
         {
             s_Connected(d->player);
         }
+
+#if defined(UNIX_ZLIB)
+        // Compression was ended before the restart. Offer it again.
+        //
+        if (OPTION_YES == d->nvt_us_state[TELNET_COMPRESS2])
+        {
+            d->nvt_us_state[TELNET_COMPRESS2] = OPTION_NO;
+            enable_us(d, TELNET_COMPRESS2);
+        }
+#endif // UNIX_ZLIB
     }
 
     DESC_ITER_CONN(d)
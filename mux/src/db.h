@@ -11,9 +11,11 @@
 #ifndef MEMORY_BASED
 #define SYNC                    cache_sync()
 #define CLOSE                   cache_close()
+#define COMMIT                  cache_commit()
 #else // !MEMORY_BASED
 #define SYNC
 #define CLOSE
+#define COMMIT
 #endif // !MEMORY_BASED
 
 #include "attrcache.h"
@@ -94,6 +96,7 @@ struct boolexp
 
 #define F_UNKNOWN   0   /* Unknown database format */
 #define F_MUX       5   /* MUX format */
+#define F_MUX_SNAPSHOT 6 /* MUX binary snapshot */
 
 #define V_MASK      0x000000ff  /* Database version */
 #define V_ZONE      0x00000100  /* ZONE/DOMAIN field */
@@ -127,6 +130,27 @@ struct boolexp
 #define NOPERM      (-4)    /* Error status, no permission */
 extern const UTF8 *aszSpecialDBRefNames[1-NOPERM];
 
+// Compiled $-command and ^-listen index for one object.  It mirrors the
+// attribute list in atr_head() order and is discarded whenever an attribute
+// on the object is added, changed, or cleared.
+//
+typedef struct
+{
+    int atr;            // Attribute number.
+    int aflags;         // Per-instance attribute flags.
+    int iPattern;       // Offset of the leadin in pText, or -1.
+    int iAction;        // Offset of the action in pText.
+    int iGlob;          // Offset of the compiled wildcard pattern, or -1.
+} AMATCH_ENTRY;
+
+typedef struct
+{
+    int           nEntries;
+    AMATCH_ENTRY *aEntries;
+    UTF8         *pText;    // Leadin, pattern, '\0', action, '\0',
+                            // compiled pattern, '\0', ...
+} AMATCH_INDEX;
+
 typedef struct object OBJ;
 struct object
 {
@@ -169,6 +193,8 @@ struct object
     UTF8    *purename;
     UTF8    *moniker;
 
+    AMATCH_INDEX *pAMatch;  // ALL: Compiled $-commands and ^-listens.
+
 #ifdef MEMORY_BASED
     ATRLIST *pALHead;   /* The head of the attribute list.       */
     int      nALAlloc;  /* Size of the allocated attribute list. */
@@ -203,19 +229,25 @@ extern OBJ *db;
 #define ThMail(t)       db[t].throttled_mail
 #define ThRefs(t)       db[t].throttled_references
 
-#define s_Location(t,n)     db[t].location = (n)
-
-#define s_Zone(t,n)         db[t].zone = (n)
-
-#define s_Contents(t,n)     db[t].contents = (n)
-#define s_Exits(t,n)        db[t].exits = (n)
-#define s_Next(t,n)         db[t].next = (n)
-#define s_Link(t,n)         db[t].link = (n)
-#define s_Owner(t,n)        db[t].owner = (n)
-#define s_Parent(t,n)       db[t].parent = (n)
-#define s_Flags(t,f,n)      db[t].fs.word[f] = (n)
-#define s_Powers(t,n)       db[t].powers = (n)
-#define s_Powers2(t,n)      db[t].powers2 = (n)
+// Every change to a field which is saved in the database goes through one of
+// these, so that incremental checkpoints can find the objects which changed.
+// Code which assigns to db[] directly must use s_Dirty() itself.
+//
+#define s_Dirty(t)          (mudstate.bJournal ? mudstate.bfDirty.Set(t) : (void)0)
+
+#define s_Location(t,n)     (s_Dirty(t), db[t].location = (n))
+
+#define s_Zone(t,n)         (s_Dirty(t), db[t].zone = (n))
+
+#define s_Contents(t,n)     (s_Dirty(t), db[t].contents = (n))
+#define s_Exits(t,n)        (s_Dirty(t), db[t].exits = (n))
+#define s_Next(t,n)         (s_Dirty(t), db[t].next = (n))
+#define s_Link(t,n)         (s_Dirty(t), db[t].link = (n))
+#define s_Owner(t,n)        (s_Dirty(t), db[t].owner = (n))
+#define s_Parent(t,n)       (s_Dirty(t), db[t].parent = (n))
+#define s_Flags(t,f,n)      (s_Dirty(t), db[t].fs.word[f] = (n))
+#define s_Powers(t,n)       (s_Dirty(t), db[t].powers = (n))
+#define s_Powers2(t,n)      (s_Dirty(t), db[t].powers2 = (n))
 #define s_Home(t,n)         s_Link(t,n)
 #define s_Dropto(t,n)       s_Location(t,n)
 #define s_ThAttrib(t,n)     db[t].throttled_attributes = (n);
@@ -249,13 +281,38 @@ void db_grow(dbref);
 void db_free(void);
 void db_make_minimal(void);
 dbref    db_read(FILE *, int *, int *, int *);
-dbref    db_write(FILE *, int, int);
+dbref    db_write(FILE *, int, int, int);
+
+typedef struct db_writer DB_WRITER;
+DB_WRITER *db_write_begin(FILE *f, int format, int version, int generation);
+bool     db_write_step(DB_WRITER *pdw, int nObjects);
+dbref    db_write_end(DB_WRITER *pdw);
+void     db_write_abort(DB_WRITER *pdw);
+
+bool db_fopen_write(FILE **pFile, const UTF8 *pFilename, int iLevel);
+bool db_fopen_read(FILE **pFile, const UTF8 *pFilename);
+int  db_fclose(FILE *f);
+
+// Checkpoint journal.
+//
+bool journal_start(void);
+bool journal_checkpoint(void);
+int  journal_begin_dump(void);
+void journal_end_dump(int iGeneration, bool bWritten);
+void journal_commit_dump(int iGeneration, const UTF8 *pTemp, const UTF8 *pOut, const UTF8 *pPrev);
+void journal_stop(void);
+#ifdef MEMORY_BASED
+void journal_attr(dbref thing, int atr);
+#endif // MEMORY_BASED
+
 void destroy_thing(dbref);
 void destroy_exit(dbref);
 void putstring(FILE *f, const UTF8 *s);
 void *getstring_noalloc(FILE *f, bool new_strings, size_t *pnBuffer);
 void init_attrtab(void);
 int GrowFiftyPercent(int x, int low, int high);
+const AMATCH_INDEX *amatch_index(dbref thing);
+void amatch_index_clear(dbref thing);
 
 #define DOLIST(thing,list) \
     for ((thing)=(list); \
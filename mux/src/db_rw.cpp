@@ -9,13 +9,19 @@
 #include "config.h"
 #include "externs.h"
 
+#include "ansi.h"
 #include "attrs.h"
 #include "mathutil.h"
 #include "vattr.h"
 
+#include <atomic>
+
 static int g_version;
 static int g_format;
 static int g_flags;
+static int g_generation;
+
+static void journal_replay(void);
 
 // The following mux_AttrNameInitialSet_latin1 is only used for converting
 // A_LOCK.
@@ -347,607 +353,3476 @@ static bool get_list(FILE *f, dbref i)
     }
 }
 
-dbref db_read(FILE *f, int *db_format, int *db_version, int *db_flags)
+/* ---------------------------------------------------------------------------
+ * db_adjust_attr_next: Reconcile the next free attribute number with the
+ * attribute names and values that were actually loaded.
+ */
+
+static void db_adjust_attr_next(bool nextattr_gotten)
 {
-    dbref i, anum;
-    int ch;
-    const UTF8 *tstr;
-    int aflags;
-    BOOLEXP *tempbool;
-    UTF8 *buff;
-    size_t nBuffer;
+    // Attribute number warnings.
+    //
+    if (g_max_nam_atr < g_max_obj_atr)
+    {
+        Log.tinyprintf(T(ENDLINE "Warning: One or more attribute values are unnamed. Did you use ./Backup on a running game?"));
+    }
 
-    g_format = F_UNKNOWN;
-    g_version = 0;
-    g_flags = 0;
-    g_max_nam_atr = INT_MIN;
-    g_max_obj_atr = INT_MIN;
+    if (!nextattr_gotten)
+    {
+        Log.tinyprintf(T(ENDLINE "Warning: Missing +N<next free>. Adjusting."));
+    }
 
+    if (mudstate.attr_next <= g_max_nam_atr)
+    {
+        if (nextattr_gotten)
+        {
+            Log.tinyprintf(T(ENDLINE "Warning: +N<next free attr> conflicts with existing attribute names. Adjusting."));
+        }
+        mudstate.attr_next = g_max_nam_atr + 1;
+    }
 
-    bool header_gotten = false;
-    bool size_gotten = false;
-    bool nextattr_gotten = false;
+    if (mudstate.attr_next <= g_max_obj_atr)
+    {
+        if (nextattr_gotten)
+        {
+            Log.tinyprintf(T(ENDLINE "Warning: +N<next free attr> conflicts object attribute numbers. Adjusting."));
+        }
+        mudstate.attr_next = g_max_nam_atr + 1;
+    }
 
-    bool convert_values = false;
-    bool read_attribs = true;
-    bool read_name = true;
-    bool read_key = true;
-    bool read_money = true;
+    int max_atr = A_USER_START;
+    if (max_atr < g_max_nam_atr)
+    {
+        max_atr = g_max_nam_atr;
+    }
 
-    size_t nName;
-    bool bValid;
-    UTF8 *pName;
+    if (max_atr < g_max_obj_atr)
+    {
+        max_atr = g_max_obj_atr;
+    }
+
+    if (max_atr + 1 < mudstate.attr_next)
+    {
+        if (nextattr_gotten)
+        {
+            Log.tinyprintf(T(ENDLINE "Info: +N<next free attr> can be safely adjusted down."));
+        }
+        mudstate.attr_next = max_atr + 1;
+    }
+}
+
+// Binary snapshot format.
+//
+// A snapshot carries the same information as a flatfile written with the
+// same flags, but as fixed-size records that are copied into the object
+// table without any parsing.  It is written in native byte order and is
+// meant for restarting the same server quickly.  Flatfiles remain the
+// portable format.
+//
+// The file begins with SNAPSHOT_MAGIC, followed by a blob of NUL-terminated
+// strings (attribute names, object names, and attribute values), the
+// attribute name table, the object table, the attribute table, and a
+// trailer which locates each of them.  The trailer comes last so that a
+// snapshot can be written through a pipe and so that a truncated snapshot
+// is noticed.  String offsets are relative to the start of the blob.
+//
+// Version 2 adds SNAP_GENERATION just ahead of the trailer, which keeps its
+// version 1 layout.
+//
+#define SNAPSHOT_MAGIC      "\x89MUXSNAP"
+#define SNAPSHOT_END        "MUXSEND\n"
+#define SNAPSHOT_TAG_LEN    8
+#define SNAPSHOT_VERSION    2
+#define SNAPSHOT_BYTEORDER  0x01020304
+
+typedef struct
+{
+    UINT64 iName;
+    UINT32 nName;
+    INT32  iNumber;
+    INT32  iFlags;
+    INT32  iReserved;
+} SNAP_ATTRNAME;
+
+typedef struct
+{
+    UINT64 iName;       // Only if V_ATRNAME is not set.
+    UINT64 iAttr;       // First entry in the attribute table.
+    UINT32 nName;
+    UINT32 nAttr;
+    INT32  dbObject;
+    INT32  dbLocation;
+    INT32  dbZone;
+    INT32  dbContents;
+    INT32  dbExits;
+    INT32  dbLink;
+    INT32  dbNext;
+    INT32  dbOwner;
+    INT32  dbParent;
+    INT32  iPennies;    // Only if V_ATRMONEY is not set.
+    INT32  aFlags[3];
+    INT32  aPowers[2];
+    INT32  iReserved;
+} SNAP_OBJECT;
+
+typedef struct
+{
+    UINT64 iValue;
+    UINT32 nValue;
+    INT32  iAttr;
+} SNAP_ATTR;
+
+typedef struct
+{
+    UINT32 nByteOrder;
+    UINT32 nVersion;
+    INT32  iFlags;          // Same as +X.
+    INT32  nDbTop;          // Same as +S.
+    INT32  nAttrNext;       // Same as +N.
+    INT32  nRecordPlayers;  // Same as -R.
+    UINT32 nAttrNames;
+    UINT32 nObjects;
+    UINT64 nAttrs;
+    UINT64 nBlob;
+    UINT64 iAttrNames;
+    UINT64 iObjects;
+    UINT64 iAttrs;
+    char   szEnd[SNAPSHOT_TAG_LEN];
+} SNAP_TRAILER;
+
+typedef struct
+{
+    INT32  iGeneration;     // Same as +J.
+    INT32  iReserved;
+} SNAP_GENERATION;
+
+/* ---------------------------------------------------------------------------
+ * snapshot_string: Validate a string reference into the blob.
+ */
+
+static const UTF8 *snapshot_string(const UTF8 *pBlob, UINT64 nBlob, UINT64 iString, UINT32 nString)
+{
+    if (  nBlob <= iString
+       || nBlob - iString <= nString
+       || '\0' != pBlob[iString + nString])
+    {
+        return nullptr;
+    }
+    return pBlob + iString;
+}
+
+/* ---------------------------------------------------------------------------
+ * snapshot_section: Validate the location of a table.
+ */
+
+static bool snapshot_section(UINT64 iStart, UINT64 nCount, size_t nSize, UINT64 iMin, UINT64 iMax)
+{
+    return (  0 == (iStart % sizeof(UINT64))
+           && iMin <= iStart
+           && iStart <= iMax
+           && nCount <= (iMax - iStart) / nSize);
+}
+
+#if defined(UNIX_MMAP)
+/* ---------------------------------------------------------------------------
+ * db_map: Map a regular file for reading, or return nullptr.  The position
+ * of the stream is not disturbed.
+ */
+
+static const UTF8 *db_map(FILE *f, size_t *pnFile)
+{
+    struct stat sb;
+    if (  0 == fstat(fileno(f), &sb)
+       && S_ISREG(sb.st_mode)
+       && 0 < sb.st_size)
+    {
+        void *pMap = mmap(nullptr, static_cast<size_t>(sb.st_size), PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (MAP_FAILED != pMap)
+        {
+#if defined(HAVE_MADVISE)
+            madvise(pMap, static_cast<size_t>(sb.st_size), MADV_SEQUENTIAL);
+#endif // HAVE_MADVISE
+            *pnFile = static_cast<size_t>(sb.st_size);
+            return static_cast<const UTF8 *>(pMap);
+        }
+    }
+    return nullptr;
+}
+#endif // UNIX_MMAP
+
+/* ---------------------------------------------------------------------------
+ * snapshot_map: Make the whole snapshot addressable.  Regular files are
+ * mapped.  Anything else (for example, the output of uncompress_program) is
+ * read into memory.
+ */
+
+static const UTF8 *snapshot_map(FILE *f, size_t *pnFile, bool *pbMapped)
+{
+#if defined(UNIX_MMAP)
+    const UTF8 *pMap = db_map(f, pnFile);
+    if (nullptr != pMap)
+    {
+        *pbMapped = true;
+        return pMap;
+    }
+#endif // UNIX_MMAP
+
+    size_t nAlloc = 65536;
+    size_t nFile = 0;
+    UTF8 *pFile = (UTF8 *)MEMALLOC(nAlloc);
+    ISOUTOFMEMORY(pFile);
+    for (;;)
+    {
+        if (nFile == nAlloc)
+        {
+            UTF8 *pNew = (UTF8 *)MEMALLOC(2*nAlloc);
+            ISOUTOFMEMORY(pNew);
+            memcpy(pNew, pFile, nFile);
+            MEMFREE(pFile);
+            pFile = pNew;
+            nAlloc *= 2;
+        }
+
+        size_t n = fread(pFile + nFile, 1, nAlloc - nFile, f);
+        if (0 == n)
+        {
+            break;
+        }
+        nFile += n;
+    }
+    *pnFile = nFile;
+    *pbMapped = false;
+    return pFile;
+}
+
+static void snapshot_unmap(const UTF8 *pFile, size_t nFile, bool bMapped)
+{
+#if defined(UNIX_MMAP)
+    if (bMapped)
+    {
+        munmap(const_cast<UTF8 *>(pFile), nFile);
+        return;
+    }
+#else // UNIX_MMAP
+    UNUSED_PARAMETER(nFile);
+    UNUSED_PARAMETER(bMapped);
+#endif // UNIX_MMAP
+    MEMFREE(const_cast<UTF8 *>(pFile));
+}
+
+/* ---------------------------------------------------------------------------
+ * snapshot_get_object, snapshot_set_object: Copy the fixed fields of an
+ * object to or from a SNAP_OBJECT.  The name and attributes are handled by
+ * the caller.
+ */
+
+static void snapshot_get_object(dbref i, int flags, SNAP_OBJECT *po)
+{
+    memset(po, 0, sizeof(*po));
+    po->dbObject = i;
+    po->dbLocation = Location(i);
+    po->dbZone = Zone(i);
+    po->dbContents = Contents(i);
+    po->dbExits = Exits(i);
+    po->dbLink = Link(i);
+    po->dbNext = Next(i);
+    po->dbOwner = Owner(i);
+    po->dbParent = Parent(i);
+    if (!(flags & V_ATRMONEY))
+    {
+        po->iPennies = Pennies(i);
+    }
+    po->aFlags[0] = Flags(i);
+    po->aFlags[1] = Flags2(i);
+    po->aFlags[2] = Flags3(i);
+    po->aPowers[0] = Powers(i);
+    po->aPowers[1] = Powers2(i);
+}
+
+static void snapshot_set_object(dbref i, const SNAP_OBJECT *po, bool read_money)
+{
+    s_Location(i, po->dbLocation);
+    s_Zone(i, po->dbZone < NOTHING ? NOTHING : po->dbZone);
+    s_Contents(i, po->dbContents);
+    s_Exits(i, po->dbExits);
+    s_Link(i, po->dbLink);
+    s_Next(i, po->dbNext);
+    s_Owner(i, po->dbOwner);
+    s_Parent(i, po->dbParent);
+    if (read_money)
+    {
+        s_PenniesDirect(i, po->iPennies);
+    }
+    s_Flags(i, FLAG_WORD1, po->aFlags[0]);
+    s_Flags(i, FLAG_WORD2, po->aFlags[1]);
+    s_Flags(i, FLAG_WORD3, po->aFlags[2]);
+    s_Powers(i, po->aPowers[0]);
+    s_Powers2(i, po->aPowers[1]);
+}
+
+/* ---------------------------------------------------------------------------
+ * snapshot_load: Build the in-memory database from a snapshot image.
+ */
+
+static dbref snapshot_load(const UTF8 *pFile, size_t nFile, int *db_format, int *db_version, int *db_flags)
+{
+    SNAP_TRAILER st;
+    if (  nFile < SNAPSHOT_TAG_LEN + sizeof(st)
+       || 0 != memcmp(pFile, SNAPSHOT_MAGIC, SNAPSHOT_TAG_LEN))
+    {
+        Log.WriteString(T(ENDLINE "Snapshot is too short." ENDLINE));
+        return -1;
+    }
+
+    memcpy(&st, pFile + nFile - sizeof(st), sizeof(st));
+    if (0 != memcmp(st.szEnd, SNAPSHOT_END, SNAPSHOT_TAG_LEN))
+    {
+        Log.WriteString(T(ENDLINE "Snapshot is truncated." ENDLINE));
+        return -1;
+    }
+
+    if (SNAPSHOT_BYTEORDER != st.nByteOrder)
+    {
+        Log.WriteString(T(ENDLINE "Snapshot was written on a machine with a different byte order. Use a flatfile instead." ENDLINE));
+        return -1;
+    }
+
+    UINT64 iTrailer = nFile - sizeof(st);
+    if (2 == st.nVersion)
+    {
+        SNAP_GENERATION sg;
+        if (iTrailer < SNAPSHOT_TAG_LEN + sizeof(sg))
+        {
+            Log.WriteString(T(ENDLINE "Snapshot is too short." ENDLINE));
+            return -1;
+        }
+        iTrailer -= sizeof(sg);
+        memcpy(&sg, pFile + iTrailer, sizeof(sg));
+        g_generation = sg.iGeneration;
+    }
+    else if (1 != st.nVersion)
+    {
+        Log.tinyprintf(T(ENDLINE "Unsupported snapshot version: %u." ENDLINE), st.nVersion);
+        return -1;
+    }
+
+    g_format = F_MUX_SNAPSHOT;
+    g_version = st.iFlags & V_MASK;
+    g_flags = st.iFlags & ~V_MASK;
+    if (  g_version < MIN_SUPPORTED_VERSION
+       || MAX_SUPPORTED_VERSION < g_version
+       || (g_flags & MANDFLAGS_V4) != MANDFLAGS_V4)
+    {
+        Log.tinyprintf(T(ENDLINE "Unsupported snapshot database version: %d." ENDLINE), g_version);
+        return -1;
+    }
+
+    const UTF8 *pBlob = pFile + SNAPSHOT_TAG_LEN;
+    UINT64 iTables = SNAPSHOT_TAG_LEN + st.nBlob;
+    if (  iTrailer < iTables
+       || !snapshot_section(st.iAttrNames, st.nAttrNames, sizeof(SNAP_ATTRNAME), iTables, iTrailer)
+       || !snapshot_section(st.iObjects, st.nObjects, sizeof(SNAP_OBJECT), iTables, iTrailer)
+       || !snapshot_section(st.iAttrs, st.nAttrs, sizeof(SNAP_ATTR), iTables, iTrailer))
+    {
+        Log.WriteString(T(ENDLINE "Snapshot tables are damaged." ENDLINE));
+        return -1;
+    }
+
+    const SNAP_ATTRNAME *pAttrNames = reinterpret_cast<const SNAP_ATTRNAME *>(pFile + st.iAttrNames);
+    const SNAP_OBJECT   *pObjects   = reinterpret_cast<const SNAP_OBJECT *>(pFile + st.iObjects);
+    const SNAP_ATTR     *pAttrs     = reinterpret_cast<const SNAP_ATTR *>(pFile + st.iAttrs);
+
+    bool read_attribs = !(g_flags & V_DATABASE);
+    bool read_name = !(g_flags & V_ATRNAME);
+    bool read_money = !(g_flags & V_ATRMONEY);
 
-    int iDotCounter = 0;
     if (mudstate.bStandAlone)
     {
-        Log.WriteString(T("Reading "));
+        Log.WriteString(T("Reading snapshot "));
         Log.Flush();
     }
 
     db_free();
-    for (i = 0;; i++)
+    mudstate.min_size = st.nDbTop;
+    mudstate.attr_next = st.nAttrNext;
+    mudstate.record_players = st.nRecordPlayers;
+    if (mudconf.reset_players)
     {
-        if (mudstate.bStandAlone)
+        mudstate.record_players = 0;
+    }
+
+    // User-named attributes.
+    //
+    UINT32 iName;
+    for (iName = 0; iName < st.nAttrNames; iName++)
+    {
+        const SNAP_ATTRNAME *pan = pAttrNames + iName;
+        const UTF8 *tstr = snapshot_string(pBlob, st.nBlob, pan->iName, pan->nName);
+        if (nullptr == tstr)
         {
-            if (!iDotCounter)
+            Log.tinyprintf(T(ENDLINE "Bad name for attribute %d in snapshot." ENDLINE), pan->iNumber);
+            return -1;
+        }
+
+        size_t nName;
+        bool bValid;
+        UTF8 *pName = MakeCanonicalAttributeName(tstr, &nName, &bValid);
+        if (bValid)
+        {
+            if (g_max_nam_atr < pan->iNumber)
             {
-                iDotCounter = 100;
-                fputc('.', stderr);
-                fflush(stderr);
+                g_max_nam_atr = pan->iNumber;
             }
-            iDotCounter--;
+            vattr_define_LEN(pName, nName, pan->iNumber, pan->iFlags);
         }
+    }
 
-        ch = getc(f);
-        switch (ch)
+    // Objects are stored in ascending order, so the object table can be
+    // sized once.
+    //
+    if (0 < st.nObjects)
+    {
+        dbref dbLast = pObjects[st.nObjects - 1].dbObject;
+        if (  dbLast < 0
+           || INT_MAX - 1 < dbLast)
         {
-        case '-':   // Misc tag
-            ch = getc(f);
-            if (ch == 'R')
+            Log.WriteString(T(ENDLINE "Snapshot object table is damaged." ENDLINE));
+            return -1;
+        }
+        db_grow(dbLast + 1);
+    }
+
+    UTF8 *buff = alloc_mbuf("snapshot_load.s_Name");
+    dbref dbPrevious = NOTHING;
+    UINT32 iObject;
+    for (iObject = 0; iObject < st.nObjects; iObject++)
+    {
+        const SNAP_OBJECT *po = pObjects + iObject;
+        dbref i = po->dbObject;
+        if (  i <= dbPrevious
+           || mudstate.db_top <= i
+           || st.nAttrs < po->iAttr
+           || st.nAttrs - po->iAttr < po->nAttr)
+        {
+            free_mbuf(buff);
+            Log.tinyprintf(T(ENDLINE "Bad entry for object #%d in snapshot." ENDLINE), i);
+            return -1;
+        }
+        dbPrevious = i;
+
+        if (read_name)
+        {
+            const UTF8 *tstr = snapshot_string(pBlob, st.nBlob, po->iName, po->nName);
+            if (nullptr == tstr)
             {
-                // Record number of players
-                //
-                mudstate.record_players = getref(f);
-                if (mudconf.reset_players)
-                {
-                    mudstate.record_players = 0;
-                }
+                free_mbuf(buff);
+                Log.tinyprintf(T(ENDLINE "Bad name for object #%d in snapshot." ENDLINE), i);
+                return -1;
             }
-            break;
+            StripTabsAndTruncate(tstr, buff, MBUF_SIZE-1, MBUF_SIZE-1);
+            s_Name(i, buff);
+        }
 
-        case '+':
+        snapshot_set_object(i, po, read_money);
 
-            // MUX header
-            //
-            ch = getc(f);
-            if (ch == 'A')
+        if (read_attribs)
+        {
+            const SNAP_ATTR *pa = pAttrs + po->iAttr;
+            for (UINT32 j = 0; j < po->nAttr; j++, pa++)
             {
-                // USER-NAMED ATTRIBUTE
-                //
-                anum = getref(f);
-                tstr = (UTF8 *)getstring_noalloc(f, true, &nBuffer);
-                if (mux_isdigit(*tstr))
-                {
-                    aflags = 0;
-                    while (mux_isdigit(*tstr))
-                    {
-                        aflags = (aflags * 10) + (*tstr++ - '0');
-                    }
-                    tstr++; // skip ':'
-                }
-                else
-                {
-                    aflags = mudconf.vattr_flags;
-                }
-
-                // If v2 flatfile or earlier, convert tstr to UTF-8.
-                //
-                if (g_version <= 2)
+                const UTF8 *pValue = snapshot_string(pBlob, st.nBlob, pa->iValue, pa->nValue);
+                if (nullptr == pValue)
                 {
-                    size_t nUnused;
-                    tstr = ConvertToUTF8((char *)tstr, &nUnused);
+                    free_mbuf(buff);
+                    Log.tinyprintf(T(ENDLINE "Error reading attrs for object #%d" ENDLINE), i);
+                    return -1;
                 }
 
-                pName = MakeCanonicalAttributeName(tstr, &nName, &bValid);
-                if (bValid)
+                if (0 < pa->iAttr)
                 {
-                    // Maximum attribute number across all names.
-                    //
-                    if (g_max_nam_atr < anum)
+                    if (g_max_obj_atr < pa->iAttr)
                     {
-                        g_max_nam_atr = anum;
+                        g_max_obj_atr = pa->iAttr;
                     }
-
-                    vattr_define_LEN(pName, nName, anum, aflags);
+                    atr_add_raw_LEN(i, pa->iAttr, pValue, pa->nValue);
                 }
             }
-            else if (ch == 'X')
-            {
-                // MUX VERSION
-                //
-                if (header_gotten)
-                {
-                    Log.tinyprintf(T(ENDLINE "Duplicate MUX version header entry at object %d, ignored." ENDLINE), i);
-                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
-                }
-                else
-                {
-                    header_gotten = true;
-                    g_format = F_MUX;
-                    g_version = getref(f);
-                    g_flags = g_version & ~V_MASK;
-                    g_version &= V_MASK;
+        }
 
-                    if (  g_version < MIN_SUPPORTED_VERSION
-                       || MAX_SUPPORTED_VERSION < g_version)
-                    {
-                        Log.tinyprintf(T(ENDLINE "Unsupported flatfile version: %d." ENDLINE), g_version);
-                        return -1;
-                    }
+        if (isPlayer(i))
+        {
+            c_Connected(i);
+        }
+    }
+    free_mbuf(buff);
 
-                    // Due to potential UTF-8 characters in attribute names,
-                    // we do not support parsing A_LOCK from the header. After
-                    // converting from v2 to v4, this should never be needed
-                    // anyway.
-                    //
-                    mux_assert(  (  (  1 == g_version
-                                    || 2 == g_version)
-                                 && (g_flags & MANDFLAGS_V2) == MANDFLAGS_V2)
-                              || (  3 == g_version
-                                 && (g_flags & MANDFLAGS_V3) == MANDFLAGS_V3)
-                              || (  4 == g_version
-                                 && (g_flags & MANDFLAGS_V4) == MANDFLAGS_V4));
+    db_adjust_attr_next(true);
 
-                    // Otherwise extract feature flags
-                    //
-                    if (g_flags & V_DATABASE)
-                    {
-                        if (  1 == g_version
-                           || 2 == g_version)
-                        {
-                            // We'll convert the external database from
-                            // Latin-1 to UTF-8 at the end.
-                            //
-                            convert_values = true;
-                        }
-                        read_attribs = false;
-                        read_name = !(g_flags & V_ATRNAME);
-                    }
-                    read_key = !(g_flags & V_ATRKEY);
-                    read_money = !(g_flags & V_ATRMONEY);
-                }
+    *db_version = g_version;
+    *db_format = g_format;
+    *db_flags = g_flags;
+    if (mudstate.bStandAlone)
+    {
+        Log.WriteString(T(ENDLINE));
+        Log.Flush();
+    }
+    else
+    {
+        journal_replay();
+        load_player_names();
+    }
+    return mudstate.db_top;
+}
+
+/* ---------------------------------------------------------------------------
+ * db_read_snapshot: Load a binary snapshot.  The image is only needed while
+ * the in-memory database is built, so it is released before returning.
+ */
+
+static dbref db_read_snapshot(FILE *f, int *db_format, int *db_version, int *db_flags)
+{
+    size_t nFile;
+    bool bMapped;
+    const UTF8 *pFile = snapshot_map(f, &nFile, &bMapped);
+    dbref cc = snapshot_load(pFile, nFile, db_format, db_version, db_flags);
+    snapshot_unmap(pFile, nFile, bMapped);
+    return cc;
+}
+
+#if defined(UNIX_THREADS) && defined(UNIX_MMAP)
+// Parallel flatfile loader.
+//
+// Apart from the header and the attribute names, the object records in a
+// flatfile are independent.  Once the ordinary reader reaches the first
+// object, one pass over the mapped file finds where each record begins.
+// Worker threads then decode contiguous runs of records into tables that
+// were allocated beforehand, and the main thread commits the results to the
+// database in file order.  Workers neither allocate nor touch server state.
+//
+// Anything unexpected makes the loader give up before anything has been
+// committed, and the ordinary reader carries on from the same place.
+//
+#define FLAT_MAX_WORKERS    16
+#define FLAT_MIN_PARALLEL   (256*1024)
+
+typedef struct
+{
+    const UTF8 *pValue;
+    size_t      nValue;
+    int         iAttr;
+} FLAT_ATTR;
+
+typedef struct
+{
+    const UTF8 *pStart;     // The '!' which begins the record.
+    const UTF8 *pName;
+    size_t      nName;
+    size_t      iAttr;      // First entry in the attribute table.
+    size_t      nAttr;
+    dbref       dbObject;
+    dbref       dbLocation;
+    dbref       dbZone;
+    dbref       dbContents;
+    dbref       dbExits;
+    dbref       dbLink;
+    dbref       dbNext;
+    dbref       dbOwner;
+    dbref       dbParent;
+    int         iPennies;
+    int         aFlags[3];
+    int         aPowers[2];
+} FLAT_RECORD;
+
+typedef struct
+{
+    const UTF8  *pBase;     // Start of the mapped file.
+    const UTF8  *pStop;     // The '*' which ends the objects.
+    UTF8        *pDecode;   // Same size as the mapped file.
+    FLAT_RECORD *aRecords;
+    size_t       nRecords;
+    FLAT_ATTR   *aAttrs;
+    size_t       nAttrs;
+    bool         bReadName;
+    bool         bReadMoney;
+    bool         bReadAttribs;
+} FLAT_LOAD;
+
+typedef struct
+{
+    FLAT_LOAD *pfl;
+    size_t     iFirst;
+    size_t     iLast;
+    bool       bOk;
+    bool       bStarted;
+    pthread_t  thread;
+} FLAT_WORKER;
+
+/* ---------------------------------------------------------------------------
+ * flat_ref: Decode one line as a number, as getref() does.
+ */
+
+static bool flat_ref(const UTF8 **pp, const UTF8 *pEnd, int *piValue)
+{
+    const UTF8 *p = *pp;
+    const UTF8 *pEol = (const UTF8 *)memchr(p, '\n', pEnd - p);
+    if (nullptr == pEol)
+    {
+        return false;
+    }
+    *piValue = mux_atol(p);
+    *pp = pEol + 1;
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * flat_string: Decode one quoted string, as getstring_noalloc() does.  The
+ * output never outgrows the input, so each string is decoded into the spot
+ * in pDecode which corresponds to its position in the file.
+ */
+
+static bool flat_string(const FLAT_LOAD *pfl, const UTF8 **pp, const UTF8 **ppOut, size_t *pnOut)
+{
+    const UTF8 *p = *pp;
+    if ('"' != *p)
+    {
+        return false;
+    }
+    UTF8 *pOut = pfl->pDecode + (p - pfl->pBase);
+    UTF8 *q = pOut;
+    UTF8 *qMax = pOut + 2*LBUF_SIZE;
+    p++;
+
+    for (;;)
+    {
+        if (pfl->pStop <= p)
+        {
+            return false;
+        }
+
+        UTF8 ch = *p++;
+        if ('"' == ch)
+        {
+            break;
+        }
+        else if ('\\' == ch)
+        {
+            if (pfl->pStop <= p)
+            {
+                return false;
             }
-            else if (ch == 'S')
+
+            ch = *p++;
+            switch (ch)
             {
-                // SIZE
-                //
-                if (size_gotten)
-                {
-                    Log.tinyprintf(T(ENDLINE "Duplicate size entry at object %d, ignored." ENDLINE), i);
-                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
-                }
-                else
-                {
-                    mudstate.min_size = getref(f);
-                    size_gotten = true;
-                }
+            case 'e':
+            case 'E':
+                ch = ESC_CHAR;
+                break;
+
+            case 'n':
+            case 'N':
+                ch = '\n';
+                break;
+
+            case 'r':
+            case 'R':
+                ch = '\r';
+                break;
+
+            case 't':
+            case 'T':
+                ch = '\t';
+                break;
             }
-            else if (ch == 'N')
+        }
+        else if ('\0' == ch)
+        {
+            return false;
+        }
+
+        if (q < qMax)
+        {
+            *q++ = ch;
+        }
+    }
+    *q = '\0';
+
+    // The rest of the line is ignored.
+    //
+    const UTF8 *pEol = (const UTF8 *)memchr(p, '\n', pfl->pStop - p);
+    if (nullptr == pEol)
+    {
+        return false;
+    }
+    *pp = pEol + 1;
+    *ppOut = pOut;
+    *pnOut = q - pOut;
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * flat_record: Decode one object record.  It must end exactly where the
+ * next one begins.
+ */
+
+static bool flat_record(const FLAT_LOAD *pfl, FLAT_RECORD *pr, const UTF8 *pNext)
+{
+    const UTF8 *p = pr->pStart + 1;
+    if (!flat_ref(&p, pNext, &pr->dbObject))
+    {
+        return false;
+    }
+
+    if (  pr->dbObject < 0
+       || INT_MAX - 1 < pr->dbObject)
+    {
+        return false;
+    }
+
+    if (  pfl->bReadName
+       && !flat_string(pfl, &p, &pr->pName, &pr->nName))
+    {
+        return false;
+    }
+
+    if (  !flat_ref(&p, pNext, &pr->dbLocation)
+       || !flat_ref(&p, pNext, &pr->dbZone)
+       || !flat_ref(&p, pNext, &pr->dbContents)
+       || !flat_ref(&p, pNext, &pr->dbExits)
+       || !flat_ref(&p, pNext, &pr->dbLink)
+       || !flat_ref(&p, pNext, &pr->dbNext)
+       || !flat_ref(&p, pNext, &pr->dbOwner)
+       || !flat_ref(&p, pNext, &pr->dbParent)
+       || (  pfl->bReadMoney
+          && !flat_ref(&p, pNext, &pr->iPennies))
+       || !flat_ref(&p, pNext, &pr->aFlags[0])
+       || !flat_ref(&p, pNext, &pr->aFlags[1])
+       || !flat_ref(&p, pNext, &pr->aFlags[2])
+       || !flat_ref(&p, pNext, &pr->aPowers[0])
+       || !flat_ref(&p, pNext, &pr->aPowers[1]))
+    {
+        return false;
+    }
+
+    if (pfl->bReadAttribs)
+    {
+        FLAT_ATTR *pa = pfl->aAttrs + pr->iAttr;
+        size_t nAttr = 0;
+        for (;;)
+        {
+            if (pNext <= p)
             {
-                // NEXT ATTR TO ALLOC WHEN NO FREELIST
-                //
-                if (nextattr_gotten)
+                return false;
+            }
+
+            if ('>' == *p)
+            {
+                if (pr->nAttr <= nAttr)
                 {
-                    Log.tinyprintf(T(ENDLINE "Duplicate next free vattr entry at object %d, ignored." ENDLINE), i);
-                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+                    return false;
                 }
-                else
+
+                p++;
+                if (  !flat_ref(&p, pNext, &pa->iAttr)
+                   || pNext <= p
+                   || !flat_string(pfl, &p, &pa->pValue, &pa->nValue))
                 {
-                    mudstate.attr_next = getref(f);
-                    nextattr_gotten = true;
+                    return false;
                 }
+                pa++;
+                nAttr++;
             }
-            else
+            else if ('\n' == *p)
             {
-                Log.tinyprintf(T(ENDLINE "Unexpected character \xE2\x80\x98%c\xE2\x80\x99 in MUX header near object #%d, ignored." ENDLINE), ch, i);
-                tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+                p++;
             }
-            break;
-
-        case '!':   // MUX entry
-            i = getref(f);
-            db_grow(i + 1);
-
-            if (read_name)
+            else if ('<' == *p)
             {
-                tstr = (UTF8 *)getstring_noalloc(f, true, &nBuffer);
-                if (g_version <= 2)
+                p++;
+                if (  p < pNext
+                   && '\n' == *p)
                 {
-                    size_t nUsed;
-                    tstr = ConvertToUTF8((char *)tstr, &nUsed);
+                    p++;
                 }
-                buff = alloc_mbuf("dbread.s_Name");
-                StripTabsAndTruncate(tstr, buff, MBUF_SIZE-1, MBUF_SIZE-1);
-                s_Name(i, buff);
-                free_mbuf(buff);
-
-                s_Location(i, getref(f));
+                break;
             }
             else
             {
-                s_Location(i, getref(f));
-            }
-
-            // ZONE
-            //
-            int zone;
-            zone = getref(f);
-            if (zone < NOTHING)
-            {
-                zone = NOTHING;
+                return false;
             }
-            s_Zone(i, zone);
+        }
 
-            // CONTENTS and EXITS
-            //
-            s_Contents(i, getref(f));
-            s_Exits(i, getref(f));
+        if (nAttr != pr->nAttr)
+        {
+            return false;
+        }
+    }
+    return (p == pNext);
+}
 
-            // LINK
-            //
-            s_Link(i, getref(f));
+static void *flat_worker(void *pArg)
+{
+    FLAT_WORKER *pw = static_cast<FLAT_WORKER *>(pArg);
+    const FLAT_LOAD *pfl = pw->pfl;
+    pw->bOk = true;
+    for (size_t i = pw->iFirst; i < pw->iLast && pw->bOk; i++)
+    {
+        const UTF8 *pNext = (i + 1 < pfl->nRecords) ? pfl->aRecords[i + 1].pStart : pfl->pStop;
+        pw->bOk = flat_record(pfl, pfl->aRecords + i, pNext);
+    }
+    return nullptr;
+}
 
-            // NEXT
-            //
-            s_Next(i, getref(f));
+/* ---------------------------------------------------------------------------
+ * flat_index: Find the start of each object record and count attributes.
+ * Quoted strings are skipped so that their contents are never mistaken for
+ * the start of a line.
+ */
 
-            // LOCK
-            //
-            if (read_key)
+static bool flat_index(FLAT_LOAD *pfl, const UTF8 *pStart, const UTF8 *pEnd)
+{
+    size_t nAlloc = 1024;
+    pfl->aRecords = (FLAT_RECORD *)MEMALLOC(nAlloc * sizeof(FLAT_RECORD));
+    ISOUTOFMEMORY(pfl->aRecords);
+    pfl->nRecords = 0;
+    pfl->nAttrs = 0;
+
+    const UTF8 *p = pStart;
+    while (p < pEnd)
+    {
+        switch (*p)
+        {
+        case '!':
+            if (pfl->nRecords == nAlloc)
             {
-                // Parse lock directly from flatfile.
-                // Only used when reading v2 format.
-                //
-                tempbool = getboolexp(f);
-                atr_add_raw(i, A_LOCK, unparse_boolexp_quiet(1, tempbool));
-                free_boolexp(tempbool);
+                FLAT_RECORD *aNew = (FLAT_RECORD *)MEMALLOC(2 * nAlloc * sizeof(FLAT_RECORD));
+                ISOUTOFMEMORY(aNew);
+                memcpy(aNew, pfl->aRecords, nAlloc * sizeof(FLAT_RECORD));
+                MEMFREE(pfl->aRecords);
+                pfl->aRecords = aNew;
+                nAlloc *= 2;
             }
+            memset(pfl->aRecords + pfl->nRecords, 0, sizeof(FLAT_RECORD));
+            pfl->aRecords[pfl->nRecords].pStart = p;
+            pfl->aRecords[pfl->nRecords].iAttr = pfl->nAttrs;
+            pfl->nRecords++;
+            break;
 
-            // OWNER
-            //
-            s_Owner(i, getref(f));
+        case '>':
+            if (0 == pfl->nRecords)
+            {
+                return false;
+            }
+            pfl->aRecords[pfl->nRecords - 1].nAttr++;
+            pfl->nAttrs++;
+            break;
 
-            // PARENT
-            //
-            s_Parent(i, getref(f));
+        case '"':
+            for (p++; p < pEnd && '"' != *p; p++)
+            {
+                if ('\\' == *p)
+                {
+                    p++;
+                }
+            }
 
-            // PENNIES
-            //
-            if (read_money)
+            if (pEnd <= p)
             {
-                s_PenniesDirect(i, getref(f));
+                return false;
             }
+            break;
 
-            // FLAGS
-            //
-            s_Flags(i, FLAG_WORD1, getref(f));
-            s_Flags(i, FLAG_WORD2, getref(f));
-            s_Flags(i, FLAG_WORD3, getref(f));
+        case '*':
+            pfl->pStop = p;
+            return true;
+        }
 
-            // POWERS
-            //
-            s_Powers(i, getref(f));
-            s_Powers2(i, getref(f));
+        const UTF8 *pEol = (const UTF8 *)memchr(p, '\n', pEnd - p);
+        if (nullptr == pEol)
+        {
+            return false;
+        }
+        p = pEol + 1;
+    }
+    return false;
+}
 
-            // ATTRIBUTES
-            //
-            if (read_attribs)
+static int flat_worker_count(void)
+{
+    int nWorkers = mudconf.load_threads;
+    if (nWorkers <= 0)
+    {
+        nWorkers = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+        long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (0 < nCPUs)
+        {
+            nWorkers = static_cast<int>(nCPUs);
+        }
+#endif // _SC_NPROCESSORS_ONLN
+    }
+
+    if (FLAT_MAX_WORKERS < nWorkers)
+    {
+        nWorkers = FLAT_MAX_WORKERS;
+    }
+    return nWorkers;
+}
+
+/* ---------------------------------------------------------------------------
+ * db_read_parallel: Load every object record, starting with the one whose
+ * leading '!' has just been read from f.  On success, f is left at the end
+ * marker, and *piLast is the last object read.  Otherwise, nothing has been
+ * changed, not even the position of f.
+ */
+
+static bool db_read_parallel(FILE *f, bool read_name, bool read_money, bool read_attribs, dbref *piLast)
+{
+    int nWorkers = flat_worker_count();
+    if (nWorkers <= 1)
+    {
+        return false;
+    }
+
+    long iRecord = ftell(f) - 1;
+    size_t nFile;
+    const UTF8 *pFile = db_map(f, &nFile);
+    if (nullptr == pFile)
+    {
+        return false;
+    }
+
+    if (  iRecord < 0
+       || nFile <= static_cast<size_t>(iRecord)
+       || '!' != pFile[iRecord]
+       || nFile - iRecord < FLAT_MIN_PARALLEL)
+    {
+        munmap(const_cast<UTF8 *>(pFile), nFile);
+        return false;
+    }
+
+    FLAT_LOAD fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.pBase = pFile;
+    fl.bReadName = read_name;
+    fl.bReadMoney = read_money;
+    fl.bReadAttribs = read_attribs;
+
+    bool bOk = flat_index(&fl, pFile + iRecord, pFile + nFile);
+    if (bOk)
+    {
+        fl.pDecode = (UTF8 *)MEMALLOC(nFile);
+        ISOUTOFMEMORY(fl.pDecode);
+        if (0 < fl.nAttrs)
+        {
+            fl.aAttrs = (FLAT_ATTR *)MEMALLOC(fl.nAttrs * sizeof(FLAT_ATTR));
+            ISOUTOFMEMORY(fl.aAttrs);
+        }
+
+        // Give each worker about the same number of bytes.
+        //
+        // Workers should never see the game's signals, so they start with
+        // all of them blocked.
+        //
+        sigset_t sigAll, sigSave;
+        sigfillset(&sigAll);
+        pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+
+        FLAT_WORKER aWorkers[FLAT_MAX_WORKERS];
+        size_t nPerWorker = (fl.pStop - (pFile + iRecord)) / nWorkers + 1;
+        size_t iNext = 0;
+        int iWorker;
+        for (iWorker = 0; iWorker < nWorkers; iWorker++)
+        {
+            FLAT_WORKER *pw = aWorkers + iWorker;
+            pw->pfl = &fl;
+            pw->iFirst = iNext;
+            if (iWorker == nWorkers - 1)
             {
-                if (!get_list(f, i))
+                iNext = fl.nRecords;
+            }
+            else
+            {
+                const UTF8 *pLimit = pFile + iRecord + (iWorker + 1) * nPerWorker;
+                while (  iNext < fl.nRecords
+                      && fl.aRecords[iNext].pStart < pLimit)
                 {
-                    Log.tinyprintf(T(ENDLINE "Error reading attrs for object #%d" ENDLINE), i);
-                    return -1;
+                    iNext++;
                 }
             }
+            pw->iLast = iNext;
+            pw->bStarted = (0 == pthread_create(&pw->thread, nullptr, flat_worker, pw));
+        }
+        pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
 
-            // check to see if it's a player
-            //
-            if (isPlayer(i))
+        // If a worker couldn't be started, do its share here.
+        //
+        for (iWorker = 0; iWorker < nWorkers; iWorker++)
+        {
+            FLAT_WORKER *pw = aWorkers + iWorker;
+            if (pw->bStarted)
             {
-                c_Connected(i);
+                pthread_join(pw->thread, nullptr);
             }
-            break;
-
-        case '*':   // EOF marker
-            tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
-            if (strncmp((char *)tstr, "**END OF DUMP***", 16))
+            else
             {
-                Log.tinyprintf(T(ENDLINE "Bad EOF marker at object #%d" ENDLINE), i);
-                return -1;
+                (void)flat_worker(pw);
             }
-            else
+            bOk = bOk && pw->bOk;
+        }
+    }
+
+    if (bOk)
+    {
+        int iDotCounter = 0;
+        UTF8 *buff = alloc_mbuf("db_read_parallel.s_Name");
+        for (size_t iRec = 0; iRec < fl.nRecords; iRec++)
+        {
+            if (mudstate.bStandAlone)
             {
-                // Attribute number warnings.
-                //
-                if (g_max_nam_atr < g_max_obj_atr)
+                if (!iDotCounter)
                 {
-                    Log.tinyprintf(T(ENDLINE "Warning: One or more attribute values are unnamed. Did you use ./Backup on a running game?"));
+                    iDotCounter = 100;
+                    fputc('.', stderr);
+                    fflush(stderr);
                 }
+                iDotCounter--;
+            }
 
-                if (!nextattr_gotten)
-                {
-                    Log.tinyprintf(T(ENDLINE "Warning: Missing +N<next free>. Adjusting."));
-                }
+            const FLAT_RECORD *pr = fl.aRecords + iRec;
+            dbref i = pr->dbObject;
+            db_grow(i + 1);
 
-                if (mudstate.attr_next <= g_max_nam_atr)
-                {
-                    if (nextattr_gotten)
-                    {
-                        Log.tinyprintf(T(ENDLINE "Warning: +N<next free attr> conflicts with existing attribute names. Adjusting."));
-                    }
-                    mudstate.attr_next = g_max_nam_atr + 1;
-                }
+            if (read_name)
+            {
+                StripTabsAndTruncate(pr->pName, buff, MBUF_SIZE-1, MBUF_SIZE-1);
+                s_Name(i, buff);
+            }
+            s_Location(i, pr->dbLocation);
+            s_Zone(i, pr->dbZone < NOTHING ? NOTHING : pr->dbZone);
+            s_Contents(i, pr->dbContents);
+            s_Exits(i, pr->dbExits);
+            s_Link(i, pr->dbLink);
+            s_Next(i, pr->dbNext);
+            s_Owner(i, pr->dbOwner);
+            s_Parent(i, pr->dbParent);
+            if (read_money)
+            {
+                s_PenniesDirect(i, pr->iPennies);
+            }
+            s_Flags(i, FLAG_WORD1, pr->aFlags[0]);
+            s_Flags(i, FLAG_WORD2, pr->aFlags[1]);
+            s_Flags(i, FLAG_WORD3, pr->aFlags[2]);
+            s_Powers(i, pr->aPowers[0]);
+            s_Powers2(i, pr->aPowers[1]);
 
-                if (mudstate.attr_next <= g_max_obj_atr)
+            if (read_attribs)
+            {
+                const FLAT_ATTR *pa = fl.aAttrs + pr->iAttr;
+                for (size_t j = 0; j < pr->nAttr; j++, pa++)
                 {
-                    if (nextattr_gotten)
+                    if (0 < pa->iAttr)
                     {
-                        Log.tinyprintf(T(ENDLINE "Warning: +N<next free attr> conflicts object attribute numbers. Adjusting."));
+                        if (g_max_obj_atr < pa->iAttr)
+                        {
+                            g_max_obj_atr = pa->iAttr;
+                        }
+                        atr_add_raw_LEN(i, pa->iAttr, pa->pValue, pa->nValue);
                     }
-                    mudstate.attr_next = g_max_nam_atr + 1;
                 }
+            }
 
-                int max_atr = A_USER_START;
-                if (max_atr < g_max_nam_atr)
-                {
-                    max_atr = g_max_nam_atr;
-                }
+            if (isPlayer(i))
+            {
+                c_Connected(i);
+            }
+            *piLast = i;
+        }
+        free_mbuf(buff);
+        fseek(f, static_cast<long>(fl.pStop - pFile), SEEK_SET);
+
+        if (!mudstate.bStandAlone)
+        {
+            STARTLOG(LOG_STARTUP, "INI", "LOAD");
+            Log.tinyprintf(T("Decoded %d objects with %d threads."), static_cast<int>(fl.nRecords), nWorkers);
+            ENDLOG;
+        }
+    }
+
+    if (nullptr != fl.pDecode)
+    {
+        MEMFREE(fl.pDecode);
+        fl.pDecode = nullptr;
+    }
+    if (nullptr != fl.aAttrs)
+    {
+        MEMFREE(fl.aAttrs);
+        fl.aAttrs = nullptr;
+    }
+    if (nullptr != fl.aRecords)
+    {
+        MEMFREE(fl.aRecords);
+        fl.aRecords = nullptr;
+    }
+    munmap(const_cast<UTF8 *>(pFile), nFile);
+    return bOk;
+}
+#endif // UNIX_THREADS && UNIX_MMAP
+
+dbref db_read(FILE *f, int *db_format, int *db_version, int *db_flags)
+{
+    dbref i, anum;
+    int ch;
+    const UTF8 *tstr;
+    int aflags;
+    BOOLEXP *tempbool;
+    UTF8 *buff;
+    size_t nBuffer;
+
+    g_format = F_UNKNOWN;
+    g_version = 0;
+    g_flags = 0;
+    g_generation = 0;
+    g_max_nam_atr = INT_MIN;
+    g_max_obj_atr = INT_MIN;
+
+    // A snapshot is recognized by its first byte, which cannot begin a
+    // flatfile.
+    //
+    int chFirst = getc(f);
+    ungetc(chFirst, f);
+    if (static_cast<unsigned char>(SNAPSHOT_MAGIC[0]) == chFirst)
+    {
+        return db_read_snapshot(f, db_format, db_version, db_flags);
+    }
+
+    bool header_gotten = false;
+    bool size_gotten = false;
+    bool nextattr_gotten = false;
+
+    bool convert_values = false;
+    bool read_attribs = true;
+    bool read_name = true;
+    bool read_key = true;
+    bool read_money = true;
+#if defined(UNIX_THREADS) && defined(UNIX_MMAP)
+    bool tried_parallel = false;
+#endif // UNIX_THREADS && UNIX_MMAP
+
+    size_t nName;
+    bool bValid;
+    UTF8 *pName;
+
+    int iDotCounter = 0;
+    if (mudstate.bStandAlone)
+    {
+        Log.WriteString(T("Reading "));
+        Log.Flush();
+    }
+
+    db_free();
+    for (i = 0;; i++)
+    {
+        if (mudstate.bStandAlone)
+        {
+            if (!iDotCounter)
+            {
+                iDotCounter = 100;
+                fputc('.', stderr);
+                fflush(stderr);
+            }
+            iDotCounter--;
+        }
 
-                if (max_atr < g_max_obj_atr)
+        ch = getc(f);
+        switch (ch)
+        {
+        case '-':   // Misc tag
+            ch = getc(f);
+            if (ch == 'R')
+            {
+                // Record number of players
+                //
+                mudstate.record_players = getref(f);
+                if (mudconf.reset_players)
                 {
-                    max_atr = g_max_obj_atr;
+                    mudstate.record_players = 0;
                 }
+            }
+            break;
 
-                if (max_atr + 1 < mudstate.attr_next)
+        case '+':
+
+            // MUX header
+            //
+            ch = getc(f);
+            if (ch == 'A')
+            {
+                // USER-NAMED ATTRIBUTE
+                //
+                anum = getref(f);
+                tstr = (UTF8 *)getstring_noalloc(f, true, &nBuffer);
+                if (mux_isdigit(*tstr))
                 {
-                    if (nextattr_gotten)
+                    aflags = 0;
+                    while (mux_isdigit(*tstr))
                     {
-                        Log.tinyprintf(T(ENDLINE "Info: +N<next free attr> can be safely adjusted down."));
+                        aflags = (aflags * 10) + (*tstr++ - '0');
                     }
-                    mudstate.attr_next = max_atr + 1;
+                    tstr++; // skip ':'
+                }
+                else
+                {
+                    aflags = mudconf.vattr_flags;
                 }
 
-                if (convert_values)
+                // If v2 flatfile or earlier, convert tstr to UTF-8.
+                //
+                if (g_version <= 2)
                 {
-                    Log.WriteString(T("Converting external database to UTF-8 " ENDLINE));
-                    Log.Flush();
+                    size_t nUnused;
+                    tstr = ConvertToUTF8((char *)tstr, &nUnused);
+                }
 
-                    // Convert every attribute on every object in the external database.
+                pName = MakeCanonicalAttributeName(tstr, &nName, &bValid);
+                if (bValid)
+                {
+                    // Maximum attribute number across all names.
                     //
-                    dbref iObject;
-                    atr_push();
-                    DO_WHOLE_DB(iObject)
+                    if (g_max_nam_atr < anum)
                     {
-                        unsigned char *as;
-                        for (int iAttr = atr_head(iObject, &as); iAttr; iAttr = atr_next(&as))
-                        {
-                            if (  0 < iAttr
-                               && iAttr <= anum_alc_top)
-                            {
-                                const char *pLatin1 = (char *)atr_get_raw(iObject, iAttr);
-                                if (nullptr != pLatin1)
-                                {
-                                    size_t nUnicode;
-                                    const UTF8 *pUnicode = ConvertToUTF8(pLatin1, &nUnicode);
-                                    atr_add_raw_LEN(iObject, iAttr, pUnicode, nUnicode);
-                                }
-                            }
-                        }
+                        g_max_nam_atr = anum;
                     }
-                    atr_pop();
-                }
 
-                *db_version = g_version;
-                *db_format = g_format;
-                *db_flags = g_flags;
-                if (mudstate.bStandAlone)
+                    vattr_define_LEN(pName, nName, anum, aflags);
+                }
+            }
+            else if (ch == 'X')
+            {
+                // MUX VERSION
+                //
+                if (header_gotten)
                 {
-                    Log.WriteString(T(ENDLINE));
-                    Log.Flush();
+                    Log.tinyprintf(T(ENDLINE "Duplicate MUX version header entry at object %d, ignored." ENDLINE), i);
+                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
                 }
                 else
                 {
-                    load_player_names();
-                }
-                return mudstate.db_top;
+                    header_gotten = true;
+                    g_format = F_MUX;
+                    g_version = getref(f);
+                    g_flags = g_version & ~V_MASK;
+                    g_version &= V_MASK;
+
+                    if (  g_version < MIN_SUPPORTED_VERSION
+                       || MAX_SUPPORTED_VERSION < g_version)
+                    {
+                        Log.tinyprintf(T(ENDLINE "Unsupported flatfile version: %d." ENDLINE), g_version);
+                        return -1;
+                    }
+
+                    // Due to potential UTF-8 characters in attribute names,
+                    // we do not support parsing A_LOCK from the header. After
+                    // converting from v2 to v4, this should never be needed
+                    // anyway.
+                    //
+                    mux_assert(  (  (  1 == g_version
+                                    || 2 == g_version)
+                                 && (g_flags & MANDFLAGS_V2) == MANDFLAGS_V2)
+                              || (  3 == g_version
+                                 && (g_flags & MANDFLAGS_V3) == MANDFLAGS_V3)
+                              || (  4 == g_version
+                                 && (g_flags & MANDFLAGS_V4) == MANDFLAGS_V4));
+
+                    // Otherwise extract feature flags
+                    //
+                    if (g_flags & V_DATABASE)
+                    {
+                        if (  1 == g_version
+                           || 2 == g_version)
+                        {
+                            // We'll convert the external database from
+                            // Latin-1 to UTF-8 at the end.
+                            //
+                            convert_values = true;
+                        }
+                        read_attribs = false;
+                        read_name = !(g_flags & V_ATRNAME);
+                    }
+                    read_key = !(g_flags & V_ATRKEY);
+                    read_money = !(g_flags & V_ATRMONEY);
+                }
+            }
+            else if (ch == 'S')
+            {
+                // SIZE
+                //
+                if (size_gotten)
+                {
+                    Log.tinyprintf(T(ENDLINE "Duplicate size entry at object %d, ignored." ENDLINE), i);
+                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+                }
+                else
+                {
+                    mudstate.min_size = getref(f);
+                    size_gotten = true;
+                }
+            }
+            else if (ch == 'J')
+            {
+                // GENERATION OF THE CHECKPOINT JOURNAL WHICH FOLLOWS
+                //
+                g_generation = getref(f);
+            }
+            else if (ch == 'N')
+            {
+                // NEXT ATTR TO ALLOC WHEN NO FREELIST
+                //
+                if (nextattr_gotten)
+                {
+                    Log.tinyprintf(T(ENDLINE "Duplicate next free vattr entry at object %d, ignored." ENDLINE), i);
+                    tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+                }
+                else
+                {
+                    mudstate.attr_next = getref(f);
+                    nextattr_gotten = true;
+                }
+            }
+            else
+            {
+                Log.tinyprintf(T(ENDLINE "Unexpected character \xE2\x80\x98%c\xE2\x80\x99 in MUX header near object #%d, ignored." ENDLINE), ch, i);
+                tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+            }
+            break;
+
+        case '!':   // MUX entry
+#if defined(UNIX_THREADS) && defined(UNIX_MMAP)
+            if (  !tried_parallel
+               && 3 <= g_version
+               && !read_key)
+            {
+                tried_parallel = true;
+                if (db_read_parallel(f, read_name, read_money, read_attribs, &i))
+                {
+                    break;
+                }
+            }
+#endif // UNIX_THREADS && UNIX_MMAP
+            i = getref(f);
+            db_grow(i + 1);
+
+            if (read_name)
+            {
+                tstr = (UTF8 *)getstring_noalloc(f, true, &nBuffer);
+                if (g_version <= 2)
+                {
+                    size_t nUsed;
+                    tstr = ConvertToUTF8((char *)tstr, &nUsed);
+                }
+                buff = alloc_mbuf("dbread.s_Name");
+                StripTabsAndTruncate(tstr, buff, MBUF_SIZE-1, MBUF_SIZE-1);
+                s_Name(i, buff);
+                free_mbuf(buff);
+
+                s_Location(i, getref(f));
+            }
+            else
+            {
+                s_Location(i, getref(f));
+            }
+
+            // ZONE
+            //
+            int zone;
+            zone = getref(f);
+            if (zone < NOTHING)
+            {
+                zone = NOTHING;
+            }
+            s_Zone(i, zone);
+
+            // CONTENTS and EXITS
+            //
+            s_Contents(i, getref(f));
+            s_Exits(i, getref(f));
+
+            // LINK
+            //
+            s_Link(i, getref(f));
+
+            // NEXT
+            //
+            s_Next(i, getref(f));
+
+            // LOCK
+            //
+            if (read_key)
+            {
+                // Parse lock directly from flatfile.
+                // Only used when reading v2 format.
+                //
+                tempbool = getboolexp(f);
+                atr_add_raw(i, A_LOCK, unparse_boolexp_quiet(1, tempbool));
+                free_boolexp(tempbool);
+            }
+
+            // OWNER
+            //
+            s_Owner(i, getref(f));
+
+            // PARENT
+            //
+            s_Parent(i, getref(f));
+
+            // PENNIES
+            //
+            if (read_money)
+            {
+                s_PenniesDirect(i, getref(f));
+            }
+
+            // FLAGS
+            //
+            s_Flags(i, FLAG_WORD1, getref(f));
+            s_Flags(i, FLAG_WORD2, getref(f));
+            s_Flags(i, FLAG_WORD3, getref(f));
+
+            // POWERS
+            //
+            s_Powers(i, getref(f));
+            s_Powers2(i, getref(f));
+
+            // ATTRIBUTES
+            //
+            if (read_attribs)
+            {
+                if (!get_list(f, i))
+                {
+                    Log.tinyprintf(T(ENDLINE "Error reading attrs for object #%d" ENDLINE), i);
+                    return -1;
+                }
+            }
+
+            // check to see if it's a player
+            //
+            if (isPlayer(i))
+            {
+                c_Connected(i);
+            }
+            break;
+
+        case '*':   // EOF marker
+            tstr = (UTF8 *)getstring_noalloc(f, false, &nBuffer);
+            if (strncmp((char *)tstr, "**END OF DUMP***", 16))
+            {
+                Log.tinyprintf(T(ENDLINE "Bad EOF marker at object #%d" ENDLINE), i);
+                return -1;
+            }
+            else
+            {
+                db_adjust_attr_next(nextattr_gotten);
+
+                if (convert_values)
+                {
+                    Log.WriteString(T("Converting external database to UTF-8 " ENDLINE));
+                    Log.Flush();
+
+                    // Convert every attribute on every object in the external database.
+                    //
+                    dbref iObject;
+                    atr_push();
+                    DO_WHOLE_DB(iObject)
+                    {
+                        unsigned char *as;
+                        for (int iAttr = atr_head(iObject, &as); iAttr; iAttr = atr_next(&as))
+                        {
+                            if (  0 < iAttr
+                               && iAttr <= anum_alc_top)
+                            {
+                                const char *pLatin1 = (char *)atr_get_raw(iObject, iAttr);
+                                if (nullptr != pLatin1)
+                                {
+                                    size_t nUnicode;
+                                    const UTF8 *pUnicode = ConvertToUTF8(pLatin1, &nUnicode);
+                                    atr_add_raw_LEN(iObject, iAttr, pUnicode, nUnicode);
+                                }
+                            }
+                        }
+                    }
+                    atr_pop();
+                }
+
+                *db_version = g_version;
+                *db_format = g_format;
+                *db_flags = g_flags;
+                if (mudstate.bStandAlone)
+                {
+                    Log.WriteString(T(ENDLINE));
+                    Log.Flush();
+                }
+                else
+                {
+                    journal_replay();
+                    load_player_names();
+                }
+                return mudstate.db_top;
+            }
+
+        case EOF:
+            Log.tinyprintf(T(ENDLINE "Unexpected end of file near object #%d" ENDLINE), i);
+            return -1;
+
+        default:
+            if (mux_isprint_ascii(ch))
+            {
+                Log.tinyprintf(T(ENDLINE "Illegal character \xE2\x80\x98%c\xE2\x80\x99 near object #%d" ENDLINE), ch, i);
+            }
+            else
+            {
+                Log.tinyprintf(T(ENDLINE "Illegal character 0x%02x near object #%d" ENDLINE), ch, i);
+            }
+            return -1;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * attr_to_write: Map an attribute from atr_head()/atr_next() to the number
+ * written to the database, or return false if it is not written.
+ */
+
+static bool attr_to_write(int ca, int flags, int *pj)
+{
+    int j;
+    if (mudstate.bStandAlone)
+    {
+        j = ca;
+    }
+    else
+    {
+        ATTR *a = atr_num(ca);
+        if (!a)
+        {
+            return false;
+        }
+        j = a->number;
+    }
+
+    if (j < A_USER_START)
+    {
+        switch (j)
+        {
+        case A_NAME:
+            if (!(flags & V_ATRNAME))
+            {
+                return false;
+            }
+            break;
+
+        case A_LIST:
+        case A_MONEY:
+            return false;
+        }
+    }
+    *pj = j;
+    return true;
+}
+
+static bool db_write_object(FILE *f, dbref i, int db_format, int flags)
+{
+    UNUSED_PARAMETER(db_format);
+
+    int ca, j;
+
+    if (!(flags & V_ATRNAME))
+    {
+        putstring(f, Name(i));
+    }
+    putref(f, Location(i));
+    putref(f, Zone(i));
+    putref(f, Contents(i));
+    putref(f, Exits(i));
+    putref(f, Link(i));
+    putref(f, Next(i));
+    putref(f, Owner(i));
+    putref(f, Parent(i));
+    if (!(flags & V_ATRMONEY))
+    {
+        putref(f, Pennies(i));
+    }
+    putref(f, Flags(i));
+    putref(f, Flags2(i));
+    putref(f, Flags3(i));
+    putref(f, Powers(i));
+    putref(f, Powers2(i));
+
+    // Write the attribute list.
+    //
+    if (!(flags & V_DATABASE))
+    {
+        UTF8 buf[SBUF_SIZE];
+        buf[0] = '>';
+        unsigned char *as;
+        for (ca = atr_head(i, &as); ca; ca = atr_next(&as))
+        {
+            if (!attr_to_write(ca, flags, &j))
+            {
+                continue;
+            }
+
+            // Format is: ">%d\n", j
+            //
+            const UTF8 *p = atr_get_raw(i, j);
+            size_t n = mux_ltoa(j, buf+1) + 1;
+            buf[n++] = '\n';
+            fwrite(buf, sizeof(UTF8), n, f);
+            putstring(f, p);
+        }
+        fwrite("<\n", sizeof(UTF8), 2, f);
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------------------
+ * db_write_begin, db_write_step, db_write_end: Write the database a few
+ * objects at a time.
+ *
+ * db_write() takes every step at once.  A journaled dump takes one step per
+ * pass through the main loop instead of forking, and the checkpoint journal
+ * covers the objects which change in the meantime.  The objects written are
+ * those which existed when the dump began.
+ *
+ * A snapshot's blob is written as the objects are visited while its tables
+ * are collected in memory and written at the end.  Nothing seeks, so the
+ * output may be a pipe.
+ */
+
+struct db_writer
+{
+    FILE  *f;
+    int    format;
+    int    flags;
+    dbref  iNext;
+    dbref  iTop;
+    int    iDotCounter;
+
+    // Only used for snapshots.
+    //
+    SNAP_TRAILER    st;
+    SNAP_GENERATION sg;
+    UINT64          iPos;
+    SNAP_ATTRNAME  *pAttrNames;
+    SNAP_OBJECT    *pObjects;
+    SNAP_ATTR      *pAttrs;
+    size_t          nObjectsAlloc;
+    size_t          nAttrsAlloc;
+};
+
+static void snapshot_put(FILE *f, const void *p, size_t n, UINT64 *piPos)
+{
+    fwrite(p, 1, n, f);
+    *piPos += n;
+}
+
+static const UTF8 *snapshot_value(dbref i, int j, size_t *pn)
+{
+    const UTF8 *p = atr_get_raw_LEN(i, j, pn);
+    if (nullptr == p)
+    {
+        *pn = 0;
+        return T("");
+    }
+    return p;
+}
+
+static void snapshot_begin(DB_WRITER *pdw, int generation)
+{
+    SNAP_TRAILER *pst = &pdw->st;
+    pst->nByteOrder = SNAPSHOT_BYTEORDER;
+    pst->nVersion = SNAPSHOT_VERSION;
+    pst->iFlags = pdw->flags;
+    pst->nDbTop = mudstate.db_top;
+    pst->nAttrNext = mudstate.attr_next;
+    pst->nRecordPlayers = mudstate.record_players;
+    memcpy(pst->szEnd, SNAPSHOT_END, SNAPSHOT_TAG_LEN);
+    pdw->sg.iGeneration = generation;
+
+    snapshot_put(pdw->f, SNAPSHOT_MAGIC, SNAPSHOT_TAG_LEN, &pdw->iPos);
+
+    int iAttr;
+    ATTR *vp;
+    for (iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+    {
+        vp = (ATTR *) anum_get(iAttr);
+        if (  vp != nullptr
+           && !(vp->flags & AF_DELETED))
+        {
+            pst->nAttrNames++;
+        }
+    }
+
+    if (0 < pst->nAttrNames)
+    {
+        pdw->pAttrNames = (SNAP_ATTRNAME *)MEMALLOC(pst->nAttrNames * sizeof(SNAP_ATTRNAME));
+        ISOUTOFMEMORY(pdw->pAttrNames);
+    }
+
+    UINT32 iName = 0;
+    for (iAttr = A_USER_START; iAttr <= anum_alc_top && iName < pst->nAttrNames; iAttr++)
+    {
+        vp = (ATTR *) anum_get(iAttr);
+        if (  vp != nullptr
+           && !(vp->flags & AF_DELETED))
+        {
+            SNAP_ATTRNAME *pan = pdw->pAttrNames + iName++;
+            memset(pan, 0, sizeof(*pan));
+            pan->iName = pdw->iPos - SNAPSHOT_TAG_LEN;
+            pan->nName = static_cast<UINT32>(strlen((char *)vp->name));
+            pan->iNumber = vp->number;
+            pan->iFlags = vp->flags;
+            snapshot_put(pdw->f, vp->name, pan->nName + 1, &pdw->iPos);
+        }
+    }
+}
+
+static void snapshot_object(DB_WRITER *pdw, dbref i)
+{
+    if (pdw->nObjectsAlloc <= pdw->st.nObjects)
+    {
+        pdw->nObjectsAlloc = (0 == pdw->nObjectsAlloc) ? 1024 : 2 * pdw->nObjectsAlloc;
+        pdw->pObjects = (SNAP_OBJECT *)MEMREALLOC(pdw->pObjects, pdw->nObjectsAlloc * sizeof(SNAP_OBJECT));
+        ISOUTOFMEMORY(pdw->pObjects);
+    }
+    SNAP_OBJECT *po = pdw->pObjects + pdw->st.nObjects++;
+    snapshot_get_object(i, pdw->flags, po);
+
+    if (!(pdw->flags & V_ATRNAME))
+    {
+        const UTF8 *pName = Name(i);
+        po->iName = pdw->iPos - SNAPSHOT_TAG_LEN;
+        po->nName = static_cast<UINT32>(strlen((char *)pName));
+        snapshot_put(pdw->f, pName, po->nName + 1, &pdw->iPos);
+    }
+
+    po->iAttr = pdw->st.nAttrs;
+    if (!(pdw->flags & V_DATABASE))
+    {
+        int ca, j;
+        unsigned char *as;
+        for (ca = atr_head(i, &as); ca; ca = atr_next(&as))
+        {
+            if (attr_to_write(ca, pdw->flags, &j))
+            {
+                if (pdw->nAttrsAlloc <= pdw->st.nAttrs)
+                {
+                    pdw->nAttrsAlloc = (0 == pdw->nAttrsAlloc) ? 4096 : 2 * pdw->nAttrsAlloc;
+                    pdw->pAttrs = (SNAP_ATTR *)MEMREALLOC(pdw->pAttrs, pdw->nAttrsAlloc * sizeof(SNAP_ATTR));
+                    ISOUTOFMEMORY(pdw->pAttrs);
+                }
+
+                size_t n;
+                const UTF8 *p = snapshot_value(i, j, &n);
+                SNAP_ATTR *pa = pdw->pAttrs + pdw->st.nAttrs++;
+                pa->iValue = pdw->iPos - SNAPSHOT_TAG_LEN;
+                pa->nValue = static_cast<UINT32>(n);
+                pa->iAttr = j;
+                snapshot_put(pdw->f, p, n + 1, &pdw->iPos);
+                po->nAttr++;
+            }
+        }
+    }
+}
+
+static void snapshot_end(DB_WRITER *pdw)
+{
+    SNAP_TRAILER *pst = &pdw->st;
+    pst->nBlob = pdw->iPos - SNAPSHOT_TAG_LEN;
+
+    static const UTF8 aZero[sizeof(UINT64)] = { 0 };
+    snapshot_put(pdw->f, aZero, (sizeof(UINT64) - pdw->iPos % sizeof(UINT64)) % sizeof(UINT64), &pdw->iPos);
+
+    pst->iAttrNames = pdw->iPos;
+    snapshot_put(pdw->f, pdw->pAttrNames, pst->nAttrNames * sizeof(SNAP_ATTRNAME), &pdw->iPos);
+    pst->iObjects = pdw->iPos;
+    snapshot_put(pdw->f, pdw->pObjects, pst->nObjects * sizeof(SNAP_OBJECT), &pdw->iPos);
+    pst->iAttrs = pdw->iPos;
+    snapshot_put(pdw->f, pdw->pAttrs, pst->nAttrs * sizeof(SNAP_ATTR), &pdw->iPos);
+    snapshot_put(pdw->f, &pdw->sg, sizeof(pdw->sg), &pdw->iPos);
+    snapshot_put(pdw->f, pst, sizeof(*pst), &pdw->iPos);
+}
+
+static void flatfile_begin(DB_WRITER *pdw, int generation)
+{
+    FILE *f = pdw->f;
+    mux_fprintf(f, T("+X%d\n+S%d\n+N%d\n"), pdw->flags, mudstate.db_top, mudstate.attr_next);
+    if (0 != generation)
+    {
+        mux_fprintf(f, T("+J%d\n"), generation);
+    }
+    mux_fprintf(f, T("-R%d\n"), mudstate.record_players);
+
+    // Dump user-named attribute info.
+    //
+    UTF8 Buffer[LBUF_SIZE];
+    Buffer[0] = '+';
+    Buffer[1] = 'A';
+    int iAttr;
+    for (iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+    {
+        ATTR *vp = (ATTR *) anum_get(iAttr);
+        if (  vp != nullptr
+           && !(vp->flags & AF_DELETED))
+        {
+            // Format is: "+A%d\n\"%d:%s\"\n", vp->number, vp->flags, vp->name
+            //
+            UTF8 *pBuffer = Buffer+2;
+            pBuffer += mux_ltoa(vp->number, pBuffer);
+            *pBuffer++ = '\n';
+            *pBuffer++ = '"';
+            pBuffer += mux_ltoa(vp->flags, pBuffer);
+            *pBuffer++ = ':';
+            size_t nNameLength = strlen((char *)vp->name);
+            memcpy(pBuffer, vp->name, nNameLength);
+            pBuffer += nNameLength;
+            *pBuffer++ = '"';
+            *pBuffer++ = '\n';
+            fwrite(Buffer, sizeof(UTF8), pBuffer-Buffer, f);
+        }
+    }
+}
+
+static void flatfile_object(DB_WRITER *pdw, dbref i)
+{
+    // Format is: "!%d\n", i
+    //
+    UTF8 buf[SBUF_SIZE];
+    buf[0] = '!';
+    size_t n = mux_ltoa(i, buf+1) + 1;
+    buf[n++] = '\n';
+    fwrite(buf, sizeof(UTF8), n, pdw->f);
+    db_write_object(pdw->f, i, pdw->format, pdw->flags);
+}
+
+/*! \brief Starts writing the database.
+ *
+ * \param f           Output file.
+ * \param format      F_MUX or F_MUX_SNAPSHOT.
+ * \param version     Version and flags to write.
+ * \param generation  Journal generation which follows this dump, or 0.
+ * \return            Writer to pass to db_write_step(), or nullptr if the
+ *                    format cannot be written.
+ */
+
+DB_WRITER *db_write_begin(FILE *f, int format, int version, int generation)
+{
+    if (  F_MUX != format
+       && F_MUX_SNAPSHOT != format)
+    {
+        Log.WriteString(T("Can only write MUX format." ENDLINE));
+        return nullptr;
+    }
+
+    DB_WRITER *pdw = (DB_WRITER *)MEMALLOC(sizeof(DB_WRITER));
+    ISOUTOFMEMORY(pdw);
+    memset(pdw, 0, sizeof(*pdw));
+    pdw->f = f;
+    pdw->format = format;
+    pdw->flags = version;
+    pdw->iNext = 0;
+    pdw->iTop = mudstate.db_top;
+
+    if (mudstate.bStandAlone)
+    {
+        Log.WriteString(F_MUX_SNAPSHOT == format ? T("Writing snapshot ") : T("Writing "));
+        Log.Flush();
+    }
+
+    if (F_MUX_SNAPSHOT == format)
+    {
+        snapshot_begin(pdw, generation);
+    }
+    else
+    {
+        flatfile_begin(pdw, generation);
+    }
+    return pdw;
+}
+
+/*! \brief Writes the next few objects.
+ *
+ * \param pdw       Writer from db_write_begin().
+ * \param nObjects  How many objects to visit.
+ * \return          true once every object has been written.
+ */
+
+bool db_write_step(DB_WRITER *pdw, int nObjects)
+{
+    dbref iLast = pdw->iTop;
+    if (nObjects < iLast - pdw->iNext)
+    {
+        iLast = pdw->iNext + nObjects;
+    }
+
+    // Objects which were destroyed and then truncated away since the dump
+    // began no longer exist.
+    //
+    if (mudstate.db_top < iLast)
+    {
+        iLast = mudstate.db_top;
+        pdw->iTop = iLast;
+    }
+
+    for ( ; pdw->iNext < iLast; pdw->iNext++)
+    {
+        dbref i = pdw->iNext;
+        if (mudstate.bStandAlone)
+        {
+            if (!pdw->iDotCounter)
+            {
+                pdw->iDotCounter = 100;
+                fputc('.', stderr);
+                fflush(stderr);
+            }
+            pdw->iDotCounter--;
+        }
+
+        if (!isGarbage(i))
+        {
+            if (F_MUX_SNAPSHOT == pdw->format)
+            {
+                snapshot_object(pdw, i);
+            }
+            else
+            {
+                flatfile_object(pdw, i);
+            }
+        }
+    }
+    return pdw->iTop <= pdw->iNext;
+}
+
+static void db_write_free(DB_WRITER *pdw)
+{
+    if (nullptr != pdw->pAttrNames)
+    {
+        MEMFREE(pdw->pAttrNames);
+        pdw->pAttrNames = nullptr;
+    }
+    if (nullptr != pdw->pObjects)
+    {
+        MEMFREE(pdw->pObjects);
+        pdw->pObjects = nullptr;
+    }
+    if (nullptr != pdw->pAttrs)
+    {
+        MEMFREE(pdw->pAttrs);
+        pdw->pAttrs = nullptr;
+    }
+    MEMFREE(pdw);
+}
+
+/*! \brief Writes whatever follows the objects and releases the writer.
+ *
+ * \param pdw  Writer from db_write_begin().  Every step must have been taken.
+ * \return     Size of the database written.
+ */
+
+dbref db_write_end(DB_WRITER *pdw)
+{
+    if (F_MUX_SNAPSHOT == pdw->format)
+    {
+        snapshot_end(pdw);
+    }
+    else
+    {
+        fputs("***END OF DUMP***\n", pdw->f);
+    }
+    db_write_free(pdw);
+
+    if (mudstate.bStandAlone)
+    {
+        Log.WriteString(T(ENDLINE));
+        Log.Flush();
+    }
+    return mudstate.db_top;
+}
+
+/*! \brief Releases a writer without finishing the dump.
+ *
+ * \param pdw  Writer from db_write_begin().
+ * \return     None.
+ */
+
+void db_write_abort(DB_WRITER *pdw)
+{
+    db_write_free(pdw);
+}
+
+dbref db_write(FILE *f, int format, int version, int generation)
+{
+    DB_WRITER *pdw = db_write_begin(f, format, version, generation);
+    if (nullptr == pdw)
+    {
+        return -1;
+    }
+    db_write_step(pdw, INT_MAX);
+    return db_write_end(pdw);
+}
+
+// Compressed database files.
+//
+// When compression_level is set, dumps are written through zlib in gzip
+// format, and the loader recognizes gzip input by its magic number.  The
+// reader and writer in this file work on stdio streams, so rather than teach
+// each of them about zlib, a helper thread sits on the far side of a pipe and
+// does the (de)compression while the main thread reads or writes the near
+// side.  db_fclose() must be used to close such a stream so that the helper is
+// joined and its status collected.  The helper never logs or allocates.
+//
+#if defined(UNIX_ZLIB) && defined(UNIX_THREADS)
+#define DB_ZLIB_BUFFER 65536
+
+typedef struct db_zstream
+{
+    FILE              *f;
+    gzFile             gz;
+    int                fdPipe;
+    bool               bWrite;
+    bool               bOK;
+    pthread_t          th;
+    struct db_zstream *pNext;
+} DB_ZSTREAM;
+
+static DB_ZSTREAM *pZStreams = nullptr;
+
+static void *db_zwrite_thread(void *pArg)
+{
+    DB_ZSTREAM *pzs = (DB_ZSTREAM *)pArg;
+    char *pBuffer = (char *)malloc(DB_ZLIB_BUFFER);
+    if (nullptr == pBuffer)
+    {
+        pzs->bOK = false;
+    }
+
+    // Keep draining the pipe after a failure so that the main thread is never
+    // left blocked on a full pipe.
+    //
+    char aSmall[512];
+    for (;;)
+    {
+        ssize_t n;
+        if (nullptr != pBuffer)
+        {
+            n = read(pzs->fdPipe, pBuffer, DB_ZLIB_BUFFER);
+        }
+        else
+        {
+            n = read(pzs->fdPipe, aSmall, sizeof(aSmall));
+        }
+
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            pzs->bOK = false;
+            break;
+        }
+        else if (0 == n)
+        {
+            break;
+        }
+
+        if (  pzs->bOK
+           && gzwrite(pzs->gz, pBuffer, (unsigned)n) != (int)n)
+        {
+            pzs->bOK = false;
+        }
+    }
+
+    if (Z_OK != gzclose(pzs->gz))
+    {
+        pzs->bOK = false;
+    }
+    pzs->gz = nullptr;
+    close(pzs->fdPipe);
+    free(pBuffer);
+    return nullptr;
+}
+
+static void *db_zread_thread(void *pArg)
+{
+    DB_ZSTREAM *pzs = (DB_ZSTREAM *)pArg;
+    char *pBuffer = (char *)malloc(DB_ZLIB_BUFFER);
+    if (nullptr == pBuffer)
+    {
+        pzs->bOK = false;
+    }
+
+    while (nullptr != pBuffer)
+    {
+        int n = gzread(pzs->gz, pBuffer, DB_ZLIB_BUFFER);
+        if (n < 0)
+        {
+            pzs->bOK = false;
+            break;
+        }
+        else if (0 == n)
+        {
+            break;
+        }
+
+        // A write error means the reader closed its end early.
+        //
+        char *p = pBuffer;
+        while (0 < n)
+        {
+            ssize_t nWritten = write(pzs->fdPipe, p, n);
+            if (nWritten < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                n = -1;
+                break;
+            }
+            p += nWritten;
+            n -= (int)nWritten;
+        }
+
+        if (n < 0)
+        {
+            break;
+        }
+    }
+
+    gzclose(pzs->gz);
+    pzs->gz = nullptr;
+    close(pzs->fdPipe);
+    free(pBuffer);
+    return nullptr;
+}
+
+// Wrap the open file fd in a compressed stream.  The fd is consumed either
+// way.
+//
+static FILE *db_zstream_open(int fd, bool bWrite, int iLevel)
+{
+    UTF8 aMode[4];
+    if (bWrite)
+    {
+        mux_sprintf(aMode, sizeof(aMode), T("wb%d"), iLevel);
+    }
+    else
+    {
+        mux_strncpy(aMode, T("rb"), sizeof(aMode)-1);
+    }
+
+    int aPipe[2];
+    if (0 != pipe(aPipe))
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    gzFile gz = gzdopen(fd, (char *)aMode);
+    if (nullptr == gz)
+    {
+        close(fd);
+        close(aPipe[0]);
+        close(aPipe[1]);
+        return nullptr;
+    }
+
+    DB_ZSTREAM *pzs = (DB_ZSTREAM *)MEMALLOC(sizeof(DB_ZSTREAM));
+    ISOUTOFMEMORY(pzs);
+    pzs->gz = gz;
+    pzs->bWrite = bWrite;
+    pzs->bOK = true;
+    if (bWrite)
+    {
+        pzs->fdPipe = aPipe[0];
+        pzs->f = fdopen(aPipe[1], "wb");
+    }
+    else
+    {
+        pzs->fdPipe = aPipe[1];
+        pzs->f = fdopen(aPipe[0], "rb");
+    }
+
+    // The helper should never see a signal intended for the main thread.
+    //
+    bool bThread = false;
+    if (nullptr != pzs->f)
+    {
+        sigset_t sigAll, sigSave;
+        sigfillset(&sigAll);
+        pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+        bThread = (0 == pthread_create(&pzs->th, nullptr,
+            bWrite ? db_zwrite_thread : db_zread_thread, pzs));
+        pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
+    }
+
+    if (!bThread)
+    {
+        if (nullptr != pzs->f)
+        {
+            fclose(pzs->f);
+        }
+        else
+        {
+            close(bWrite ? aPipe[1] : aPipe[0]);
+        }
+        close(pzs->fdPipe);
+        gzclose(gz);
+        MEMFREE(pzs);
+        return nullptr;
+    }
+
+    pzs->pNext = pZStreams;
+    pZStreams = pzs;
+    return pzs->f;
+}
+#endif // UNIX_ZLIB && UNIX_THREADS
+
+/*! \brief Opens a database file for writing.
+ *
+ * With a level between 1 and 9, the file is gzip-compressed as it is
+ * written.  Otherwise, it is an ordinary file.
+ *
+ * \param pFile      Receives the stream.
+ * \param pFilename  File to create.
+ * \param iLevel     zlib compression level, or 0 for none.
+ * \return           true if the file was opened.
+ */
+
+bool db_fopen_write(FILE **pFile, const UTF8 *pFilename, int iLevel)
+{
+#if defined(UNIX_ZLIB) && defined(UNIX_THREADS)
+    if (  1 <= iLevel
+       && iLevel <= 9)
+    {
+        // Create the file the way fopen() does, so the umask decides its
+        // mode just as it does for an uncompressed dump.
+        //
+        *pFile = nullptr;
+        int fd = open((char *)pFilename, O_WRONLY|O_BINARY|O_CREAT|O_TRUNC, 0666);
+        if (0 <= fd)
+        {
+            *pFile = db_zstream_open(fd, true, iLevel);
+        }
+        return (nullptr != *pFile);
+    }
+#else
+    UNUSED_PARAMETER(iLevel);
+#endif // UNIX_ZLIB && UNIX_THREADS
+    return mux_fopen(pFile, pFilename, T("wb"));
+}
+
+/*! \brief Opens a database file for reading.
+ *
+ * A gzip-compressed file is decompressed as it is read.  Anything else is
+ * opened as an ordinary file.
+ *
+ * \param pFile      Receives the stream.
+ * \param pFilename  File to open.
+ * \return           true if the file was opened.
+ */
+
+bool db_fopen_read(FILE **pFile, const UTF8 *pFilename)
+{
+#if defined(UNIX_ZLIB) && defined(UNIX_THREADS)
+    *pFile = nullptr;
+    int fd;
+    if (!mux_open(&fd, pFilename, O_RDONLY|O_BINARY))
+    {
+        return false;
+    }
+
+    unsigned char aMagic[2];
+    if (  sizeof(aMagic) == read(fd, aMagic, sizeof(aMagic))
+       && 0x1F == aMagic[0]
+       && 0x8B == aMagic[1]
+       && 0 == lseek(fd, 0, SEEK_SET))
+    {
+        *pFile = db_zstream_open(fd, false, 0);
+        return (nullptr != *pFile);
+    }
+    close(fd);
+#endif // UNIX_ZLIB && UNIX_THREADS
+    return mux_fopen(pFile, pFilename, T("rb"));
+}
+
+/*! \brief Closes a stream opened by db_fopen_write() or db_fopen_read().
+ *
+ * For a compressed stream, this waits for the helper thread to finish, and
+ * any error it met is reported here.
+ *
+ * \param f   Stream to close.
+ * \return    0 on success, like fclose().
+ */
+
+int db_fclose(FILE *f)
+{
+#if defined(UNIX_ZLIB) && defined(UNIX_THREADS)
+    DB_ZSTREAM **ppzs = &pZStreams;
+    while (nullptr != *ppzs)
+    {
+        DB_ZSTREAM *pzs = *ppzs;
+        if (pzs->f == f)
+        {
+            *ppzs = pzs->pNext;
+            int cc = fclose(f);
+            pthread_join(pzs->th, nullptr);
+            if (!pzs->bOK)
+            {
+                STARTLOG(LOG_PROBLEMS, "DMP", "ZLIB");
+                log_printf(T("%s of compressed database failed."),
+                    pzs->bWrite ? T("Writing") : T("Reading"));
+                ENDLOG;
+                cc = EOF;
+            }
+            MEMFREE(pzs);
+            return cc;
+        }
+        ppzs = &pzs->pNext;
+    }
+#endif // UNIX_ZLIB && UNIX_THREADS
+    return fclose(f);
+}
+
+// Checkpoint journal.
+//
+// When incremental_dumps is set, most checkpoints do not write the whole
+// database.  Instead, they append an image of each object changed since the
+// previous checkpoint to <outdb>.jnl.  The setters in db.h mark objects with
+// s_Dirty().  A disk-based game already keeps its attributes durable in the
+// page file, so its journal carries only the object structure.  A
+// memory-based game also records which attributes changed.  The user
+// attribute name table is written whole whenever it changes.
+//
+// Every full dump is stamped with a generation (+J in a flatfile).  A
+// journal's header names its own generation and the generation before it.
+// At startup, only journals which follow the loaded database are replayed.
+// When a full dump starts, <outdb>.jnl is renamed to <outdb>.jnl.old and a
+// new journal is started for the new generation.  Until the new dump is
+// complete, the previous dump, the old journal, and the new journal still
+// describe the game.  A dump which is written over several steps changes
+// while it is written.  A checkpoint taken when the dump is complete brings
+// every object changed along the way up to date, so the dump is not renamed
+// into place until that checkpoint is on disk.
+//
+// A writer thread does the writes, fdatasync() calls, and renames, so the
+// game does not wait on the disk.  Memory is allocated and freed only by the
+// main thread, and the writer does not log.
+//
+#define JOURNAL_MAGIC       "MUXJRNL\n"
+#define JOURNAL_VERSION     1
+#define JOURNAL_CHECKPOINT  0x54504B43UL    // "CKPT"
+#define JOURNAL_NO_NAMES    0xFFFFFFFFUL
+
+typedef struct
+{
+    char   szMagic[SNAPSHOT_TAG_LEN];
+    UINT32 nByteOrder;
+    UINT32 nVersion;
+    INT32  iGeneration;
+    INT32  iPrevious;       // Generation of the journal or dump before this one.
+} JOURNAL_HEADER;
+
+typedef struct
+{
+    UINT32 nMagic;
+    UINT32 nCRC;            // Covers the whole record with nCRC as zero.
+    UINT64 nLength;         // Bytes which follow this header.
+    INT32  iFlags;          // Same as +X.
+    INT32  nDbTop;          // Same as +S.
+    INT32  nAttrNext;       // Same as +N.
+    INT32  nRecordPlayers;  // Same as -R.
+    UINT32 nAttrNames;      // JOURNAL_NO_NAMES if the table did not change.
+    UINT32 nObjects;
+    UINT64 nAttrs;
+} JOURNAL_RECORD;
+
+// A record holds the attribute names, then the attributes, then the
+// objects.  Each SNAP_ATTRNAME is followed by its name, each JOURNAL_ATTR by
+// its value, and each SNAP_OBJECT by its name unless V_ATRNAME is set.
+// Offsets in the snapshot structures are unused, and nothing is
+// NUL-terminated.  Attributes come first because removing every attribute
+// from an object also removes the name and money which its SNAP_OBJECT
+// restores.
+//
+typedef struct
+{
+    INT32  dbObject;
+    INT32  iAttr;           // Zero to remove every attribute.
+    UINT32 nValue;          // Zero to remove the attribute.
+    INT32  iReserved;
+} JOURNAL_ATTR;
+
+typedef struct
+{
+    char  *p;
+    size_t n;
+    size_t nAlloc;
+} JOURNAL_BUFFER;
+
+#define JOURNAL_OP_APPEND   0
+#define JOURNAL_OP_ROTATE   1
+#define JOURNAL_OP_COMMIT   2
+
+typedef struct journal_op JOURNAL_OP;
+struct journal_op
+{
+    JOURNAL_OP *pNext;
+    int    iOp;
+    char  *pData;           // JOURNAL_OP_APPEND
+    size_t nData;
+    INT32  iGeneration;     // JOURNAL_OP_ROTATE and JOURNAL_OP_COMMIT
+    INT32  iPrevious;       // JOURNAL_OP_ROTATE
+    UTF8  *pTemp;           // JOURNAL_OP_COMMIT
+    UTF8  *pOut;
+    UTF8  *pPrev;
+};
+
+static UTF8  *pJournalName = nullptr;
+static UTF8  *pJournalOldName = nullptr;
+static int    hJournal = MUX_OPEN_INVALID_HANDLE_VALUE;   // Writer only.
+
+// Generation of the database loaded at startup, the largest generation seen
+// in any header, and the generation of the journal being appended to.
+//
+static INT32  iJournalBase = 0;
+static INT32  iJournalLatest = 0;
+static INT32  iJournalGeneration = 0;
+
+// What replay left behind for journal_start().
+//
+static bool   bJournalContinue = false;
+static INT32  iJournalContinue = 0;
+static INT64  nJournalGood = 0;
+
+// What the last checkpoint saw, so that an idle checkpoint writes nothing.
+//
+static UINT32 nJournalNamesCRC = 0;
+static int    nJournalDbTop = 0;
+static int    nJournalAttrNext = 0;
+static int    nJournalRecordPlayers = 0;
+static int    nJournalCheckpoints = 0;
+
+// Generation of the last dump known to be in place.  Set by the writer.
+//
+static std::atomic<INT32> iJournalCommitted(0);
+static std::atomic<int>   iJournalErrno(0);
+
+#if defined(UNIX_THREADS)
+static pthread_t       thJournal;
+static pthread_mutex_t mtxJournal = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cvJournalWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  cvJournalDone = PTHREAD_COND_INITIALIZER;
+static bool            bJournalThread = false;
+static bool            bJournalStop = false;
+
+// Operations run oldest first.  Those ahead of pJournalNext are finished and
+// are waiting for the main thread to free them.
+//
+static JOURNAL_OP     *pJournalHead = nullptr;
+static JOURNAL_OP     *pJournalTail = nullptr;
+static JOURNAL_OP     *pJournalNext = nullptr;
+#endif // UNIX_THREADS
+
+#if defined(MEMORY_BASED)
+typedef struct
+{
+    dbref dbObject;
+    int   iAttr;
+} JOURNAL_KEY;
+
+static JOURNAL_KEY *aJournalKeys = nullptr;
+static size_t nJournalKeys = 0;
+static size_t nJournalKeysAlloc = 0;
+#endif // MEMORY_BASED
+
+static void journal_put(JOURNAL_BUFFER *pjb, const void *p, size_t n)
+{
+    if (pjb->nAlloc - pjb->n < n)
+    {
+        size_t nAlloc = (0 == pjb->nAlloc) ? 65536 : pjb->nAlloc;
+        while (nAlloc - pjb->n < n)
+        {
+            nAlloc *= 2;
+        }
+        pjb->p = (char *)MEMREALLOC(pjb->p, nAlloc);
+        ISOUTOFMEMORY(pjb->p);
+        pjb->nAlloc = nAlloc;
+    }
+    memcpy(pjb->p + pjb->n, p, n);
+    pjb->n += n;
+}
+
+static bool journal_get(const char **pp, const char *pEnd, void *pOut, size_t n)
+{
+    if (static_cast<size_t>(pEnd - *pp) < n)
+    {
+        return false;
+    }
+    memcpy(pOut, *pp, n);
+    *pp += n;
+    return true;
+}
+
+static bool journal_get_string(const char **pp, const char *pEnd, size_t n, UTF8 *pOut, size_t nOut)
+{
+    if (nOut <= n)
+    {
+        return false;
+    }
+    pOut[n] = '\0';
+    return journal_get(pp, pEnd, pOut, n);
+}
+
+static UINT32 journal_crc(const JOURNAL_RECORD *pjr, const void *pData)
+{
+    JOURNAL_RECORD jr = *pjr;
+    jr.nCRC = 0;
+    UINT32 nCRC = CRC32_ProcessBuffer(0, &jr, sizeof(jr));
+    return CRC32_ProcessBuffer(nCRC, pData, static_cast<size_t>(jr.nLength));
+}
+
+// Changes to the user attribute name table are found by comparing a CRC of
+// it with the one taken at the last checkpoint.
+//
+static UINT32 journal_names_crc(void)
+{
+    UINT32 nCRC = 0;
+    for (int iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+    {
+        ATTR *vp = (ATTR *)anum_get(iAttr);
+        if (  nullptr != vp
+           && !(vp->flags & AF_DELETED))
+        {
+            nCRC = CRC32_ProcessBuffer(nCRC, &vp->number, sizeof(vp->number));
+            nCRC = CRC32_ProcessBuffer(nCRC, &vp->flags, sizeof(vp->flags));
+            nCRC = CRC32_ProcessBuffer(nCRC, vp->name, strlen((const char *)vp->name) + 1);
+        }
+    }
+    return nCRC;
+}
+
+static void journal_set_names(void)
+{
+    if (nullptr == pJournalName)
+    {
+        pJournalName = StringClone(tprintf(T("%s.jnl"), mudconf.outdb));
+        pJournalOldName = StringClone(tprintf(T("%s.jnl.old"), mudconf.outdb));
+    }
+}
+
+static INT32 journal_new_generation(void)
+{
+    CLinearTimeAbsolute ltaNow;
+    ltaNow.GetUTC();
+    INT64 iNow = ltaNow.ReturnSeconds();
+
+    INT32 iGeneration = iJournalLatest + 1;
+    if (  iGeneration < iNow
+       && iNow < INT32_MAX_VALUE)
+    {
+        iGeneration = static_cast<INT32>(iNow);
+    }
+    iJournalLatest = iGeneration;
+    return iGeneration;
+}
+
+// The remaining journal_file_* functions belong to the writer.
+//
+static void journal_file_sync(int h)
+{
+#if defined(WINDOWS_FILES)
+    _commit(h);
+#elif defined(HAVE_FDATASYNC)
+    fdatasync(h);
+#else
+    fsync(h);
+#endif // HAVE_FDATASYNC
+}
+
+static bool journal_file_write(int h, const void *p, size_t n)
+{
+    const char *pc = static_cast<const char *>(p);
+    while (0 < n)
+    {
+        int cc = mux_write(h, pc, static_cast<unsigned int>(n));
+        if (cc <= 0)
+        {
+            if (0 == cc)
+            {
+                errno = EIO;
+            }
+            return false;
+        }
+        pc += cc;
+        n -= cc;
+    }
+    return true;
+}
+
+static bool journal_file_rename(const UTF8 *pFrom, const UTF8 *pTo)
+{
+#if defined(WINDOWS_FILES)
+    return ReplaceFile(const_cast<UTF8 *>(pFrom), const_cast<UTF8 *>(pTo)) == 0;
+#else
+    return rename((const char *)pFrom, (const char *)pTo) == 0;
+#endif // WINDOWS_FILES
+}
+
+static bool journal_file_create(INT32 iGeneration, INT32 iPrevious)
+{
+    if (!mux_open(&hJournal, pJournalName, O_RDWR|O_BINARY|O_CREAT|O_TRUNC))
+    {
+        hJournal = MUX_OPEN_INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    JOURNAL_HEADER jh;
+    memset(&jh, 0, sizeof(jh));
+    memcpy(jh.szMagic, JOURNAL_MAGIC, SNAPSHOT_TAG_LEN);
+    jh.nByteOrder = SNAPSHOT_BYTEORDER;
+    jh.nVersion = JOURNAL_VERSION;
+    jh.iGeneration = iGeneration;
+    jh.iPrevious = iPrevious;
+    if (!journal_file_write(hJournal, &jh, sizeof(jh)))
+    {
+        return false;
+    }
+    journal_file_sync(hJournal);
+    return true;
+}
+
+static void journal_file_op(const JOURNAL_OP *pop)
+{
+    bool bOK = false;
+    switch (pop->iOp)
+    {
+    case JOURNAL_OP_APPEND:
+        if (  MUX_OPEN_INVALID_HANDLE_VALUE != hJournal
+           && journal_file_write(hJournal, pop->pData, pop->nData))
+        {
+            journal_file_sync(hJournal);
+            bOK = true;
+        }
+        break;
+
+    case JOURNAL_OP_ROTATE:
+        if (MUX_OPEN_INVALID_HANDLE_VALUE != hJournal)
+        {
+            mux_close(hJournal);
+            hJournal = MUX_OPEN_INVALID_HANDLE_VALUE;
+        }
+
+        // If the old journal cannot be set aside, it is still needed, so it
+        // must not be truncated by creating the new one.
+        //
+        bOK =  journal_file_rename(pJournalName, pJournalOldName)
+            && journal_file_create(pop->iGeneration, pop->iPrevious);
+        break;
+
+    case JOURNAL_OP_COMMIT:
+        {
+            int h;
+            if (mux_open(&h, pop->pTemp, O_RDWR|O_BINARY))
+            {
+                journal_file_sync(h);
+                mux_close(h);
+            }
+
+            // The first dump has no predecessor to set aside.
+            //
+            journal_file_rename(pop->pOut, pop->pPrev);
+            bOK = journal_file_rename(pop->pTemp, pop->pOut);
+            if (bOK)
+            {
+                iJournalCommitted = pop->iGeneration;
+            }
+        }
+        break;
+    }
+
+    if (!bOK)
+    {
+        iJournalErrno = (0 == errno) ? EIO : errno;
+    }
+}
+
+static void journal_free_op(JOURNAL_OP *pop)
+{
+    if (nullptr != pop->pData)
+    {
+        MEMFREE(pop->pData);
+    }
+    if (nullptr != pop->pTemp)
+    {
+        MEMFREE(pop->pTemp);
+        MEMFREE(pop->pOut);
+        MEMFREE(pop->pPrev);
+    }
+    MEMFREE(pop);
+}
+
+static void journal_report(void)
+{
+    int iErrno = iJournalErrno.exchange(0);
+    if (0 != iErrno)
+    {
+        STARTLOG(LOG_PROBLEMS, "DMP", "JRNL");
+        log_printf(T("Checkpoint journal %s failed: %s"), pJournalName, mux_strerror(iErrno));
+        ENDLOG;
+    }
+}
+
+#if defined(UNIX_THREADS)
+static void *journal_thread(void *pArg)
+{
+    UNUSED_PARAMETER(pArg);
+
+    pthread_mutex_lock(&mtxJournal);
+    for (;;)
+    {
+        if (nullptr == pJournalNext)
+        {
+            if (bJournalStop)
+            {
+                break;
+            }
+            pthread_cond_wait(&cvJournalWork, &mtxJournal);
+            continue;
+        }
+
+        JOURNAL_OP *pop = pJournalNext;
+        pthread_mutex_unlock(&mtxJournal);
+        journal_file_op(pop);
+        pthread_mutex_lock(&mtxJournal);
+        pJournalNext = pop->pNext;
+        pthread_cond_broadcast(&cvJournalDone);
+    }
+    pthread_mutex_unlock(&mtxJournal);
+    return nullptr;
+}
+
+static void journal_reap(void)
+{
+    pthread_mutex_lock(&mtxJournal);
+    JOURNAL_OP *pDone = pJournalHead;
+    while (  nullptr != pJournalHead
+          && pJournalNext != pJournalHead)
+    {
+        pJournalHead = pJournalHead->pNext;
+    }
+    JOURNAL_OP *pStop = pJournalHead;
+    if (nullptr == pJournalHead)
+    {
+        pJournalTail = nullptr;
+    }
+    pthread_mutex_unlock(&mtxJournal);
+
+    while (pDone != pStop)
+    {
+        JOURNAL_OP *pNext = pDone->pNext;
+        journal_free_op(pDone);
+        pDone = pNext;
+    }
+}
+#endif // UNIX_THREADS
+
+static void journal_submit(JOURNAL_OP *pop)
+{
+    pop->pNext = nullptr;
+#if defined(UNIX_THREADS)
+    if (bJournalThread)
+    {
+        pthread_mutex_lock(&mtxJournal);
+        if (nullptr == pJournalTail)
+        {
+            pJournalHead = pop;
+        }
+        else
+        {
+            pJournalTail->pNext = pop;
+        }
+        pJournalTail = pop;
+        if (nullptr == pJournalNext)
+        {
+            pJournalNext = pop;
+        }
+        pthread_cond_signal(&cvJournalWork);
+        pthread_mutex_unlock(&mtxJournal);
+        journal_reap();
+        journal_report();
+        return;
+    }
+#endif // UNIX_THREADS
+    journal_file_op(pop);
+    journal_free_op(pop);
+    journal_report();
+}
+
+static JOURNAL_OP *journal_new_op(int iOp)
+{
+    JOURNAL_OP *pop = (JOURNAL_OP *)MEMALLOC(sizeof(JOURNAL_OP));
+    ISOUTOFMEMORY(pop);
+    memset(pop, 0, sizeof(JOURNAL_OP));
+    pop->iOp = iOp;
+    return pop;
+}
+
+// Wait for the writer to finish everything submitted so far.
+//
+static void journal_drain(void)
+{
+#if defined(UNIX_THREADS)
+    if (bJournalThread)
+    {
+        pthread_mutex_lock(&mtxJournal);
+        while (nullptr != pJournalNext)
+        {
+            pthread_cond_wait(&cvJournalDone, &mtxJournal);
+        }
+        pthread_mutex_unlock(&mtxJournal);
+        journal_reap();
+    }
+#endif // UNIX_THREADS
+    journal_report();
+}
+
+#if defined(MEMORY_BASED)
+static int journal_compare_keys(const void *p, const void *q)
+{
+    const JOURNAL_KEY *pk = static_cast<const JOURNAL_KEY *>(p);
+    const JOURNAL_KEY *qk = static_cast<const JOURNAL_KEY *>(q);
+    if (pk->dbObject != qk->dbObject)
+    {
+        return (pk->dbObject < qk->dbObject) ? -1 : 1;
+    }
+    if (pk->iAttr != qk->iAttr)
+    {
+        return (pk->iAttr < qk->iAttr) ? -1 : 1;
+    }
+    return 0;
+}
+
+static void journal_sort_keys(void)
+{
+    if (nJournalKeys < 2)
+    {
+        return;
+    }
+    qsort(aJournalKeys, nJournalKeys, sizeof(JOURNAL_KEY), journal_compare_keys);
+
+    size_t j = 0;
+    for (size_t i = 1; i < nJournalKeys; i++)
+    {
+        if (0 != journal_compare_keys(aJournalKeys + j, aJournalKeys + i))
+        {
+            aJournalKeys[++j] = aJournalKeys[i];
+        }
+    }
+    nJournalKeys = j + 1;
+}
+
+/*! \brief Notes that an attribute changed since the last checkpoint.
+ *
+ * \param thing  Object which holds the attribute.
+ * \param atr    Attribute number, or zero if every attribute was removed.
+ * \return       None.
+ */
+
+void journal_attr(dbref thing, int atr)
+{
+    switch (atr)
+    {
+    case A_NAME:
+    case A_MONEY:
+
+        // These are written with the object rather than as attributes.
+        //
+        s_Dirty(thing);
+        return;
+    }
+
+    if (nJournalKeysAlloc <= nJournalKeys)
+    {
+        journal_sort_keys();
+        if (nJournalKeysAlloc / 2 <= nJournalKeys)
+        {
+            nJournalKeysAlloc = (0 == nJournalKeysAlloc) ? 1024 : 2 * nJournalKeysAlloc;
+            aJournalKeys = (JOURNAL_KEY *)MEMREALLOC(aJournalKeys, nJournalKeysAlloc * sizeof(JOURNAL_KEY));
+            ISOUTOFMEMORY(aJournalKeys);
+        }
+    }
+    aJournalKeys[nJournalKeys].dbObject = thing;
+    aJournalKeys[nJournalKeys].iAttr = atr;
+    nJournalKeys++;
+}
+#endif // MEMORY_BASED
+
+/*! \brief Appends the objects changed since the last checkpoint to the
+ * journal.
+ *
+ * The caller should have flushed the attribute caches first.
+ *
+ * \return  true if a checkpoint was written.
+ */
+
+bool journal_checkpoint(void)
+{
+    if (!mudstate.bJournal)
+    {
+        return false;
+    }
+
+    JOURNAL_BUFFER jb = { nullptr, 0, 0 };
+    JOURNAL_RECORD jr;
+    memset(&jr, 0, sizeof(jr));
+    jr.nMagic = JOURNAL_CHECKPOINT;
+    jr.iFlags = OUTPUT_VERSION | OUTPUT_FLAGS;
+    jr.nDbTop = mudstate.db_top;
+    jr.nAttrNext = mudstate.attr_next;
+    jr.nRecordPlayers = mudstate.record_players;
+    jr.nAttrNames = JOURNAL_NO_NAMES;
+    journal_put(&jb, &jr, sizeof(jr));
+
+    UINT32 nNamesCRC = journal_names_crc();
+    if (nNamesCRC != nJournalNamesCRC)
+    {
+        jr.nAttrNames = 0;
+        for (int iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+        {
+            ATTR *vp = (ATTR *)anum_get(iAttr);
+            if (  nullptr != vp
+               && !(vp->flags & AF_DELETED))
+            {
+                SNAP_ATTRNAME san;
+                memset(&san, 0, sizeof(san));
+                san.nName = static_cast<UINT32>(strlen((const char *)vp->name));
+                san.iNumber = vp->number;
+                san.iFlags = vp->flags;
+                journal_put(&jb, &san, sizeof(san));
+                journal_put(&jb, vp->name, san.nName);
+                jr.nAttrNames++;
             }
+        }
+    }
 
-        case EOF:
-            Log.tinyprintf(T(ENDLINE "Unexpected end of file near object #%d" ENDLINE), i);
-            return -1;
+#if defined(MEMORY_BASED)
+    journal_sort_keys();
+    for (size_t k = 0; k < nJournalKeys; k++)
+    {
+        const JOURNAL_KEY *pk = aJournalKeys + k;
+        if (mudstate.db_top <= pk->dbObject)
+        {
+            continue;
+        }
 
-        default:
-            if (mux_isprint_ascii(ch))
+        JOURNAL_ATTR ja;
+        memset(&ja, 0, sizeof(ja));
+        ja.dbObject = pk->dbObject;
+        ja.iAttr = pk->iAttr;
+
+        size_t nValue = 0;
+        const UTF8 *pValue = nullptr;
+        if (  0 != pk->iAttr
+           && nullptr != atr_num(pk->iAttr))
+        {
+            pValue = atr_get_raw_LEN(pk->dbObject, pk->iAttr, &nValue);
+            if (nullptr == pValue)
             {
-                Log.tinyprintf(T(ENDLINE "Illegal character \xE2\x80\x98%c\xE2\x80\x99 near object #%d" ENDLINE), ch, i);
+                nValue = 0;
             }
-            else
+        }
+        ja.nValue = static_cast<UINT32>(nValue);
+        journal_put(&jb, &ja, sizeof(ja));
+        if (0 < nValue)
+        {
+            journal_put(&jb, pValue, nValue);
+        }
+        jr.nAttrs++;
+    }
+    nJournalKeys = 0;
+#endif // MEMORY_BASED
+
+    dbref i;
+    DO_WHOLE_DB(i)
+    {
+        if (mudstate.bfDirty.IsSet(i))
+        {
+            SNAP_OBJECT so;
+            snapshot_get_object(i, jr.iFlags, &so);
+            const UTF8 *pName = T("");
+            if (!(jr.iFlags & V_ATRNAME))
             {
-                Log.tinyprintf(T(ENDLINE "Illegal character 0x%02x near object #%d" ENDLINE), ch, i);
+                pName = Name(i);
+                so.nName = static_cast<UINT32>(strlen((const char *)pName));
             }
-            return -1;
+            journal_put(&jb, &so, sizeof(so));
+            journal_put(&jb, pName, so.nName);
+            jr.nObjects++;
         }
     }
+    mudstate.bfDirty.ClearAll();
+
+    if (  JOURNAL_NO_NAMES == jr.nAttrNames
+       && 0 == jr.nObjects
+       && 0 == jr.nAttrs
+       && nJournalDbTop == jr.nDbTop
+       && nJournalAttrNext == jr.nAttrNext
+       && nJournalRecordPlayers == jr.nRecordPlayers)
+    {
+        MEMFREE(jb.p);
+        return false;
+    }
+    nJournalNamesCRC = nNamesCRC;
+    nJournalDbTop = jr.nDbTop;
+    nJournalAttrNext = jr.nAttrNext;
+    nJournalRecordPlayers = jr.nRecordPlayers;
+
+    jr.nLength = jb.n - sizeof(jr);
+    jr.nCRC = journal_crc(&jr, jb.p + sizeof(jr));
+    memcpy(jb.p, &jr, sizeof(jr));
+
+    JOURNAL_OP *pop = journal_new_op(JOURNAL_OP_APPEND);
+    pop->pData = jb.p;
+    pop->nData = jb.n;
+    journal_submit(pop);
+    nJournalCheckpoints++;
+
+    STARTLOG(LOG_DBSAVES, "DMP", "JRNL");
+    log_printf(T("Checkpoint %d of generation %d: %u objects, %u bytes."),
+        nJournalCheckpoints, iJournalGeneration, jr.nObjects, static_cast<unsigned int>(jb.n));
+    ENDLOG;
+    return true;
 }
 
-static bool db_write_object(FILE *f, dbref i, int db_format, int flags)
+static void journal_clear_names(void)
 {
-    UNUSED_PARAMETER(db_format);
+    for (int iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+    {
+        ATTR *vp = (ATTR *)anum_get(iAttr);
+        if (nullptr != vp)
+        {
+            UTF8 *pName = const_cast<UTF8 *>(vp->name);
+            vattr_delete_LEN(pName, strlen((const char *)pName));
+        }
+    }
+}
 
-    ATTR *a;
-    int ca, j;
+static bool journal_apply(const JOURNAL_RECORD *pjr, const char *p)
+{
+    const char *pEnd = p + pjr->nLength;
+    bool read_name = !(pjr->iFlags & V_ATRNAME);
+    bool read_money = !(pjr->iFlags & V_ATRMONEY);
+    bool bOK = false;
 
-    if (!(flags & V_ATRNAME))
+    if (  pjr->nDbTop < 0
+       || INT_MAX - 1 < pjr->nDbTop)
     {
-        putstring(f, Name(i));
+        return false;
     }
-    putref(f, Location(i));
-    putref(f, Zone(i));
-    putref(f, Contents(i));
-    putref(f, Exits(i));
-    putref(f, Link(i));
-    putref(f, Next(i));
-    putref(f, Owner(i));
-    putref(f, Parent(i));
-    if (!(flags & V_ATRMONEY))
+    db_grow(pjr->nDbTop);
+
+    UTF8 *buff = alloc_lbuf("journal_apply");
+    UTF8 *pName = alloc_mbuf("journal_apply.s_Name");
+    if (JOURNAL_NO_NAMES != pjr->nAttrNames)
     {
-        putref(f, Pennies(i));
+        journal_clear_names();
+        for (UINT32 k = 0; k < pjr->nAttrNames; k++)
+        {
+            SNAP_ATTRNAME san;
+            if (  !journal_get(&p, pEnd, &san, sizeof(san))
+               || !journal_get_string(&p, pEnd, san.nName, buff, LBUF_SIZE))
+            {
+                goto done;
+            }
+
+            size_t nName;
+            bool bValid;
+            UTF8 *pAttrName = MakeCanonicalAttributeName(buff, &nName, &bValid);
+            if (bValid)
+            {
+                vattr_define_LEN(pAttrName, nName, san.iNumber, san.iFlags);
+            }
+        }
     }
-    putref(f, Flags(i));
-    putref(f, Flags2(i));
-    putref(f, Flags3(i));
-    putref(f, Powers(i));
-    putref(f, Powers2(i));
 
-    // Write the attribute list.
-    //
-    if (!(flags & V_DATABASE))
+    for (UINT64 k = 0; k < pjr->nAttrs; k++)
     {
-        UTF8 buf[SBUF_SIZE];
-        buf[0] = '>';
-        unsigned char *as;
-        for (ca = atr_head(i, &as); ca; ca = atr_next(&as))
+        JOURNAL_ATTR ja;
+        if (  !journal_get(&p, pEnd, &ja, sizeof(ja))
+           || ja.dbObject < 0
+           || mudstate.db_top <= ja.dbObject
+           || ja.iAttr < 0)
         {
-            if (mudstate.bStandAlone)
+            goto done;
+        }
+
+        if (0 == ja.iAttr)
+        {
+            atr_free(ja.dbObject);
+        }
+        else if (0 == ja.nValue)
+        {
+            atr_clr(ja.dbObject, ja.iAttr);
+        }
+        else
+        {
+            if (!journal_get_string(&p, pEnd, ja.nValue, buff, LBUF_SIZE))
             {
-                j = ca;
+                goto done;
             }
-            else
+            atr_add_raw_LEN(ja.dbObject, ja.iAttr, buff, ja.nValue);
+        }
+    }
+
+    for (UINT32 k = 0; k < pjr->nObjects; k++)
+    {
+        SNAP_OBJECT so;
+        if (  !journal_get(&p, pEnd, &so, sizeof(so))
+           || so.dbObject < 0
+           || mudstate.db_top <= so.dbObject)
+        {
+            goto done;
+        }
+
+        dbref i = so.dbObject;
+        if (read_name)
+        {
+            if (!journal_get_string(&p, pEnd, so.nName, buff, LBUF_SIZE))
             {
-                a = atr_num(ca);
-                if (!a)
-                {
-                    continue;
-                }
-                j = a->number;
+                goto done;
             }
+            StripTabsAndTruncate(buff, pName, MBUF_SIZE-1, MBUF_SIZE-1);
+            s_Name(i, pName);
+        }
+        snapshot_set_object(i, &so, read_money);
+        if (isPlayer(i))
+        {
+            c_Connected(i);
+        }
+    }
 
-            if (j < A_USER_START)
-            {
-                switch (j)
-                {
-                case A_NAME:
-                    if (!(flags & V_ATRNAME))
-                    {
-                        continue;
-                    }
-                    break;
+    mudstate.attr_next = pjr->nAttrNext;
+    if (!mudconf.reset_players)
+    {
+        mudstate.record_players = pjr->nRecordPlayers;
+    }
+    bOK = (p == pEnd);
 
-                case A_LIST:
-                case A_MONEY:
-                    continue;
-                }
+done:
+    free_mbuf(pName);
+    free_lbuf(buff);
+    return bOK;
+}
+
+static bool journal_read_header(int h, JOURNAL_HEADER *pjh)
+{
+    if (  sizeof(*pjh) != mux_read(h, pjh, sizeof(*pjh))
+       || 0 != memcmp(pjh->szMagic, JOURNAL_MAGIC, SNAPSHOT_TAG_LEN)
+       || SNAPSHOT_BYTEORDER != pjh->nByteOrder
+       || JOURNAL_VERSION != pjh->nVersion)
+    {
+        return false;
+    }
+    if (iJournalLatest < pjh->iGeneration)
+    {
+        iJournalLatest = pjh->iGeneration;
+    }
+    return true;
+}
+
+// Replay stops at the first record which is incomplete or fails its CRC.
+// Everything after it was written by a checkpoint which never finished.
+//
+static int journal_replay_file(int h, const UTF8 *pName, INT64 *pnGood)
+{
+    INT64 nFile = mux_lseek(h, 0, SEEK_END);
+    INT64 iPos = sizeof(JOURNAL_HEADER);
+    mux_lseek(h, static_cast<long>(iPos), SEEK_SET);
+
+    char *pData = nullptr;
+    size_t nAlloc = 0;
+    int nApplied = 0;
+    JOURNAL_RECORD jr;
+    while (  sizeof(jr) == mux_read(h, &jr, sizeof(jr))
+          && JOURNAL_CHECKPOINT == jr.nMagic
+          && jr.nLength <= static_cast<UINT64>(nFile - iPos - sizeof(jr)))
+    {
+        size_t nData = static_cast<size_t>(jr.nLength);
+        if (nAlloc < nData)
+        {
+            if (nullptr != pData)
+            {
+                MEMFREE(pData);
             }
+            pData = (char *)MEMALLOC(nData);
+            ISOUTOFMEMORY(pData);
+            nAlloc = nData;
+        }
 
-            // Format is: ">%d\n", j
-            //
-            const UTF8 *p = atr_get_raw(i, j);
-            size_t n = mux_ltoa(j, buf+1) + 1;
-            buf[n++] = '\n';
-            fwrite(buf, sizeof(UTF8), n, f);
-            putstring(f, p);
+        if (  static_cast<int>(nData) != mux_read(h, pData, static_cast<unsigned int>(nData))
+           || journal_crc(&jr, pData) != jr.nCRC)
+        {
+            break;
         }
-        fwrite("<\n", sizeof(UTF8), 2, f);
+
+        if (!journal_apply(&jr, pData))
+        {
+            Log.tinyprintf(T("Checkpoint %d in %s is damaged." ENDLINE), nApplied + 1, pName);
+            break;
+        }
+        nApplied++;
+        iPos += sizeof(jr) + nData;
     }
-    return false;
+    if (nullptr != pData)
+    {
+        MEMFREE(pData);
+    }
+    *pnGood = iPos;
+    return nApplied;
 }
 
-dbref db_write(FILE *f, int format, int version)
+// Called by db_read() once the database is loaded.  The old journal applies
+// to the loaded database if a full dump was under way when the game stopped.
+//
+static void journal_replay(void)
 {
-    dbref i;
-    int flags;
-    ATTR *vp;
+    iJournalBase = g_generation;
+    iJournalLatest = g_generation;
+    bJournalContinue = false;
+    if (0 == g_generation)
+    {
+        return;
+    }
+    journal_set_names();
 
-    switch (format)
+    int nApplied = 0;
+    INT64 nGood;
+    JOURNAL_HEADER jh;
+    int h;
+    if (mux_open(&h, pJournalOldName, O_RDONLY|O_BINARY))
     {
-    case F_MUX:
-        flags = version;
-        break;
+        if (  journal_read_header(h, &jh)
+           && jh.iGeneration == g_generation)
+        {
+            nApplied += journal_replay_file(h, pJournalOldName, &nGood);
+        }
+        mux_close(h);
+    }
 
-    default:
-        Log.WriteString(T("Can only write MUX format." ENDLINE));
-        return -1;
+    if (mux_open(&h, pJournalName, O_RDONLY|O_BINARY))
+    {
+        if (  journal_read_header(h, &jh)
+           && (  jh.iGeneration == g_generation
+              || jh.iPrevious == g_generation))
+        {
+            nApplied += journal_replay_file(h, pJournalName, &nGood);
+            bJournalContinue = true;
+            iJournalContinue = jh.iGeneration;
+            nJournalGood = nGood;
+        }
+        mux_close(h);
     }
-    if (mudstate.bStandAlone)
+
+    if (0 < nApplied)
     {
-        Log.WriteString(T("Writing "));
-        Log.Flush();
+        Log.tinyprintf(T("Replayed %d checkpoints from the journal." ENDLINE), nApplied);
     }
-    i = mudstate.attr_next;
-    mux_fprintf(f, T("+X%d\n+S%d\n+N%d\n"), flags, mudstate.db_top, i);
-    mux_fprintf(f, T("-R%d\n"), mudstate.record_players);
+}
 
-    // Dump user-named attribute info.
-    //
-    UTF8 Buffer[LBUF_SIZE];
-    Buffer[0] = '+';
-    Buffer[1] = 'A';
-    int iAttr;
-    for (iAttr = A_USER_START; iAttr <= anum_alc_top; iAttr++)
+/*! \brief Starts tracking changes for the checkpoint journal.
+ *
+ * Called once the database is loaded.  The journal which was replayed is
+ * continued.  Otherwise, a new journal is started which follows the loaded
+ * database.
+ *
+ * \return  true if the loaded database has no generation, so a full dump
+ *          is needed before the journal can be replayed.
+ */
+
+bool journal_start(void)
+{
+    if (  mudconf.incremental_dumps <= 0
+       || mudstate.bStandAlone
+       || mudstate.bJournal)
     {
-        vp = (ATTR *) anum_get(iAttr);
-        if (  vp != nullptr
-           && !(vp->flags & AF_DELETED))
+        return false;
+    }
+    journal_set_names();
+
+    if (  bJournalContinue
+       && mux_open(&hJournal, pJournalName, O_RDWR|O_BINARY))
+    {
+        // Drop whatever an interrupted checkpoint left at the end.
+        //
+#if defined(WINDOWS_FILES)
+        _chsize_s(hJournal, nJournalGood);
+#else
+        if (0 != ftruncate(hJournal, static_cast<off_t>(nJournalGood)))
         {
-            // Format is: "+A%d\n\"%d:%s\"\n", vp->number, vp->flags, vp->name
-            //
-            UTF8 *pBuffer = Buffer+2;
-            pBuffer += mux_ltoa(vp->number, pBuffer);
-            *pBuffer++ = '\n';
-            *pBuffer++ = '"';
-            pBuffer += mux_ltoa(vp->flags, pBuffer);
-            *pBuffer++ = ':';
-            size_t nNameLength = strlen((char *)vp->name);
-            memcpy(pBuffer, vp->name, nNameLength);
-            pBuffer += nNameLength;
-            *pBuffer++ = '"';
-            *pBuffer++ = '\n';
-            fwrite(Buffer, sizeof(UTF8), pBuffer-Buffer, f);
+            log_perror(T("DMP"), T("JRNL"), T("Truncating"), pJournalName);
         }
+#endif // WINDOWS_FILES
+        mux_lseek(hJournal, 0, SEEK_END);
+        iJournalGeneration = iJournalContinue;
     }
-
-    int iDotCounter = 0;
-    UTF8 buf[SBUF_SIZE];
-    buf[0] = '!';
-    DO_WHOLE_DB(i)
+    else
     {
-        if (mudstate.bStandAlone)
+        iJournalGeneration = journal_new_generation();
+        if (!journal_file_create(iJournalGeneration, iJournalBase))
         {
-            if (!iDotCounter)
+            log_perror(T("DMP"), T("JRNL"), T("Creating"), pJournalName);
+            if (MUX_OPEN_INVALID_HANDLE_VALUE != hJournal)
             {
-                iDotCounter = 100;
-                fputc('.', stderr);
-                fflush(stderr);
+                mux_close(hJournal);
+                hJournal = MUX_OPEN_INVALID_HANDLE_VALUE;
             }
-            iDotCounter--;
+            return false;
         }
+    }
+    iJournalCommitted = iJournalBase;
+
+    mudstate.bfDirty.Resize(mudstate.db_top);
+    mudstate.bfDirty.ClearAll();
+    nJournalNamesCRC = journal_names_crc();
+    nJournalDbTop = mudstate.db_top;
+    nJournalAttrNext = mudstate.attr_next;
+    nJournalRecordPlayers = mudstate.record_players;
+    mudstate.bJournal = true;
+
+#if defined(UNIX_THREADS)
+    // The writer thread should never see the game's signals.
+    //
+    bJournalStop = false;
+    sigset_t sigAll, sigSave;
+    sigfillset(&sigAll);
+    pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+    bJournalThread = (0 == pthread_create(&thJournal, nullptr, journal_thread, nullptr));
+    pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
+#endif // UNIX_THREADS
+
+    STARTLOG(LOG_DBSAVES, "DMP", "JRNL");
+    log_printf(T("Journaling checkpoints to %s, generation %d."), pJournalName, iJournalGeneration);
+    ENDLOG;
+    return (0 == iJournalBase);
+}
 
-        if (!isGarbage(i))
-        {
-            // Format is: "!%d\n", i
-            //
-            size_t n = mux_ltoa(i, buf+1) + 1;
-            buf[n++] = '\n';
-            fwrite(buf, sizeof(UTF8), n, f);
-            db_write_object(f, i, format, flags);
-        }
+/*! \brief Prepares the journal for a full dump.
+ *
+ * Takes a checkpoint and, if the current journal already follows a dump
+ * which is in place, starts a new journal.
+ *
+ * \return  Generation to stamp on the dump, or zero if journaling is off.
+ */
+
+int journal_begin_dump(void)
+{
+    if (!mudstate.bJournal)
+    {
+        return 0;
     }
-    fputs("***END OF DUMP***\n", f);
-    if (mudstate.bStandAlone)
+    journal_checkpoint();
+
+    // If the last dump never made it into place, the current journal is
+    // still needed and still applies, so it is kept.
+    //
+    if (iJournalCommitted == iJournalGeneration)
     {
-        Log.WriteString(T(ENDLINE));
-        Log.Flush();
+        JOURNAL_OP *pop = journal_new_op(JOURNAL_OP_ROTATE);
+        pop->iPrevious = iJournalGeneration;
+        iJournalGeneration = journal_new_generation();
+        pop->iGeneration = iJournalGeneration;
+        journal_submit(pop);
+        nJournalCheckpoints = 0;
     }
-    return mudstate.db_top;
+    return iJournalGeneration;
+}
+
+/*! \brief Finishes a full dump which was written all at once.
+ *
+ * \param iGeneration  Value from journal_begin_dump().
+ * \param bWritten     Whether the dump is in place.
+ * \return             None.
+ */
+
+void journal_end_dump(int iGeneration, bool bWritten)
+{
+    if (  !mudstate.bJournal
+       || 0 == iGeneration)
+    {
+        return;
+    }
+    journal_checkpoint();
+    journal_drain();
+    if (bWritten)
+    {
+        iJournalCommitted = iGeneration;
+    }
+}
+
+/*! \brief Finishes a full dump which was written over several steps.
+ *
+ * The last checkpoint is taken now, and the writer moves the dump into
+ * place once that checkpoint is on disk.
+ *
+ * \param iGeneration  Value from journal_begin_dump().
+ * \param pTemp        File the dump was written to.
+ * \param pOut         Its final name.
+ * \param pPrev        Name for the dump it replaces.
+ * \return             None.
+ */
+
+void journal_commit_dump(int iGeneration, const UTF8 *pTemp, const UTF8 *pOut, const UTF8 *pPrev)
+{
+    journal_checkpoint();
+
+    JOURNAL_OP *pop = journal_new_op(JOURNAL_OP_COMMIT);
+    pop->iGeneration = iGeneration;
+    pop->pTemp = StringClone(pTemp);
+    pop->pOut = StringClone(pOut);
+    pop->pPrev = StringClone(pPrev);
+    journal_submit(pop);
+}
+
+/*! \brief Waits for the journal writer and stops it.
+ *
+ * \return  None.
+ */
+
+void journal_stop(void)
+{
+    if (!mudstate.bJournal)
+    {
+        return;
+    }
+    journal_drain();
+
+#if defined(UNIX_THREADS)
+    if (bJournalThread)
+    {
+        pthread_mutex_lock(&mtxJournal);
+        bJournalStop = true;
+        pthread_cond_signal(&cvJournalWork);
+        pthread_mutex_unlock(&mtxJournal);
+        pthread_join(thJournal, nullptr);
+        bJournalThread = false;
+    }
+#endif // UNIX_THREADS
+
+    if (MUX_OPEN_INVALID_HANDLE_VALUE != hJournal)
+    {
+        mux_close(hJournal);
+        hJournal = MUX_OPEN_INVALID_HANDLE_VALUE;
+    }
+    mudstate.bJournal = false;
 }
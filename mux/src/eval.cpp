@@ -711,6 +711,261 @@ TryAgain:
     return rstr;
 }
 
+//-----------------------------------------------------------------------------
+// Compiled text cache.
+//
+// Where each [...], {...}, and argument list in a string ends, and which
+// function each literal name before a '(' refers to, depend only on the text
+// of that string.  mux_exec() remembers both for each string it evaluates,
+// keyed by a hash of the contents, so that the next evaluation of the same
+// text (a u() library attribute, the body of an iter(), and so on) does not
+// rescan it or look the names up again.
+//
+// Nested calls which evaluate part of the current string share its entry.
+// An entry is never replaced while an evaluation is using it.  Strings built
+// on the fly (such as an iter() body after ## replacement) are rarely seen
+// twice, so a string is only compiled the second time in a row that it lands
+// in its bucket.
+//
+#define ECACHE_SIZE 512
+
+#define ECK_ARG         0   // parse_to_lite(p, ',',  ')')
+#define ECK_LASTARG     1   // parse_to_lite(p, '\0', ')')
+#define ECK_BRACKET     2   // parse_to_lite(p, ']',  '\0')
+#define ECK_BRACE       3   // parse_to_lite(p, '}',  '\0')
+#define ECK_FUNC        4   // Function name ending at p.
+#define ECK_FUNC_TRIM   5   // Function name ending at p, spaces trimmed.
+
+typedef struct
+{
+    UINT32  key;        // ((offset << 3) | kind) + 1, or 0 when unused.
+    UINT32  value;      // (nLen << 2) | iWhichDelim, or the name length.
+    UINT32  generation; // mudstate.func_generation when pFunc was found.
+    bool    bUser;      // pFunc is a UFUN rather than a FUN.
+    void   *pFunc;
+} ECACHE_SLOT;
+
+typedef struct
+{
+    UINT32       nHash;
+    UINT32       nMissHash; // Hash of the last string not admitted.
+    size_t       nText;
+    UTF8        *pText;
+    int          nActive;   // Evaluations currently using this entry.
+    UINT32       nSlots;    // Zero or a power of two.
+    UINT32       nUsed;
+    ECACHE_SLOT *aSlots;
+} ECACHE_ENT;
+
+static ECACHE_ENT aECache[ECACHE_SIZE];
+
+// The string currently being evaluated and its entry (if any).
+//
+static const UTF8 *pECacheText = nullptr;
+static size_t      nECacheText = 0;
+static ECACHE_ENT *pECacheEnt  = nullptr;
+
+static UINT32 ecache_hash(const UTF8 *p, size_t n)
+{
+    UINT64 h = n * UINT64_C(0x9E3779B97F4A7C15);
+    while (sizeof(UINT64) <= n)
+    {
+        UINT64 w;
+        memcpy(&w, p, sizeof(w));
+        h = (h ^ w) * UINT64_C(0xFF51AFD7ED558CCD);
+        h ^= h >> 32;
+        p += sizeof(UINT64);
+        n -= sizeof(UINT64);
+    }
+    while (0 < n)
+    {
+        h = (h ^ *p++) * UINT64_C(0xC4CEB9FE1A85EC53);
+        n--;
+    }
+    h ^= h >> 29;
+    return static_cast<UINT32>(h);
+}
+
+static ECACHE_SLOT *ecache_probe(ECACHE_ENT *pe, UINT32 key)
+{
+    UINT32 mask = pe->nSlots - 1;
+    UINT32 i = (key * 2654435761U) & mask;
+    while (  0 != pe->aSlots[i].key
+          && key != pe->aSlots[i].key)
+    {
+        i = (i + 1) & mask;
+    }
+    return pe->aSlots + i;
+}
+
+static UINT32 ecache_key(const UTF8 *p, int kind)
+{
+    return ((static_cast<UINT32>(p - pECacheText) << 3) | kind) + 1;
+}
+
+static ECACHE_SLOT *ecache_get(const UTF8 *p, int kind)
+{
+    ECACHE_ENT *pe = pECacheEnt;
+    if (  nullptr == pe
+       || 0 == pe->nSlots)
+    {
+        return nullptr;
+    }
+
+    ECACHE_SLOT *ps = ecache_probe(pe, ecache_key(p, kind));
+    return (0 == ps->key) ? nullptr : ps;
+}
+
+static ECACHE_SLOT *ecache_put(const UTF8 *p, int kind)
+{
+    ECACHE_ENT *pe = pECacheEnt;
+    if (nullptr == pe)
+    {
+        return nullptr;
+    }
+
+    if (pe->nSlots <= 2*(pe->nUsed + 1))
+    {
+        // Keep the table at most half full.
+        //
+        UINT32 nOld = pe->nSlots;
+        ECACHE_SLOT *aOld = pe->aSlots;
+        pe->nSlots = (0 == nOld) ? 16 : 2*nOld;
+        pe->aSlots = (ECACHE_SLOT *)MEMALLOC(pe->nSlots * sizeof(ECACHE_SLOT));
+        ISOUTOFMEMORY(pe->aSlots);
+        memset(pe->aSlots, 0, pe->nSlots * sizeof(ECACHE_SLOT));
+        for (UINT32 i = 0; i < nOld; i++)
+        {
+            if (0 != aOld[i].key)
+            {
+                *ecache_probe(pe, aOld[i].key) = aOld[i];
+            }
+        }
+        if (nullptr != aOld)
+        {
+            MEMFREE(aOld);
+        }
+    }
+
+    UINT32 key = ecache_key(p, kind);
+    ECACHE_SLOT *ps = ecache_probe(pe, key);
+    if (0 == ps->key)
+    {
+        ps->key = key;
+        pe->nUsed++;
+    }
+    return ps;
+}
+
+// Make pStr the current string unless it is part of the current string
+// already. The previous state is returned through the arguments so that
+// ecache_leave() can restore it.
+//
+static void ecache_enter(const UTF8 *pStr, const UTF8 **ppText, size_t *pnText,
+    ECACHE_ENT **ppe)
+{
+    *ppText = pECacheText;
+    *pnText = nECacheText;
+    *ppe    = pECacheEnt;
+
+    if (  nullptr != pECacheText
+       && pECacheText <= pStr
+       && pStr < pECacheText + nECacheText)
+    {
+        return;
+    }
+
+    size_t nText = strlen((const char *)pStr);
+    pECacheText = pStr;
+    nECacheText = nText;
+    pECacheEnt  = nullptr;
+
+    if (LBUF_SIZE <= nText)
+    {
+        return;
+    }
+
+    UINT32 nHash = ecache_hash(pStr, nText);
+    ECACHE_ENT *pe = aECache + (nHash & (ECACHE_SIZE - 1));
+    if (  nullptr == pe->pText
+       || pe->nHash != nHash
+       || pe->nText != nText
+       || 0 != memcmp(pe->pText, pStr, nText))
+    {
+        if (  0 < pe->nActive
+           || pe->nMissHash != nHash)
+        {
+            pe->nMissHash = nHash;
+            return;
+        }
+
+        if (nullptr != pe->pText)
+        {
+            MEMFREE(pe->pText);
+        }
+        if (nullptr != pe->aSlots)
+        {
+            MEMFREE(pe->aSlots);
+        }
+        pe->pText = StringCloneLen(pStr, nText);
+        pe->nHash  = nHash;
+        pe->nText  = nText;
+        pe->nSlots = 0;
+        pe->nUsed  = 0;
+        pe->aSlots = nullptr;
+    }
+    pe->nActive++;
+    pECacheEnt = pe;
+}
+
+static void ecache_leave(const UTF8 *pText, size_t nText, ECACHE_ENT *pe)
+{
+    if (  pECacheText != pText
+       && nullptr != pECacheEnt)
+    {
+        pECacheEnt->nActive--;
+    }
+    pECacheText = pText;
+    nECacheText = nText;
+    pECacheEnt  = pe;
+}
+
+static const UTF8 *parse_to_compiled(const UTF8 *dstr, int kind, size_t *nLen,
+    int *iWhichDelim)
+{
+    static const UTF8 delims[4][2] =
+    {
+        { ',',  ')'  },
+        { '\0', ')'  },
+        { ']',  '\0' },
+        { '}',  '\0' }
+    };
+
+    if (  nullptr == dstr
+       || '\0' == dstr[0])
+    {
+        return parse_to_lite(dstr, delims[kind][0], delims[kind][1], nLen,
+            iWhichDelim);
+    }
+
+    ECACHE_SLOT *ps = ecache_get(dstr, kind);
+    if (nullptr != ps)
+    {
+        *nLen = ps->value >> 2;
+        *iWhichDelim = ps->value & 3;
+        return (0 == *iWhichDelim) ? nullptr : dstr + *nLen + 1;
+    }
+
+    const UTF8 *rstr = parse_to_lite(dstr, delims[kind][0], delims[kind][1],
+        nLen, iWhichDelim);
+    ps = ecache_put(dstr, kind);
+    if (nullptr != ps)
+    {
+        ps->value = static_cast<UINT32>(*nLen << 2) | *iWhichDelim;
+    }
+    return rstr;
+}
+
 //-----------------------------------------------------------------------------
 // parse_arglist: Parse a line into an argument list contained in lbufs. A
 // pointer is returned to whatever follows the final delimiter. If the arglist
@@ -794,11 +1049,11 @@ static const UTF8 *parse_arglist_lite( dbref executor, dbref caller, dbref enact
         pCurr = pNext;
         if (arg < nfargs - 1)
         {
-            pNext = parse_to_lite(pCurr, ',', ')', &nLen, &iWhichDelim);
+            pNext = parse_to_compiled(pCurr, ECK_ARG, &nLen, &iWhichDelim);
         }
         else
         {
-            pNext = parse_to_lite(pCurr, '\0', ')', &nLen, &iWhichDelim);
+            pNext = parse_to_compiled(pCurr, ECK_LASTARG, &nLen, &iWhichDelim);
         }
 
         // The following recognizes and returns zero arguments. We avoid
@@ -1325,6 +1580,13 @@ void mux_exec( const UTF8 *pStr, size_t nStr, UTF8 *buff, UTF8 **bufc, dbref exe
         mux_strncpy(savestr, pStr, nStr);
     }
 
+    // Find the compiled form of this string.
+    //
+    const UTF8 *pECacheTextSave;
+    size_t      nECacheTextSave;
+    ECACHE_ENT *pECacheEntSave;
+    ecache_enter(pStr, &pECacheTextSave, &nECacheTextSave, &pECacheEntSave);
+
     // Save Parser Mode.
     //
     bool bSpaceIsSpecialSave = isSpecial(L1, ' ');
@@ -1398,52 +1660,88 @@ void mux_exec( const UTF8 *pStr, size_t nStr, UTF8 *buff, UTF8 **bufc, dbref exe
             // execute it if we should.
             //
             at_space = 0;
+            fp = nullptr;
+            ufp = nullptr;
 
-            // Load an sbuf with an lowercase version of the func name, and
-            // see if the func exists. Trim trailing spaces from the name if
-            // configured.
+            // If the name was copied straight from the string, the compiled
+            // form may already know which function it is.
             //
-            UTF8 *pEnd = *bufc - 1;
-            if (mudconf.space_compress && (eval & EV_FMAND))
+            bool bTrim = mudconf.space_compress && (eval & EV_FMAND);
+            int  iFunKind = bTrim ? ECK_FUNC_TRIM : ECK_FUNC;
+            bool bLiteral =  static_cast<size_t>(*bufc - oldp) == iStr
+                          && 0 == memcmp(oldp, pStr, iStr);
+            ECACHE_SLOT *ps = bLiteral ? ecache_get(pStr + iStr, iFunKind) : nullptr;
+            if (  nullptr != ps
+               && iStr == ps->value
+               && mudstate.func_generation == ps->generation)
             {
-                while (  oldp <= pEnd
-                      && mux_isspace(*pEnd))
+                if (ps->bUser)
+                {
+                    ufp = (UFUN *)ps->pFunc;
+                }
+                else
                 {
-                    pEnd--;
+                    fp = (FUN *)ps->pFunc;
                 }
             }
-
-            fp = nullptr;
-            ufp = nullptr;
-
-            size_t nFun = 0;
-            if (oldp <= pEnd)
+            else
             {
-                nFun = pEnd - oldp + 1;
-                if (LBUF_SIZE <= nFun)
+                // Load an sbuf with an lowercase version of the func name, and
+                // see if the func exists. Trim trailing spaces from the name if
+                // configured.
+                //
+                UTF8 *pEnd = *bufc - 1;
+                if (bTrim)
                 {
-                    nFun = LBUF_SIZE - 1;
+                    while (  oldp <= pEnd
+                          && mux_isspace(*pEnd))
+                    {
+                        pEnd--;
+                    }
                 }
 
-                // _strlwr();
-                //
-                for (size_t iFun = 0; iFun < nFun; iFun++)
+                size_t nFun = 0;
+                if (oldp <= pEnd)
                 {
-                    mux_scratch[iFun] = mux_toupper_ascii(oldp[iFun]);
+                    nFun = pEnd - oldp + 1;
+                    if (LBUF_SIZE <= nFun)
+                    {
+                        nFun = LBUF_SIZE - 1;
+                    }
+
+                    // _strlwr();
+                    //
+                    for (size_t iFun = 0; iFun < nFun; iFun++)
+                    {
+                        mux_scratch[iFun] = mux_toupper_ascii(oldp[iFun]);
+                    }
                 }
-            }
-            mux_scratch[nFun] = '\0';
+                mux_scratch[nFun] = '\0';
 
-            if (  0 < nFun
-               && nFun <= MAX_UFUN_NAME_LEN)
-            {
-                fp = (FUN *)hashfindLEN(mux_scratch, nFun, &mudstate.func_htab);
+                if (  0 < nFun
+                   && nFun <= MAX_UFUN_NAME_LEN)
+                {
+                    fp = (FUN *)hashfindLEN(mux_scratch, nFun, &mudstate.func_htab);
 
-                // If not a builtin func, check for global func.
-                //
-                if (nullptr == fp)
+                    // If not a builtin func, check for global func.
+                    //
+                    if (nullptr == fp)
+                    {
+                        ufp = (UFUN *)hashfindLEN(mux_scratch, nFun, &mudstate.ufunc_htab);
+                    }
+                }
+
+                if (  bLiteral
+                   && (fp || ufp))
                 {
-                    ufp = (UFUN *)hashfindLEN(mux_scratch, nFun, &mudstate.ufunc_htab);
+                    ps = ecache_put(pStr + iStr, iFunKind);
+                    if (nullptr != ps)
+                    {
+                        ps->value = static_cast<UINT32>(iStr);
+                        ps->generation = mudstate.func_generation;
+                        ps->bUser = (nullptr != ufp);
+                        ps->pFunc = ufp ? (void *)ufp : (void *)fp;
+                    }
                 }
             }
 
@@ -2225,7 +2523,7 @@ void mux_exec( const UTF8 *pStr, size_t nStr, UTF8 *buff, UTF8 **bufc, dbref exe
             // continue.
             //
             mudstate.nStackNest++;
-            tstr = parse_to_lite(pStr + iStr + 1, ']', '\0', &n, &at_space);
+            tstr = parse_to_compiled(pStr + iStr + 1, ECK_BRACKET, &n, &at_space);
             at_space = 0;
             if (tstr == nullptr)
             {
@@ -2280,7 +2578,7 @@ void mux_exec( const UTF8 *pStr, size_t nStr, UTF8 *buff, UTF8 **bufc, dbref exe
             // continue.
             //
             mudstate.nStackNest++;
-            tstr = parse_to_lite(pStr + iStr + 1, '}', '\0', &n, &at_space);
+            tstr = parse_to_compiled(pStr + iStr + 1, ECK_BRACE, &n, &at_space);
             at_space = 0;
             if (nullptr == tstr)
             {
@@ -2431,6 +2729,8 @@ void mux_exec( const UTF8 *pStr, size_t nStr, UTF8 *buff, UTF8 **bufc, dbref exe
         *bufc = buff + nPos;
     }
 
+    ecache_leave(pECacheTextSave, nECacheTextSave, pECacheEntSave);
+
     // Restore Parser Mode.
     //
     isSpecial(L1, ' ') = bSpaceIsSpecialSave;
@@ -124,13 +124,14 @@ LBUF_OFFSET trimmed_name(dbref player, UTF8 cbuff[MBUF_SIZE], LBUF_OFFSET nMin,
 /* From cque.cpp */
 int  nfy_que(dbref, int, int, int);
 int  halt_que(dbref, dbref);
+void chown_que(dbref);
 void wait_que(dbref executor, dbref caller, dbref enactor, int, bool,
     CLinearTimeAbsolute&, dbref, int, UTF8 *, int, const UTF8 *[], reg_ref *[]);
 void query_complete(UINT32 hQuery, UINT32 iError, CResultsSet *prs);
 
-#if defined(UNIX_CRYPT)
+#if defined(UNIX_CRYPT) && !defined(HAVE_CRYPT_H)
 extern "C" char *crypt(const char *inptr, const char *inkey);
-#endif // UNIX_CRYPT
+#endif // UNIX_CRYPT && !HAVE_CRYPT_H
 extern bool break_called;
 
 /* From eval.cpp */
@@ -257,6 +258,16 @@ bool regexp_match
     int nargs
 );
 
+struct real_pcre;
+struct pcre_extra;
+const struct real_pcre *regexp_compile_cached
+(
+    const UTF8 *pattern,
+    int options,
+    const struct pcre_extra **study,
+    const char **errptr
+);
+
 bool list_check
 (
     dbref thing,
@@ -276,6 +287,7 @@ bool html_escape(const UTF8 *src, UTF8 *dest, UTF8 **destp);
 #define NUM_DUMP_TYPES   5
 void dump_database_internal(int);
 void fork_and_dump(int key);
+void dump_checkpoint(void);
 
 #define MUX_OPEN_INVALID_HANDLE_VALUE (-1)
 bool mux_fopen(FILE **pFile, const UTF8 *filename, const UTF8 *mode);
@@ -298,6 +310,9 @@ void log_name_and_loc(dbref);
 void log_type_and_name(dbref);
 
 #define SIZEOF_LOG_BUFFER 1024
+#if defined(UNIX_THREADS)
+class CLogWriter;
+#endif // UNIX_THREADS
 class CLogFile
 {
 private:
@@ -318,8 +333,18 @@ private:
     UTF8 *m_pBasename;
     UTF8 m_szPrefix[32];
     UTF8 m_szFilename[SIZEOF_PATHNAME];
+#if defined(UNIX_THREADS)
+    CLogWriter *m_pWriter;
+    size_t m_nPending;
+    bool m_bWriteThrough;
+
+    bool WriteBehind(void);
+    void HandOff(void);
+    void StopWriter(void);
+#endif // UNIX_THREADS
 
     bool CreateLogFile(void);
+    void RotateLogFile(void);
     void AppendLogFile(void);
     void CloseLogFile(void);
 public:
@@ -330,6 +355,11 @@ public:
     void WriteInteger(int iNumber);
     void DCL_CDECL tinyprintf(const UTF8 *pFormatSpec, ...);
     void Flush(void);
+    void WriteThrough(void);
+    void Tick(void);
+#if defined(UNIX_THREADS)
+    void AfterFork(void);
+#endif // UNIX_THREADS
     void SetPrefix(const UTF8 *pPrefix);
     void SetBasename(const UTF8 *pBasename);
     void StartLogging(void);
@@ -377,6 +407,12 @@ void badname_remove(UTF8 *);
 bool badname_check(UTF8 *);
 void badname_list(dbref, const UTF8 *);
 void ChangePassword(dbref player, const UTF8 *szPassword);
+typedef void PASS_CALLBACK(dbref player, bool bValid, void *pContext, int iContext);
+void ChangePasswordLater(dbref player, const UTF8 *szPassword, PASS_CALLBACK *pfDone, void *pContext, int iContext);
+void check_pass_later(dbref player, const UTF8 *pPassword, const UTF8 *pNewPassword, PASS_CALLBACK *pfDone, void *pContext, int iContext);
+#if defined(UNIX_THREADS)
+void pass_reap(void);
+#endif // UNIX_THREADS
 const UTF8 *mux_crypt(const UTF8 *szPassword, const UTF8 *szSalt, int *piType);
 int  QueueMax(dbref);
 int  a_Queue(dbref, int);
@@ -455,6 +491,8 @@ void SetClearFlags(dbref thing, FLAG aClearFlags[3], FLAG aSetFlags[3]);
 bool eval_boolexp(dbref, dbref, dbref, BOOLEXP *);
 BOOLEXP *parse_boolexp(dbref, const UTF8 *, bool);
 bool eval_boolexp_atr(dbref, dbref, dbref, UTF8 *);
+bool eval_boolexp_lock(dbref, dbref, dbref, int);
+void lock_cache_clear(dbref, int);
 
 /* From functions.cpp */
 bool xlate(UTF8 *);
@@ -481,9 +519,12 @@ dbref olist_first(void);
 dbref olist_next(void);
 
 /* From wild.cpp */
+size_t wild_compile(const UTF8 *, UTF8 *, size_t);
+bool wild_compiled(const UTF8 *, const UTF8 *, UTF8 *[], int);
 bool wild(UTF8 *, UTF8 *, UTF8 *[], int);
 bool wild_match(UTF8 *, const UTF8 *);
 bool quick_wild(const UTF8 *, const UTF8 *);
+bool quick_wild_compiled(const UTF8 *, const UTF8 *);
 
 /* From command.cpp */
 bool check_access(dbref player, int mask);
@@ -618,6 +659,7 @@ extern int anum_alc_top;
 #define DUMP_STRUCT     1   /* Dump flat structure file */
 #define DUMP_TEXT       2   /* Dump to external attribute database. */
 #define DUMP_FLATFILE   4   /* Dump .FLAT file */
+#define DUMP_COMPACT    8   // Compact the attribute page file.
 #define EDIT_CHANNEL_CCHOWN   0  /* @cchown */
 #define EDIT_CHANNEL_CCHARGE  1  /* @ccharge */
 #define EDIT_CHANNEL_CPFLAGS  2  /* @cpflags */
@@ -1047,20 +1089,31 @@ void dispatch_KeepAlive(void *pUnused, int iUnused);
 #ifndef MEMORY_BASED
 void dispatch_CacheTick(void *pUnused, int iUnused);
 #endif
+void dispatch_LogFlush(void *pUnused, int iUnused);
 
-// Using a heap as the data structure for representing this priority
-// has some attributes which we depend on:
+// Timed tasks wait in a hierarchical timing wheel, and tasks which are ready
+// to run wait in a heap ordered by priority.  The combination has some
+// attributes which we depend on:
 //
 // 1. Most importantly, actions scheduled for the same time (i.e.,
-//    immediately) keep the order that they were inserted into the
-//    heap.
+//    immediately) keep the order that they were inserted.  The wheel does
+//    not order tasks within a slot, so this is guaranteed by the ticket
+//    which breaks ties in the priority heap.
+//
+// 2. DeferTask() returns a handle which CancelTask() can use to remove the
+//    task without searching.  A handle is only good until the task runs or
+//    is cancelled.
 //
 // If you ever re-implement this object using another data structure,
-// please remember to maintain this property.
+// please remember to maintain these properties.
 //
 typedef void FTASK(void *, int);
 
-typedef struct
+#define TASK_IN_NONE  0
+#define TASK_IN_WHEEL 1
+#define TASK_IN_HEAP  2
+
+typedef struct task_record
 {
     CLinearTimeAbsolute ltaWhen;
 
@@ -1069,7 +1122,10 @@ typedef struct
     FTASK      *fpTask;
     void       *arg_voidptr;
     int        arg_Integer;
-    int        m_iVisitedMark;
+    int        m_iWhere;        // TASK_IN_WHEEL, TASK_IN_HEAP, or TASK_IN_NONE.
+    int        m_iIndex;        // Wheel slot or heap position.
+    struct task_record *m_pNext;    // Other tasks in the same wheel slot.
+    struct task_record *m_pPrev;
 } TASK_RECORD, *PTASK_RECORD;
 
 #define PRIORITY_SYSTEM  100
@@ -1092,15 +1148,11 @@ private:
     int m_nCurrent;
     PTASK_RECORD *m_pHeap;
 
-    int m_iVisitedMark;
-
     bool Grow(void);
+    void Place(int, PTASK_RECORD);
     void SiftDown(int, SCHCMP *);
     void SiftUp(int, SCHCMP *);
     PTASK_RECORD Remove(int, SCHCMP *);
-    void Update(int iNode, SCHCMP *pfCompare);
-    void Sort(SCHCMP *pfCompare);
-    void Remake(SCHCMP *pfCompare);
 
 public:
     CTaskHeap();
@@ -1110,36 +1162,87 @@ public:
     bool Insert(PTASK_RECORD, SCHCMP *);
     PTASK_RECORD PeekAtTopmost(void);
     PTASK_RECORD RemoveTopmost(SCHCMP *);
+    void Remove(PTASK_RECORD, SCHCMP *);
+    void Update(PTASK_RECORD, SCHCMP *);
     void CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer);
+    int  Count(void) { return m_nCurrent; }
+    int  Collect(PTASK_RECORD *aTasks);
+};
+
+// The wheel has one level of 256 slots, each WHEEL_TICK wide (about 13ms),
+// followed by four levels of 64 slots, each 64 times coarser than the one
+// before.  Together, they reach about 1.8 years ahead.  Tasks further out
+// than that are kept in the last slot which can reach them, and they are
+// re-filed whenever that slot comes due.
+//
+#define WHEEL_TICK_SHIFT  17
+#define WHEEL_LEVEL0_BITS 8
+#define WHEEL_LEVELN_BITS 6
+#define WHEEL_LEVELS      5
+#define WHEEL_LEVEL0_SIZE (1 << WHEEL_LEVEL0_BITS)
+#define WHEEL_LEVELN_SIZE (1 << WHEEL_LEVELN_BITS)
+#define WHEEL_SLOTS       (WHEEL_LEVEL0_SIZE + (WHEEL_LEVELS-1)*WHEEL_LEVELN_SIZE)
+
+class CTaskWheel
+{
+private:
+    INT64 m_tCurrent;           // The tick not yet completely expired.
+    INT64 m_tCascaded;          // The tick for which cascading was done.
+    int   m_nTasks;
+    int   m_anLevel[WHEEL_LEVELS];
+    PTASK_RECORD m_aSlots[WHEEL_SLOTS];
+
+    void Place(PTASK_RECORD);
+    void Cascade(int iLevel, int iIndex);
+    void Skip(INT64 tNow);
+
+public:
+    CTaskWheel();
+    ~CTaskWheel();
+
+    void Insert(PTASK_RECORD);
+    void Remove(PTASK_RECORD);
+    PTASK_RECORD Expire(const CLinearTimeAbsolute& ltaNow);
+    bool WhenNext(CLinearTimeAbsolute *);
+    void CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer, bool bDelete);
+    int  Count(void) { return m_nTasks; }
+    int  Collect(PTASK_RECORD *aTasks);
+};
 
 #define IU_DONE        0
 #define IU_NEXT_TASK   1
 #define IU_REMOVE_TASK 2
 #define IU_UPDATE_TASK 3
-    int TraverseUnordered(SCHLOOK *pfLook, SCHCMP *pfCompare);
-    int TraverseOrdered(SCHLOOK *pfLook, SCHCMP *pfCompare);
-};
 
 class CScheduler
 {
 private:
-    CTaskHeap m_WhenHeap;
-    CTaskHeap m_PriorityHeap;
-    int       m_Ticket;
-    int       m_minPriority;
+    CTaskWheel m_WhenWheel;
+    CTaskHeap  m_PriorityHeap;
+    int        m_Ticket;
+    int        m_minPriority;
+    int        m_nTraversing;
+
+    PTASK_RECORD NewTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer);
+    PTASK_RECORD *Snapshot(bool bOrdered, int *pnTasks);
+    void Traverse(SCHLOOK *pfLook, bool bOrdered);
+    void Discard(PTASK_RECORD pTask);
 
 public:
     void TraverseUnordered(SCHLOOK *pfLook);
     void TraverseOrdered(SCHLOOK *pfLook);
-    CScheduler(void) { m_Ticket = 0; m_minPriority = PRIORITY_CF_DEQUEUE_ENABLED; }
-    void DeferTask(const CLinearTimeAbsolute& ltWhen, int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer);
-    void DeferImmediateTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer);
+    CScheduler(void) { m_Ticket = 0; m_minPriority = PRIORITY_CF_DEQUEUE_ENABLED; m_nTraversing = 0; }
+    PTASK_RECORD DeferTask(const CLinearTimeAbsolute& ltWhen, int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer);
+    PTASK_RECORD DeferImmediateTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer);
     bool WhenNext(CLinearTimeAbsolute *);
     int  RunTasks(int iCount);
     int  RunAllTasks(void);
     int  RunTasks(const CLinearTimeAbsolute& tNow);
     void ReadyTasks(const CLinearTimeAbsolute& tNow);
     void CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer);
+    void CancelTask(PTASK_RECORD pTask);
+    void UpdateTask(PTASK_RECORD pTask);
+    void Sort(PTASK_RECORD *aTasks, int nTasks);
     void Shrink(void);
 
     void SetMinPriority(int arg_minPriority);
@@ -40,19 +40,26 @@ FUNCTION(fun_grab)
         return;
     }
 
+    UTF8 *pCompiled = alloc_lbuf("fun_grab");
+    if (0 == wild_compile(fargs[1], pCompiled, LBUF_SIZE))
+    {
+        free_lbuf(pCompiled);
+        return;
+    }
+
     // Walk the wordstring, until we find the word we want.
     //
     UTF8 *s = trim_space_sep(fargs[0], sep);
     do
     {
         UTF8 *r = split_token(&s, sep);
-        mudstate.wild_invk_ctr = 0;
-        if (quick_wild(fargs[1], r))
+        if (quick_wild_compiled(pCompiled, r))
         {
             safe_str(r, buff, bufc);
-            return;
+            break;
         }
     } while (s);
+    free_lbuf(pCompiled);
 }
 
 FUNCTION(fun_graball)
@@ -68,13 +75,19 @@ FUNCTION(fun_graball)
         return;
     }
 
+    UTF8 *pCompiled = alloc_lbuf("fun_graball");
+    if (0 == wild_compile(fargs[1], pCompiled, LBUF_SIZE))
+    {
+        free_lbuf(pCompiled);
+        return;
+    }
+
     bool bFirst = true;
     UTF8 *s = trim_space_sep(fargs[0], sep);
     do
     {
         UTF8 *r = split_token(&s, sep);
-        mudstate.wild_invk_ctr = 0;
-        if (quick_wild(fargs[1], r))
+        if (quick_wild_compiled(pCompiled, r))
         {
             if (!bFirst)
             {
@@ -87,6 +100,7 @@ FUNCTION(fun_graball)
             safe_str(r, buff, bufc);
         }
     } while (s);
+    free_lbuf(pCompiled);
 }
 
 /* ---------------------------------------------------------------------------
@@ -581,13 +595,15 @@ FUNCTION(fun_matchall)
     // Check each word individually, returning the word number of all that
     // match. If none match, return 0.
     //
+    UTF8 *pCompiled = alloc_lbuf("fun_matchall");
+    bool bCompiled = (0 != wild_compile(fargs[1], pCompiled, LBUF_SIZE));
     wcount = 1;
     s = trim_space_sep(fargs[0], sep);
     do
     {
         r = split_token(&s, sep);
-        mudstate.wild_invk_ctr = 0;
-        if (quick_wild(fargs[1], r))
+        if (  bCompiled
+           && quick_wild_compiled(pCompiled, r))
         {
             mux_ltoa(wcount, tbuf);
             if (old != *bufc)
@@ -598,6 +614,7 @@ FUNCTION(fun_matchall)
         }
         wcount++;
     } while (s);
+    free_lbuf(pCompiled);
 
     if (*bufc == old)
     {
@@ -2242,15 +2259,15 @@ static void real_regmatch(const UTF8 *search, const UTF8 *pattern, UTF8 *registe
     }
 
     const char *errptr;
-    int erroffset;
     // To capture N substrings, you need space for 3(N+1) offsets in the
     // offset vector. We'll allow 2N-1 substrings and possibly ignore some.
     //
     const int ovecsize = 6 * MAX_GLOBAL_REGS;
     int ovec[ovecsize];
 
-    pcre *re = pcre_compile((char *)pattern, PCRE_UTF8|(cis ? PCRE_CASELESS : 0),
-        &errptr, &erroffset, nullptr);
+    const pcre_extra *study;
+    const pcre *re = regexp_compile_cached(pattern, cis ? PCRE_CASELESS : 0,
+        &study, &errptr);
     if (!re)
     {
         // Matching error.
@@ -2260,7 +2277,7 @@ static void real_regmatch(const UTF8 *search, const UTF8 *pattern, UTF8 *registe
         return;
     }
 
-    int matches = pcre_exec(re, nullptr, (char *)search, static_cast<int>(strlen((char *)search)), 0, 0,
+    int matches = pcre_exec(re, study, (char *)search, static_cast<int>(strlen((char *)search)), 0, 0,
         ovec, ovecsize);
     if (matches == 0)
     {
@@ -2279,7 +2296,6 @@ static void real_regmatch(const UTF8 *search, const UTF8 *pattern, UTF8 *registe
     //
     if (nfargs != 3)
     {
-        MEMFREE(re);
         return;
     }
 
@@ -2313,7 +2329,6 @@ static void real_regmatch(const UTF8 *search, const UTF8 *pattern, UTF8 *registe
             free_lbuf(p);
         }
     }
-    MEMFREE(re);
 }
 
 FUNCTION(fun_regmatch)
@@ -2355,18 +2370,17 @@ static void real_regrab(__in UTF8 *search, __in const UTF8 *pattern, __in const
     {
         return;
     }
-    pcre *re;
-    pcre_extra *study = nullptr;
+    const pcre *re;
+    const pcre_extra *study;
     const char *errptr;
-    int erroffset;
     // To capture N substrings, you need space for 3(N+1) offsets in the
     // offset vector. We'll allow 2N-1 substrings and possibly ignore some.
     //
     const int ovecsize = 6 * MAX_GLOBAL_REGS;
     int ovec[ovecsize];
 
-    re = pcre_compile((char *)pattern, PCRE_UTF8|(cis ? PCRE_CASELESS : 0),
-        &errptr, &erroffset, nullptr);
+    re = regexp_compile_cached(pattern, cis ? PCRE_CASELESS : 0, &study,
+        &errptr);
     if (!re)
     {
         // Matching error.
@@ -2376,11 +2390,6 @@ static void real_regrab(__in UTF8 *search, __in const UTF8 *pattern, __in const
         return;
     }
 
-    if (all)
-    {
-        study = pcre_study(re, 0, &errptr);
-    }
-
     bool first = true;
     UTF8 *s = trim_space_sep(search, sep);
     do
@@ -2404,12 +2413,6 @@ static void real_regrab(__in UTF8 *search, __in const UTF8 *pattern, __in const
             }
         }
     } while (s);
-
-    MEMFREE(re);
-    if (study)
-    {
-        MEMFREE(study);
-    }
 }
 
 FUNCTION(fun_regrab)
@@ -3131,18 +3131,23 @@ static FUNCTION(fun_match)
     // Check each word individually, returning the word number of the first
     // one that matches.  If none match, return 0.
     //
-    int wcount = 1;
-    UTF8 *s = trim_space_sep(fargs[0], sep);
-    do {
-        UTF8 *r = split_token(&s, sep);
-        mudstate.wild_invk_ctr = 0;
-        if (quick_wild(fargs[1], r))
-        {
-            safe_ltoa(wcount, buff, bufc);
-            return;
-        }
-        wcount++;
-    } while (s);
+    UTF8 *pCompiled = alloc_lbuf("fun_match");
+    if (0 != wild_compile(fargs[1], pCompiled, LBUF_SIZE))
+    {
+        int wcount = 1;
+        UTF8 *s = trim_space_sep(fargs[0], sep);
+        do {
+            UTF8 *r = split_token(&s, sep);
+            if (quick_wild_compiled(pCompiled, r))
+            {
+                free_lbuf(pCompiled);
+                safe_ltoa(wcount, buff, bufc);
+                return;
+            }
+            wcount++;
+        } while (s);
+    }
+    free_lbuf(pCompiled);
     safe_chr('0', buff, bufc);
 }
 
@@ -3158,7 +3163,6 @@ static FUNCTION(fun_strmatch)
 
     // Check if we match the whole string.  If so, return 1.
     //
-    mudstate.wild_invk_ctr = 0;
     bool cc = quick_wild(fargs[1], fargs[0]);
     safe_bool(cc, buff, bufc);
 }
@@ -11425,6 +11429,7 @@ void function_add(FUN *fp)
     if (nullptr == hashfindLEN(pCased, nCased, &mudstate.func_htab))
     {
         hashaddLEN(pCased, nCased, fp, &mudstate.func_htab);
+        mudstate.func_generation++;
     }
 }
 
@@ -11433,6 +11438,7 @@ void function_remove(FUN *fp)
     size_t nCased;
     UTF8 *pCased = mux_strupr(fp->name, nCased);
     hashdeleteLEN(pCased, nCased, &mudstate.func_htab);
+    mudstate.func_generation++;
 }
 
 void functions_add(FUN funlist[])
@@ -11592,6 +11598,7 @@ void do_function
                 }
             }
             hashdeleteLEN(pName, nLen, &mudstate.ufunc_htab);
+            mudstate.func_generation++;
             delete ufp;
             notify_quiet(executor, tprintf(T("Function %s deleted."), pName));
         }
@@ -11670,6 +11677,7 @@ void do_function
             ufp2->next = ufp;
         }
         hashaddLEN(pName, nLen, ufp, &mudstate.ufunc_htab);
+        mudstate.func_generation++;
     }
     ufp->obj = obj;
     ufp->atr = pattr->number;
@@ -38,6 +38,16 @@ void do_dump(dbref executor, dbref caller, dbref enactor, int eval, int key)
     UNUSED_PARAMETER(enactor);
     UNUSED_PARAMETER(eval);
 
+    if (key & DUMP_COMPACT)
+    {
+#ifdef MEMORY_BASED
+        notify(executor, T("Database is memory based."));
+#else // MEMORY_BASED
+        cache_compact(executor);
+#endif // MEMORY_BASED
+        return;
+    }
+
 #if defined(HAVE_WORKING_FORK)
     if (mudstate.dumping)
     {
@@ -73,6 +83,180 @@ void report(void)
     }
 }
 
+/* ----------------------------------------------------------------------
+ * Compiled regular expression cache.
+ *
+ * regmatch(), regrab(), regexp $-commands, and regexp FILTERs tend to use
+ * the same few patterns over and over.  Compiled and studied patterns are
+ * kept in regexp_htab keyed by options and pattern text, and the least
+ * recently used one is discarded when there are more than REGEXP_CACHE_SIZE.
+ * The Del column for Regexps in @list hashstats counts those evictions.
+ */
+
+#define REGEXP_CACHE_SIZE   128
+#define REGEXP_CACHE_KEY    (SBUF_SIZE * 4)
+
+typedef struct regexp_entry
+{
+    struct regexp_entry *pPrev;     // More recently used.
+    struct regexp_entry *pNext;     // Less recently used.
+    pcre       *re;
+    pcre_extra *study;
+    size_t      nKey;
+    UTF8       *pKey;
+} REGEXP_ENTRY;
+
+static REGEXP_ENTRY *pRegexpMRU = nullptr;
+static REGEXP_ENTRY *pRegexpLRU = nullptr;
+static int           nRegexps   = 0;
+
+// A pattern too long to cache is held here until the next call.
+//
+static REGEXP_ENTRY  reUncached = { nullptr, nullptr, nullptr, nullptr, 0, nullptr };
+
+static void regexp_entry_release(REGEXP_ENTRY *pre)
+{
+    if (nullptr != pre->re)
+    {
+        MEMFREE(pre->re);
+        pre->re = nullptr;
+    }
+    if (nullptr != pre->study)
+    {
+        MEMFREE(pre->study);
+        pre->study = nullptr;
+    }
+}
+
+static void regexp_unlink(REGEXP_ENTRY *pre)
+{
+    if (nullptr == pre->pPrev)
+    {
+        pRegexpMRU = pre->pNext;
+    }
+    else
+    {
+        pre->pPrev->pNext = pre->pNext;
+    }
+
+    if (nullptr == pre->pNext)
+    {
+        pRegexpLRU = pre->pPrev;
+    }
+    else
+    {
+        pre->pNext->pPrev = pre->pPrev;
+    }
+}
+
+static void regexp_push(REGEXP_ENTRY *pre)
+{
+    pre->pPrev = nullptr;
+    pre->pNext = pRegexpMRU;
+    if (nullptr == pRegexpMRU)
+    {
+        pRegexpLRU = pre;
+    }
+    else
+    {
+        pRegexpMRU->pPrev = pre;
+    }
+    pRegexpMRU = pre;
+}
+
+/*! \brief Compiles a regular expression or finds it already compiled.
+ *
+ * The result belongs to the cache.  It must not be freed, and it is only
+ * good until the next call, so nothing which might compile another pattern
+ * should run while it is in use.
+ *
+ * \param pattern  Regular expression.
+ * \param options  PCRE_* options, e.g., PCRE_CASELESS.
+ * \param study    Receives the pcre_study() results (may be nullptr).
+ * \param errptr   Receives the compile error, if any.
+ * \return         Compiled pattern, or nullptr if it does not compile.
+ */
+
+const pcre *regexp_compile_cached
+(
+    const UTF8 *pattern,
+    int options,
+    const pcre_extra **study,
+    const char **errptr
+)
+{
+    options |= PCRE_UTF8;
+    *study = nullptr;
+
+    size_t nPattern = strlen((const char *)pattern);
+    size_t nKey = sizeof(options) + nPattern;
+    int erroffset;
+    if (REGEXP_CACHE_KEY < nKey)
+    {
+        regexp_entry_release(&reUncached);
+        reUncached.re = pcre_compile((const char *)pattern, options, errptr,
+            &erroffset, nullptr);
+        if (nullptr != reUncached.re)
+        {
+            reUncached.study = pcre_study(reUncached.re, 0, errptr);
+            *study = reUncached.study;
+        }
+        return reUncached.re;
+    }
+
+    UTF8 aKey[REGEXP_CACHE_KEY];
+    memcpy(aKey, &options, sizeof(options));
+    memcpy(aKey + sizeof(options), pattern, nPattern);
+
+    REGEXP_ENTRY *pre = (REGEXP_ENTRY *)hashfindLEN(aKey, nKey,
+        &mudstate.regexp_htab);
+    if (nullptr != pre)
+    {
+        if (pRegexpMRU != pre)
+        {
+            regexp_unlink(pre);
+            regexp_push(pre);
+        }
+        *study = pre->study;
+        return pre->re;
+    }
+
+    pcre *re = pcre_compile((const char *)pattern, options, errptr,
+        &erroffset, nullptr);
+    if (nullptr == re)
+    {
+        return nullptr;
+    }
+
+    if (REGEXP_CACHE_SIZE <= nRegexps)
+    {
+        pre = pRegexpLRU;
+        regexp_unlink(pre);
+        hashdeleteLEN(pre->pKey, pre->nKey, &mudstate.regexp_htab);
+        regexp_entry_release(pre);
+        MEMFREE(pre->pKey);
+        nRegexps--;
+    }
+    else
+    {
+        pre = (REGEXP_ENTRY *)MEMALLOC(sizeof(REGEXP_ENTRY));
+        ISOUTOFMEMORY(pre);
+    }
+
+    pre->re    = re;
+    pre->study = pcre_study(re, 0, errptr);
+    pre->nKey  = nKey;
+    pre->pKey  = (UTF8 *)MEMALLOC(nKey);
+    ISOUTOFMEMORY(pre->pKey);
+    memcpy(pre->pKey, aKey, nKey);
+    hashaddLEN(pre->pKey, pre->nKey, pre, &mudstate.regexp_htab);
+    regexp_push(pre);
+    nRegexps++;
+
+    *study = pre->study;
+    return pre->re;
+}
+
 /* ----------------------------------------------------------------------
  * regexp_match: Load a regular expression match and insert it into
  * registers.
@@ -90,17 +274,16 @@ bool regexp_match
     int matches;
     int i;
     const char *errptr;
-    int erroffset;
 
     /*
-     * Load the regexp pattern. This allocates memory which must be
-     * later freed. A free() of the regexp does free all structures
-     * under it.
+     * Load the regexp pattern. The compiled pattern belongs to the
+     * regexp cache and must not be freed.
      */
 
-    pcre *re;
+    const pcre *re;
+    const pcre_extra *study;
     if (  alarm_clock.alarmed
-       || (re = pcre_compile((char *)pattern, PCRE_UTF8|case_opt, &errptr, &erroffset, nullptr)) == nullptr)
+       || (re = regexp_compile_cached(pattern, case_opt, &study, &errptr)) == nullptr)
     {
         /*
          * This is a matching error. We have an error message in
@@ -120,11 +303,10 @@ bool regexp_match
      * Now we try to match the pattern. The relevant fields will
      * automatically be filled in by this.
      */
-    matches = pcre_exec(re, nullptr, (char *)str, static_cast<int>(strlen((char *)str)), 0, 0, ovec, ovecsize);
+    matches = pcre_exec(re, study, (char *)str, static_cast<int>(strlen((char *)str)), 0, 0, ovec, ovecsize);
     if (matches < 0)
     {
         delete [] ovec;
-        MEMFREE(re);
         return false;
     }
 
@@ -155,7 +337,6 @@ bool regexp_match
     }
 
     delete [] ovec;
-    MEMFREE(re);
     return true;
 }
 
@@ -219,11 +400,14 @@ static int atr_match1
     bool bFoundCommands = false;
     bool bFoundListens  = false;
 
-    atr_push();
-    unsigned char *as;
-    for (int atr = atr_head(parent, &as); atr; atr = atr_next(&as))
+    // The compiled index lets us check every attribute without fetching its
+    // value.  Nothing below changes attributes, so the index stays put.
+    //
+    const AMATCH_INDEX *pIndex = amatch_index(parent);
+    for (int i = 0; i < pIndex->nEntries; i++)
     {
-        ATTR *ap = atr_num(atr);
+        const AMATCH_ENTRY *pEntry = pIndex->aEntries + i;
+        ATTR *ap = atr_num(pEntry->atr);
 
         // Never check NOPROG attributes.
         //
@@ -233,31 +417,18 @@ static int atr_match1
             continue;
         }
 
-        // We need to grab the attribute even before we know whether we'll use
-        // it or not in order to maintain cached knowledge about ^-Commands
-        // and $-Commands.
-        //
-        dbref aowner;
-        int   aflags;
-        UTF8 buff[LBUF_SIZE];
-        atr_get_str(buff, parent, atr, &aowner, &aflags);
-
-        UTF8 *s = nullptr;
-        if (  0 == (aflags & AF_NOPROG)
-           &&  (  AMATCH_CMD    == buff[0]
-               || AMATCH_LISTEN == buff[0]))
+        int   aflags = pEntry->aflags;
+        UTF8 *pPattern = nullptr;
+        if (0 <= pEntry->iPattern)
         {
-            s = (UTF8 *)strchr((char *)buff+1, ':');
-            if (s)
+            pPattern = pIndex->pText + pEntry->iPattern;
+            if (AMATCH_CMD == pPattern[0])
             {
-                if (AMATCH_CMD == buff[0])
-                {
-                    bFoundCommands = true;
-                }
-                else
-                {
-                    bFoundListens = true;
-                }
+                bFoundCommands = true;
+            }
+            else
+            {
+                bFoundListens = true;
             }
         }
 
@@ -277,57 +448,54 @@ static int atr_match1
         //
         if (hash_insert)
         {
-            hashaddLEN(&(ap->number), sizeof(ap->number), &atr, &mudstate.parent_htab);
-        }
-
-        if (aflags & AF_NOPROG)
-        {
-            continue;
+            hashaddLEN(&(ap->number), sizeof(ap->number), ap, &mudstate.parent_htab);
         }
 
         // Check for the leadin character after excluding the attrib.
         // This lets non-command attribs on the child block commands
         // on the parent.
         //
-        if (buff[0] != type)
-        {
-            continue;
-        }
-
-        // Was there a ':'?
-        //
-        if (!s)
+        if (  nullptr == pPattern
+           || pPattern[0] != type)
         {
             continue;
         }
-        *s++ = '\0';
 
         UTF8 *args[NUM_ENV_VARS];
         if (  (  0 != (aflags & AF_REGEXP)
-            && regexp_match(buff + 1, (aflags & AF_NOPARSE) ? raw_str : str,
+            && regexp_match(pPattern + 1, (aflags & AF_NOPARSE) ? raw_str : str,
                 ((aflags & AF_CASE) ? 0 : PCRE_CASELESS), args, NUM_ENV_VARS))
            || (  0 == (aflags & AF_REGEXP)
-              && wild(buff + 1, (aflags & AF_NOPARSE) ? raw_str : str,
-                args, NUM_ENV_VARS)))
+              && 0 <= pEntry->iGlob
+              && wild_compiled(pIndex->pText + pEntry->iGlob,
+                (aflags & AF_NOPARSE) ? raw_str : str, args, NUM_ENV_VARS)))
         {
             match = 1;
             CLinearTimeAbsolute lta;
             wait_que(thing, player, player, AttrTrace(aflags, 0), false, lta,
                 NOTHING, 0,
-                s,
+                pIndex->pText + pEntry->iAction,
                 NUM_ENV_VARS, (const UTF8 **)args,
                 mudstate.global_regs);
 
-            for (int i = 0; i < NUM_ENV_VARS; i++)
+            for (int j = 0; j < NUM_ENV_VARS; j++)
             {
-                if (args[i])
+                if (args[j])
                 {
-                    free_lbuf(args[i]);
+                    free_lbuf(args[j]);
                 }
             }
         }
     }
-    atr_pop();
+
+    // An object without commands or listens is caught by the bitfields
+    // above, so there is no reason to keep its index.
+    //
+    if (  !bFoundCommands
+       && !bFoundListens)
+    {
+        amatch_index_clear(parent);
+    }
 
     if (bFoundCommands)
     {
@@ -456,41 +624,44 @@ static bool check_filter(dbref object, dbref player, int filter, const UTF8 *msg
 
     if (!(aflags & AF_REGEXP))
     {
+        // Each pattern is compiled into the same buffer.
+        //
+        UTF8 *pCompiled = alloc_lbuf("check_filter.glob");
         do
         {
             UTF8 *cp = parse_to(&dp, ',', EV_STRIP_CURLY);
-            mudstate.wild_invk_ctr = 0;
             if (  alarm_clock.alarmed
-               || quick_wild(cp, msg))
+               || (  0 != wild_compile(cp, pCompiled, LBUF_SIZE)
+                  && quick_wild_compiled(pCompiled, msg)))
             {
+                free_lbuf(pCompiled);
                 free_lbuf(nbuf);
                 return false;
             }
         } while (dp != nullptr);
+        free_lbuf(pCompiled);
     }
     else
     {
         int case_opt = (aflags & AF_CASE) ? 0 : PCRE_CASELESS;
         do
         {
-            int erroffset;
             const char *errptr;
             UTF8 *cp = parse_to(&dp, ',', EV_STRIP_CURLY);
-            pcre *re;
+            const pcre *re;
+            const pcre_extra *study;
             if (  !alarm_clock.alarmed
-               && (re = pcre_compile((char *)cp, PCRE_UTF8|case_opt, &errptr, &erroffset, nullptr)) != nullptr)
+               && (re = regexp_compile_cached(cp, case_opt, &study, &errptr)) != nullptr)
             {
                 const int ovecsize = 33;
                 int ovec[ovecsize];
-                int matches = pcre_exec(re, nullptr, (char *)msg, static_cast<int>(strlen((char *)msg)), 0, 0,
+                int matches = pcre_exec(re, study, (char *)msg, static_cast<int>(strlen((char *)msg)), 0, 0,
                     ovec, ovecsize);
                 if (0 <= matches)
                 {
-                    MEMFREE(re);
                     free_lbuf(nbuf);
                     return false;
                 }
-                MEMFREE(re);
             }
         } while (dp != nullptr);
     }
@@ -610,6 +781,37 @@ bool html_escape(const UTF8 *src, UTF8 *dest, UTF8 **destp)
     return ret;
 }
 
+// notify_check() runs once for every object which hears a message, and it
+// nests through forwardlists, exits, and contents.  Released mux_string
+// temporaries are kept for the next call instead of being freed.  That saves
+// a new/delete pair per listener.  A temporary that a long message already
+// moved to an lbuf also keeps that lbuf.
+//
+#define NOTIFY_SCRATCH_MAX 16
+static mux_string *aNotifyScratch[NOTIFY_SCRATCH_MAX];
+static int nNotifyScratch = 0;
+
+static mux_string *notify_scratch_get(void)
+{
+    if (0 < nNotifyScratch)
+    {
+        return aNotifyScratch[--nNotifyScratch];
+    }
+    return new mux_string;
+}
+
+static void notify_scratch_put(mux_string *sStr)
+{
+    if (nNotifyScratch < NOTIFY_SCRATCH_MAX)
+    {
+        aNotifyScratch[nNotifyScratch++] = sStr;
+    }
+    else
+    {
+        delete sStr;
+    }
+}
+
 void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
 {
     // If speaker is invalid or message is empty, just exit.
@@ -649,8 +851,8 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
         return;
     }
 
-    mux_string *msg_ns = new mux_string;
-    mux_string *msgFinal = new mux_string;
+    mux_string *msg_ns = nullptr;
+    mux_string *msgFinal = notify_scratch_get();
     UTF8 *tp;
     UTF8 *prefix;
     dbref aowner,  recip, obj;
@@ -658,8 +860,10 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
     FWDLIST *fp;
 
     // If we want NOSPOOF output, generate it.  It is only needed if we are
-    // sending the message to the target object.
+    // sending the message to the target object.  Otherwise, pmsg_ns is just
+    // the message.
     //
+    const mux_string *pmsg_ns = &msg;
     if (key & MSG_ME)
     {
         if (  Nospoof(target)
@@ -671,6 +875,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
             // caller may have.  notify(target, tprintf(...)) is quite common
             // in the code.
             //
+            msg_ns = notify_scratch_get();
             msg_ns->import(T("["), 1);
             msg_ns->append(Moniker(sender));
             msg_ns->append_TextPlain(T("("), 1);
@@ -718,11 +923,12 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
             }
 
             msg_ns->append_TextPlain(T("] "), 2);
+            msg_ns->append(msg);
+            pmsg_ns = msg_ns;
         }
     }
-    msg_ns->append(msg);
 
-    // msg contains the raw message, msg_ns contains the NOSPOOFed msg.
+    // msg contains the raw message, pmsg_ns points to the NOSPOOFed msg.
     //
     bool check_listens = !Halted(target);
     switch (Typeof(target))
@@ -732,17 +938,18 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
         {
             if (key & MSG_HTML)
             {
-                raw_notify_html(target, *msg_ns);
+                raw_notify_html(target, *pmsg_ns);
             }
-            else
+            else if (Html(target))
             {
-                msgFinal->import(*msg_ns);
-                if (Html(target))
-                {
-                    msgFinal->encode_Html();
-                }
+                msgFinal->import(*pmsg_ns);
+                msgFinal->encode_Html();
                 raw_notify(target, *msgFinal);
             }
+            else
+            {
+                raw_notify(target, *pmsg_ns);
+            }
         }
         if (!mudconf.player_listen)
         {
@@ -761,7 +968,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
         if (  mudstate.inpipe
            && !isPlayer(target))
         {
-            raw_notify(target, *msg_ns);
+            raw_notify(target, *pmsg_ns);
         }
 
         // Forward puppet message if it is for me.
@@ -779,7 +986,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
         {
             msgFinal->import(Moniker(target));
             msgFinal->append_TextPlain(T("> "), 2);
-            msgFinal->append(*msg_ns);
+            msgFinal->append(*pmsg_ns);
             raw_notify(Owner(target), *msgFinal);
         }
 
@@ -937,7 +1144,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
                 msgFinal->import(msg);
             }
 
-            mux_string *msgPrefixed2 = new mux_string;
+            mux_string *msgPrefixed2 = notify_scratch_get();
 
             DOLIST(obj, Exits(Location(target)))
             {
@@ -957,7 +1164,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
                         MSG_ME | MSG_F_UP | MSG_F_CONTENTS | MSG_S_INSIDE | (key & (MSG_SRC_MASK | MSG_SAYPOSE | MSG_OOC)));
                 }
             }
-            delete msgPrefixed2;
+            notify_scratch_put(msgPrefixed2);
         }
 
         // Deliver message to contents.
@@ -982,6 +1189,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
                 msgFinal->import(msg);
             }
 
+            mux_render_cache rc(*msgFinal);
             DOLIST(obj, Contents(target))
             {
                 if (obj != target)
@@ -1013,6 +1221,7 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
                 msgFinal->import(msg);
             }
 
+            mux_render_cache rc(*msgFinal);
             DOLIST(obj, Contents(targetloc))
             {
                 if (  obj != target
@@ -1049,8 +1258,11 @@ void notify_check(dbref target, dbref sender, const mux_string &msg, int key)
         }
         free_lbuf(msgPlain);
     }
-    delete msgFinal;
-    delete msg_ns;
+    notify_scratch_put(msgFinal);
+    if (nullptr != msg_ns)
+    {
+        notify_scratch_put(msg_ns);
+    }
     mudstate.ntfy_nest_lev--;
 }
 
@@ -1065,47 +1277,68 @@ void notify_check(dbref target, dbref sender, const UTF8 *msg, int key)
         return;
     }
 
-    mux_string *sMsg = new mux_string(msg);
+    mux_string *sMsg = notify_scratch_get();
+    sMsg->import(msg);
 
     notify_check(target, sender, *sMsg, key);
 
-    delete sMsg;
+    notify_scratch_put(sMsg);
 }
 
 void notify_except(dbref loc, dbref player, dbref exception, const UTF8 *msg, int key)
 {
-    dbref first;
-
-    if (loc != exception)
+    if (  nullptr == msg
+       || '\0' == msg[0])
     {
-        notify_check(loc, player, msg, MSG_ME_ALL | MSG_F_UP | MSG_S_INSIDE | MSG_NBR_EXITS_A | key);
+        return;
     }
-    DOLIST(first, Contents(loc))
+
+    dbref first;
+    mux_string *sMsg = new mux_string(msg);
     {
-        if (first != exception)
+        mux_render_cache rc(*sMsg);
+        if (loc != exception)
+        {
+            notify_check(loc, player, *sMsg, MSG_ME_ALL | MSG_F_UP | MSG_S_INSIDE | MSG_NBR_EXITS_A | key);
+        }
+        DOLIST(first, Contents(loc))
         {
-            notify_check(first, player, msg, MSG_ME | MSG_F_DOWN | MSG_S_OUTSIDE | key);
+            if (first != exception)
+            {
+                notify_check(first, player, *sMsg, MSG_ME | MSG_F_DOWN | MSG_S_OUTSIDE | key);
+            }
         }
     }
+    delete sMsg;
 }
 
 void notify_except2(dbref loc, dbref player, dbref exc1, dbref exc2, const UTF8 *msg)
 {
-    dbref first;
-
-    if (  loc != exc1
-       && loc != exc2)
+    if (  nullptr == msg
+       || '\0' == msg[0])
     {
-        notify_check(loc, player, msg, MSG_ME_ALL | MSG_F_UP | MSG_S_INSIDE | MSG_NBR_EXITS_A);
+        return;
     }
-    DOLIST(first, Contents(loc))
+
+    dbref first;
+    mux_string *sMsg = new mux_string(msg);
     {
-        if (  first != exc1
-           && first != exc2)
+        mux_render_cache rc(*sMsg);
+        if (  loc != exc1
+           && loc != exc2)
         {
-            notify_check(first, player, msg, MSG_ME | MSG_F_DOWN | MSG_S_OUTSIDE);
+            notify_check(loc, player, *sMsg, MSG_ME_ALL | MSG_F_UP | MSG_S_INSIDE | MSG_NBR_EXITS_A);
+        }
+        DOLIST(first, Contents(loc))
+        {
+            if (  first != exc1
+               && first != exc2)
+            {
+                notify_check(first, player, *sMsg, MSG_ME | MSG_F_DOWN | MSG_S_OUTSIDE);
+            }
         }
     }
+    delete sMsg;
 }
 
 /* ----------------------------------------------------------------------
@@ -1345,22 +1578,32 @@ void do_shutdown
 // Type 0 and 2 are allowed to touch each other's files. Type 1 and 4 should not
 // touch files used in Type 0 or Type 2.
 //
+// Type 0 and 2 are written as binary snapshots when snapshot_db is enabled,
+// and they are stamped with the generation of the checkpoint journal.  The
+// others are always flatfiles so that they stay portable.
+//
+// Type 0, 2, and 3 are gzip-compressed when compression_level is set.  Type 1
+// and 4 are written while the game is falling over, so they stay as simple as
+// possible.
+//
 typedef struct
 {
     UTF8      **ppszOutputBase;
     const UTF8 *szOutputSuffix;
     bool        bUseTemporary;
+    bool        bPrimary;
+    bool        bCompress;
     int         fType;
     const UTF8 *pszErrorMessage;
 } DUMP_PROCEDURE;
 
 static DUMP_PROCEDURE DumpProcedures[NUM_DUMP_TYPES] =
 {
-    { nullptr,          T(""),     false, 0,                             T("") }, // 0 -- Handled specially.
-    { &mudconf.crashdb, T(""),     false, UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening crash file") }, // 1
-    { &mudconf.indb,    T(""),     true,  OUTPUT_VERSION | OUTPUT_FLAGS, T("Opening input file") }, // 2
-    { &mudconf.indb,   T(".FLAT"), false, UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening flatfile")   }, // 3
-    { &mudconf.indb,   T(".SIG"),  false, UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening signalled flatfile")}  // 4
+    { nullptr,          T(""),     false, true,  true,  0,                             T("") }, // 0 -- Handled specially.
+    { &mudconf.crashdb, T(""),     false, false, false, UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening crash file") }, // 1
+    { &mudconf.indb,    T(""),     true,  true,  true,  OUTPUT_VERSION | OUTPUT_FLAGS, T("Opening input file") }, // 2
+    { &mudconf.indb,   T(".FLAT"), false, false, true,  UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening flatfile")   }, // 3
+    { &mudconf.indb,   T(".SIG"),  false, false, false, UNLOAD_VERSION | UNLOAD_FLAGS, T("Opening signalled flatfile")}  // 4
 };
 
 #if defined(WINDOWS_FILES)
@@ -1371,6 +1614,261 @@ static DUMP_PROCEDURE DumpProcedures[NUM_DUMP_TYPES] =
 #define POPEN_WRITE_OP "w"
 #endif // UNIX_FILES
 
+static void dump_mail_and_comsys(void)
+{
+    if (mudconf.have_mailer)
+    {
+        FILE *f;
+        if (mux_fopen(&f, mudconf.mail_db, T("wb")))
+        {
+            DebugTotalFiles++;
+            dump_mail(f);
+            if (fclose(f) == 0)
+            {
+                DebugTotalFiles--;
+            }
+        }
+    }
+
+    if (mudconf.have_comsys)
+    {
+        save_comsys(mudconf.comsys_db);
+    }
+}
+
+// Journaled dumps.  With incremental_dumps set, a periodic dump usually
+// appends a checkpoint to the journal (see db_rw.cpp).  Every
+// incremental_dumps-th one writes the whole database instead, dump_slice
+// objects at a time from the task queue, so the game neither pauses nor
+// forks.
+//
+static DB_WRITER *pSliceWriter = nullptr;
+static FILE *pSliceFile = nullptr;
+static bool  bSlicePipe = false;
+static int   iSliceGeneration = 0;
+static int   nSliceCheckpoints = 0;
+static bool  bSliceNeeded = false;
+static UTF8  aSliceTemp[SIZEOF_PATHNAME+32];
+static UTF8  aSliceOut[SIZEOF_PATHNAME+32];
+static UTF8  aSlicePrev[SIZEOF_PATHNAME+32];
+
+static void dispatch_DumpSlice(void *pUnused, int iUnused);
+
+static bool dump_slices_close(void)
+{
+    bool bOK = (0 == ferror(pSliceFile));
+    if (bSlicePipe)
+    {
+        if (pclose(pSliceFile) != -1)
+        {
+            DebugTotalFiles--;
+        }
+        else
+        {
+            bOK = false;
+        }
+    }
+    else if (db_fclose(pSliceFile) == 0)
+    {
+        DebugTotalFiles--;
+    }
+    else
+    {
+        bOK = false;
+    }
+    pSliceFile = nullptr;
+    return bOK;
+}
+
+static void dump_slices_abort(void)
+{
+    if (nullptr == pSliceWriter)
+    {
+        return;
+    }
+    scheduler.CancelTask(dispatch_DumpSlice, 0, 0);
+    db_write_abort(pSliceWriter);
+    pSliceWriter = nullptr;
+    dump_slices_close();
+    RemoveFile(aSliceTemp);
+    bSliceNeeded = true;
+}
+
+static void dump_slices_finish(void)
+{
+    db_write_end(pSliceWriter);
+    pSliceWriter = nullptr;
+    if (dump_slices_close())
+    {
+        journal_commit_dump(iSliceGeneration, aSliceTemp, aSliceOut, aSlicePrev);
+        nSliceCheckpoints = 0;
+    }
+    else
+    {
+        log_perror(T("SAV"), T("FAIL"), T("Writing"), aSliceTemp);
+        RemoveFile(aSliceTemp);
+        bSliceNeeded = true;
+    }
+    dump_mail_and_comsys();
+
+    STARTLOG(LOG_DBSAVES, "DMP", "DONE")
+    log_text(T("Dump complete: "));
+    log_text(aSliceTemp);
+    ENDLOG;
+
+    local_dump_complete_signal();
+    ServerEventsSinkNode *p = g_pServerEventsSinkListHead;
+    while (nullptr != p)
+    {
+        p->pSink->dump_complete_signal();
+        p = p->pNext;
+    }
+}
+
+static void dispatch_DumpSlice(void *pUnused, int iUnused)
+{
+    UNUSED_PARAMETER(pUnused);
+    UNUSED_PARAMETER(iUnused);
+
+    if (nullptr == pSliceWriter)
+    {
+        return;
+    }
+
+    const UTF8 *cmdsave = mudstate.debug_cmd;
+    mudstate.debug_cmd = T("< dump >");
+    int nSlice = (0 < mudconf.dump_slice) ? mudconf.dump_slice : INT_MAX;
+    if (db_write_step(pSliceWriter, nSlice))
+    {
+        dump_slices_finish();
+    }
+    else
+    {
+        CLinearTimeAbsolute ltaNextTime;
+        ltaNextTime.GetUTC();
+        ltaNextTime += time_5ms;
+        scheduler.DeferTask(ltaNextTime, PRIORITY_SYSTEM, dispatch_DumpSlice, 0, 0);
+    }
+    mudstate.debug_cmd = cmdsave;
+}
+
+static void dump_slices_start(void)
+{
+    if (nullptr != pSliceWriter)
+    {
+        return;
+    }
+
+    local_presync_database();
+    ServerEventsSinkNode *p = g_pServerEventsSinkListHead;
+    while (nullptr != p)
+    {
+        p->pSink->presync_database();
+        p = p->pNext;
+    }
+
+#ifndef MEMORY_BASED
+    // Save cached modified attribute list
+    //
+    al_store();
+#endif // MEMORY_BASED
+
+    pcache_sync();
+
+    mudstate.epoch++;
+    iSliceGeneration = journal_begin_dump();
+    if (mudconf.compress_db)
+    {
+        mux_sprintf(aSlicePrev, sizeof(aSlicePrev), T("%s.prev.gz"), mudconf.outdb);
+        mux_sprintf(aSliceTemp, sizeof(aSliceTemp), T("%s.#%d#.gz"), mudconf.outdb, mudstate.epoch - 1);
+        RemoveFile(aSliceTemp);
+        mux_sprintf(aSliceTemp, sizeof(aSliceTemp), T("%s.#%d#.gz"), mudconf.outdb, mudstate.epoch);
+        mux_sprintf(aSliceOut, sizeof(aSliceOut), T("%s.gz"), mudconf.outdb);
+        pSliceFile = popen((char *)tprintf(T("%s > %s"), mudconf.compress, aSliceTemp), POPEN_WRITE_OP);
+        bSlicePipe = true;
+    }
+    else
+    {
+        mux_sprintf(aSlicePrev, sizeof(aSlicePrev), T("%s.prev"), mudconf.outdb);
+        mux_sprintf(aSliceTemp, sizeof(aSliceTemp), T("%s.#%d#"), mudconf.outdb, mudstate.epoch - 1);
+        RemoveFile(aSliceTemp);
+        mux_sprintf(aSliceTemp, sizeof(aSliceTemp), T("%s.#%d#"), mudconf.outdb, mudstate.epoch);
+        mux_sprintf(aSliceOut, sizeof(aSliceOut), T("%s"), mudconf.outdb);
+        if (!db_fopen_write(&pSliceFile, aSliceTemp, mudconf.compress_level))
+        {
+            pSliceFile = nullptr;
+        }
+        bSlicePipe = false;
+    }
+
+    if (nullptr == pSliceFile)
+    {
+        log_perror(T("SAV"), T("FAIL"), T("Opening"), aSliceTemp);
+        bSliceNeeded = true;
+        return;
+    }
+    DebugTotalFiles++;
+    setvbuf(pSliceFile, nullptr, _IOFBF, 16384);
+
+    pSliceWriter = db_write_begin(pSliceFile, mudconf.snapshot_db ? F_MUX_SNAPSHOT : F_MUX,
+        OUTPUT_VERSION | OUTPUT_FLAGS, iSliceGeneration);
+    if (nullptr == pSliceWriter)
+    {
+        dump_slices_close();
+        RemoveFile(aSliceTemp);
+        bSliceNeeded = true;
+        return;
+    }
+    bSliceNeeded = false;
+
+    STARTLOG(LOG_DBSAVES, "DMP", "DUMP");
+    log_text(T("Dumping in slices: "));
+    log_text(aSliceTemp);
+    ENDLOG;
+
+    local_dump_database(DUMP_I_NORMAL);
+    p = g_pServerEventsSinkListHead;
+    while (nullptr != p)
+    {
+        p->pSink->dump_database(DUMP_I_NORMAL);
+        p = p->pNext;
+    }
+
+    CLinearTimeAbsolute ltaNextTime;
+    ltaNextTime.GetUTC();
+    scheduler.DeferTask(ltaNextTime, PRIORITY_SYSTEM, dispatch_DumpSlice, 0, 0);
+}
+
+/*! \brief Periodic dump when the checkpoint journal is in use.
+ *
+ * \return  None.
+ */
+
+void dump_checkpoint(void)
+{
+    check_mail_expiration();
+
+#ifndef MEMORY_BASED
+    // Save cached modified attribute list
+    //
+    al_store();
+#endif // MEMORY_BASED
+
+    pcache_sync();
+
+    nSliceCheckpoints++;
+    if (  nullptr == pSliceWriter
+       && (  bSliceNeeded
+          || mudconf.incremental_dumps <= nSliceCheckpoints))
+    {
+        dump_slices_start();
+    }
+    else
+    {
+        journal_checkpoint();
+    }
+}
+
 void dump_database_internal(int dump_type)
 {
     UTF8 tmpfile[SIZEOF_PATHNAME+32];
@@ -1410,9 +1908,25 @@ void dump_database_internal(int dump_type)
         p = p->pNext;
     }
 
+    // A full dump written all at once replaces one being written in slices.
+    //
+    int iGeneration = 0;
+    bool bWritten = false;
+    if (DumpProcedures[dump_type].bPrimary)
+    {
+        dump_slices_abort();
+        iGeneration = journal_begin_dump();
+    }
+
     if (0 < dump_type)
     {
         DUMP_PROCEDURE *dp = &DumpProcedures[dump_type];
+        int iLevel = 0;
+        if (  dp->bCompress
+           && !mudconf.compress_db)
+        {
+            iLevel = mudconf.compress_level;
+        }
         bool bOpen;
 
         mux_sprintf(outfn, sizeof(outfn), T("%s%s"), *(dp->ppszOutputBase), dp->szOutputSuffix);
@@ -1420,52 +1934,40 @@ void dump_database_internal(int dump_type)
         {
             mux_sprintf(tmpfile, sizeof(tmpfile), T("%s.#%d#"), outfn, mudstate.epoch);
             RemoveFile(tmpfile);
-            bOpen = mux_fopen(&f, tmpfile, T("wb"));
+            bOpen = db_fopen_write(&f, tmpfile, iLevel);
         }
         else
         {
             RemoveFile(outfn);
-            bOpen = mux_fopen(&f, outfn, T("wb"));
+            bOpen = db_fopen_write(&f, outfn, iLevel);
         }
 
         if (bOpen)
         {
             DebugTotalFiles++;
             setvbuf(f, nullptr, _IOFBF, 16384);
-            db_write(f, F_MUX, dp->fType);
-            if (fclose(f) == 0)
+            db_write(f, (dp->bPrimary && mudconf.snapshot_db) ? F_MUX_SNAPSHOT : F_MUX, dp->fType, iGeneration);
+            bool bClosed = (db_fclose(f) == 0);
+            if (bClosed)
             {
                 DebugTotalFiles--;
             }
 
-            if (dp->bUseTemporary)
+            if (  dp->bUseTemporary
+               && bClosed)
             {
-                ReplaceFile(tmpfile, outfn);
+                bWritten = (0 == ReplaceFile(tmpfile, outfn));
             }
         }
         else
         {
             log_perror(T("DMP"), T("FAIL"), dp->pszErrorMessage, outfn);
         }
+        journal_end_dump(iGeneration, bWritten);
 
         if (!bPotentialConflicts)
         {
-            if (mudconf.have_mailer)
-            {
-                if (mux_fopen(&f, mudconf.mail_db, T("wb")))
-                {
-                    DebugTotalFiles++;
-                    dump_mail(f);
-                    if (fclose(f) == 0)
-                    {
-                        DebugTotalFiles--;
-                    }
-                }
-            }
-            if (mudconf.have_comsys)
-            {
-                save_comsys(mudconf.comsys_db);
-            }
+            dump_mail_and_comsys();
         }
         return;
     }
@@ -1485,7 +1987,7 @@ void dump_database_internal(int dump_type)
         {
             DebugTotalFiles++;
             setvbuf(f, nullptr, _IOFBF, 16384);
-            db_write(f, F_MUX, OUTPUT_VERSION | OUTPUT_FLAGS);
+            db_write(f, mudconf.snapshot_db ? F_MUX_SNAPSHOT : F_MUX, OUTPUT_VERSION | OUTPUT_FLAGS, iGeneration);
             if (pclose(f) != -1)
             {
                 DebugTotalFiles--;
@@ -1495,6 +1997,10 @@ void dump_database_internal(int dump_type)
             {
                 log_perror(T("SAV"), T("FAIL"), T("Renaming output file to DB file"), tmpfile);
             }
+            else
+            {
+                bWritten = true;
+            }
         }
         else
         {
@@ -1508,19 +2014,29 @@ void dump_database_internal(int dump_type)
         RemoveFile(tmpfile);
         mux_sprintf(tmpfile, sizeof(tmpfile), T("%s.#%d#"), mudconf.outdb, mudstate.epoch);
 
-        if (mux_fopen(&f, tmpfile, T("wb")))
+        if (db_fopen_write(&f, tmpfile, mudconf.compress_level))
         {
             DebugTotalFiles++;
             setvbuf(f, nullptr, _IOFBF, 16384);
-            db_write(f, F_MUX, OUTPUT_VERSION | OUTPUT_FLAGS);
-            if (fclose(f) == 0)
+            db_write(f, mudconf.snapshot_db ? F_MUX_SNAPSHOT : F_MUX, OUTPUT_VERSION | OUTPUT_FLAGS, iGeneration);
+            if (db_fclose(f) == 0)
             {
                 DebugTotalFiles--;
+                ReplaceFile(mudconf.outdb, prevfile);
+                if (ReplaceFile(tmpfile, mudconf.outdb) < 0)
+                {
+                    log_perror(T("SAV"), T("FAIL"), T("Renaming output file to DB file"), tmpfile);
+                }
+                else
+                {
+                    bWritten = true;
+                }
             }
-            ReplaceFile(mudconf.outdb, prevfile);
-            if (ReplaceFile(tmpfile, mudconf.outdb) < 0)
+            else
             {
-                log_perror(T("SAV"), T("FAIL"), T("Renaming output file to DB file"), tmpfile);
+                // Keep the previous database rather than a damaged one.
+                //
+                log_perror(T("SAV"), T("FAIL"), T("Closing"), tmpfile);
             }
         }
         else
@@ -1528,24 +2044,8 @@ void dump_database_internal(int dump_type)
             log_perror(T("SAV"), T("FAIL"), T("Opening"), tmpfile);
         }
     }
-
-    if (mudconf.have_mailer)
-    {
-        if (mux_fopen(&f, mudconf.mail_db, T("wb")))
-        {
-            DebugTotalFiles++;
-            dump_mail(f);
-            if (fclose(f) == 0)
-            {
-                DebugTotalFiles--;
-            }
-        }
-    }
-
-    if (mudconf.have_comsys)
-    {
-        save_comsys(mudconf.comsys_db);
-    }
+    journal_end_dump(iGeneration, bWritten);
+    dump_mail_and_comsys();
 }
 
 static void dump_database(void)
@@ -1597,6 +2097,7 @@ static void dump_database(void)
     pcache_sync();
 
     dump_database_internal(DUMP_I_NORMAL);
+    journal_stop();
     SYNC;
 
     STARTLOG(LOG_DBSAVES, "DMP", "DONE")
@@ -1644,6 +2145,16 @@ void fork_and_dump(int key)
         key = DUMP_TEXT+DUMP_STRUCT;
     }
 
+    // With the checkpoint journal, the structure is written in slices
+    // instead of by a forked child.
+    //
+    if (  mudstate.bJournal
+       && (key & DUMP_STRUCT))
+    {
+        key &= ~DUMP_STRUCT;
+        dump_slices_start();
+    }
+
     if (*mudconf.dump_msg)
     {
         raw_broadcast(0, T("%s"), mudconf.dump_msg);
@@ -1846,7 +2357,9 @@ static int load_game(int ccPageFile)
             return LOAD_GAME_NO_INPUT_DB;
         }
 
-        if (!mux_fopen(&f, infile, T("rb")))
+        // A file written with compression_level is recognized here.
+        //
+        if (!db_fopen_read(&f, infile))
         {
             return LOAD_GAME_CANNOT_OPEN;
         }
@@ -1873,7 +2386,7 @@ static int load_game(int ccPageFile)
         }
         else
         {
-            if (fclose(f) == 0)
+            if (db_fclose(f) == 0)
             {
                 DebugTotalFiles--;
             }
@@ -1898,7 +2411,7 @@ static int load_game(int ccPageFile)
     }
     else
     {
-        if (fclose(f) == 0)
+        if (db_fclose(f) == 0)
         {
             DebugTotalFiles--;
         }
@@ -2118,6 +2631,9 @@ static void process_preload(void)
     UTF8 *tstr;
 
     tstr = alloc_lbuf("process_preload.string");
+#ifndef MEMORY_BASED
+    cache_prefetch();
+#endif // MEMORY_BASED
     DO_WHOLE_DB(thing)
     {
         // Ignore GOING objects.
@@ -2188,6 +2704,10 @@ static void info(int fmt, int flags, int ver)
     {
         cp = T("MUX");
     }
+    else if (fmt == F_MUX_SNAPSHOT)
+    {
+        cp = T("MUX snapshot");
+    }
     else
     {
         cp = T("*unknown*");
@@ -2227,6 +2747,7 @@ static const UTF8 *standalone_basename = nullptr;
 static bool standalone_check = false;
 static bool standalone_load = false;
 static bool standalone_unload = false;
+static bool standalone_snapshot = false;
 
 static void dbconvert(void)
 {
@@ -2312,7 +2833,7 @@ static void dbconvert(void)
     }
 
     FILE *fpIn;
-    if (!mux_fopen(&fpIn, standalone_infile, T("rb")))
+    if (!db_fopen_read(&fpIn, standalone_infile))
     {
         exit(1);
     }
@@ -2342,7 +2863,7 @@ static void dbconvert(void)
     {
         do_dbck(NOTHING, NOTHING, NOTHING, 0, DBCK_FULL);
     }
-    fclose(fpIn);
+    db_fclose(fpIn);
 
     if (do_write)
     {
@@ -2353,7 +2874,8 @@ static void dbconvert(void)
         }
 
         db_flags = (db_flags & ~clrflags) | setflags;
-        if (db_format != F_MUX)
+        if (  db_format != F_MUX
+           && db_format != F_MUX_SNAPSHOT)
         {
             db_ver = 3;
         }
@@ -2361,15 +2883,16 @@ static void dbconvert(void)
         {
             db_ver = ver;
         }
+        int out_format = standalone_snapshot ? F_MUX_SNAPSHOT : F_MUX;
         Log.WriteString(T("Output: "));
-        info(F_MUX, db_flags, db_ver);
+        info(out_format, db_flags, db_ver);
         setvbuf(fpOut, nullptr, _IOFBF, 16384);
 #ifndef MEMORY_BASED
         // Save cached modified attribute list
         //
         al_store();
 #endif // MEMORY_BASED
-        db_write(fpOut, F_MUX, db_ver | db_flags);
+        db_write(fpOut, out_format, db_ver | db_flags, 0);
         fclose(fpOut);
     }
     CLOSE;
@@ -2478,6 +3001,7 @@ long DebugTotalMemory = 0;
 #define CLI_DO_BASENAME    CLI_USER+9
 #define CLI_DO_PID_FILE    CLI_USER+10
 #define CLI_DO_ERRORPATH   CLI_USER+11
+#define CLI_DO_SNAPSHOT    CLI_USER+12
 
 static bool bMinDB = false;
 static bool bSyntaxError = false;
@@ -2500,6 +3024,7 @@ static CLI_OptionEntry OptionTable[] =
     { "l", CLI_NONE,     CLI_DO_LOAD        },
     { "u", CLI_NONE,     CLI_DO_UNLOAD      },
     { "d", CLI_REQUIRED, CLI_DO_BASENAME    },
+    { "b", CLI_NONE,     CLI_DO_SNAPSHOT    },
 #endif // MEMORY_BASED
     { "p", CLI_REQUIRED, CLI_DO_PID_FILE    },
     { "e", CLI_REQUIRED, CLI_DO_ERRORPATH   }
@@ -2566,6 +3091,11 @@ static void CLI_CallBack(CLI_OptionEntry *p, const char *pValue)
             mudstate.bStandAlone = true;
             standalone_basename = (UTF8 *)pValue;
             break;
+
+        case CLI_DO_SNAPSHOT:
+            mudstate.bStandAlone = true;
+            standalone_snapshot = true;
+            break;
 #endif
 
         case CLI_DO_USAGE:
@@ -2713,7 +3243,8 @@ int DCL_CDECL main(int argc, char *argv[])
         mux_fprintf(stderr, T("Version: %s" ENDLINE), mudstate.version);
         if (mudstate.bStandAlone)
         {
-            mux_fprintf(stderr, T("Usage: %s -d <dbname> -i <infile> [-o <outfile>] [-l|-u|-k]" ENDLINE), pProg);
+            mux_fprintf(stderr, T("Usage: %s -d <dbname> -i <infile> [-o <outfile>] [-l|-u|-k] [-b]" ENDLINE), pProg);
+            mux_fprintf(stderr, T("  -b  Write a binary snapshot instead of a flatfile." ENDLINE));
             mux_fprintf(stderr, T("  -d  Basename." ENDLINE));
             mux_fprintf(stderr, T("  -i  Input file." ENDLINE));
             mux_fprintf(stderr, T("  -k  Check." ENDLINE));
@@ -2768,8 +3299,8 @@ int DCL_CDECL main(int argc, char *argv[])
     extern CHashFile hfAllocData;
     extern CHashFile hfIdentData;
     extern bool bMemAccountingInitialized;
-    hfAllocData.Open("svdptrs.dir", "svdptrs.pag", 40);
-    hfIdentData.Open("svdlines.dir", "svdlines.pag", 40);
+    hfAllocData.Open("svdptrs.dir", "svdptrs.pag", 40, false);
+    hfIdentData.Open("svdlines.dir", "svdlines.pag", 40, false);
     bMemAccountingInitialized = true;
 #endif
 
@@ -2812,6 +3343,7 @@ int DCL_CDECL main(int argc, char *argv[])
     pool_init(POOL_BOOL, sizeof(struct boolexp));
 
     pool_init(POOL_DESC, sizeof(DESC));
+    pool_init(POOL_TBLOCK, sizeof(TBLOCK));
     pool_init(POOL_QENTRY, sizeof(BQUE));
     pool_init(POOL_LBUFREF, sizeof(lbuf_ref));
     pool_init(POOL_REGREF, sizeof(reg_ref));
@@ -2971,6 +3503,10 @@ int DCL_CDECL main(int argc, char *argv[])
             return 2;
         }
     }
+
+    // A database which the journal cannot follow yet needs a full dump.
+    //
+    bool bFullDump = journal_start();
     set_signals();
     Guest.StartUp();
 
@@ -3032,6 +3568,10 @@ int DCL_CDECL main(int argc, char *argv[])
     }
 
     init_timer();
+    if (bFullDump)
+    {
+        dump_slices_start();
+    }
 
     shovechars(num_main_game_ports, main_game_ports);
 
@@ -268,14 +268,15 @@ static void ReportMatchedTopics(dbref executor, const UTF8 *topic, CHashTable *h
     bool matched = false;
     UTF8 *topic_list = nullptr;
     UTF8 *buffp = nullptr;
+    UTF8 *pCompiled = alloc_lbuf("ReportMatchedTopics");
+    bool bCompiled = (0 != wild_compile(topic, pCompiled, LBUF_SIZE));
     struct help_entry *htab_entry;
     for (htab_entry = (struct help_entry *)hash_firstentry(htab);
-         htab_entry != nullptr;
+         bCompiled && htab_entry != nullptr;
          htab_entry = (struct help_entry *)hash_nextentry(htab))
     {
-        mudstate.wild_invk_ctr = 0;
         if (  htab_entry->key
-           && quick_wild(topic, htab_entry->key))
+           && quick_wild_compiled(pCompiled, htab_entry->key))
         {
             if (!matched)
             {
@@ -288,6 +289,7 @@ static void ReportMatchedTopics(dbref executor, const UTF8 *topic, CHashTable *h
             safe_chr(' ', topic_list, &buffp);
         }
     }
+    free_lbuf(pCompiled);
 
     if (!matched)
     {
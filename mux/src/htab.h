@@ -23,6 +23,23 @@ struct name_table
 
 /* BQUE - Command queue */
 
+// Lists in queue_htab which a queue entry can be on.
+//
+#define QI_ALL        0     // Every entry.
+#define QI_EXECUTOR   1     // Entries by executor.
+#define QI_OWNER      2     // Entries by owner of the executor.
+#define QI_SEMOBJ     3     // Semaphore entries by semaphore object.
+#define QI_SEMAPHORE  4     // Semaphore entries by object and attribute.
+#define QI_COUNT      5
+
+// Kinds of queue entries.
+//
+#define QK_NONE       0     // Not queued.
+#define QK_WAIT       1     // Immediate or @wait.
+#define QK_SEMAPHORE  2     // Waiting on a semaphore.
+#define QK_SQL        3     // Waiting on a SQL query.
+#define QK_COUNT      4
+
 typedef struct bque BQUE;
 struct bque
 {
@@ -50,6 +67,11 @@ struct bque
     int     iRow;                   // Current Row
 #endif // STUB_SLAVE
     bool    IsTimed;                // Is there a waittime time on this entry?
+    int     kind;                   // QK_WAIT, QK_SEMAPHORE, QK_SQL, or QK_NONE.
+    dbref   owner;                  // Owner list this entry is on.
+    struct task_record *pTask;      // Scheduler handle.
+    BQUE    *next[QI_COUNT];        // queue_htab lists.
+    BQUE    *prev[QI_COUNT];
 };
 
 class CBitField
@@ -58,7 +58,8 @@ typedef struct cmd_block
     UTF8    cmd[LBUF_SIZE - sizeof(CBLKHDR)];
 } CBLK;
 
-#define TBLK_FLAG_LOCKED    0x01
+#define TBLK_FLAG_LOCKED     0x01
+#define TBLK_FLAG_COMPRESSED 0x02   // Block is already in its on-the-wire form.
 
 typedef struct text_block TBLOCK;
 typedef struct text_block_hdr
@@ -76,6 +77,9 @@ typedef struct text_block
     UTF8    data[OUTPUT_BLOCK_SIZE - sizeof(TBLOCKHDR)];
 } TBLOCK;
 
+#define alloc_tblock(s) (TBLOCK *)pool_alloc(POOL_TBLOCK, (UTF8 *)s, (UTF8 *)__FILE__, __LINE__)
+#define free_tblock(b)  pool_free(POOL_TBLOCK, (UTF8 *)(b), (UTF8 *)__FILE__, __LINE__)
+
 typedef struct prog_data PROG;
 struct prog_data
 {
@@ -120,6 +124,7 @@ struct prog_data
 #define TELNET_ENV      ((unsigned char)'\x27')
 #define TELNET_CHARSET  ((unsigned char)'\x2A')
 #define TELNET_STARTTLS ((unsigned char)'\x2E')
+#define TELNET_COMPRESS2 ((unsigned char)'\x56')
 
 // Telnet Option Negotiation States
 //
@@ -218,6 +223,33 @@ struct descriptor_data
 #ifdef UNIX_SSL
   SSL *ssl_session;
 #endif
+
+#if defined(UNIX_NETWORKING_EPOLL)
+  UINT32 epoll_events;    // Events currently registered with epoll.
+#endif // UNIX_NETWORKING_EPOLL
+
+#if defined(UNIX_ZLIB)
+  z_stream *mccp;         // MCCP2 deflate stream, or nullptr if not compressing.
+  size_t mccp_in;         // Bytes given to the deflate stream.
+  size_t mccp_out;        // Compressed bytes produced by the deflate stream.
+#endif // UNIX_ZLIB
+
+  struct pending_connect *pending_connect;  // Connect waiting on a password check.
+};
+
+// A connect waiting on a password check.  Input on the descriptor is held
+// until the check finishes.  d is cleared if the descriptor goes away first.
+//
+typedef struct pending_connect PENDING_CONNECT;
+struct pending_connect
+{
+  DESC *d;
+  bool  bDark;
+  bool  bGuest;
+  UTF8  aUser[MBUF_SIZE];
+  UTF8  aAddr[51];              // Copies of the descriptor's addresses, so
+  UTF8  aUsername[11];          // a failure can be recorded without it.
+  UTF8  aHostAddress[MBUF_SIZE];
 };
 
 int him_state(DESC *d, unsigned char chOption);
@@ -292,6 +324,37 @@ extern void queue_write(DESC *, const UTF8 *);
 extern void queue_string(DESC *, const UTF8 *);
 extern void queue_string(DESC *d, const mux_string &s);
 extern void freeqs(DESC *);
+
+// While a mux_render_cache is in scope, queue_string() converts its message
+// once for each combination of encoding and color settings and hands the
+// same bytes to every other descriptor with those settings.  Caches nest, so
+// a broadcast may open one for each form of the message it sends.
+//
+#define RENDER_CACHE_SIZE 8
+
+class mux_render_cache
+{
+public:
+    mux_render_cache(const mux_string &sMsg);
+    ~mux_render_cache(void);
+
+    static bool queue(DESC *d, const mux_string &sMsg, int iKey);
+
+private:
+    struct entry
+    {
+        int     iKey;
+        size_t  nText;
+        UTF8   *pText;
+    };
+
+    const mux_string *m_psMsg;
+    mux_render_cache *m_pPrevious;
+    int               m_nEntries;
+    entry             m_aEntries[RENDER_CACHE_SIZE];
+
+    static mux_render_cache *m_pActive;
+};
 extern void welcome_user(DESC *);
 extern void save_command(DESC *, CBLK *);
 extern void announce_disconnect(dbref, DESC *, const UTF8 *);
@@ -312,7 +375,7 @@ extern void handle_prog(DESC *d, UTF8 *message);
 // From player.cpp
 //
 void record_login(dbref, bool, UTF8 *, UTF8 *, UTF8 *, UTF8 *);
-extern dbref connect_player(UTF8 *, UTF8 *, UTF8 *, UTF8 *, UTF8 *);
+extern dbref connect_player(dbref, bool, UTF8 *, UTF8 *, UTF8 *);
 
 
 #define DESC_ITER_PLAYER(p,d) \
@@ -358,6 +421,10 @@ extern "C" MUX_RESULT DCL_API pipepump(void);
 #ifdef UNIX_SSL
 void CleanUpSSLConnections(void);
 #endif
+#if defined(UNIX_ZLIB)
+void CleanUpCompression(void);
+void process_output_compressed(DESC *d);
+#endif // UNIX_ZLIB
 
 extern NAMETAB sigactions_nametab[];
 
@@ -365,6 +432,15 @@ extern NAMETAB sigactions_nametab[];
 extern int maxd;
 #endif // UNIX_NETWORKING_SELECT
 
+#if defined(UNIX_NETWORKING_EPOLL)
+extern void update_desc_events(DESC *d);
+#endif // UNIX_NETWORKING_EPOLL
+
+#if defined(UNIX_NETWORKING) && defined(UNIX_THREADS)
+bool wake_init(void);
+void wake_game_thread(void);
+#endif // UNIX_NETWORKING && UNIX_THREADS
+
 extern long DebugTotalSockets;
 
 #if defined(WINDOWS_NETWORKING)
@@ -13,6 +13,10 @@
 #include "command.h"
 #include "mathutil.h"
 
+#if defined(UNIX_THREADS)
+#include <atomic>
+#endif // UNIX_THREADS
+
 NAMETAB logdata_nametab[] =
 {
     {T("flags"),           1,  0,  LOGOPT_FLAGS},
@@ -107,7 +111,6 @@ bool start_log(const UTF8 * primary, const UTF8 * secondary)
 void end_log(void)
 {
     Log.WriteString((UTF8 *) ENDLINE);
-    Log.Flush();
     mudstate.logging--;
 }
 
@@ -134,7 +137,6 @@ void log_perror(const UTF8 * primary, const UTF8 * secondary,
 #ifndef WIN32
     Log.WriteString((UTF8 *) ENDLINE);
 #endif // !WIN32
-    Log.Flush();
     mudstate.logging--;
 }
 
@@ -365,6 +367,410 @@ void do_log
 }
 
 CLogFile Log;
+
+#define FILE_SIZE_TRIGGER (512*1024UL)
+
+#if defined(UNIX_THREADS)
+/* ---------------------------------------------------------------------------
+ * CLogWriter: Background log writer.
+ *
+ * When log_buffer_size is non-zero, CLogFile copies log text into a ring
+ * and a writer thread makes the write() calls, so a slow disk does not stall
+ * the game.  There is exactly one producer (the game thread), which advances
+ * m_iTail to publish text, and one consumer (the writer thread), which
+ * advances m_iHead once text is written.  The mutex and condition variables
+ * are only used to sleep and wake up, never to guard the text itself.
+ */
+
+#define SIZEOF_LOG_RING (256*1024)
+
+class CLogWriter
+{
+public:
+    CLogWriter(int fd);
+    ~CLogWriter(void);
+    bool Start(void);
+    void Append(size_t nString, const UTF8 *pString);
+    void Publish(void);
+    void Drain(void);
+    void Stop(void);
+    bool Failed(void);
+    void WriteUnpublished(void);
+
+private:
+    static void *ThreadProc(void *pArg);
+    void Run(void);
+    size_t Space(void) const
+    {
+        return SIZEOF_LOG_RING - (m_iEnd - m_iHead.load(std::memory_order_acquire));
+    }
+
+    int       m_fd;
+    pthread_t m_thread;
+    bool      m_bStarted;
+    bool      m_bStop;              // Guarded by m_mutex.
+    pthread_mutex_t m_mutex;
+    pthread_cond_t  m_condWork;     // Text was published, or stop requested.
+    pthread_cond_t  m_condDone;     // Text was written.
+    size_t    m_iEnd;               // End of appended text (game thread only).
+    std::atomic<size_t> m_iTail;    // End of published text.
+    std::atomic<size_t> m_iHead;    // End of written text.
+    std::atomic<bool>   m_bFailed;
+    UTF8      m_aRing[SIZEOF_LOG_RING];
+};
+
+CLogWriter::CLogWriter(int fd)
+{
+    m_fd = fd;
+    m_bStarted = false;
+    m_bStop = false;
+    m_iEnd = 0;
+    m_iTail = 0;
+    m_iHead = 0;
+    m_bFailed = false;
+    pthread_mutex_init(&m_mutex, nullptr);
+    pthread_cond_init(&m_condWork, nullptr);
+    pthread_cond_init(&m_condDone, nullptr);
+}
+
+CLogWriter::~CLogWriter(void)
+{
+    Stop();
+    pthread_cond_destroy(&m_condDone);
+    pthread_cond_destroy(&m_condWork);
+    pthread_mutex_destroy(&m_mutex);
+}
+
+// Only the child side of a fork() needs attention.  The writer thread does
+// not exist there, and the text in the ring belongs to the parent.
+//
+static void log_atfork_child(void)
+{
+    Log.AfterFork();
+}
+
+bool CLogWriter::Start(void)
+{
+    static bool bAtFork = false;
+    if (!bAtFork)
+    {
+        bAtFork = (0 == pthread_atfork(nullptr, nullptr, log_atfork_child));
+        if (!bAtFork)
+        {
+            return false;
+        }
+    }
+
+    // The writer thread should never see the game's signals, so it starts
+    // with all of them blocked.
+    //
+    sigset_t sigAll, sigSave;
+    sigfillset(&sigAll);
+    pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+    m_bStarted = (0 == pthread_create(&m_thread, nullptr, ThreadProc, this));
+    pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
+    return m_bStarted;
+}
+
+void *CLogWriter::ThreadProc(void *pArg)
+{
+    static_cast<CLogWriter *>(pArg)->Run();
+    return nullptr;
+}
+
+void CLogWriter::Run(void)
+{
+    pthread_mutex_lock(&m_mutex);
+    for (;;)
+    {
+        size_t iHead = m_iHead.load(std::memory_order_relaxed);
+        size_t iTail = m_iTail.load(std::memory_order_acquire);
+        if (iHead == iTail)
+        {
+            if (m_bStop)
+            {
+                break;
+            }
+            pthread_cond_wait(&m_condWork, &m_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&m_mutex);
+
+        while (iHead != iTail)
+        {
+            size_t iRing = iHead % SIZEOF_LOG_RING;
+            size_t nWrite = iTail - iHead;
+            if (SIZEOF_LOG_RING - iRing < nWrite)
+            {
+                nWrite = SIZEOF_LOG_RING - iRing;
+            }
+
+            ssize_t written = mux_write(m_fd, m_aRing + iRing, nWrite);
+            if (written <= 0)
+            {
+                if (  written < 0
+                   && EINTR == errno)
+                {
+                    continue;
+                }
+
+                // There is no recourse but to drop the text.
+                //
+                m_bFailed = true;
+                written = nWrite;
+            }
+            iHead += written;
+        }
+        m_iHead.store(iHead, std::memory_order_release);
+
+        pthread_mutex_lock(&m_mutex);
+        pthread_cond_broadcast(&m_condDone);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void CLogWriter::Append(size_t nString, const UTF8 *pString)
+{
+    while (0 < nString)
+    {
+        size_t nSpace = Space();
+        if (0 == nSpace)
+        {
+            // The ring is full, so wait for the writer to make room.
+            //
+            Publish();
+            pthread_mutex_lock(&m_mutex);
+            while (0 == Space())
+            {
+                pthread_cond_wait(&m_condDone, &m_mutex);
+            }
+            pthread_mutex_unlock(&m_mutex);
+            continue;
+        }
+
+        size_t iRing = m_iEnd % SIZEOF_LOG_RING;
+        size_t nMove = nString;
+        if (nSpace < nMove)
+        {
+            nMove = nSpace;
+        }
+        if (SIZEOF_LOG_RING - iRing < nMove)
+        {
+            nMove = SIZEOF_LOG_RING - iRing;
+        }
+        memcpy(m_aRing + iRing, pString, nMove);
+        pString += nMove;
+        nString -= nMove;
+        m_iEnd  += nMove;
+    }
+}
+
+void CLogWriter::Publish(void)
+{
+    if (m_iTail.load(std::memory_order_relaxed) != m_iEnd)
+    {
+        m_iTail.store(m_iEnd, std::memory_order_release);
+        pthread_mutex_lock(&m_mutex);
+        pthread_cond_signal(&m_condWork);
+        pthread_mutex_unlock(&m_mutex);
+    }
+}
+
+void CLogWriter::Drain(void)
+{
+    Publish();
+    pthread_mutex_lock(&m_mutex);
+    while (m_iHead.load(std::memory_order_acquire) != m_iEnd)
+    {
+        pthread_cond_wait(&m_condDone, &m_mutex);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void CLogWriter::Stop(void)
+{
+    if (m_bStarted)
+    {
+        Publish();
+        pthread_mutex_lock(&m_mutex);
+        m_bStop = true;
+        pthread_cond_signal(&m_condWork);
+        pthread_mutex_unlock(&m_mutex);
+        pthread_join(m_thread, nullptr);
+        m_bStarted = false;
+    }
+}
+
+bool CLogWriter::Failed(void)
+{
+    return m_bFailed.exchange(false);
+}
+
+/*! \brief Writes appended but unpublished text directly to the file.
+ *
+ * This takes no locks and never waits on the writer thread, so it is safe
+ * inside a signal handler even if the fault was taken with m_mutex held or
+ * while the writer thread is stuck in write().  Text which was already
+ * published is left to the writer thread.
+ *
+ * \return  None.
+ */
+
+void CLogWriter::WriteUnpublished(void)
+{
+    size_t iTail = m_iTail.load(std::memory_order_relaxed);
+    while (iTail != m_iEnd)
+    {
+        size_t iRing = iTail % SIZEOF_LOG_RING;
+        size_t nWrite = m_iEnd - iTail;
+        if (SIZEOF_LOG_RING - iRing < nWrite)
+        {
+            nWrite = SIZEOF_LOG_RING - iRing;
+        }
+
+        ssize_t written = mux_write(m_fd, m_aRing + iRing, nWrite);
+        if (written <= 0)
+        {
+            if (  written < 0
+               && EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        iTail += written;
+    }
+
+    // The writer thread never sees this text.
+    //
+    m_iEnd = m_iTail.load(std::memory_order_relaxed);
+}
+
+/*! \brief Decides whether log text should go to the writer thread.
+ *
+ * Text is written directly when log_buffer_size is zero, while panicking, in
+ * standalone mode, when logging to stderr, and when there is no log file.
+ * Switching back to direct writes first lets the writer thread finish.
+ *
+ * \return  true if WriteBuffer() should hand text to m_pWriter.
+ */
+
+bool CLogFile::WriteBehind(void)
+{
+    static bool bWriterFailed = false;
+    if (  mudstate.panicking
+       || m_bWriteThrough)
+    {
+        // Stopping the writer thread here could deadlock inside a signal
+        // handler, so leave it idle and write directly.
+        //
+        return false;
+    }
+    else if (  0 < mudconf.log_buffer_size
+            && !bUseStderr
+            && !mudstate.bStandAlone
+            && MUX_OPEN_INVALID_HANDLE_VALUE != m_fdFile
+            && !bWriterFailed)
+    {
+        if (nullptr == m_pWriter)
+        {
+            try
+            {
+                m_pWriter = new CLogWriter(m_fdFile);
+            }
+            catch (...)
+            {
+                ; // Nothing.
+            }
+
+            if (  nullptr != m_pWriter
+               && !m_pWriter->Start())
+            {
+                delete m_pWriter;
+                m_pWriter = nullptr;
+            }
+
+            if (nullptr == m_pWriter)
+            {
+                bWriterFailed = true;
+                return false;
+            }
+            m_nPending = 0;
+        }
+        return true;
+    }
+    StopWriter();
+    return false;
+}
+
+// Publishes the text appended since the last hand-off, and starts a new log
+// file if this one has grown too large.
+//
+void CLogFile::HandOff(void)
+{
+    m_pWriter->Publish();
+    m_nSize += m_nPending;
+    m_nPending = 0;
+
+    if (m_pWriter->Failed())
+    {
+        raw_broadcast(WIZARD,
+            T("GAME: Unable to write to the log.  The disk may be full."));
+    }
+
+    if (FILE_SIZE_TRIGGER < m_nSize)
+    {
+        RotateLogFile();
+    }
+}
+
+void CLogFile::StopWriter(void)
+{
+    CLogWriter *pWriter = m_pWriter;
+    if (nullptr != pWriter)
+    {
+        m_pWriter = nullptr;
+        m_nSize += m_nPending;
+        m_nPending = 0;
+        pWriter->Stop();
+        bool bFailed = pWriter->Failed();
+        delete pWriter;
+
+        if (bFailed)
+        {
+            raw_broadcast(WIZARD,
+                T("GAME: Unable to write to the log.  The disk may be full."));
+        }
+    }
+}
+
+void CLogFile::AfterFork(void)
+{
+    m_pWriter = nullptr;
+    m_nPending = 0;
+}
+#endif // UNIX_THREADS
+
+/*! \brief Writes out everything buffered and writes later text directly.
+ *
+ * Used by emergency_shutdown() so that the log is on disk before the panic
+ * dump begins, and so that nothing logged during the dump waits in the ring.
+ *
+ * \return  None.
+ */
+
+void CLogFile::WriteThrough(void)
+{
+#if defined(UNIX_THREADS)
+    m_bWriteThrough = true;
+    if (!mudstate.panicking)
+    {
+        StopWriter();
+    }
+#endif // UNIX_THREADS
+    Flush();
+}
+
 void CLogFile::WriteInteger(int iNumber)
 {
     UTF8 aTempBuffer[I32BUF_SIZE];
@@ -379,6 +785,19 @@ void CLogFile::WriteBuffer(size_t nString, const UTF8 * pString)
         return;
     }
 
+#if defined(UNIX_THREADS)
+    if (WriteBehind())
+    {
+        m_pWriter->Append(nString, pString);
+        m_nPending += nString;
+        if (static_cast<size_t>(mudconf.log_buffer_size) < m_nPending)
+        {
+            HandOff();
+        }
+        return;
+    }
+#endif // UNIX_THREADS
+
 #if defined(WINDOWS_THREADS)
     EnterCriticalSection(&csLog);
 #endif // WINDOWS_THREADS
@@ -510,6 +929,10 @@ void CLogFile::AppendLogFile(void)
 
 void CLogFile::CloseLogFile(void)
 {
+#if defined(UNIX_THREADS)
+    StopWriter();
+#endif // UNIX_THREADS
+
 #if defined(WINDOWS_FILES)
     if (INVALID_HANDLE_VALUE != m_hFile)
     {
@@ -525,10 +948,31 @@ void CLogFile::CloseLogFile(void)
 #endif // UNIX_FILES
 }
 
-#define FILE_SIZE_TRIGGER (512*1024UL)
-
 void CLogFile::Flush(void)
 {
+#if defined(UNIX_THREADS)
+    if (nullptr != m_pWriter)
+    {
+        if (mudstate.panicking)
+        {
+            // HandOff() and Drain() take locks and may broadcast or rotate
+            // the log, none of which is safe from a signal handler.
+            //
+            m_pWriter->WriteUnpublished();
+            m_nSize += m_nPending;
+            m_nPending = 0;
+        }
+        else
+        {
+            HandOff();
+            if (nullptr != m_pWriter)
+            {
+                m_pWriter->Drain();
+            }
+        }
+    }
+#endif // UNIX_THREADS
+
     if (  m_nBuffer <= 0
        || !bEnabled)
     {
@@ -564,18 +1008,43 @@ void CLogFile::Flush(void)
 
         if (m_nSize > FILE_SIZE_TRIGGER)
         {
-            CloseLogFile();
-
-            m_ltaStarted.GetLocal();
-            MakeLogName(m_pBasename, m_szPrefix, m_ltaStarted, m_szFilename,
-                sizeof(m_szFilename));
-
-            CreateLogFile();
+            RotateLogFile();
         }
     }
     m_nBuffer = 0;
 }
 
+/*! \brief Hands buffered log text to the writer thread.
+ *
+ * Called every log_flush_interval so that text does not sit in the ring
+ * waiting for log_buffer_size bytes to accumulate.
+ *
+ * \return  None.
+ */
+
+void CLogFile::Tick(void)
+{
+#if defined(UNIX_THREADS)
+    if (  nullptr != m_pWriter
+       && WriteBehind()
+       && 0 < m_nPending)
+    {
+        HandOff();
+    }
+#endif // UNIX_THREADS
+}
+
+void CLogFile::RotateLogFile(void)
+{
+    CloseLogFile();
+
+    m_ltaStarted.GetLocal();
+    MakeLogName(m_pBasename, m_szPrefix, m_ltaStarted, m_szFilename,
+        sizeof(m_szFilename));
+
+    CreateLogFile();
+}
+
 void CLogFile::SetPrefix(const UTF8 * szPrefix)
 {
     if (  !bUseStderr
@@ -649,6 +1118,11 @@ CLogFile::CLogFile(void)
     m_pBasename = nullptr;
     m_szPrefix[0] = '\0';
     m_szFilename[0] = '\0';
+#if defined(UNIX_THREADS)
+    m_pWriter = nullptr;
+    m_nPending = 0;
+    m_bWriteThrough = false;
+#endif // UNIX_THREADS
 }
 
 void CLogFile::StartLogging()
@@ -665,6 +1139,9 @@ void CLogFile::StartLogging()
 
 void CLogFile::StopLogging(void)
 {
+#if defined(UNIX_THREADS)
+    StopWriter();
+#endif // UNIX_THREADS
     Flush();
     bEnabled = false;
     if (!bUseStderr)
@@ -37,6 +37,7 @@ struct confdata
 {
     bool    autozone;           // New objects are automatically zoned.
     bool    cache_names;        /* Should object names be cached separately */
+    bool    cache_mmap;         // Map the page file instead of caching pages.
     bool    clone_copy_cost;    /* Does @clone copy value? */
     bool    compress_db;        // should we use compress.
     bool    dark_sleepers;      /* Are sleeping players 'dark'? */
@@ -71,6 +72,7 @@ struct confdata
     bool    safe_wipe;          // If yes, SAFE flag must be removed to @wipe.
     bool    safer_passwords;    /* enforce reasonably good password choices? */
     bool    see_own_dark;       /* Do you see your own dark stuff? */
+    bool    snapshot_db;        // Write dumps as binary snapshots.
     bool    space_compress;     /* Convert multiple spaces into one space */
     bool    sweep_dark;         /* Can you sweep dark places? */
     bool    switch_df_all;      /* Should @switch match all by default? */
@@ -97,10 +99,12 @@ struct confdata
 
     int     active_q_chunk;     /* # cmds to run from queue when active */
     int     cache_pages;        // Size of hash page cache (in pages).
+    int     cache_compact_pages; // Pages copied per step of @dump/compact.
     int     check_interval;     /* interval between db check/cleans in secs */
     int     check_offset;       /* when to perform first check and clean */
     int     cmd_quota_incr;     /* Bump #cmds allowed by this each timeslice */
     int     cmd_quota_max;      /* Max commands at one time */
+    int     compress_level;     // zlib level for dumps, or 0 for none.
     int     conn_timeout;       /* Allow this long to connect before booting */
     int     control_flags;      /* Global runtime control flags */
     int     createmax;          /* max cost of @create command */
@@ -108,19 +112,23 @@ struct confdata
     int     digcost;            /* cost of @dig command */
     int     dump_interval;      /* interval between ckp dumps in seconds */
     int     dump_offset;        /* when to take first checkpoint dump */
+    int     dump_slice;         // Objects written per step of a journaled dump.
     int     events_daily_hour;  /* At what hour should @daily be executed? */
     int     exit_quota;         /* quota needed to make an exit */
     int     func_invk_lim;      /* Max funcs invoked by a command */
     int     func_nest_lim;      /* Max nesting of functions */
     int     idle_interval;      /* when to check for idle users */
     int     idle_timeout;       /* Boot off players idle this long in secs */
+    int     incremental_dumps;  // Journal checkpoints between full dumps.
     int     init_size;          // initial db size.
     int     keepalive_interval; /* when to send keep alive */
     int     killguarantee;      /* cost of kill cmd that guarantees success */
     int     killmax;            /* max cost of kill command */
     int     killmin;            /* default (and minimum) cost of kill cmd */
     int     linkcost;           /* cost of @link command */
+    int     load_threads;       // Threads used to decode the flatfile.
     int     lock_nest_lim;      /* Max nesting of lock evals */
+    int     log_buffer_size;    // Log text held for the writer thread.
     int     log_info;           /* Info that goes into log entries */
     int     log_options;        /* What gets logged */
     int     machinecost;        /* One in mc+1 cmds costs 1 penny (POW2-1) */
@@ -135,6 +143,10 @@ struct confdata
     int     room_name_charset;  // Charset restrictions for room names.
     int     thing_name_charset; // Charset restrictions for thing names.
     int     password_methods;   // Password encryption methods.
+    int     password_threads;   // Threads used to check and hash passwords.
+    int     resolver_threads;   // Threads used to look up host names.
+    int     resolver_cache_ttl; // Seconds a host name is cached.
+    int     resolver_negative_ttl; // Seconds a failed lookup is cached.
     int     default_charset;    // Default client charset mapping.
 #ifdef REALITY_LVLS
     int     no_levels;          /* Number of reality levels */
@@ -182,7 +194,6 @@ struct confdata
     int     vattr_flags;        /* Attr flags for all user-defined attrs */
     int     vattr_per_hour;     // Maximum allowed vattrs per hour per object.
     int     waitcost;           /* cost of @wait (refunded when finishes) */
-    int     wild_invk_lim;      // Max Regular Expression function calls.
     int     zone_nest_lim;      /* Max nesting of zones */
     int     restrict_home;      // Special condition to restrict 'home' command
     int     float_precision;    // Maximum precision of float-to-string conversion.
@@ -263,6 +274,7 @@ struct confdata
     CLinearTimeDelta rpt_cmdsecs;  /* Reporting Threshhold for time taken by command */
     CLinearTimeDelta max_cmdsecs;  /* Upper Limit for real time taken by command */
     CLinearTimeDelta cache_tick_period; // Minor cycle for cache maintenance.
+    CLinearTimeDelta log_flush_interval; // Longest wait for buffered log text.
     CLinearTimeDelta timeslice;         // How often do we bump people's cmd quotas?
 
     FLAGSET exit_flags;         /* Flags exits start with */
@@ -412,6 +424,7 @@ typedef struct badname_struc BADNAME;
 struct badname_struc
 {
     UTF8    *name;
+    UTF8    *compiled;      /* name as a compiled wildcard pattern, or nullptr */
     struct badname_struc    *next;
 };
 
@@ -426,6 +439,7 @@ typedef struct attr_permission_list ATTRPERM;
 struct attr_permission_list
 {
     UTF8    *wildcard;
+    UTF8    *compiled;      /* wildcard as a compiled pattern, or nullptr */
     int      flags;
     struct attr_permission_list *next;
 };
@@ -441,6 +455,7 @@ struct statedata
     bool bStandAlone;           // Are we running in dbconvert mode.
     bool panicking;             // are we in the middle of dying horribly?
     bool shutdown_flag;         // Should interface be shut down?
+    bool bJournal;              // Are changes tracked for the checkpoint journal?
     bool inpipe;                // Are we collecting output for a pipe?
 #if defined(HAVE_WORKING_FORK)
     bool          restarting;   // Are we restarting?
@@ -464,6 +479,7 @@ struct statedata
     int     events_flag;        /* Flags for check_events */
     int     func_invk_ctr;      /* Functions invoked so far by this command */
     int     func_nest_lev;      /* Current nesting of functions */
+    UINT32  func_generation;    // Changes whenever func_htab or ufunc_htab does.
     int     generation;         /* DB global generation number */
     int     in_loop;            // Loop nesting level.
     int     lock_nest_lev;      /* Current nesting of lock evals */
@@ -482,7 +498,6 @@ struct statedata
     int     ntfy_nest_lev;      // Current nesting of notifys.
     int     train_nest_lev;     // Current nesting of train.
     int     record_players;     // The maximum # of player logged on.
-    int     wild_invk_ctr;      // Regular Expression function calls.
     int     zone_nest_num;      /* Global current zone nest position */
     int     mstat_idrss[2];     /* Summed private data size */
     int     mstat_isrss[2];     /* Summed private stack size */
@@ -542,12 +557,15 @@ struct statedata
     CHashTable flags_htab;      /* Flags hashtable */
     CHashTable func_htab;       /* Functions hashtable */
     CHashTable fwdlist_htab;    /* Room forwardlists */
+    CHashTable lock_htab;       // Parsed locks by object and lock attribute.
     CHashTable logout_cmd_htab; /* Logged-out commands hashtable (WHO, etc) */
     CHashTable mail_htab;       /* Mail players hashtable */
     CHashTable parent_htab;     /* Parent $-command exclusion */
     CHashTable player_htab;     /* Player name->number hashtable */
     CHashTable powers_htab;     /* Powers hashtable */
     CHashTable reference_htab;  /* @reference hashtable */
+    CHashTable regexp_htab;     // Compiled regular expressions by pattern.
+    CHashTable queue_htab;      // Queued commands by executor, owner, and semaphore.
     CHashTable ufunc_htab;      /* Local functions hashtable */
     CHashTable vattr_name_htab; /* User attribute names hashtable */
     CHashTable scratch_htab;    /* Multi-purpose scratch hash table */
@@ -557,6 +575,8 @@ struct statedata
     CBitField bfCommands;       // Cache knowledge that there are $-Commands.
     CBitField bfListens;        // Cache knowledge that there are ^-Commands.
 
+    CBitField bfDirty;          // Objects changed since the last checkpoint.
+
     CBitField bfReport;         // Used for LROOMS.
     CBitField bfTraverse;       // Used for LROOMS.
 };
@@ -316,7 +316,7 @@ static void add_to_output_queue(DESC *d, const UTF8 *b, size_t n)
     //
     if (nullptr == d->output_head)
     {
-        tp = (TBLOCK *)MEMALLOC(OUTPUT_BLOCK_SIZE);
+        tp = alloc_tblock("add_to_output_queue.first");
         if (nullptr != tp)
         {
             tp->hdr.nxt = nullptr;
@@ -327,6 +327,9 @@ static void add_to_output_queue(DESC *d, const UTF8 *b, size_t n)
 
             d->output_head = tp;
             d->output_tail = tp;
+#if defined(UNIX_NETWORKING_EPOLL)
+            update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
         }
         else
         {
@@ -347,11 +350,13 @@ static void add_to_output_queue(DESC *d, const UTF8 *b, size_t n)
         // string.  If so, copy it and update the pointers.
         //
         // We cannot update a buffer marked TBLK_FLAG_LOCKED.  If fact, we
-        // should not read or write to such a buffer in any fashion.
+        // should not read or write to such a buffer in any fashion.  A buffer
+        // marked TBLK_FLAG_COMPRESSED is already in wire form, and text
+        // appended to it would escape compression.
         //
         left = OUTPUT_BLOCK_SIZE - (tp->hdr.end - (UTF8 *)tp + 1);
         if (  n <= left
-           && 0 == (tp->hdr.flags & TBLK_FLAG_LOCKED))
+           && 0 == (tp->hdr.flags & (TBLK_FLAG_LOCKED|TBLK_FLAG_COMPRESSED)))
         {
             memcpy(tp->hdr.end, b, n);
             tp->hdr.end += n;
@@ -364,7 +369,7 @@ static void add_to_output_queue(DESC *d, const UTF8 *b, size_t n)
             // what will fit, allocate another buffer, and retry.
             //
             if (  0 < left
-               && 0 == (tp->hdr.flags & TBLK_FLAG_LOCKED))
+               && 0 == (tp->hdr.flags & (TBLK_FLAG_LOCKED|TBLK_FLAG_COMPRESSED)))
             {
                 memcpy(tp->hdr.end, b, left);
                 tp->hdr.end += left;
@@ -373,7 +378,7 @@ static void add_to_output_queue(DESC *d, const UTF8 *b, size_t n)
                 n -= left;
             }
 
-            tp = (TBLOCK *)MEMALLOC(OUTPUT_BLOCK_SIZE);
+            tp = alloc_tblock("add_to_output_queue.next");
             if (nullptr != tp)
             {
                 tp->hdr.nxt = nullptr;
@@ -436,7 +441,19 @@ void queue_write_LEN(DESC *d, const UTF8 *b, size_t n)
     //
     if (static_cast<size_t>(mudconf.output_limit) < d->output_size + n)
     {
-        process_output(d, false);
+#if defined(UNIX_ZLIB)
+        if (nullptr != d->mccp)
+        {
+            // Compressing the queued text now would leave nothing which
+            // could be thrown away below.
+            //
+            process_output_compressed(d);
+        }
+        else
+#endif // UNIX_ZLIB
+        {
+            process_output(d, false);
+        }
     }
 
     if (static_cast<size_t>(mudconf.output_limit) < d->output_size + n)
@@ -474,28 +491,56 @@ void queue_write_LEN(DESC *d, const UTF8 *b, size_t n)
             }
             else
 #endif
-            if (0 == (tp->hdr.flags & TBLK_FLAG_LOCKED))
-            {
-                STARTLOG(LOG_NET, "NET", "WRITE");
-                UTF8 *buf = alloc_lbuf("queue_write.LOG");
-                mux_sprintf(buf, LBUF_SIZE, T("[%u/%s] Output buffer overflow, %d chars discarded by "),
-                    d->descriptor, d->addr, tp->hdr.nchars);
-                log_text(buf);
-                free_lbuf(buf);
-                if (d->flags & DS_CONNECTED)
+            {
+                // Dropping part of a compressed stream would corrupt the
+                // rest of it, so the oldest text which has not been
+                // compressed yet is thrown away instead.
+                //
+                TBLOCK *prev = nullptr;
+                while (  nullptr != tp
+                      && 0 != (tp->hdr.flags & TBLK_FLAG_COMPRESSED))
                 {
-                    log_name(d->player);
+                    prev = tp;
+                    tp = tp->hdr.nxt;
                 }
-                ENDLOG;
-                d->output_size -= tp->hdr.nchars;
-                d->output_head = tp->hdr.nxt;
-                d->output_lost += tp->hdr.nchars;
-                if (d->output_head == nullptr)
+
+                if (  nullptr != tp
+                   && 0 == (tp->hdr.flags & TBLK_FLAG_LOCKED))
                 {
-                    d->output_tail = nullptr;
+                    STARTLOG(LOG_NET, "NET", "WRITE");
+                    UTF8 *buf = alloc_lbuf("queue_write.LOG");
+                    mux_sprintf(buf, LBUF_SIZE, T("[%u/%s] Output buffer overflow, %llu chars discarded by "),
+                        d->descriptor, d->addr, static_cast<UINT64>(tp->hdr.nchars));
+                    log_text(buf);
+                    free_lbuf(buf);
+                    if (d->flags & DS_CONNECTED)
+                    {
+                        log_name(d->player);
+                    }
+                    ENDLOG;
+                    d->output_size -= tp->hdr.nchars;
+                    d->output_lost += tp->hdr.nchars;
+                    if (nullptr == prev)
+                    {
+                        d->output_head = tp->hdr.nxt;
+                    }
+                    else
+                    {
+                        prev->hdr.nxt = tp->hdr.nxt;
+                    }
+                    if (d->output_tail == tp)
+                    {
+                        d->output_tail = prev;
+                    }
+#if defined(UNIX_NETWORKING_EPOLL)
+                    if (nullptr == d->output_head)
+                    {
+                        update_desc_events(d);
+                    }
+#endif // UNIX_NETWORKING_EPOLL
+                    free_tblock(tp);
+                    tp = nullptr;
                 }
-                MEMFREE(tp);
-                tp = nullptr;
             }
         }
     }
@@ -621,7 +666,14 @@ void queue_string(DESC *d, const UTF8 *s)
     queue_write(d, q);
 }
 
-void queue_string(DESC *d, const mux_string &s)
+/*! \brief Convert a message to the bytes sent to one descriptor.
+ *
+ * \param d         Network descriptor state.
+ * \param s         Message.
+ * \return          '\0'-terminated bytes ready for queue_write().
+ */
+
+static const UTF8 *render_string(DESC *d, const mux_string &s)
 {
     const UTF8 *p = s.export_TextConverted((d->flags & DS_CONNECTED) && Ansi(d->player), NoBleed(d->player), Color256(d->player), Html(d->player));
 
@@ -650,8 +702,114 @@ void queue_string(DESC *d, const mux_string &s)
         }
     }
 
-    q = encode_iac(q);
-    queue_write(d, q);
+    return encode_iac(q);
+}
+
+/*! \brief Describe the settings of a descriptor which affect render_string().
+ *
+ * \param d         Network descriptor state.
+ * \return          Key which is equal for descriptors that render alike.
+ */
+
+static int render_key(DESC *d)
+{
+    int iKey = d->encoding << 4;
+    if (  (d->flags & DS_CONNECTED)
+       && Ansi(d->player))
+    {
+        iKey |= 1;
+    }
+    if (NoBleed(d->player))
+    {
+        iKey |= 2;
+    }
+    if (Color256(d->player))
+    {
+        iKey |= 4;
+    }
+    if (Html(d->player))
+    {
+        iKey |= 8;
+    }
+    return iKey;
+}
+
+mux_render_cache *mux_render_cache::m_pActive = nullptr;
+
+mux_render_cache::mux_render_cache(const mux_string &sMsg)
+{
+    m_psMsg = &sMsg;
+    m_nEntries = 0;
+    m_pPrevious = m_pActive;
+    m_pActive = this;
+}
+
+mux_render_cache::~mux_render_cache(void)
+{
+    for (int i = 0; i < m_nEntries; i++)
+    {
+        MEMFREE(m_aEntries[i].pText);
+        m_aEntries[i].pText = nullptr;
+    }
+    m_pActive = m_pPrevious;
+}
+
+/*! \brief Queue a message from an active cache if one holds it.
+ *
+ * \param d         Network descriptor state.
+ * \param sMsg      Message.
+ * \param iKey      render_key() for d.
+ * \return          true if the message was queued.
+ */
+
+bool mux_render_cache::queue(DESC *d, const mux_string &sMsg, int iKey)
+{
+    for (mux_render_cache *prc = m_pActive; nullptr != prc; prc = prc->m_pPrevious)
+    {
+        if (  &sMsg != prc->m_psMsg
+           && !sMsg.equal(*prc->m_psMsg))
+        {
+            continue;
+        }
+
+        for (int i = 0; i < prc->m_nEntries; i++)
+        {
+            if (iKey == prc->m_aEntries[i].iKey)
+            {
+                queue_write_LEN(d, prc->m_aEntries[i].pText, prc->m_aEntries[i].nText);
+                return true;
+            }
+        }
+
+        if (RENDER_CACHE_SIZE <= prc->m_nEntries)
+        {
+            return false;
+        }
+
+        const UTF8 *q = render_string(d, sMsg);
+        size_t n = strlen(reinterpret_cast<const char *>(q));
+        UTF8 *pText = reinterpret_cast<UTF8 *>(MEMALLOC(n+1));
+        ISOUTOFMEMORY(pText);
+        memcpy(pText, q, n+1);
+
+        entry *pe = &prc->m_aEntries[prc->m_nEntries++];
+        pe->iKey = iKey;
+        pe->nText = n;
+        pe->pText = pText;
+
+        queue_write_LEN(d, pText, n);
+        return true;
+    }
+    return false;
+}
+
+void queue_string(DESC *d, const mux_string &s)
+{
+    if (mux_render_cache::queue(d, s, render_key(d)))
+    {
+        return;
+    }
+    queue_write(d, render_string(d, s));
 }
 
 void freeqs(DESC *d)
@@ -663,7 +821,7 @@ void freeqs(DESC *d)
     while (tb)
     {
         tnext = tb->hdr.nxt;
-        MEMFREE(tb);
+        free_tblock(tb);
         tb = tnext;
     }
     d->output_head = nullptr;
@@ -784,6 +942,9 @@ void save_command(DESC *d, CBLK *command)
         // We have added our first command to an empty list. Go process it later.
         //
         scheduler.DeferImmediateTask(PRIORITY_SYSTEM, Task_ProcessCommand, d, 0);
+#if defined(UNIX_NETWORKING_EPOLL)
+        update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
     }
     else
     {
@@ -1015,6 +1176,7 @@ static void announce_connect(dbref player, DESC *d)
     s_Flags(player, FLAG_WORD2, Flags2(player) & ~VACATION);
     if (Guest(player))
     {
+        s_Dirty(player);
         db[player].fs.word[FLAG_WORD1] &= ~DARK;
     }
 
@@ -1333,11 +1495,13 @@ void announce_disconnect(dbref player, DESC *d, const UTF8 *reason)
         if (d->flags & DS_AUTODARK)
         {
             d->flags &= ~DS_AUTODARK;
+            s_Dirty(player);
             db[player].fs.word[FLAG_WORD1] &= ~DARK;
         }
 
         if (Guest(player))
         {
+            s_Dirty(player);
             db[player].fs.word[FLAG_WORD1] |= DARK;
             halt_que(NOTHING, player);
         }
@@ -1633,6 +1797,7 @@ void check_idle(void)
                     }
                     if (!bFound)
                     {
+                        s_Dirty(d->player);
                         db[d->player].fs.word[FLAG_WORD1] |= DARK;
                         DESC_ITER_PLAYER(d->player, d1)
                         {
@@ -2292,8 +2457,7 @@ void init_logout_cmdtab(void)
 
 static void failconn(const UTF8 *logcode, const UTF8 *logtype, const UTF8 *logreason,
                      DESC *d, int disconnect_reason,
-                     dbref player, int filecache, UTF8 *motd_msg, UTF8 *command,
-                     UTF8 *user, UTF8 *password, const UTF8 *cmdsave)
+                     dbref player, int filecache, UTF8 *motd_msg, const UTF8 *user)
 {
     STARTLOG(LOG_LOGIN | LOG_SECURITY, logcode, "RJCT");
     UTF8 *buff = alloc_mbuf("failconn.LOG");
@@ -2318,22 +2482,234 @@ static void failconn(const UTF8 *logcode, const UTF8 *logtype, const UTF8 *logre
         queue_string(d, motd_msg);
         queue_write_LEN(d, T("\r\n"), 2);
     }
-    free_lbuf(command);
-    free_lbuf(user);
-    free_lbuf(password);
     shutdownsock(d, disconnect_reason);
-    mudstate.debug_cmd = cmdsave;
-    return;
 }
 
 static const UTF8 *connect_fail = T("Either that player does not exist, or has a different password.\r\n");
 
-static bool check_connect(DESC *d, UTF8 *msg)
+/*! \brief Finishes a connect to an existing player.
+ *
+ * \param d        Network descriptor.
+ * \param player   Player, or NOTHING if the name or password was wrong.
+ * \param bDark    Connect dark (the 'cd' command).
+ * \param isGuest  The player is a guest created for this connect.
+ * \param user     Name given.
+ * \return         None.
+ */
+
+static void check_connect_player(DESC *d, dbref player, bool bDark, bool isGuest, const UTF8 *user)
 {
     UTF8 *buff;
-    dbref player, aowner;
+    dbref aowner;
     int aflags, nplayers;
     DESC *d2;
+
+    int host_info = mudstate.access_list.check(&d->address);
+
+    // See if this connection would exceed the max #players.
+    //
+    if (mudconf.max_players < 0)
+    {
+        nplayers = mudconf.max_players - 1;
+    }
+    else
+    {
+        nplayers = 0;
+        DESC_ITER_CONN(d2)
+        {
+            nplayers++;
+        }
+    }
+
+    if (  player == NOTHING
+       || (!isGuest && Guest.CheckGuest(player)))
+    {
+        // Not a player, or wrong password.
+        //
+        queue_write(d, connect_fail);
+        STARTLOG(LOG_LOGIN | LOG_SECURITY, "CON", "BAD");
+        buff = alloc_lbuf("check_conn.LOG.bad");
+        mux_sprintf(buff, LBUF_SIZE, T("[%u/%s] Failed connect to \xE2\x80\x98%s\xE2\x80\x99"), d->descriptor, d->addr, user);
+        log_text(buff);
+        free_lbuf(buff);
+        ENDLOG;
+        if (--(d->retries_left) <= 0)
+        {
+            shutdownsock(d, R_BADLOGIN);
+        }
+    }
+    else if (  (  (mudconf.control_flags & CF_LOGIN)
+               && (nplayers < mudconf.max_players))
+            || RealWizRoy(player)
+            || God(player))
+    {
+        if (  bDark
+           && (  RealWizard(player)
+              || God(player)))
+        {
+            s_Dirty(player);
+            db[player].fs.word[FLAG_WORD1] |= DARK;
+        }
+
+        // Make sure we don't have a guest from an unwanted host.
+        // The majority of these are handled above.
+        //
+        // The following code handles the case where a staffer
+        // (#1-only by default) has specifically given the guest 'power'
+        // to an existing player.
+        //
+        // In this case, the player -already- has an account complete
+        // with password. We still fail the connection to -this- player
+        // but if the site isn't register_sited, this player can simply
+        // auto-create another player. So, the procedure is not much
+        // different from @newpassword'ing them. Oh well. We are just
+        // following orders. ;)
+        //
+        if (  Guest(player)
+           && (host_info & HI_NOGUEST))
+        {
+            failconn(T("CON"), T("Connect"), T("Guest Site Forbidden"), d,
+                R_GAMEDOWN, player, FC_CONN_SITE,
+                mudconf.downmotd_msg, user);
+            return;
+        }
+
+        // Logins are enabled, or wiz or god.
+        //
+        STARTLOG(LOG_LOGIN, "CON", "LOGIN");
+        buff = alloc_mbuf("check_conn.LOG.login");
+        mux_sprintf(buff, MBUF_SIZE, T("[%u/%s] Connected to "), d->descriptor, d->addr);
+        log_text(buff);
+        log_name_and_loc(player);
+        free_mbuf(buff);
+        ENDLOG;
+        d->flags |= DS_CONNECTED;
+        d->connected_at.GetUTC();
+        d->player = player;
+
+        // Check to see if the player is currently running an
+        // @program. If so, drop the new descriptor into it.
+        //
+        DESC_ITER_PLAYER(player, d2)
+        {
+            if (  nullptr != d2->program_data
+               && nullptr == d->program_data)
+            {
+                d->program_data = d2->program_data;
+            }
+            else if (nullptr != d2->program_data)
+            {
+                // Enforce that all program_data pointers for this player
+                // are the same.
+                //
+                mux_assert(d->program_data == d2->program_data);
+            }
+        }
+
+        // Give the player the MOTD file and the settable MOTD
+        // message(s). Use raw notifies so the player doesn't try
+        // to match on the text.
+        //
+        if (Guest(player))
+        {
+            fcache_dump(d, FC_CONN_GUEST);
+        }
+        else
+        {
+            buff = atr_get("check_connect.2375", player, A_LAST, &aowner, &aflags);
+            if (*buff == '\0')
+                fcache_dump(d, FC_CREA_NEW);
+            else
+                fcache_dump(d, FC_MOTD);
+            if (Wizard(player))
+                fcache_dump(d, FC_WIZMOTD);
+            free_lbuf(buff);
+        }
+        announce_connect(player, d);
+
+        DESC* dtemp;
+        int num_con = 0;
+        DESC_ITER_PLAYER(player, dtemp)
+        {
+            num_con++;
+        }
+        local_connect(player, 0, num_con);
+
+        ServerEventsSinkNode *pNode = g_pServerEventsSinkListHead;
+        while (nullptr != pNode)
+        {
+            pNode->pSink->connect(player, 0, num_con);
+            pNode = pNode->pNext;
+        }
+
+        // If stuck in an @prog, show the prompt.
+        //
+        if (nullptr != d->program_data)
+        {
+            queue_write_LEN(d, T(">\377\371"), 3);
+        }
+
+    }
+    else if (!(mudconf.control_flags & CF_LOGIN))
+    {
+        failconn(T("CON"), T("Connect"), T("Logins Disabled"), d, R_GAMEDOWN, player, FC_CONN_DOWN,
+            mudconf.downmotd_msg, user);
+    }
+    else
+    {
+        failconn(T("CON"), T("Connect"), T("Game Full"), d, R_GAMEFULL, player, FC_CONN_FULL,
+            mudconf.fullmotd_msg, user);
+    }
+}
+
+/*! \brief Called once the password for a connect has been checked.
+ *
+ * \param player    Player.
+ * \param bValid    Whether the password was correct.
+ * \param pContext  PENDING_CONNECT.
+ * \param iContext  Unused.
+ * \return          None.
+ */
+
+static void connect_verified(dbref player, bool bValid, void *pContext, int iContext)
+{
+    UNUSED_PARAMETER(iContext);
+
+    PENDING_CONNECT *pc = (PENDING_CONNECT *)pContext;
+    DESC *d = pc->d;
+    if (nullptr != d)
+    {
+        const UTF8 *cmdsave = mudstate.debug_cmd;
+        mudstate.debug_cmd = T("< check_connect >");
+
+        // Let held input go.
+        //
+        d->pending_connect = nullptr;
+        if (nullptr != d->input_head)
+        {
+            scheduler.CancelTask(Task_ProcessCommand, d, 0);
+            scheduler.DeferImmediateTask(PRIORITY_SYSTEM, Task_ProcessCommand, d, 0);
+        }
+
+        player = connect_player(player, bValid, pc->aAddr, pc->aUsername, pc->aHostAddress);
+        check_connect_player(d, player, pc->bDark, pc->bGuest, pc->aUser);
+        mudstate.debug_cmd = cmdsave;
+    }
+    else if (!bValid)
+    {
+        // Hanging up does not hide a bad password.
+        //
+        connect_player(player, false, pc->aAddr, pc->aUsername, pc->aHostAddress);
+    }
+    MEMFREE(pc);
+}
+
+static bool check_connect(DESC *d, UTF8 *msg)
+{
+    UTF8 *buff;
+    dbref player;
+    int nplayers;
+    DESC *d2;
     const UTF8 *p;
     bool isGuest = false;
 
@@ -2374,7 +2750,11 @@ static bool check_connect(DESC *d, UTF8 *msg)
                 //
                 failconn(T("CONN"), T("Connect"), T("Guest Site Forbidden"), d,
                     R_GAMEDOWN, NOTHING, FC_CONN_REG, mudconf.downmotd_msg,
-                    command, user, password, cmdsave);
+                    user);
+                free_lbuf(command);
+                free_lbuf(user);
+                free_lbuf(password);
+                mudstate.debug_cmd = cmdsave;
                 return false;
             }
 
@@ -2406,170 +2786,37 @@ static bool check_connect(DESC *d, UTF8 *msg)
             }
         }
 
-        // See if this connection would exceed the max #players.
+        // The password is checked off the game thread when it can be.
+        // Input on this descriptor waits until the check finishes.
         //
-        if (mudconf.max_players < 0)
+        const bool bDark = (strncmp((char *)command, "cd", 2) == 0);
+        player = lookup_player(NOTHING, user, false);
+        if (NOTHING == player)
         {
-            nplayers = mudconf.max_players - 1;
+            check_connect_player(d, NOTHING, bDark, isGuest, user);
         }
         else
         {
-            nplayers = 0;
-            DESC_ITER_CONN(d2)
-            {
-                nplayers++;
-            }
-        }
-
-        UTF8 host_address[MBUF_SIZE];
-        d->address.ntop(host_address, sizeof(host_address));
-        player = connect_player(user, password, d->addr, d->username, host_address);
-        if (  player == NOTHING
-           || (!isGuest && Guest.CheckGuest(player)))
-        {
-            // Not a player, or wrong password.
-            //
-            queue_write(d, connect_fail);
-            STARTLOG(LOG_LOGIN | LOG_SECURITY, "CON", "BAD");
-            buff = alloc_lbuf("check_conn.LOG.bad");
-            mux_sprintf(buff, LBUF_SIZE, T("[%u/%s] Failed connect to \xE2\x80\x98%s\xE2\x80\x99"), d->descriptor, d->addr, user);
-            log_text(buff);
-            free_lbuf(buff);
-            ENDLOG;
-            if (--(d->retries_left) <= 0)
-            {
-                free_lbuf(command);
-                free_lbuf(user);
-                free_lbuf(password);
-                shutdownsock(d, R_BADLOGIN);
-                mudstate.debug_cmd = cmdsave;
-                return false;
-            }
+            PENDING_CONNECT *pc = (PENDING_CONNECT *)MEMALLOC(sizeof(PENDING_CONNECT));
+            ISOUTOFMEMORY(pc);
+            pc->d = d;
+            pc->bDark = bDark;
+            pc->bGuest = isGuest;
+            mux_strncpy(pc->aUser, user, sizeof(pc->aUser)-1);
+            mux_strncpy(pc->aAddr, d->addr, sizeof(pc->aAddr)-1);
+            mux_strncpy(pc->aUsername, d->username, sizeof(pc->aUsername)-1);
+            d->address.ntop(pc->aHostAddress, sizeof(pc->aHostAddress));
+            d->pending_connect = pc;
+            check_pass_later(player, password, nullptr, connect_verified, pc, 0);
         }
-        else if (  (  (mudconf.control_flags & CF_LOGIN)
-                   && (nplayers < mudconf.max_players))
-                || RealWizRoy(player)
-                || God(player))
-        {
-            if (  strncmp((char *)command, "cd", 2) == 0
-               && (  RealWizard(player)
-                  || God(player)))
-            {
-                db[player].fs.word[FLAG_WORD1] |= DARK;
-            }
-
-            // Make sure we don't have a guest from an unwanted host.
-            // The majority of these are handled above.
-            //
-            // The following code handles the case where a staffer
-            // (#1-only by default) has specifically given the guest 'power'
-            // to an existing player.
-            //
-            // In this case, the player -already- has an account complete
-            // with password. We still fail the connection to -this- player
-            // but if the site isn't register_sited, this player can simply
-            // auto-create another player. So, the procedure is not much
-            // different from @newpassword'ing them. Oh well. We are just
-            // following orders. ;)
-            //
-            if (  Guest(player)
-               && (host_info & HI_NOGUEST))
-            {
-                failconn(T("CON"), T("Connect"), T("Guest Site Forbidden"), d,
-                    R_GAMEDOWN, player, FC_CONN_SITE,
-                    mudconf.downmotd_msg, command, user, password,
-                    cmdsave);
-                return false;
-            }
-
-            // Logins are enabled, or wiz or god.
-            //
-            STARTLOG(LOG_LOGIN, "CON", "LOGIN");
-            buff = alloc_mbuf("check_conn.LOG.login");
-            mux_sprintf(buff, MBUF_SIZE, T("[%u/%s] Connected to "), d->descriptor, d->addr);
-            log_text(buff);
-            log_name_and_loc(player);
-            free_mbuf(buff);
-            ENDLOG;
-            d->flags |= DS_CONNECTED;
-            d->connected_at.GetUTC();
-            d->player = player;
-
-            // Check to see if the player is currently running an
-            // @program. If so, drop the new descriptor into it.
-            //
-            DESC_ITER_PLAYER(player, d2)
-            {
-                if (  nullptr != d2->program_data
-                   && nullptr == d->program_data)
-                {
-                    d->program_data = d2->program_data;
-                }
-                else if (nullptr != d2->program_data)
-                {
-                    // Enforce that all program_data pointers for this player
-                    // are the same.
-                    //
-                    mux_assert(d->program_data == d2->program_data);
-                }
-            }
-
-            // Give the player the MOTD file and the settable MOTD
-            // message(s). Use raw notifies so the player doesn't try
-            // to match on the text.
-            //
-            if (Guest(player))
-            {
-                fcache_dump(d, FC_CONN_GUEST);
-            }
-            else
-            {
-                buff = atr_get("check_connect.2375", player, A_LAST, &aowner, &aflags);
-                if (*buff == '\0')
-                    fcache_dump(d, FC_CREA_NEW);
-                else
-                    fcache_dump(d, FC_MOTD);
-                if (Wizard(player))
-                    fcache_dump(d, FC_WIZMOTD);
-                free_lbuf(buff);
-            }
-            announce_connect(player, d);
-
-            DESC* dtemp;
-            int num_con = 0;
-            DESC_ITER_PLAYER(player, dtemp)
-            {
-                num_con++;
-            }
-            local_connect(player, 0, num_con);
-
-            ServerEventsSinkNode *pNode = g_pServerEventsSinkListHead;
-            while (nullptr != pNode)
-            {
-                pNode->pSink->connect(player, 0, num_con);
-                pNode = pNode->pNext;
-            }
-
-            // If stuck in an @prog, show the prompt.
-            //
-            if (nullptr != d->program_data)
-            {
-                queue_write_LEN(d, T(">\377\371"), 3);
-            }
 
-        }
-        else if (!(mudconf.control_flags & CF_LOGIN))
-        {
-            failconn(T("CON"), T("Connect"), T("Logins Disabled"), d, R_GAMEDOWN, player, FC_CONN_DOWN,
-                mudconf.downmotd_msg, command, user, password, cmdsave);
-            return false;
-        }
-        else
-        {
-            failconn(T("CON"), T("Connect"), T("Game Full"), d, R_GAMEFULL, player, FC_CONN_FULL,
-                mudconf.fullmotd_msg, command, user, password, cmdsave);
-            return false;
-        }
+        // d may be gone now.
+        //
+        free_lbuf(command);
+        free_lbuf(user);
+        free_lbuf(password);
+        mudstate.debug_cmd = cmdsave;
+        return true;
     }
     else if (strncmp((char *)command, "cr", 2) == 0)
     {
@@ -2578,7 +2825,11 @@ static bool check_connect(DESC *d, UTF8 *msg)
         if (!(mudconf.control_flags & CF_LOGIN))
         {
             failconn(T("CRE"), T("Create"), T("Logins Disabled"), d, R_GAMEDOWN, NOTHING, FC_CONN_DOWN,
-                mudconf.downmotd_msg, command, user, password, cmdsave);
+                mudconf.downmotd_msg, user);
+            free_lbuf(command);
+            free_lbuf(user);
+            free_lbuf(password);
+            mudstate.debug_cmd = cmdsave;
             return false;
         }
 
@@ -2602,8 +2853,11 @@ static bool check_connect(DESC *d, UTF8 *msg)
             //
             failconn(T("CRE"), T("Create"), T("Game Full"), d,
                 R_GAMEFULL, NOTHING, FC_CONN_FULL,
-                mudconf.fullmotd_msg, command, user, password,
-                cmdsave);
+                mudconf.fullmotd_msg, user);
+            free_lbuf(command);
+            free_lbuf(user);
+            free_lbuf(password);
+            mudstate.debug_cmd = cmdsave;
             return false;
         }
         if (host_info & HI_REGISTER)
@@ -2938,7 +3192,12 @@ void Task_ProcessCommand(void *arg_voidptr, int arg_iInteger)
     UNUSED_PARAMETER(arg_iInteger);
 
     DESC *d = (DESC *)arg_voidptr;
-    if (d)
+
+    // Input waits while a connect is checking a password.  It is started
+    // again when the check finishes.
+    //
+    if (  d
+       && nullptr == d->pending_connect)
     {
         CBLK *t = d->input_head;
         if (t)
@@ -2956,6 +3215,9 @@ void Task_ProcessCommand(void *arg_voidptr, int arg_iInteger)
                 else
                 {
                     d->input_tail = nullptr;
+#if defined(UNIX_NETWORKING_EPOLL)
+                    update_desc_events(d);
+#endif // UNIX_NETWORKING_EPOLL
                 }
                 d->input_size -= strlen((char *)t->cmd);
                 d->last_time.GetUTC();
@@ -503,6 +503,7 @@ dbref create_obj(dbref player, int objtype, const UTF8 *name, int cost)
         s_Zone(obj, NOTHING);
     }
     f.word[FLAG_WORD1] |= objtype;
+    s_Dirty(obj);
     db[obj].fs = f;
     s_Owner(obj, (self_owned ? obj : owner));
     s_Pennies(obj, value);
@@ -886,6 +887,7 @@ static void purge_going(void)
                 }
                 log_text(T("GOING object doesn\xE2\x80\x99t remember its destroyer. GOING reset."));
                 ENDLOG;
+                s_Dirty(i);
                 db[i].fs.word[FLAG_WORD1] &= ~GOING;
             }
             else
@@ -1032,6 +1034,10 @@ static void check_dead_refs(void)
                     owner = GOD;
                 }
                 s_Owner(i, owner);
+                if (!mudstate.bStandAlone)
+                {
+                    chown_que(i);
+                }
             }
         }
 
@@ -282,6 +282,15 @@ static void EncodeBase64(size_t nIn, const UTF8 *pIn, UTF8 *pOut)
 
 const UTF8 szFail[] = "$FAIL$$";
 
+// mux_crypt() also runs on the password threads, so the buffers it returns
+// are kept per thread.
+//
+#if defined(UNIX_THREADS)
+#define CRYPT_BUFFER static thread_local
+#else
+#define CRYPT_BUFFER static
+#endif // UNIX_THREADS
+
 const UTF8 szSHA1Prefix[] = "$SHA1$";
 #define SHA1_PREFIX_LENGTH (sizeof(szSHA1Prefix)-1)
 #define SHA1_HASH_LENGTH 5*sizeof(UINT32)
@@ -400,15 +409,18 @@ static const UTF8 *GenerateSalt(int iType)
     return szSalt;
 }
 
+// Password methods, from most to least preferred.
+//
+static const int aPassMethods[] = { CRYPT_SHA512, CRYPT_SHA256, CRYPT_MD5, CRYPT_SHA1, CRYPT_DES };
+
 void ChangePassword(dbref player, const UTF8 *szPassword)
 {
     int iTypeOut;
     const UTF8 *pEncodedPassword = nullptr;
-    int methods[] = { CRYPT_SHA512, CRYPT_SHA256, CRYPT_MD5, CRYPT_SHA1, CRYPT_DES };
-    for (size_t i = 0; i < sizeof(methods)/sizeof(methods[0]); i++)
+    for (size_t i = 0; i < sizeof(aPassMethods)/sizeof(aPassMethods[0]); i++)
     {
-        if (  (mudconf.password_methods & methods[i])
-           && nullptr != (pEncodedPassword = mux_crypt(szPassword, GenerateSalt(methods[i]), &iTypeOut)))
+        if (  (mudconf.password_methods & aPassMethods[i])
+           && nullptr != (pEncodedPassword = mux_crypt(szPassword, GenerateSalt(aPassMethods[i]), &iTypeOut)))
         {
             break;
         }
@@ -437,7 +449,7 @@ const UTF8 *p6h_xx_crypt(const UTF8 *szPassword)
     // 1234567890123456789012345678
     // $P6H$$XXhhhhhhhhhhhhhhhhhhhh
     //
-    static UTF8 buf[P6H_PREFIX_LENGTH + 1 + P6H_XX_HASH_LENGTH_MAX + 1 + 16];
+    CRYPT_BUFFER UTF8 buf[P6H_PREFIX_LENGTH + 1 + P6H_XX_HASH_LENGTH_MAX + 1 + 16];
     mux_strncpy(buf, szP6HPrefix, P6H_PREFIX_LENGTH);
     buf[P6H_PREFIX_LENGTH] = '$';
 
@@ -474,7 +486,7 @@ const UTF8 *p6h_vaht_crypt(const UTF8 *szPassword, const UTF8 *szSetting)
         // 123456789012345678901234567890123456789012345678901234567890123456
         // $P6H$$1:sha1:hhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhh:tttttttttttt
         //
-        static UTF8 buff[LBUF_SIZE];
+        CRYPT_BUFFER UTF8 buff[LBUF_SIZE];
         UTF8 *bufc = buff;
 
         safe_str(szP6HPrefix1SHA1, buff, &bufc);
@@ -617,7 +629,31 @@ const UTF8 *mux_crypt(const UTF8 *szPassword, const UTF8 *szSetting, int *piType
 #endif // WINDOWS_CRYPT
 
     case CRYPT_DES:
-#if defined(HAVE_CRYPT)
+#if defined(HAVE_CRYPT) && defined(UNIX_THREADS) && defined(HAVE_CRYPT_R)
+        {
+            CRYPT_BUFFER struct crypt_data cd;
+            return (UTF8 *)crypt_r((char *)szPassword, (char *)szSetting, &cd);
+        }
+#elif defined(HAVE_CRYPT) && defined(UNIX_THREADS)
+        {
+            // crypt() is not reentrant, so calls are taken one at a time, and
+            // each thread gets its own copy of the result.
+            //
+            static pthread_mutex_t mtxCrypt = PTHREAD_MUTEX_INITIALIZER;
+            CRYPT_BUFFER UTF8 buf[MBUF_SIZE];
+            const UTF8 *pResult = nullptr;
+            pthread_mutex_lock(&mtxCrypt);
+            const char *p = crypt((char *)szPassword, (char *)szSetting);
+            if (  nullptr != p
+               && strlen(p) < sizeof(buf))
+            {
+                mux_strncpy(buf, (const UTF8 *)p, sizeof(buf)-1);
+                pResult = buf;
+            }
+            pthread_mutex_unlock(&mtxCrypt);
+            return pResult;
+        }
+#elif defined(HAVE_CRYPT)
         return (UTF8 *)crypt((char *)szPassword, (char *)szSetting);
 #else
         return szFail;
@@ -638,7 +674,7 @@ const UTF8 *mux_crypt(const UTF8 *szPassword, const UTF8 *szSetting, int *piType
     // 12345678901234567890123456789012345678901234567
     // $SHA1$ssssssssssss$hhhhhhhhhhhhhhhhhhhhhhhhhhhh
     //
-    static UTF8 buf[SHA1_PREFIX_LENGTH + SHA1_ENCODED_SALT_LENGTH + 1 + SHA1_ENCODED_HASH_LENGTH + 1 + 16];
+    CRYPT_BUFFER UTF8 buf[SHA1_PREFIX_LENGTH + SHA1_ENCODED_SALT_LENGTH + 1 + SHA1_ENCODED_HASH_LENGTH + 1 + 16];
     mux_strncpy(buf, szSHA1Prefix, SHA1_PREFIX_LENGTH);
     memcpy(buf + SHA1_PREFIX_LENGTH, pSaltField, nSaltField);
     buf[SHA1_PREFIX_LENGTH + nSaltField] = '$';
@@ -647,57 +683,422 @@ const UTF8 *mux_crypt(const UTF8 *szPassword, const UTF8 *szSetting, int *piType
 }
 
 /* ---------------------------------------------------------------------------
- * check_pass: Test a password to see if it is correct.
+ * Password threads.
+ *
+ * Checking or hashing a password with the stronger methods takes several
+ * milliseconds, which is enough for a burst of connection attempts to stall
+ * the game.  When password_threads is non-zero, check_pass_later() and
+ * ChangePasswordLater() hand the work to a small pool of threads and return
+ * at once.  Once a job is finished, the game thread is woken, and the job is
+ * completed from the scheduler.
+ *
+ * A job carries copies of everything it needs, so the threads never touch the
+ * database.  They also never log or allocate.  Jobs for the same player always
+ * go to the same thread, so they finish in the order they were started.
+ * Without the threads, the same work is done at once, and the callback runs
+ * before the function returns.
  */
 
-static bool check_pass(dbref player, const UTF8 *pPassword)
+typedef struct pass_job PASS_JOB;
+struct pass_job
 {
-    bool bValidPass  = false;
-    int  iType;
+    PASS_JOB      *pNext;
+    dbref          player;
+    PASS_CALLBACK *pfDone;
+    void          *pContext;
+    int            iContext;
+    int            iMethods;     // password_methods when the job was started.
+    bool           bVerify;      // Check aPassword against aTarget.
+    bool           bHash;        // Hash aNew with aSalt.
+    bool           bRehash;      // aPassword was hashed again with aSalt.
+    bool           bValid;
+    UTF8           aPassword[MBUF_SIZE];
+    UTF8           aTarget[MBUF_SIZE];
+    UTF8           aNew[MBUF_SIZE];
+    UTF8           aSalt[SBUF_SIZE];
+    UTF8           aHash[MBUF_SIZE];
+};
 
-    int   aflags;
-    dbref aowner;
-    UTF8 *pTarget = atr_get("check_pass.466", player, A_PASS, &aowner, &aflags);
-    if (*pTarget)
+// The method ChangePassword() tries first.
+//
+static int PreferredMethod(void)
+{
+    for (size_t i = 0; i < sizeof(aPassMethods)/sizeof(aPassMethods[0]); i++)
+    {
+        if (mudconf.password_methods & aPassMethods[i])
+        {
+            return aPassMethods[i];
+        }
+    }
+    return CRYPT_SHA1;
+}
+
+// Runs on a password thread, or on the game thread when there are none.
+//
+static void pass_work(PASS_JOB *pj)
+{
+    const UTF8 *pNew = pj->aNew;
+    bool bHash = pj->bHash;
+    pj->aHash[0] = '\0';
+
+    if (pj->bVerify)
+    {
+        int iType;
+        const UTF8 *p = mux_crypt(pj->aPassword, pj->aTarget, &iType);
+        pj->bValid = (  '\0' != pj->aTarget[0]
+                     && nullptr != p
+                     && strcmp((const char *)p, (const char *)pj->aTarget) == 0);
+        if (!pj->bValid)
+        {
+            return;
+        }
+
+        if (  !bHash
+           && 0 == (iType & pj->iMethods))
+        {
+            // Bring the stored password up to a current method.
+            //
+            pNew = pj->aPassword;
+            pj->bRehash = true;
+            bHash = true;
+        }
+    }
+
+    if (bHash)
     {
-        if (strcmp((char *)mux_crypt(pPassword, pTarget, &iType), (char *)pTarget) == 0)
+        int iType;
+        const UTF8 *p = mux_crypt(pNew, pj->aSalt, &iType);
+        if (  nullptr != p
+           && strlen((const char *)p) < sizeof(pj->aHash))
         {
-            bValidPass = true;
-            if (0 == (iType & mudconf.password_methods))
+            mux_strncpy(pj->aHash, p, sizeof(pj->aHash)-1);
+        }
+    }
+}
+
+// Runs on the game thread.
+//
+static void pass_finish(PASS_JOB *pj)
+{
+    dbref player = pj->player;
+    bool bValid = pj->bValid;
+    if (  !Good_obj(player)
+       || !isPlayer(player))
+    {
+        bValid = false;
+    }
+    else
+    {
+        if (pj->bVerify)
+        {
+            // A check only counts against the password it was made with.
+            //
+            int   aflags;
+            dbref aowner;
+            UTF8 *pTarget = atr_get("pass_finish.721", player, A_PASS, &aowner, &aflags);
+            if (strcmp((char *)pTarget, (char *)pj->aTarget) != 0)
+            {
+                bValid = false;
+            }
+            free_lbuf(pTarget);
+        }
+
+        if (  bValid
+           && (  pj->bHash
+              || pj->bRehash))
+        {
+            if ('\0' != pj->aHash[0])
+            {
+                s_Pass(player, pj->aHash);
+            }
+            else
             {
-                ChangePassword(player, pPassword);
+                // The preferred method failed, so try the others.
+                //
+                ChangePassword(player, pj->bRehash ? pj->aPassword : pj->aNew);
             }
         }
     }
-#if 0
-    else if (GOD == player)
+
+    if (nullptr != pj->pfDone)
+    {
+        pj->pfDone(player, bValid, pj->pContext, pj->iContext);
+    }
+    memset(pj, 0, sizeof(PASS_JOB));
+    MEMFREE(pj);
+}
+
+#if defined(UNIX_THREADS)
+#define PASS_MAX_THREADS 16
+
+typedef struct
+{
+    pthread_t      thread;
+    pthread_cond_t cvWork;
+    PASS_JOB      *pHead;        // Guarded by mtxPass.
+    PASS_JOB      *pTail;
+} PASS_THREAD;
+
+static PASS_THREAD     aPassThreads[PASS_MAX_THREADS];
+static int             nPassThreads = 0;
+static bool            bPassStarted = false;
+static pthread_mutex_t mtxPass = PTHREAD_MUTEX_INITIALIZER;
+static PASS_JOB       *pPassDoneHead = nullptr;   // Guarded by mtxPass.
+static PASS_JOB       *pPassDoneTail = nullptr;
+
+static void *pass_thread(void *pArg)
+{
+    PASS_THREAD *pt = (PASS_THREAD *)pArg;
+
+    pthread_mutex_lock(&mtxPass);
+    for (;;)
+    {
+        PASS_JOB *pj = pt->pHead;
+        if (nullptr == pj)
+        {
+            pthread_cond_wait(&pt->cvWork, &mtxPass);
+            continue;
+        }
+        pt->pHead = pj->pNext;
+        if (nullptr == pt->pHead)
+        {
+            pt->pTail = nullptr;
+        }
+        pthread_mutex_unlock(&mtxPass);
+
+        pass_work(pj);
+
+        pthread_mutex_lock(&mtxPass);
+        pj->pNext = nullptr;
+        if (nullptr == pPassDoneTail)
+        {
+            pPassDoneHead = pj;
+        }
+        else
+        {
+            pPassDoneTail->pNext = pj;
+        }
+        pPassDoneTail = pj;
+        wake_game_thread();
+    }
+    return nullptr;
+}
+
+static bool pass_start(void)
+{
+    if (bPassStarted)
+    {
+        return (0 < nPassThreads);
+    }
+    bPassStarted = true;
+
+    int nWanted = mudconf.password_threads;
+    if (PASS_MAX_THREADS < nWanted)
+    {
+        nWanted = PASS_MAX_THREADS;
+    }
+    if (  nWanted <= 0
+       || !wake_init())
+    {
+        return false;
+    }
+
+    // The threads should never see the game's signals, so they start with
+    // all of them blocked.
+    //
+    sigset_t sigAll, sigSave;
+    sigfillset(&sigAll);
+    pthread_sigmask(SIG_SETMASK, &sigAll, &sigSave);
+    while (nPassThreads < nWanted)
+    {
+        PASS_THREAD *pt = &aPassThreads[nPassThreads];
+        pt->pHead = nullptr;
+        pt->pTail = nullptr;
+        pthread_cond_init(&pt->cvWork, nullptr);
+        if (0 != pthread_create(&pt->thread, nullptr, pass_thread, pt))
+        {
+            pthread_cond_destroy(&pt->cvWork);
+            break;
+        }
+        nPassThreads++;
+    }
+    pthread_sigmask(SIG_SETMASK, &sigSave, nullptr);
+
+    STARTLOG(LOG_STARTUP, "INI", "PASS");
+    log_printf(T("Started %d of %d password threads."), nPassThreads, nWanted);
+    ENDLOG;
+    return (0 < nPassThreads);
+}
+
+static void Task_PassDone(void *arg_voidptr, int arg_iInteger)
+{
+    UNUSED_PARAMETER(arg_iInteger);
+    pass_finish((PASS_JOB *)arg_voidptr);
+}
+
+/*! \brief Hands finished password jobs to the scheduler.
+ *
+ * Called on the game thread after a password thread wakes it.
+ *
+ * \return  None.
+ */
+
+void pass_reap(void)
+{
+    pthread_mutex_lock(&mtxPass);
+    PASS_JOB *pj = pPassDoneHead;
+    pPassDoneHead = nullptr;
+    pPassDoneTail = nullptr;
+    pthread_mutex_unlock(&mtxPass);
+
+    while (nullptr != pj)
+    {
+        PASS_JOB *pNext = pj->pNext;
+        scheduler.DeferImmediateTask(PRIORITY_SYSTEM, Task_PassDone, pj, 0);
+        pj = pNext;
+    }
+}
+#endif // UNIX_THREADS
+
+static void pass_submit(PASS_JOB *pj)
+{
+#if defined(UNIX_THREADS)
+    if (pass_start())
+    {
+        PASS_THREAD *pt = &aPassThreads[pj->player % nPassThreads];
+        pj->pNext = nullptr;
+        pthread_mutex_lock(&mtxPass);
+        if (nullptr == pt->pTail)
+        {
+            pt->pHead = pj;
+        }
+        else
+        {
+            pt->pTail->pNext = pj;
+        }
+        pt->pTail = pj;
+        pthread_cond_signal(&pt->cvWork);
+        pthread_mutex_unlock(&mtxPass);
+        return;
+    }
+#endif // UNIX_THREADS
+    pass_work(pj);
+    pass_finish(pj);
+}
+
+static PASS_JOB *pass_new_job(dbref player, PASS_CALLBACK *pfDone, void *pContext, int iContext)
+{
+    PASS_JOB *pj = (PASS_JOB *)MEMALLOC(sizeof(PASS_JOB));
+    ISOUTOFMEMORY(pj);
+    memset(pj, 0, sizeof(PASS_JOB));
+    pj->player   = player;
+    pj->pfDone   = pfDone;
+    pj->pContext = pContext;
+    pj->iContext = iContext;
+    pj->iMethods = mudconf.password_methods;
+    pj->bValid   = true;
+    mux_strncpy(pj->aSalt, GenerateSalt(PreferredMethod()), sizeof(pj->aSalt)-1);
+    return pj;
+}
+
+/*! \brief Checks a player's password, possibly on another thread.
+ *
+ * If the password is correct and pNewPassword is given, the player's password
+ * is changed to it.  Otherwise, a correct password stored with a method not
+ * in password_methods is hashed again with a current one.  The check is made
+ * against the password stored now, and it fails if that changes before the
+ * check is finished.
+ *
+ * \param player        Player whose password is checked.
+ * \param pPassword     Password given.
+ * \param pNewPassword  Replacement password, or nullptr.
+ * \param pfDone        Called on the game thread with the result.
+ * \param pContext      Passed to pfDone.
+ * \param iContext      Passed to pfDone.
+ * \return              None.
+ */
+
+void check_pass_later(dbref player, const UTF8 *pPassword, const UTF8 *pNewPassword,
+    PASS_CALLBACK *pfDone, void *pContext, int iContext)
+{
+    PASS_JOB *pj = pass_new_job(player, pfDone, pContext, iContext);
+    pj->bVerify = true;
+    pj->bValid  = false;
+
+    int   aflags;
+    dbref aowner;
+    UTF8 *pTarget = atr_get("check_pass_later.872", player, A_PASS, &aowner, &aflags);
+    if (  strlen((char *)pTarget) < sizeof(pj->aTarget)
+       && strlen((const char *)pPassword) < sizeof(pj->aPassword)
+       && (  nullptr == pNewPassword
+          || strlen((const char *)pNewPassword) < sizeof(pj->aNew)))
     {
-        // When GOD doesn't have a password, we need to a way to set one.
+        mux_strncpy(pj->aTarget, pTarget, sizeof(pj->aTarget)-1);
+        mux_strncpy(pj->aPassword, pPassword, sizeof(pj->aPassword)-1);
+        if (nullptr != pNewPassword)
+        {
+            mux_strncpy(pj->aNew, pNewPassword, sizeof(pj->aNew)-1);
+            pj->bHash = true;
+        }
+    }
+    else
+    {
+        // Nothing that long can match.
         //
-        bValidPass = true;
-        ChangePassword(player, pPassword);
+        pj->aTarget[0] = '\0';
     }
-#endif
     free_lbuf(pTarget);
-    return bValidPass;
+    pass_submit(pj);
+}
+
+/*! \brief Changes a player's password, possibly on another thread.
+ *
+ * \param player      Player whose password is changed.
+ * \param szPassword  New password.
+ * \param pfDone      Called on the game thread once the change is made, or nullptr.
+ * \param pContext    Passed to pfDone.
+ * \param iContext    Passed to pfDone.
+ * \return            None.
+ */
+
+void ChangePasswordLater(dbref player, const UTF8 *szPassword,
+    PASS_CALLBACK *pfDone, void *pContext, int iContext)
+{
+    if (strlen((const char *)szPassword) < MBUF_SIZE)
+    {
+        PASS_JOB *pj = pass_new_job(player, pfDone, pContext, iContext);
+        mux_strncpy(pj->aNew, szPassword, sizeof(pj->aNew)-1);
+        pj->bHash = true;
+        pass_submit(pj);
+    }
+    else
+    {
+        ChangePassword(player, szPassword);
+        if (nullptr != pfDone)
+        {
+            pfDone(player, true, pContext, iContext);
+        }
+    }
 }
 
 /* ---------------------------------------------------------------------------
- * connect_player: Try to connect to an existing player.
+ * connect_player: Finish a connect to an existing player once the password
+ * has been checked.
  */
 
-dbref connect_player(UTF8 *name, UTF8 *password, UTF8 *host, UTF8 *username, UTF8 *ipaddr)
+dbref connect_player(dbref player, bool bValid, UTF8 *host, UTF8 *username, UTF8 *ipaddr)
 {
+    if (  !Good_obj(player)
+       || !isPlayer(player))
+    {
+        return NOTHING;
+    }
+
     CLinearTimeAbsolute ltaNow;
     ltaNow.GetLocal();
     UTF8 *time_str = ltaNow.ReturnDateString(7);
 
-    dbref player = lookup_player(NOTHING, name, false);
-    if (player == NOTHING)
-    {
-        return NOTHING;
-    }
-    if (!check_pass(player, password))
+    if (!bValid)
     {
         record_login(player, false, time_str, host, username, ipaddr);
         return NOTHING;
@@ -797,6 +1198,28 @@ dbref create_player
  * do_password: Change the password for a player
  */
 
+static void password_done(dbref player, bool bValid, void *pContext, int iContext)
+{
+    UNUSED_PARAMETER(iContext);
+
+    if (!Good_obj(player))
+    {
+        return;
+    }
+    else if (!bValid)
+    {
+        notify(player, T("Sorry."));
+    }
+    else if (nullptr == pContext)
+    {
+        notify(player, T("Password changed."));
+    }
+    else
+    {
+        notify(player, (const UTF8 *)pContext);
+    }
+}
+
 void do_password
 (
     dbref executor,
@@ -823,19 +1246,19 @@ void do_password
     int   aflags;
     UTF8 *target = atr_get("do_password.618", executor, A_PASS, &aowner, &aflags);
     const UTF8 *pmsg;
-    if (  !*target
-       || !check_pass(executor, oldpass))
+    if (!*target)
     {
         notify(executor, T("Sorry."));
     }
     else if (ok_password(newpass, &pmsg))
     {
-        ChangePassword(executor, newpass);
-        notify(executor,(UTF8 *) "Password changed.");
+        check_pass_later(executor, oldpass, newpass, password_done, nullptr, 0);
     }
     else
     {
-        notify(executor, pmsg);
+        // A wrong old password is still reported ahead of a bad new one.
+        //
+        check_pass_later(executor, oldpass, nullptr, password_done, (void *)pmsg, 0);
     }
     free_lbuf(target);
 }
@@ -1157,6 +1580,16 @@ void badname_add(UTF8 *bad_name)
     if (nullptr != bp)
     {
         bp->name = StringClone(bad_name);
+        UTF8 *pCompiled = alloc_lbuf("badname_add");
+        if (0 != wild_compile(bad_name, pCompiled, LBUF_SIZE))
+        {
+            bp->compiled = StringClone(pCompiled);
+        }
+        else
+        {
+            bp->compiled = nullptr;
+        }
+        free_lbuf(pCompiled);
         bp->next = mudstate.badname_head;
         mudstate.badname_head = bp;
     }
@@ -1186,6 +1619,11 @@ void badname_remove(UTF8 *bad_name)
             }
             MEMFREE(bp->name);
             bp->name = nullptr;
+            if (nullptr != bp->compiled)
+            {
+                MEMFREE(bp->compiled);
+                bp->compiled = nullptr;
+            }
             delete bp;
             bp = nullptr;
             return;
@@ -1202,8 +1640,8 @@ bool badname_check(UTF8 *bad_name)
     //
     for (bp = mudstate.badname_head; bp; bp = bp->next)
     {
-        mudstate.wild_invk_ctr = 0;
-        if (quick_wild(bp->name, bad_name))
+        if (  nullptr != bp->compiled
+           && quick_wild_compiled(bp->compiled, bad_name))
         {
             return false;
         }
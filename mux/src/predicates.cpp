@@ -129,12 +129,7 @@ bool could_doit(dbref player, dbref thing, int locknum)
         return true;
     }
 
-    dbref aowner;
-    int   aflags;
-    UTF8 *key = atr_get("could_doit.134", thing, locknum, &aowner, &aflags);
-    bool doit = eval_boolexp_atr(player, thing, thing, key);
-    free_lbuf(key);
-    return doit;
+    return eval_boolexp_lock(player, thing, thing, locknum);
 }
 
 bool can_see(dbref player, dbref thing, bool can_see_loc)
@@ -1614,6 +1609,9 @@ void do_restart(dbref executor, dbref caller, dbref enactor, int eval, int key)
 #ifdef UNIX_SSL
     CleanUpSSLConnections();
 #endif
+#if defined(UNIX_ZLIB)
+    CleanUpCompression();
+#endif // UNIX_ZLIB
 
     local_presync_database();
     ServerEventsSinkNode *p = g_pServerEventsSinkListHead;
@@ -1632,6 +1630,7 @@ void do_restart(dbref executor, dbref caller, dbref enactor, int eval, int key)
 #endif
     pcache_sync();
     dump_database_internal(DUMP_I_RESTART);
+    journal_stop();
     SYNC;
     CLOSE;
 
@@ -2058,7 +2057,8 @@ bool bCanReadAttr(dbref executor, dbref target, ATTR *tattr, bool bCheckParent)
         ATTRPERM *perm_walk = mudstate.attrperm_list;
         while (nullptr != perm_walk)
         {
-            if (quick_wild(perm_walk->wildcard, tattr->name))
+            if (  nullptr != perm_walk->compiled
+               && quick_wild_compiled(perm_walk->compiled, tattr->name))
             {
                 test_flags |= perm_walk->flags;
             }
@@ -2148,7 +2148,8 @@ bool bCanSetAttr(dbref executor, dbref target, ATTR *tattr)
         ATTRPERM *perm_walk = mudstate.attrperm_list;
         while (nullptr != perm_walk)
         {
-            if (quick_wild(perm_walk->wildcard,tattr->name))
+            if (  nullptr != perm_walk->compiled
+               && quick_wild_compiled(perm_walk->compiled, tattr->name))
             {
                 test_flags |= perm_walk->flags;
             }
@@ -2204,7 +2205,8 @@ bool bCanLockAttr(dbref executor, dbref target, ATTR *tattr)
         ATTRPERM *perm_walk = mudstate.attrperm_list;
         while (nullptr != perm_walk)
         {
-            if (quick_wild(perm_walk->wildcard,tattr->name))
+            if (  nullptr != perm_walk->compiled
+               && quick_wild_compiled(perm_walk->compiled, tattr->name))
             {
                 test_flags |= perm_walk->flags;
             }
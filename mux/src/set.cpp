@@ -143,7 +143,7 @@ void do_chzone
 
     // Everything is okay, do the change.
     //
-    db[thing].zone = zone;
+    s_Zone(thing, zone);
     if (!isPlayer(thing))
     {
         // If the object is a player, resetting these flags is rather
@@ -802,6 +802,7 @@ void SetClearFlags
 )
 {
     int j;
+    s_Dirty(thing);
     for (j = FLAG_WORD1; j <= FLAG_WORD3; j++)
     {
         if (nullptr != aClearFlags)
@@ -1615,6 +1616,13 @@ void find_wild_attrs(dbref player, dbref thing, const UTF8 *str, bool check_excl
     dbref aowner;
     int ca, ok, aflags;
 
+    UTF8 *pCompiled = alloc_lbuf("find_wild_attrs");
+    if (0 == wild_compile(str, pCompiled, LBUF_SIZE))
+    {
+        free_lbuf(pCompiled);
+        return;
+    }
+
     // Walk the attribute list of the object.
     //
     atr_push();
@@ -1656,9 +1664,8 @@ void find_wild_attrs(dbref player, dbref thing, const UTF8 *str, bool check_excl
             ok = See_attr(player, thing, pattr);
         }
 
-        mudstate.wild_invk_ctr = 0;
         if (  ok
-           && quick_wild(str, pattr->name))
+           && quick_wild_compiled(pCompiled, pattr->name))
         {
             olist_add(ca);
             if (hash_insert)
@@ -1668,6 +1675,7 @@ void find_wild_attrs(dbref player, dbref thing, const UTF8 *str, bool check_excl
         }
     }
     atr_pop();
+    free_lbuf(pCompiled);
 }
 
 bool parse_attrib_wild(dbref player, const UTF8 *str, dbref *thing,
@@ -5808,6 +5808,7 @@ CF_HAND(cf_art_rule)
 mux_string::mux_string(void)
 {
     m_iLast = CursorMin;
+    m_autf = m_autfSmall;
     m_autf[0] = '\0';
     m_ncs = 0;
     m_pcs = nullptr;
@@ -5824,6 +5825,7 @@ mux_string::mux_string(void)
 mux_string::mux_string(const mux_string &sStr)
 {
     m_iLast = CursorMin;
+    m_autf = m_autfSmall;
     m_autf[0] = '\0';
     m_ncs = 0;
     m_pcs = nullptr;
@@ -5842,6 +5844,7 @@ mux_string::mux_string(const mux_string &sStr)
 mux_string::mux_string(const UTF8 *pStr)
 {
     m_iLast = CursorMin;
+    m_autf = m_autfSmall;
     m_autf[0] = '\0';
     m_ncs = 0;
     m_pcs = nullptr;
@@ -5850,7 +5853,8 @@ mux_string::mux_string(const UTF8 *pStr)
 
 /*! \brief Destructs mux_string object.
  *
- * This destructor deletes the m_pcs array if necessary.
+ * This destructor deletes the m_pcs array and releases the lbuf holding the
+ * text if necessary.
  *
  * \return         None.
  */
@@ -5858,6 +5862,11 @@ mux_string::mux_string(const UTF8 *pStr)
 mux_string::~mux_string(void)
 {
     realloc_m_pcs(0);
+    if (m_autfSmall != m_autf)
+    {
+        free_lbuf(m_autf);
+        m_autf = m_autfSmall;
+    }
 }
 
 /*! \brief Self-checks mux_string to validate the invariant.
@@ -5906,8 +5915,14 @@ void mux_string::Validate(void) const
     size_t nbytes  = 0;
     size_t npoints = 0;
 
+    // Text kept in the small buffer must fit there with its '\0'.
+    //
+    mux_assert(  m_autfSmall != m_autf
+              || m_iLast.m_byte < MUX_STRING_SMALL);
+
     const UTF8 *p = m_autf;
-    while (  p < (m_autf + LBUF_SIZE)
+    const UTF8 *pEnd = m_autf + ((m_autfSmall == m_autf) ? MUX_STRING_SMALL : LBUF_SIZE);
+    while (  p < pEnd
           && '\0' != *p)
     {
         // Each code point must be valid encoding.
@@ -5996,6 +6011,8 @@ void mux_string::append(const mux_string &sStr, mux_cursor iStart, mux_cursor iE
     LBUF_OFFSET nBytes = iEnd.m_byte - iStart.m_byte;
     LBUF_OFFSET nPoints = iEnd.m_point - iStart.m_point;
 
+    realloc_m_autf(m_iLast.m_byte + nBytes);
+
     if (  0 != m_ncs
        || 0 != sStr.m_ncs)
     {
@@ -6097,6 +6114,7 @@ void mux_string::append_TextPlain(const UTF8 *pStr)
         nLen = (LBUF_SIZE-1) - m_iLast.m_byte;
     }
 
+    realloc_m_autf(m_iLast.m_byte + nLen);
     memcpy(m_autf + m_iLast.m_byte, pStr, nLen * sizeof(m_autf[0]));
 
     mux_cursor i = m_iLast, j = i;
@@ -6138,6 +6156,8 @@ void mux_string::append_TextPlain(const UTF8 *pStr, size_t nLen)
         nLen = (LBUF_SIZE-1) - m_iLast.m_byte;
     }
 
+    realloc_m_autf(m_iLast.m_byte + nLen);
+
     if (0 != m_ncs)
     {
         realloc_m_pcs(m_iLast.m_point + nLen);
@@ -6328,15 +6348,68 @@ void mux_string::edit(mux_string &sFrom, const mux_string &sTo)
         }
 
         mux_cursor iStart = CursorMin, iFound = CursorMin;
-        mux_cursor nTo = sTo.m_iLast;
         bool bSucceeded = search(sFrom, &iFound);
+        if (!bSucceeded)
+        {
+            return;
+        }
+
+        if (CursorMin == nFrom)
+        {
+            // An empty pattern matches between every pair of characters, so
+            // each replacement must be searched past in the edited string.
+            //
+            mux_cursor nTo = sTo.m_iLast;
+            while (bSucceeded)
+            {
+                iStart = iFound;
+                replace_Chars(sTo, iStart, nFrom);
+                iStart = iStart + nTo;
+
+                if (iStart < m_iLast)
+                {
+                    bSucceeded = search(sFrom, &iFound, iStart);
+                }
+                else
+                {
+                    bSucceeded = false;
+                }
+            }
+            return;
+        }
+
+        // Build the result in a single pass instead of moving the rest of
+        // the string once for every replacement.
+        //
+        mux_string *sOut = new mux_string;
         while (bSucceeded)
         {
-            iStart = iFound;
-            replace_Chars(sTo, iStart, nFrom);
-            iStart = iStart + nTo;
+            sOut->append(*this, iStart, iFound);
 
-            if (iStart < m_iLast)
+            // Uncolored replacement text takes on the colors of the
+            // characters it lands on, continuing with the color of the last
+            // character past the end of the string.
+            //
+            mux_cursor iOut = sOut->m_iLast;
+            sOut->append(sTo);
+            if (  0 != m_ncs
+               && 0 == sTo.m_ncs)
+            {
+                sOut->realloc_m_pcs(sOut->m_iLast.m_point);
+                for (size_t i = 0; iOut.m_point + i < sOut->m_iLast.m_point; i++)
+                {
+                    size_t j = iFound.m_point + i;
+                    if (m_iLast.m_point <= j)
+                    {
+                        j = m_iLast.m_point - 1;
+                    }
+                    sOut->m_pcs[iOut.m_point + i] = m_pcs[j];
+                }
+            }
+            iStart = iFound + nFrom;
+
+            if (  iStart < m_iLast
+               && sOut->m_iLast.m_byte < LBUF_SIZE-1)
             {
                 bSucceeded = search(sFrom, &iFound, iStart);
             }
@@ -6345,7 +6418,32 @@ void mux_string::edit(mux_string &sFrom, const mux_string &sTo)
                 bSucceeded = false;
             }
         }
+        sOut->append(*this, iStart);
+        import(*sOut);
+        delete sOut;
+    }
+}
+
+/*! \brief Determines whether two strings have the same text and color.
+ *
+ * A string which carries an all-normal color array is not considered equal
+ * to the same text without one. Callers use this to reuse work done on an
+ * earlier string, so a false negative only costs that reuse.
+ *
+ * \param sStr     String to compare against.
+ * \return         true if text and color are identical.
+ */
+
+bool mux_string::equal(const mux_string &sStr) const
+{
+    if (  m_iLast != sStr.m_iLast
+       || (0 == m_ncs) != (0 == sStr.m_ncs)
+       || 0 != memcmp(m_autf, sStr.m_autf, m_iLast.m_byte))
+    {
+        return false;
     }
+    return (  0 == m_ncs
+           || 0 == memcmp(m_pcs, sStr.m_pcs, m_iLast.m_point * sizeof(m_pcs[0])));
 }
 
 void mux_string::encode_Html(void)
@@ -7275,6 +7373,7 @@ void mux_string::import(const mux_string &sStr, mux_cursor iStart)
     }
     else
     {
+        realloc_m_autf(sStr.m_iLast.m_byte - iStart.m_byte);
         m_iLast = sStr.m_iLast - iStart;
         memcpy(m_autf, sStr.m_autf + iStart.m_byte, m_iLast.m_byte);
         m_autf[m_iLast.m_byte] = '\0';
@@ -7342,6 +7441,10 @@ void mux_string::import(const UTF8 *pStr, size_t nLen)
         nLen = LBUF_SIZE-1;
     }
 
+    // Stripping color codes never makes the text longer.
+    //
+    realloc_m_autf(nLen);
+
     bool fColor = false;
     static ColorState acsTemp[LBUF_SIZE];
     ColorState cs = CS_NORMAL;
@@ -7436,6 +7539,26 @@ void mux_string::prepend(const UTF8 *pStr, size_t n)
     delete sStore;
 }
 
+/*! \brief Moves the text to an lbuf if it will not fit in the small buffer.
+ *
+ * The text never moves back to the small buffer.  Once the string has
+ * needed an lbuf, it keeps it until it is destroyed.
+ *
+ * \param nBytes   Length of text (not counting the '\0') to make room for.
+ * \return         None.
+ */
+
+void mux_string::realloc_m_autf(size_t nBytes)
+{
+    if (  m_autfSmall == m_autf
+       && MUX_STRING_SMALL <= nBytes)
+    {
+        UTF8 *p = alloc_lbuf("mux_string");
+        memcpy(p, m_autfSmall, m_iLast.m_byte + 1);
+        m_autf = p;
+    }
+}
+
 /*! \brief Resizes or deletes the m_pcs array if necessary.
  *
  * If asked to resize the array to 0, this method will delete the
@@ -7514,6 +7637,14 @@ void mux_string::replace_Chars
     mux_cursor nMove = CursorMin;
     mux_cursor nCopy = nTo;
 
+    // Compare bytes only.  A replacement can need more bytes for the same
+    // number of code points, as some case mappings do.
+    //
+    if (nLen.m_byte < nTo.m_byte)
+    {
+        realloc_m_autf(m_iLast.m_byte + nTo.m_byte - nLen.m_byte);
+    }
+
     if (nLen != nTo)
     {
         // Since the substring size is not the same size as the replacement
@@ -7612,15 +7743,20 @@ bool mux_string::replace_Point(const UTF8 *p, const mux_cursor &i)
 
     if (n != m)
     {
+        if (n < m)
+        {
+            realloc_m_autf(m_iLast.m_byte + m - n);
+        }
+
         if (  m < n
-           && sizeof(m_autf) <= m_iLast.m_byte + m - n)
+           && LBUF_SIZE <= m_iLast.m_byte + m - n)
         {
             // We need to truncate the trailing point to make room for an expansion.
             //
             do
             {
                 cursor_prev(m_iLast);
-            } while (sizeof(m_autf) <= m_iLast.m_byte + m - n);
+            } while (LBUF_SIZE <= m_iLast.m_byte + m - n);
             m_autf[m_iLast.m_byte] = '\0';
         }
 
@@ -8357,9 +8493,68 @@ void mux_string::FoldForMatching(void)
 
 mux_words::mux_words(const mux_string &sStr) : m_s(&sStr)
 {
-    m_aiWordBegins[0] = CursorMin;
-    m_aiWordEnds[0] = CursorMin;
     m_nWords = 0;
+    m_nWordsMax = 0;
+    m_aiWordBegins = nullptr;
+    m_aiWordEnds = nullptr;
+}
+
+mux_words::~mux_words(void)
+{
+    delete [] m_aiWordBegins;
+    delete [] m_aiWordEnds;
+}
+
+/*! \brief Grows the word arrays if necessary.
+ *
+ * The arrays start small and double as words are found, so the size follows
+ * the list actually being split instead of the longest possible list.
+ *
+ * \param nWords   Number of words the arrays must be able to hold.
+ * \return         None.
+ */
+
+void mux_words::realloc_Words(size_t nWords)
+{
+    if (nWords <= m_nWordsMax)
+    {
+        return;
+    }
+
+    size_t nMax = (0 == m_nWordsMax) ? 32 : 2*static_cast<size_t>(m_nWordsMax);
+    if (nMax < nWords)
+    {
+        nMax = nWords;
+    }
+    if (MAX_WORDS < nMax)
+    {
+        nMax = MAX_WORDS;
+    }
+
+    mux_cursor *pBegins = nullptr;
+    mux_cursor *pEnds = nullptr;
+    try
+    {
+        pBegins = new mux_cursor[nMax];
+        pEnds = new mux_cursor[nMax];
+    }
+    catch (...)
+    {
+        ; // Nothing.
+    }
+    ISOUTOFMEMORY(pBegins);
+    ISOUTOFMEMORY(pEnds);
+
+    for (LBUF_OFFSET i = 0; i < m_nWordsMax; i++)
+    {
+        pBegins[i] = m_aiWordBegins[i];
+        pEnds[i] = m_aiWordEnds[i];
+    }
+    delete [] m_aiWordBegins;
+    delete [] m_aiWordEnds;
+    m_aiWordBegins = pBegins;
+    m_aiWordEnds = pEnds;
+    m_nWordsMax = static_cast<LBUF_OFFSET>(nMax);
 }
 
 void mux_words::export_WordColor(LBUF_OFFSET n, UTF8 *buff, UTF8 **bufc)
@@ -8414,6 +8609,7 @@ LBUF_OFFSET mux_words::find_Words(const UTF8 *pDelim, bool bFavorEmptyList)
     while (  bSucceeded
           && nWords + 1 < MAX_WORDS)
     {
+        realloc_Words(nWords + 1);
         m_aiWordBegins[nWords] = iStart;
         m_aiWordEnds[nWords] = iPos;
         nWords++;
@@ -8437,6 +8633,7 @@ LBUF_OFFSET mux_words::find_Words(const UTF8 *pDelim, bool bFavorEmptyList)
     if (  !fSpaceDelim
        || m_s->m_iLast != iStart)
     {
+        realloc_Words(nWords + 1);
         m_aiWordBegins[nWords] = iStart;
         m_aiWordEnds[nWords] = m_s->m_iLast;
         nWords++;
@@ -1877,6 +1877,11 @@ static const mux_cursor CursorMax(LBUF_SIZE - 1, LBUF_SIZE - 1);
 
 static const mux_cursor curAscii(1, 1);
 
+// The size of the buffer each mux_string carries inside itself.  It must be
+// large enough for the text of any number which import() converts.
+//
+#define MUX_STRING_SMALL 64
+
 class mux_string
 {
     // m_nutf, m_ncs, m_autf, m_ncs, and m_pcs work together as follows:
@@ -1908,13 +1913,26 @@ class mux_string
     // To recap, m_nutf has units of bytes while m_ncp and m_ncs are in units
     // of code points.
     //
+    // m_autf points at m_autfSmall[] until the string needs more room than
+    // that, and from then on, it points at an lbuf which is released by the
+    // destructor.  Most strings are short names, numbers, and list elements,
+    // so most mux_strings never touch the lbuf pool.  realloc_m_autf() must
+    // be called before anything is written that could extend past the small
+    // buffer.
+    //
 private:
     mux_cursor  m_iLast;
-    UTF8        m_autf[LBUF_SIZE];
+    UTF8       *m_autf;
     size_t      m_ncs;
     ColorState *m_pcs;
+    UTF8        m_autfSmall[MUX_STRING_SMALL];
+    void realloc_m_autf(size_t nBytes);
     void realloc_m_pcs(size_t ncs);
 
+    // Not implemented.  Use import() instead.
+    //
+    mux_string &operator=(const mux_string &sStr);
+
 public:
     mux_string(void);
     mux_string(const mux_string &sStr);
@@ -1948,6 +1966,7 @@ public:
     void delete_Chars(mux_cursor iStart, mux_cursor iEnd);
     void edit(mux_string &sFrom, const mux_string &sTo);
     void encode_Html(void);
+    bool equal(const mux_string &sStr) const;
     UTF8 export_Char(size_t n) const; // Deprecated.
     LBUF_OFFSET export_Char_UTF8(size_t iFirst, UTF8 *pBuffer) const;
     ColorState export_Color(size_t n) const;
@@ -2248,13 +2267,21 @@ class mux_words
 {
 private:
     LBUF_OFFSET m_nWords;
-    mux_cursor m_aiWordBegins[MAX_WORDS];
-    mux_cursor m_aiWordEnds[MAX_WORDS];
+    LBUF_OFFSET m_nWordsMax;
+    mux_cursor *m_aiWordBegins;
+    mux_cursor *m_aiWordEnds;
     const mux_string *m_s;
+    void realloc_Words(size_t nWords);
+
+    // Not implemented.
+    //
+    mux_words(const mux_words &words);
+    mux_words &operator=(const mux_words &words);
 
 public:
 
     mux_words(const mux_string &sStr);
+    ~mux_words(void);
     void export_WordColor(LBUF_OFFSET n, UTF8 *buff, UTF8 **bufc = nullptr);
     LBUF_OFFSET find_Words(const UTF8 *pDelim, bool bFavorEmptyList = false);
     void ignore_Word(LBUF_OFFSET n);
@@ -424,15 +424,42 @@ CHashPage::CHashPage(void)
 {
     m_nPageSize = 0;
     m_pPage = 0;
+    m_bAttached = false;
 }
 
 CHashPage::~CHashPage(void)
 {
-    if (m_pPage)
+    if (  m_pPage
+       && !m_bAttached)
+    {
+        delete [] m_pPage;
+    }
+    m_pPage = 0;
+}
+
+// Attach
+//
+// Points this page at memory owned by someone else (for example, a page of
+// a memory-mapped file) instead of at a private buffer. An attached page is
+// operated on in place and is never freed by us.
+//
+void CHashPage::Attach(unsigned char *pPage, unsigned int nPageSize)
+{
+    if (  m_pPage
+       && !m_bAttached)
     {
         delete [] m_pPage;
-        m_pPage = 0;
     }
+    m_pPage = pPage;
+    m_nPageSize = nPageSize;
+    m_bAttached = true;
+    SetFixedPointers();
+    SetVariablePointers();
+}
+
+void CHashPage::CopyTo(unsigned char *pPage)
+{
+    memcpy(pPage, m_pPage, m_nPageSize);
 }
 
 // GetStats
@@ -1003,6 +1030,16 @@ void CHashPage::HeapCopy(UINT32 iDir, HP_PHEAPLENGTH pnRecord, void *pRecord)
     }
 }
 
+UINT32 CHashPage::HeapHash(UINT32 iDir)
+{
+    if (m_pDirectory[iDir] < HP_DIR_DELETED) // ValidateAllocatedBlock(iDir))
+    {
+        HP_PHEAPNODE pNode = (HP_PHEAPNODE)(m_pHeapStart + m_pDirectory[iDir]);
+        return pNode->u.s.nHash;
+    }
+    return 0;
+}
+
 void CHashPage::HeapUpdate(UINT32 iDir, HP_HEAPLENGTH nRecord, void *pRecord)
 {
     if (nRecord == 0 || pRecord == 0) return;
@@ -1280,12 +1317,22 @@ bool CHashPage::Defrag(HP_HEAPLENGTH nExtra)
     }
     if (IS_HP_SUCCESS(errInserted))
     {
-        // Swap buffers.
-        //
-        unsigned char *tmp;
-        tmp = hpNew->m_pPage;
-        hpNew->m_pPage = m_pPage;
-        m_pPage = tmp;
+        if (m_bAttached)
+        {
+            // We don't own our buffer, so the defragmented page must be
+            // copied back into it.
+            //
+            hpNew->CopyTo(m_pPage);
+        }
+        else
+        {
+            // Swap buffers.
+            //
+            unsigned char *tmp;
+            tmp = hpNew->m_pPage;
+            hpNew->m_pPage = m_pPage;
+            m_pPage = tmp;
+        }
 
         SetFixedPointers();
         SetVariablePointers();
@@ -1343,6 +1390,11 @@ CHashFile::CHashFile(void)
     SeedRandomNumberGenerator();
     m_Cache = nullptr;
     m_nCache = 0;
+    m_bScratch = false;
+#if defined(UNIX_MMAP)
+    m_pMap = nullptr;
+    m_nMap = 0;
+#endif // UNIX_MMAP
     Init();
 }
 
@@ -1359,6 +1411,7 @@ void CHashFile::Init(void)
     m_nDirDepth = 0;
     m_pDir = nullptr;
     m_hpCacheLookup = nullptr;
+    m_hpCurrent = nullptr;
     iCache = 0;
     m_iLastFlushed = 0;
 }
@@ -1376,7 +1429,8 @@ void CHashFile::WriteDirectory(void)
     WriteFile(m_hDirFile, m_pDir, sizeof(HF_FILEOFFSET)*m_nDir, &nWritten, 0);
     SetEndOfFile(m_hDirFile);
 #ifdef DO_COMMIT
-    if (!mudstate.bStandAlone)
+    if (  !m_bScratch
+       && !mudstate.bStandAlone)
     {
         FlushFileBuffers(m_hDirFile);
     }
@@ -1398,7 +1452,8 @@ void CHashFile::WriteDirectory(void)
 #endif // HAVE_PWRITE
     //SetEndOfFile(m_hDirFile);
 #ifdef DO_COMMIT
-    if (!mudstate.bStandAlone)
+    if (  !m_bScratch
+       && !mudstate.bStandAlone)
     {
         fsync(m_hDirFile);
     }
@@ -1471,7 +1526,7 @@ bool CHashFile::InitializeDirectory(unsigned int n)
     return true;
 }
 
-bool CHashFile::CreateFileSet(const UTF8 *szDirFile, const UTF8 *szPageFile)
+bool CHashFile::CreateFileSet(const UTF8 *szDirFile, const UTF8 *szPageFile, bool bMapped)
 {
     CloseAll();
 
@@ -1525,6 +1580,30 @@ bool CHashFile::CreateFileSet(const UTF8 *szDirFile, const UTF8 *szPageFile)
         return false;
     }
 
+#if defined(UNIX_MMAP)
+    if (bMapped)
+    {
+        // The first page must be on disk before it can be mapped.
+        //
+        m_hpSplit[0].Empty(0, 0UL, 100);
+        if (!m_hpSplit[0].WritePage(m_hPageFile, 0UL))
+        {
+            return false;
+        }
+        m_pDir[0] = m_pDir[1] = 0UL;
+        oEndOfFile = HF_SIZEOF_PAGE;
+
+        if (MapFile(oEndOfFile))
+        {
+            WriteDirectory();
+            return true;
+        }
+        Log.WriteString(T("CHashFile::CreateFileSet - Could not map the page file. Using the page cache instead." ENDLINE));
+    }
+#else
+    UNUSED_PARAMETER(bMapped);
+#endif // UNIX_MMAP
+
     iCache = AllocateEmptyPage(0, 0);
     if (iCache < 0)
     {
@@ -1558,27 +1637,40 @@ bool CHashFile::RebuildDirectory(void)
 
     // Re-build the directory from CHashPages.
     //
+    Advise(true);
     for (UINT32 oPage = 0; oPage < oEndOfFile; oPage += HF_SIZEOF_PAGE)
     {
-        int iCache;
-        if ((iCache = AllocateEmptyPage(0, nullptr)) < 0)
+        int iCache = -1;
+        CHashPage *hp;
+#if defined(UNIX_MMAP)
+        if (IsMapped())
         {
-            Log.WriteString(T("CHashFile::RebuildDirectory.  AllocateEmptyPage failed. DB DAMAGE." ENDLINE));
-            return false;
-        }
-
-        if (m_Cache[iCache].m_hp.ReadPage(m_hPageFile, oPage))
-        {
-            m_Cache[iCache].m_o = oPage;
-            m_Cache[iCache].m_iState = HF_CACHE_CLEAN;
-            ResetAge(iCache);
+            m_hpMapped.Attach(m_pMap + oPage, HF_SIZEOF_PAGE);
+            hp = &m_hpMapped;
         }
         else
+#endif // UNIX_MMAP
         {
-            Log.WriteString(T("CHashFile::RebuildDirectory.  ReadPage failed to get the page. DB DAMAGE." ENDLINE));
+            if ((iCache = AllocateEmptyPage(0, nullptr)) < 0)
+            {
+                Log.WriteString(T("CHashFile::RebuildDirectory.  AllocateEmptyPage failed. DB DAMAGE." ENDLINE));
+                return false;
+            }
+
+            if (m_Cache[iCache].m_hp.ReadPage(m_hPageFile, oPage))
+            {
+                m_Cache[iCache].m_o = oPage;
+                m_Cache[iCache].m_iState = HF_CACHE_CLEAN;
+                ResetAge(iCache);
+            }
+            else
+            {
+                Log.WriteString(T("CHashFile::RebuildDirectory.  ReadPage failed to get the page. DB DAMAGE." ENDLINE));
+            }
+            hp = &m_Cache[iCache].m_hp;
         }
 
-        UINT32 nPageDepth = m_Cache[iCache].m_hp.GetDepth();
+        UINT32 nPageDepth = hp->GetDepth();
         while (m_nDirDepth < nPageDepth)
         {
             if (!DoubleDirectory())
@@ -1587,18 +1679,20 @@ bool CHashFile::RebuildDirectory(void)
             }
         }
         UINT32 nStart, nEnd;
-        m_Cache[iCache].m_hp.GetRange(m_nDirDepth, nStart, nEnd);
+        hp->GetRange(m_nDirDepth, nStart, nEnd);
         for ( ; nStart <= nEnd; nStart++)
         {
             if (m_pDir[nStart] != 0xFFFFFFFFUL)
             {
                 Log.WriteString(T("CHashFile::Open - The keyspace of pages in Page File overlap." ENDLINE));
+                Advise(false);
                 return false;
             }
             m_pDir[nStart] = oPage;
             m_hpCacheLookup[nStart] = iCache;
         }
     }
+    Advise(false);
 
     // Validate that the directory does not have holes.
     //
@@ -1671,11 +1765,22 @@ void CHashFile::InitCache(int nCachePages)
     m_iOldest = 0;
 }
 
-int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePages)
+int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePages, bool bMapped)
 {
     CloseAll();
     FinalCache();
     InitCache(nCachePages);
+#if defined(UNIX_MMAP)
+    if (bMapped)
+    {
+        // Page splits are staged in these before being copied into the map.
+        //
+        m_hpSplit[0].Allocate(HF_SIZEOF_PAGE);
+        m_hpSplit[1].Allocate(HF_SIZEOF_PAGE);
+    }
+#else
+    bMapped = false;
+#endif // UNIX_MMAP
 
     // First let's try to open the page file. This is the more important file.
     //
@@ -1700,7 +1805,7 @@ int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePag
     {
         // The PageFile doesn't exist, so we have'ta create both of them.
         //
-        if (!CreateFileSet(szDirFile, szPageFile))
+        if (!CreateFileSet(szDirFile, szPageFile, bMapped))
         {
             CloseAll();
             return HF_OPEN_STATUS_ERROR;
@@ -1728,7 +1833,7 @@ int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePag
         // The PageFile exists, but it's zero-length, so we have'ta create
         // both of them.
         //
-        if (!CreateFileSet(szDirFile, szPageFile))
+        if (!CreateFileSet(szDirFile, szPageFile, bMapped))
         {
             CloseAll();
             return HF_OPEN_STATUS_ERROR;
@@ -1743,6 +1848,14 @@ int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePag
         return HF_OPEN_STATUS_ERROR;
     }
 
+#if defined(UNIX_MMAP)
+    if (  bMapped
+       && !MapFile(oEndOfFile))
+    {
+        Log.WriteString(T("CHashFile::Open - Could not map the page file. Using the page cache instead." ENDLINE));
+    }
+#endif // UNIX_MMAP
+
     // Now that the page file appears valid so far, let's see if the directory
     // file is there. This file is not strictly necessary, we can rebuild it.
     // However, having it helps us to open faster.
@@ -1799,8 +1912,9 @@ int CHashFile::Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePag
     return HF_OPEN_STATUS_OLD;
 }
 
-void CHashFile::Sync(void)
+bool CHashFile::Sync(void)
 {
+    bool bSynced = true;
 #if defined(WINDOWS_FILES)
     if (INVALID_HANDLE_VALUE != m_hPageFile)
 #elif defined(UNIX_FILES)
@@ -1808,6 +1922,15 @@ void CHashFile::Sync(void)
 #endif // UNIX_FILES
     {
         cs_syncs++;
+#if defined(UNIX_MMAP)
+        if (IsMapped())
+        {
+            // The kernel holds every modified page. Hand them all to it
+            // for writing. Below, fsync() waits on them if we are committing.
+            //
+            SyncMapped(0UL, oEndOfFile, false);
+        }
+#endif // UNIX_MMAP
         bool bAllFlushed = true;
         for (int i = 0; i < m_nCache; i++)
         {
@@ -1819,16 +1942,20 @@ void CHashFile::Sync(void)
         if (!bAllFlushed)
         {
             Log.WriteString(T("CHashFile::Sync. Could not flush all the pages. DB DAMAGE." ENDLINE));
+            bSynced = false;
         }
 
 #ifdef DO_COMMIT
         if (!mudstate.bStandAlone)
         {
 #if defined(WINDOWS_FILES)
-            FlushFileBuffers(m_hPageFile);
+            if (!FlushFileBuffers(m_hPageFile))
 #elif defined(UNIX_FILES)
-            fsync(m_hPageFile);
+            if (0 != fsync(m_hPageFile))
 #endif // UNIX_FILES
+            {
+                bSynced = false;
+            }
         }
 #endif // DO_COMMIT
     }
@@ -1841,12 +1968,16 @@ void CHashFile::Sync(void)
        && !mudstate.bStandAlone)
     {
 #if defined(WINDOWS_FILES)
-        FlushFileBuffers(m_hDirFile);
+        if (!FlushFileBuffers(m_hDirFile))
 #elif defined(UNIX_FILES)
-        fsync(m_hDirFile);
+        if (0 != fsync(m_hDirFile))
 #endif // UNIX_FILES
+        {
+            bSynced = false;
+        }
     }
 #endif // DO_COMMIT
+    return bSynced;
 }
 
 void CHashFile::CloseAll(void)
@@ -1858,6 +1989,9 @@ void CHashFile::CloseAll(void)
 #endif // UNIX_FILES
     {
         Sync();
+#if defined(UNIX_MMAP)
+        UnmapFile();
+#endif // UNIX_MMAP
         if (m_pDir)
         {
             delete [] m_pDir;
@@ -1907,8 +2041,38 @@ CHashFile::~CHashFile(void)
     CloseAll();
 }
 
+#if defined(HAVE_WORKING_FORK)
+// If we are @dumping, then we have a @forked process that is also reading
+// from the file. Before a page split moves records around, we must pause and
+// let this reader process finish.
+//
+static void WaitOnForkedDump(void)
+{
+    if (  !mudstate.bStandAlone
+       && mudstate.dumping)
+    {
+        STARTLOG(LOG_DBSAVES, "DMP", "DUMP");
+        log_text(T("Waiting on previously-forked child before page-splitting... "));
+        ENDLOG;
+        do
+        {
+            // We have a forked dump in progress, so we will wait until the
+            // child exits.
+            //
+            alarm_clock.sleep(time_1s);
+        } while (mudstate.dumping);
+    }
+}
+#endif // HAVE_WORKING_FORK
+
 bool CHashFile::Insert(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord)
 {
+#if defined(UNIX_MMAP)
+    if (IsMapped())
+    {
+        return InsertMapped(nRecord, nHash, pRecord);
+    }
+#endif // UNIX_MMAP
     cs_writes++;
     for (;;)
     {
@@ -1947,23 +2111,9 @@ bool CHashFile::Insert(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord)
         }
 
 #if defined(HAVE_WORKING_FORK)
-        // First, if we are @dumping, then we have a @forked process
-        // that is also reading from the file. We must pause and let
-        // this reader process finish.
-        //
-        if (  !mudstate.bStandAlone
-           && mudstate.dumping)
+        if (!m_bScratch)
         {
-            STARTLOG(LOG_DBSAVES, "DMP", "DUMP");
-            log_text(T("Waiting on previously-forked child before page-splitting... "));
-            ENDLOG;
-            do
-            {
-                // We have a forked dump in progress, so we will wait until the
-                // child exits.
-                //
-                alarm_clock.sleep(time_1s);
-            } while (mudstate.dumping);
+            WaitOnForkedDump();
         }
 #endif // HAVE_WORKING_FORK
 
@@ -2049,7 +2199,8 @@ bool CHashFile::Insert(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord)
         FlushCache(iEmpty0);
 
 #ifdef DO_COMMIT
-        if (!mudstate.bStandAlone)
+        if (  !m_bScratch
+           && !mudstate.bStandAlone)
         {
 #if defined(WINDOWS_FILES)
             FlushFileBuffers(m_hPageFile);
@@ -2075,7 +2226,8 @@ bool CHashFile::Insert(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord)
 #endif // UNIX_FILES
 
 #ifdef DO_COMMIT
-        if (!mudstate.bStandAlone)
+        if (  !m_bScratch
+           && !mudstate.bStandAlone)
         {
 #if defined(WINDOWS_FILES)
             FlushFileBuffers(m_hDirFile);
@@ -2165,14 +2317,14 @@ UINT32 CHashFile::FindFirstKey(UINT32 nHash)
         cs_fails++;
         return HF_FIND_END;
     }
-    iCache = ReadCache(iFileDir, &cs_rhits);
-    if (iCache < 0)
+    m_hpCurrent = FetchPage(iFileDir, &cs_rhits);
+    if (nullptr == m_hpCurrent)
     {
         cs_fails++;
         return HF_FIND_END;
     }
     UINT32 nStart, nEnd;
-    m_Cache[iCache].m_hp.GetRange(m_nDirDepth, nStart, nEnd);
+    m_hpCurrent->GetRange(m_nDirDepth, nStart, nEnd);
     if (iFileDir < nStart || nEnd < iFileDir)
     {
         Log.tinyprintf(T("CHashFile::Find - Directory entry (0x%08X) points to the wrong page (0x%08X-0x%08X)." ENDLINE),
@@ -2181,7 +2333,7 @@ UINT32 CHashFile::FindFirstKey(UINT32 nHash)
     }
 
     unsigned int numchecks;
-    UINT32 iDir = m_Cache[iCache].m_hp.FindFirstKey(nHash, &numchecks);
+    UINT32 iDir = m_hpCurrent->FindFirstKey(nHash, &numchecks);
 
     if (iDir == HP_DIR_EMPTY)
     {
@@ -2197,7 +2349,7 @@ UINT32 CHashFile::FindNextKey(UINT32 iDir, UINT32 nHash)
 
     unsigned int numchecks;
 
-    iDir = m_Cache[iCache].m_hp.FindNextKey(iDir, nHash, &numchecks);
+    iDir = m_hpCurrent->FindNextKey(iDir, nHash, &numchecks);
 
     if (iDir == HP_DIR_EMPTY)
     {
@@ -2209,14 +2361,17 @@ UINT32 CHashFile::FindNextKey(UINT32 iDir, UINT32 nHash)
 
 void CHashFile::Copy(UINT32 iDir, HP_PHEAPLENGTH pnRecord, void *pRecord)
 {
-    m_Cache[iCache].m_hp.HeapCopy(iDir, pnRecord, pRecord);
+    m_hpCurrent->HeapCopy(iDir, pnRecord, pRecord);
 }
 
 void CHashFile::Remove(UINT32 iDir)
 {
     cs_dels++;
-    m_Cache[iCache].m_hp.HeapFree(iDir);
-    m_Cache[iCache].m_iState = HF_CACHE_UNPROTECTED;
+    m_hpCurrent->HeapFree(iDir);
+    if (!IsMapped())
+    {
+        m_Cache[iCache].m_iState = HF_CACHE_UNPROTECTED;
+    }
 }
 
 bool CHashFile::FlushCache(int iCache)
@@ -2386,6 +2541,316 @@ int CHashFile::ReadCache(UINT32 iFileDir, int *phits)
     return -1;
 }
 
+// SetScratch
+//
+// A scratch file (such as the copy being built by a compaction) is not
+// read by a forked dump, and is worthless until it is finished, so page
+// splits neither wait on a dump nor commit each page to disk. Call Sync()
+// once the file is complete.
+//
+void CHashFile::SetScratch(bool bScratch)
+{
+    m_bScratch = bScratch;
+}
+
+UINT32 CHashFile::GetPageCount(void)
+{
+    return oEndOfFile/HF_SIZEOF_PAGE;
+}
+
+// CopyPage
+//
+// Inserts every record of the page which covers nHash into another hash
+// file. On return, *pnNextHash is the first hash beyond this page, and
+// *pbLast says whether this was the last page in hash order. Walking the
+// file this way, starting at zero, visits each page exactly once even if
+// pages are split between calls.
+//
+bool CHashFile::CopyPage(UINT32 nHash, CHashFile &hfTo, UINT32 *pnNextHash, bool *pbLast)
+{
+    UINT32 iFileDir = nHash >> (32-m_nDirDepth);
+    if (iFileDir >= m_nDir)
+    {
+        return false;
+    }
+    CHashPage *hp = FetchPage(iFileDir, &cs_rhits);
+    if (nullptr == hp)
+    {
+        return false;
+    }
+
+    unsigned char *pRecord = nullptr;
+    try
+    {
+        pRecord = new unsigned char[HF_SIZEOF_PAGE];
+    }
+    catch (...)
+    {
+        ; // Nothing.
+    }
+    if (nullptr == pRecord)
+    {
+        return false;
+    }
+
+    // The destination has its own pages, so inserting into it cannot
+    // disturb this one.
+    //
+    bool bSuccess = true;
+    HP_HEAPLENGTH nRecord;
+    for (  UINT32 iDir = hp->FindFirst(&nRecord, pRecord);
+           HP_DIR_EMPTY != iDir;
+           iDir = hp->FindNext(&nRecord, pRecord))
+    {
+        if (!hfTo.Insert(nRecord, hp->HeapHash(iDir), pRecord))
+        {
+            bSuccess = false;
+            break;
+        }
+    }
+    delete [] pRecord;
+
+    UINT32 nStart, nEnd;
+    hp->GetRange(m_nDirDepth, nStart, nEnd);
+    *pbLast = (m_nDir <= nEnd + 1);
+    *pnNextHash = *pbLast ? 0 : ((nEnd + 1) << (32-m_nDirDepth));
+    return bSuccess;
+}
+
+// FetchPage
+//
+// Returns the page which covers the given directory entry, either from the
+// memory-mapped page file or through the page cache.
+//
+CHashPage *CHashFile::FetchPage(UINT32 iFileDir, int *pHits)
+{
+#if defined(UNIX_MMAP)
+    if (IsMapped())
+    {
+        return MapPage(iFileDir, pHits);
+    }
+#endif // UNIX_MMAP
+    iCache = ReadCache(iFileDir, pHits);
+    if (iCache < 0)
+    {
+        return nullptr;
+    }
+    return &m_Cache[iCache].m_hp;
+}
+
+// Advise
+//
+// Hints that the mapped page file is about to be read from end to end (as
+// RebuildDirectory does) or should go back to expecting random lookups.
+//
+void CHashFile::Advise(bool bScanning)
+{
+#if defined(UNIX_MMAP) && defined(HAVE_MADVISE)
+    if (IsMapped())
+    {
+        madvise(m_pMap, m_nMap, bScanning ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+#else
+    UNUSED_PARAMETER(bScanning);
+#endif // UNIX_MMAP && HAVE_MADVISE
+}
+
+// Prefetch
+//
+// Asks the kernel to start reading the whole mapped page file.  Preloading
+// fetches attributes object by object, which touches pages in no particular
+// file order, so the mapping keeps its random hint.
+//
+void CHashFile::Prefetch(void)
+{
+#if defined(UNIX_MMAP) && defined(HAVE_MADVISE)
+    if (  IsMapped()
+       && 0 < oEndOfFile)
+    {
+        madvise(m_pMap, static_cast<size_t>(oEndOfFile), MADV_WILLNEED);
+    }
+#endif // UNIX_MMAP && HAVE_MADVISE
+}
+
+#if defined(UNIX_MMAP)
+
+// The mapping is made larger than the page file so that most page splits
+// can extend the file without remapping it.
+//
+#define HF_MAP_SLACK (256*HF_SIZEOF_PAGE)
+
+bool CHashFile::MapFile(HF_FILEOFFSET oNeeded)
+{
+    size_t nMap = static_cast<size_t>(oNeeded) + oNeeded/8 + HF_MAP_SLACK;
+    void *pMap = mmap(nullptr, nMap, PROT_READ|PROT_WRITE, MAP_SHARED,
+        m_hPageFile, 0);
+    if (MAP_FAILED == pMap)
+    {
+        Log.tinyprintf(T("CHashFile::MapFile - mmap error %u." ENDLINE), errno);
+        return false;
+    }
+
+    // The new mapping is in place before the old one goes away.
+    //
+    UnmapFile();
+    m_pMap = static_cast<unsigned char *>(pMap);
+    m_nMap = static_cast<HF_FILEOFFSET>(nMap);
+#if defined(HAVE_MADVISE)
+    madvise(m_pMap, m_nMap, MADV_RANDOM);
+#endif // HAVE_MADVISE
+    return true;
+}
+
+void CHashFile::UnmapFile(void)
+{
+    if (nullptr != m_pMap)
+    {
+        munmap(m_pMap, m_nMap);
+        m_pMap = nullptr;
+        m_nMap = 0;
+    }
+}
+
+CHashPage *CHashFile::MapPage(UINT32 iFileDir, int *pHits)
+{
+    HF_FILEOFFSET oPage = m_pDir[iFileDir];
+    if (  oEndOfFile < HF_SIZEOF_PAGE
+       || oEndOfFile - HF_SIZEOF_PAGE < oPage)
+    {
+        Log.WriteString(T("CHashFile::MapPage.  Directory points past the end of the page file. DB DAMAGE." ENDLINE));
+        return nullptr;
+    }
+    (*pHits)++;
+    m_hpMapped.Attach(m_pMap + oPage, HF_SIZEOF_PAGE);
+    return &m_hpMapped;
+}
+
+void CHashFile::SyncMapped(HF_FILEOFFSET oStart, HF_FILEOFFSET nLength, bool bWait)
+{
+    // msync() requires an address aligned to the system page size.
+    //
+    HF_FILEOFFSET nAlign = static_cast<HF_FILEOFFSET>(getpagesize());
+    HF_FILEOFFSET oAligned = oStart - (oStart % nAlign);
+    msync(m_pMap + oAligned, nLength + (oStart - oAligned),
+        bWait ? MS_SYNC : MS_ASYNC);
+}
+
+// InsertMapped
+//
+// Records are inserted directly into the mapped page. When a page is full,
+// it is split into two staging pages. The upper half is appended to the page
+// file with an ordinary write -- so a full disk is reported as an error
+// rather than as a fault on the mapping -- and the lower half is copied back
+// over the original page.
+//
+bool CHashFile::InsertMapped(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord)
+{
+    cs_writes++;
+    for (;;)
+    {
+        UINT32 iFileDir = nHash >> (32-m_nDirDepth);
+        if (iFileDir >= m_nDir)
+        {
+            Log.WriteString(T("CHashFile::Insert - iFileDir out of range." ENDLINE));
+            return false;
+        }
+        CHashPage *hp = MapPage(iFileDir, &cs_whits);
+        if (nullptr == hp)
+        {
+            Log.WriteString(T("CHashFile::Insert - Page wasn\xE2\x80\x99t valid." ENDLINE));
+            return false;
+        }
+
+        UINT32 nStart, nEnd;
+        hp->GetRange(m_nDirDepth, nStart, nEnd);
+        if (iFileDir < nStart || nEnd < iFileDir)
+        {
+            Log.tinyprintf(T("CHashFile::Insert - Directory entry (0x%08X) points to the wrong page (0x%08X-0x%08X)." ENDLINE),
+                iFileDir, nStart, nEnd);
+            return false;
+        }
+        int errInserted = hp->Insert(nRecord, nHash, pRecord);
+        if (IS_HP_SUCCESS(errInserted))
+        {
+            break;
+        }
+        else if (HP_INSERT_ERROR_ILLEGAL == errInserted)
+        {
+            return false;
+        }
+
+#if defined(HAVE_WORKING_FORK)
+        if (!m_bScratch)
+        {
+            WaitOnForkedDump();
+        }
+#endif // HAVE_WORKING_FORK
+
+        // If the depth of this page is already as deep as the directory
+        // depth,then we must increase depth of the directory, first.
+        //
+        HF_FILEOFFSET oOld = m_pDir[iFileDir];
+        if (m_nDirDepth == hp->GetDepth())
+        {
+            if (!DoubleDirectory())
+            {
+                return false;
+            }
+        }
+
+        if (!hp->Split(m_hpSplit[0], m_hpSplit[1]))
+        {
+            return false;
+        }
+
+        // Tack another page onto the end of the .pag file.
+        //
+        HF_FILEOFFSET oNew = oEndOfFile;
+        if (!m_hpSplit[1].WritePage(m_hPageFile, oNew))
+        {
+            Log.WriteString(T("CHashFile::Insert - Could not extend the page file." ENDLINE));
+            return false;
+        }
+        oEndOfFile += HF_SIZEOF_PAGE;
+        if (  m_nMap < oEndOfFile
+           && !MapFile(oEndOfFile))
+        {
+            // Nothing references the new page yet, so dropping it leaves
+            // the page file as it was.
+            //
+            if (0 != ftruncate(m_hPageFile, oNew))
+            {
+                Log.WriteString(T("CHashFile::Insert - Could not truncate the page file." ENDLINE));
+            }
+            oEndOfFile = oNew;
+            return false;
+        }
+        m_hpSplit[0].CopyTo(m_pMap + oOld);
+
+        // Update the directory.
+        //
+        m_hpSplit[1].GetRange(m_nDirDepth, nStart, nEnd);
+        for ( ; nStart <= nEnd; nStart++)
+        {
+            m_pDir[nStart] = oNew;
+        }
+
+#ifdef DO_COMMIT
+        if (  !m_bScratch
+           && !mudstate.bStandAlone)
+        {
+            SyncMapped(oOld, HF_SIZEOF_PAGE, true);
+            fsync(m_hPageFile);
+        }
+#endif // DO_COMMIT
+
+        WriteDirectory();
+    }
+    return true;
+}
+
+#endif // UNIX_MMAP
+
 #endif // MEMORY_BASED
 
 CHashTable::CHashTable(void)
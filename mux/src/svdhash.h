@@ -123,6 +123,7 @@ class CHashPage
 private:
     unsigned char  *m_pPage;
     unsigned int    m_nPageSize;
+    bool            m_bAttached;    // m_pPage belongs to someone else.
     HP_PHEADER      m_pHeader;
     HP_PHEAPOFFSET  m_pDirectory;
     unsigned char  *m_pHeapStart;
@@ -146,6 +147,8 @@ private:
 public:
     CHashPage(void);
     bool Allocate(unsigned int nPageSize);
+    void Attach(unsigned char *pPage, unsigned int nPageSize);
+    void CopyTo(unsigned char *pPage);
     ~CHashPage(void);
     void Empty(UINT32 arg_nDepth, UINT32 arg_nHashGroup, UINT32 arg_nDirSize);
 #ifdef HP_PROTECTION
@@ -164,6 +167,7 @@ public:
     UINT32 FindFirst(HP_PHEAPLENGTH pnRecord, void *pRecord);
     UINT32 FindNext(HP_PHEAPLENGTH pnRecord, void *pRecord);
     void HeapCopy(UINT32 iDir, HP_PHEAPLENGTH pnRecord, void *pRecord);
+    UINT32 HeapHash(UINT32 iDir);
     void HeapFree(UINT32 iDir);
     void HeapUpdate(UINT32 iDir, HP_HEAPLENGTH nRecord, void *pRecord);
 
@@ -214,10 +218,25 @@ private:
     HF_CACHE        *m_Cache;
     int             m_nCache;
     HF_PFILEOFFSET  m_pDir;
+    CHashPage      *m_hpCurrent;
+    bool            m_bScratch;     // Not committed page-by-page.
+#if defined(UNIX_MMAP)
+    unsigned char  *m_pMap;
+    HF_FILEOFFSET   m_nMap;
+    CHashPage       m_hpMapped;
+    CHashPage       m_hpSplit[2];
+
+    bool MapFile(HF_FILEOFFSET oNeeded);
+    void UnmapFile(void);
+    CHashPage *MapPage(UINT32 iFileDir, int *pHits);
+    bool InsertMapped(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord);
+    void SyncMapped(HF_FILEOFFSET oStart, HF_FILEOFFSET nLength, bool bWait);
+#endif // UNIX_MMAP
     bool DoubleDirectory(void);
 
     int AllocateEmptyPage(int nSafe, int Safe[]);
     int ReadCache(UINT32 iFileDir, int *pHits);
+    CHashPage *FetchPage(UINT32 iFileDir, int *pHits);
     bool FlushCache(int iCache);
     void WriteDirectory(void);
     bool InitializeDirectory(unsigned int nSize);
@@ -227,24 +246,37 @@ private:
     void InitCache(int nCachePages);
     void FinalCache(void);
 
-    bool CreateFileSet(const UTF8 *szDirFile, const UTF8 *szPageFile);
+    bool CreateFileSet(const UTF8 *szDirFile, const UTF8 *szPageFile, bool bMapped);
+    bool IsMapped(void) const
+    {
+#if defined(UNIX_MMAP)
+        return nullptr != m_pMap;
+#else
+        return false;
+#endif // UNIX_MMAP
+    }
     bool RebuildDirectory(void);
     bool ReadDirectory(void);
+    void Advise(bool bScanning);
 
 public:
     CHashFile(void);
 #define HF_OPEN_STATUS_ERROR -1
 #define HF_OPEN_STATUS_NEW    0
 #define HF_OPEN_STATUS_OLD    1
-    int Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePages);
+    int Open(const UTF8 *szDirFile, const UTF8 *szPageFile, int nCachePages, bool bMapped);
     bool Insert(HP_HEAPLENGTH nRecord, UINT32 nHash, void *pRecord);
     UINT32 FindFirstKey(UINT32 nHash);
     UINT32 FindNextKey(UINT32 iDir, UINT32 nHash);
     void Copy(UINT32 iDir, HP_PHEAPLENGTH pnRecord, void *pRecord);
     void Remove(UINT32 iDir);
     void CloseAll(void);
-    void Sync(void);
+    bool Sync(void);
     void Tick(void);
+    void Prefetch(void);
+    void SetScratch(bool bScratch);
+    bool CopyPage(UINT32 nHash, CHashFile &hfTo, UINT32 *pnNextHash, bool *pbLast);
+    UINT32 GetPageCount(void);
     ~CHashFile(void);
 };
 
@@ -72,6 +72,11 @@ void dispatch_DatabaseDump(void *pUnused, int iUnused)
         }
         else
 #endif // HAVE_WORKING_FORK
+        if (mudstate.bJournal)
+        {
+            dump_checkpoint();
+        }
+        else
         {
             fork_and_dump(0);
         }
@@ -193,6 +198,31 @@ void dispatch_CacheTick(void *pUnused, int iUnused)
 }
 #endif // !MEMORY_BASED
 
+void dispatch_LogFlush(void *pUnused, int iUnused)
+{
+    UNUSED_PARAMETER(pUnused);
+    UNUSED_PARAMETER(iUnused);
+
+    const UTF8 *cmdsave = mudstate.debug_cmd;
+    mudstate.debug_cmd = T("< logflush >");
+
+    CLinearTimeDelta ltd = 0;
+    if (mudconf.log_flush_interval <= ltd)
+    {
+        mudconf.log_flush_interval.SetSeconds(1);
+    }
+
+    Log.Tick();
+
+    // Schedule ourselves again.
+    //
+    CLinearTimeAbsolute ltaNextTime;
+    ltaNextTime.GetUTC();
+    ltaNextTime += mudconf.log_flush_interval;
+    scheduler.DeferTask(ltaNextTime, PRIORITY_SYSTEM, dispatch_LogFlush, 0, 0);
+    mudstate.debug_cmd = cmdsave;
+}
+
 #if 0
 void dispatch_CleanChannels(void *pUnused, int iUnused)
 {
@@ -269,6 +299,16 @@ void init_timer(void)
         dispatch_CacheTick, 0, 0);
 #endif // !MEMORY_BASED
 
+    // Setup re-occuring log hand-off task.
+    //
+    ltd.SetSeconds(0);
+    if (mudconf.log_flush_interval <= ltd)
+    {
+        mudconf.log_flush_interval.SetSeconds(1);
+    }
+    scheduler.DeferTask(ltaNow+mudconf.log_flush_interval, PRIORITY_SYSTEM,
+        dispatch_LogFlush, 0, 0);
+
 #if 0
     // Setup comsys channel scrubbing.
     //
@@ -337,7 +377,6 @@ void do_timewarp(dbref executor, dbref caller, dbref enactor, int eval, int key,
 CTaskHeap::CTaskHeap(void)
 {
     m_nCurrent = 0;
-    m_iVisitedMark = 0;
     m_nAllocated = INITIAL_TASKS;
     m_pHeap = new PTASK_RECORD[m_nAllocated];
     if (!m_pHeap)
@@ -372,9 +411,9 @@ bool CTaskHeap::Insert(PTASK_RECORD pTask, SCHCMP *pfCompare)
             return false;
         }
     }
-    pTask->m_iVisitedMark = m_iVisitedMark-1;
+    pTask->m_iWhere = TASK_IN_HEAP;
 
-    m_pHeap[m_nCurrent] = pTask;
+    Place(m_nCurrent, pTask);
     m_nCurrent++;
     SiftUp(m_nCurrent-1, pfCompare);
     return true;
@@ -455,6 +494,27 @@ PTASK_RECORD CTaskHeap::RemoveTopmost(SCHCMP *pfCompare)
     return Remove(0, pfCompare);
 }
 
+void CTaskHeap::Remove(PTASK_RECORD pTask, SCHCMP *pfCompare)
+{
+    if (  TASK_IN_HEAP == pTask->m_iWhere
+       && pTask->m_iIndex < m_nCurrent
+       && m_pHeap[pTask->m_iIndex] == pTask)
+    {
+        Remove(pTask->m_iIndex, pfCompare);
+    }
+}
+
+void CTaskHeap::Update(PTASK_RECORD pTask, SCHCMP *pfCompare)
+{
+    if (  TASK_IN_HEAP == pTask->m_iWhere
+       && pTask->m_iIndex < m_nCurrent
+       && m_pHeap[pTask->m_iIndex] == pTask)
+    {
+        SiftDown(pTask->m_iIndex, pfCompare);
+        SiftUp(pTask->m_iIndex, pfCompare);
+    }
+}
+
 void CTaskHeap::CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer)
 {
     for (int i = 0; i < m_nCurrent; i++)
@@ -469,6 +529,12 @@ void CTaskHeap::CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer)
     }
 }
 
+int CTaskHeap::Collect(PTASK_RECORD *aTasks)
+{
+    memcpy(aTasks, m_pHeap, sizeof(PTASK_RECORD)*m_nCurrent);
+    return m_nCurrent;
+}
+
 static int ComparePriority(PTASK_RECORD pTaskA, PTASK_RECORD pTaskB)
 {
     int i = (pTaskA->iPriority) - (pTaskB->iPriority);
@@ -501,71 +567,512 @@ static int CompareWhen(PTASK_RECORD pTaskA, PTASK_RECORD pTaskB)
     }
 }
 
-void CScheduler::DeferTask(const CLinearTimeAbsolute& ltaWhen, int iPriority,
-                           FTASK *fpTask, void *arg_voidptr, int arg_Integer)
+/* ---------------------------------------------------------------------------
+ * CTaskWheel: Hierarchical timing wheel.
+ *
+ * A task due at tick t (its time divided by the tick width) which is d ticks
+ * ahead of m_tCurrent goes into level 0 when d < 256 and into the first
+ * higher level which can reach it otherwise.  Each time level 0 wraps, the
+ * next level 1 slot is cascaded, which re-files its tasks into level 0, and
+ * the same happens between each pair of higher levels.  Insertion and
+ * removal are O(1), and each task is cascaded at most once per level.
+ */
+
+#define WHEEL_LEVEL_SHIFT(l) (WHEEL_LEVEL0_BITS + ((l)-1)*WHEEL_LEVELN_BITS)
+#define WHEEL_LEVEL_SLOT(l)  (WHEEL_LEVEL0_SIZE + ((l)-1)*WHEEL_LEVELN_SIZE)
+
+static int WheelLevel(int iSlot)
 {
-    PTASK_RECORD pTask = new TASK_RECORD;
-    if (!pTask) return;
+    if (iSlot < WHEEL_LEVEL0_SIZE)
+    {
+        return 0;
+    }
+    return 1 + (iSlot - WHEEL_LEVEL0_SIZE)/WHEEL_LEVELN_SIZE;
+}
 
-    pTask->ltaWhen = ltaWhen;
-    pTask->iPriority = iPriority;
-    pTask->fpTask = fpTask;
-    pTask->arg_voidptr = arg_voidptr;
-    pTask->arg_Integer = arg_Integer;
-    pTask->m_Ticket = m_Ticket++;
+static INT64 WheelTick(const CLinearTimeAbsolute &lta)
+{
+    CLinearTimeAbsolute ltaTick = lta;
+    return ltaTick.Return100ns() >> WHEEL_TICK_SHIFT;
+}
 
-    // Must add to the WhenHeap so that network is still serviced.
-    //
-    if (!m_WhenHeap.Insert(pTask, CompareWhen))
+CTaskWheel::CTaskWheel(void)
+{
+    m_tCurrent = 0;
+    m_tCascaded = 0;
+    m_nTasks = 0;
+    for (int i = 0; i < WHEEL_LEVELS; i++)
     {
-        delete pTask;
+        m_anLevel[i] = 0;
+    }
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        m_aSlots[i] = nullptr;
     }
 }
 
-void CScheduler::DeferImmediateTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer)
+CTaskWheel::~CTaskWheel(void)
 {
-    PTASK_RECORD pTask = new TASK_RECORD;
-    if (!pTask) return;
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        PTASK_RECORD p = m_aSlots[i];
+        while (nullptr != p)
+        {
+            PTASK_RECORD pNext = p->m_pNext;
+            delete p;
+            p = pNext;
+        }
+        m_aSlots[i] = nullptr;
+    }
+}
 
-    //pTask->ltaWhen = ltaWhen;
-    pTask->iPriority = iPriority;
-    pTask->fpTask = fpTask;
-    pTask->arg_voidptr = arg_voidptr;
-    pTask->arg_Integer = arg_Integer;
-    pTask->m_Ticket = m_Ticket++;
+void CTaskWheel::Place(PTASK_RECORD pTask)
+{
+    INT64 t = WheelTick(pTask->ltaWhen);
+    INT64 d = t - m_tCurrent;
 
-    // Must add to the WhenHeap so that network is still serviced.
-    //
-    if (!m_WhenHeap.Insert(pTask, CompareWhen))
+    int iSlot;
+    if (d < WHEEL_LEVEL0_SIZE)
     {
-        delete pTask;
+        // Tasks which are already due go into the current slot.
+        //
+        if (d < 0)
+        {
+            t = m_tCurrent;
+        }
+        iSlot = static_cast<int>(t & (WHEEL_LEVEL0_SIZE-1));
+    }
+    else
+    {
+        int iLevel = 1;
+        while (  iLevel < WHEEL_LEVELS-1
+              && (d >> (WHEEL_LEVEL_SHIFT(iLevel) + WHEEL_LEVELN_BITS)) != 0)
+        {
+            iLevel++;
+        }
+
+        const int iShift = WHEEL_LEVEL_SHIFT(iLevel);
+        if ((d >> (iShift + WHEEL_LEVELN_BITS)) != 0)
+        {
+            // Beyond the reach of the wheel.
+            //
+            t = m_tCurrent + (INT64_C(1) << (iShift + WHEEL_LEVELN_BITS)) - 1;
+        }
+        iSlot = WHEEL_LEVEL_SLOT(iLevel)
+              + static_cast<int>((t >> iShift) & (WHEEL_LEVELN_SIZE-1));
+    }
+
+    PTASK_RECORD pHead = m_aSlots[iSlot];
+    pTask->m_pPrev = nullptr;
+    pTask->m_pNext = pHead;
+    if (nullptr != pHead)
+    {
+        pHead->m_pPrev = pTask;
+    }
+    m_aSlots[iSlot] = pTask;
+    pTask->m_iIndex = iSlot;
+    pTask->m_iWhere = TASK_IN_WHEEL;
+    m_anLevel[WheelLevel(iSlot)]++;
+    m_nTasks++;
+}
+
+void CTaskWheel::Insert(PTASK_RECORD pTask)
+{
+    if (0 == m_nTasks)
+    {
+        // An empty wheel can start over at the present.
+        //
+        CLinearTimeAbsolute ltaNow;
+        ltaNow.GetUTC();
+        INT64 tNow = WheelTick(ltaNow);
+        if (m_tCurrent < tNow)
+        {
+            m_tCurrent = tNow;
+            m_tCascaded = tNow;
+        }
+    }
+    Place(pTask);
+}
+
+void CTaskWheel::Remove(PTASK_RECORD pTask)
+{
+    if (TASK_IN_WHEEL != pTask->m_iWhere)
+    {
+        return;
+    }
+
+    if (nullptr == pTask->m_pPrev)
+    {
+        m_aSlots[pTask->m_iIndex] = pTask->m_pNext;
+    }
+    else
+    {
+        pTask->m_pPrev->m_pNext = pTask->m_pNext;
+    }
+    if (nullptr != pTask->m_pNext)
+    {
+        pTask->m_pNext->m_pPrev = pTask->m_pPrev;
+    }
+    m_anLevel[WheelLevel(pTask->m_iIndex)]--;
+    m_nTasks--;
+
+    pTask->m_pNext = nullptr;
+    pTask->m_pPrev = nullptr;
+    pTask->m_iWhere = TASK_IN_NONE;
+}
+
+void CTaskWheel::Cascade(int iLevel, int iIndex)
+{
+    const int iSlot = WHEEL_LEVEL_SLOT(iLevel) + iIndex;
+    PTASK_RECORD p = m_aSlots[iSlot];
+    m_aSlots[iSlot] = nullptr;
+    while (nullptr != p)
+    {
+        PTASK_RECORD pNext = p->m_pNext;
+        m_anLevel[iLevel]--;
+        m_nTasks--;
+        Place(p);
+        p = pNext;
+    }
+}
+
+// Moves m_tCurrent past ticks which cannot have anything to expire or
+// cascade.
+//
+void CTaskWheel::Skip(INT64 tNow)
+{
+    if (0 == m_nTasks)
+    {
+        if (m_tCurrent < tNow)
+        {
+            m_tCurrent = tNow;
+            m_tCascaded = tNow;
+        }
+        return;
+    }
+
+    if (0 == m_anLevel[0])
+    {
+        int iLevel = 1;
+        while (0 == m_anLevel[iLevel])
+        {
+            iLevel++;
+        }
+
+        // The next time that this level cascades.
+        //
+        const INT64 mask = (INT64_C(1) << WHEEL_LEVEL_SHIFT(iLevel)) - 1;
+        INT64 tNext = (m_tCurrent + mask) & ~mask;
+        if (tNow < tNext)
+        {
+            tNext = tNow;
+        }
+        if (m_tCurrent < tNext)
+        {
+            m_tCurrent = tNext;
+        }
+    }
+}
+
+/*! \brief Removes tasks which are due before the given time.
+ *
+ * \param ltaNow  The present.
+ * \return        Tasks linked through m_pNext, in no particular order.
+ */
+
+PTASK_RECORD CTaskWheel::Expire(const CLinearTimeAbsolute& ltaNow)
+{
+    PTASK_RECORD pReady = nullptr;
+    const INT64 tNow = WheelTick(ltaNow);
+
+    Skip(tNow);
+    for (;;)
+    {
+        if (m_tCascaded != m_tCurrent)
+        {
+            m_tCascaded = m_tCurrent;
+            int iIndex = static_cast<int>(m_tCurrent & (WHEEL_LEVEL0_SIZE-1));
+            for (int iLevel = 1; 0 == iIndex && iLevel < WHEEL_LEVELS; iLevel++)
+            {
+                iIndex = static_cast<int>((m_tCurrent >> WHEEL_LEVEL_SHIFT(iLevel))
+                       & (WHEEL_LEVELN_SIZE-1));
+                Cascade(iLevel, iIndex);
+            }
+        }
+
+        const int iSlot = static_cast<int>(m_tCurrent & (WHEEL_LEVEL0_SIZE-1));
+        PTASK_RECORD p = m_aSlots[iSlot];
+        if (m_tCurrent < tNow)
+        {
+            // Everything in this slot is due.
+            //
+            while (nullptr != p)
+            {
+                PTASK_RECORD pNext = p->m_pNext;
+                Remove(p);
+                p->m_pNext = pReady;
+                pReady = p;
+                p = pNext;
+            }
+            m_tCurrent++;
+            Skip(tNow);
+        }
+        else
+        {
+            // Only part of this slot may be due.
+            //
+            while (nullptr != p)
+            {
+                PTASK_RECORD pNext = p->m_pNext;
+                if (p->ltaWhen < ltaNow)
+                {
+                    Remove(p);
+                    p->m_pNext = pReady;
+                    pReady = p;
+                }
+                p = pNext;
+            }
+            break;
+        }
+    }
+    return pReady;
+}
+
+/*! \brief Finds a time no later than the earliest task in the wheel.
+ *
+ * The answer is exact when the earliest task is within level 0.  Otherwise,
+ * it is the start of the next slot which must be cascaded, so a caller
+ * which sleeps until then wakes up in time to find the exact answer.
+ *
+ * \param ltaWhen  Receives the time.
+ * \return         false if the wheel is empty.
+ */
+
+bool CTaskWheel::WhenNext(CLinearTimeAbsolute *ltaWhen)
+{
+    if (0 == m_nTasks)
+    {
+        return false;
+    }
+
+    bool bFound = false;
+    if (0 < m_anLevel[0])
+    {
+        for (int i = 0; i < WHEEL_LEVEL0_SIZE; i++)
+        {
+            PTASK_RECORD p = m_aSlots[(m_tCurrent + i) & (WHEEL_LEVEL0_SIZE-1)];
+            if (nullptr != p)
+            {
+                *ltaWhen = p->ltaWhen;
+                for (p = p->m_pNext; nullptr != p; p = p->m_pNext)
+                {
+                    if (p->ltaWhen < *ltaWhen)
+                    {
+                        *ltaWhen = p->ltaWhen;
+                    }
+                }
+                bFound = true;
+                break;
+            }
+        }
+    }
+
+    for (int iLevel = 1; iLevel < WHEEL_LEVELS; iLevel++)
+    {
+        if (0 == m_anLevel[iLevel])
+        {
+            continue;
+        }
+
+        const int iShift = WHEEL_LEVEL_SHIFT(iLevel);
+        const INT64 c = m_tCurrent >> iShift;
+        for (int k = 1; k <= WHEEL_LEVELN_SIZE; k++)
+        {
+            int iSlot = WHEEL_LEVEL_SLOT(iLevel)
+                      + static_cast<int>((c + k) & (WHEEL_LEVELN_SIZE-1));
+            if (nullptr != m_aSlots[iSlot])
+            {
+                CLinearTimeAbsolute lta;
+                lta.Set100ns((c + k) << (iShift + WHEEL_TICK_SHIFT));
+                if (  !bFound
+                   || lta < *ltaWhen)
+                {
+                    *ltaWhen = lta;
+                    bFound = true;
+                }
+                break;
+            }
+        }
+    }
+    return bFound;
+}
+
+void CTaskWheel::CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer, bool bDelete)
+{
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        PTASK_RECORD p = m_aSlots[i];
+        while (nullptr != p)
+        {
+            PTASK_RECORD pNext = p->m_pNext;
+            if (  p->fpTask == fpTask
+               && p->arg_voidptr == arg_voidptr
+               && p->arg_Integer == arg_Integer)
+            {
+                if (bDelete)
+                {
+                    Remove(p);
+                    delete p;
+                }
+                else
+                {
+                    p->fpTask = nullptr;
+                }
+            }
+            p = pNext;
+        }
     }
 }
 
+int CTaskWheel::Collect(PTASK_RECORD *aTasks)
+{
+    int n = 0;
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        for (PTASK_RECORD p = m_aSlots[i]; nullptr != p; p = p->m_pNext)
+        {
+            aTasks[n++] = p;
+        }
+    }
+    return n;
+}
+
+PTASK_RECORD CScheduler::NewTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer)
+{
+    PTASK_RECORD pTask = nullptr;
+    try
+    {
+        pTask = new TASK_RECORD;
+    }
+    catch (...)
+    {
+        ; // Nothing.
+    }
+
+    if (nullptr != pTask)
+    {
+        pTask->iPriority = iPriority;
+        pTask->fpTask = fpTask;
+        pTask->arg_voidptr = arg_voidptr;
+        pTask->arg_Integer = arg_Integer;
+        pTask->m_Ticket = m_Ticket++;
+        pTask->m_iWhere = TASK_IN_NONE;
+        pTask->m_iIndex = 0;
+        pTask->m_pNext = nullptr;
+        pTask->m_pPrev = nullptr;
+    }
+    return pTask;
+}
+
+PTASK_RECORD CScheduler::DeferTask(const CLinearTimeAbsolute& ltaWhen, int iPriority,
+                           FTASK *fpTask, void *arg_voidptr, int arg_Integer)
+{
+    PTASK_RECORD pTask = NewTask(iPriority, fpTask, arg_voidptr, arg_Integer);
+    if (!pTask) return nullptr;
+
+    // Must add to the WhenWheel so that network is still serviced.
+    //
+    pTask->ltaWhen = ltaWhen;
+    m_WhenWheel.Insert(pTask);
+    return pTask;
+}
+
+PTASK_RECORD CScheduler::DeferImmediateTask(int iPriority, FTASK *fpTask, void *arg_voidptr, int arg_Integer)
+{
+    PTASK_RECORD pTask = NewTask(iPriority, fpTask, arg_voidptr, arg_Integer);
+    if (!pTask) return nullptr;
+
+    // Must add to the WhenWheel so that network is still serviced.
+    //
+    m_WhenWheel.Insert(pTask);
+    return pTask;
+}
+
 void CScheduler::CancelTask(FTASK *fpTask, void *arg_voidptr, int arg_Integer)
 {
-    m_WhenHeap.CancelTask(fpTask, arg_voidptr, arg_Integer);
+    m_WhenWheel.CancelTask(fpTask, arg_voidptr, arg_Integer, 0 == m_nTraversing);
     m_PriorityHeap.CancelTask(fpTask, arg_voidptr, arg_Integer);
 }
 
+/*! \brief Cancels a task using the handle DeferTask() returned.
+ *
+ * The handle must not be used after the task runs.  During a traversal,
+ * the task is only disabled, and it is removed when the traversal ends.
+ *
+ * \param pTask  Handle for the task.
+ * \return       None.
+ */
+
+void CScheduler::CancelTask(PTASK_RECORD pTask)
+{
+    if (nullptr == pTask)
+    {
+        return;
+    }
+
+    if (0 < m_nTraversing)
+    {
+        pTask->fpTask = nullptr;
+    }
+    else if (TASK_IN_WHEEL == pTask->m_iWhere)
+    {
+        m_WhenWheel.Remove(pTask);
+        delete pTask;
+    }
+    else if (TASK_IN_HEAP == pTask->m_iWhere)
+    {
+        m_PriorityHeap.Remove(pTask, ComparePriority);
+        delete pTask;
+    }
+}
+
+/*! \brief Re-files a task after its time or priority has been changed.
+ *
+ * The task keeps its ticket, so it stays in order with tasks of the same
+ * time or priority.
+ *
+ * \param pTask  Handle for the task.
+ * \return       None.
+ */
+
+void CScheduler::UpdateTask(PTASK_RECORD pTask)
+{
+    if (TASK_IN_WHEEL == pTask->m_iWhere)
+    {
+        m_WhenWheel.Remove(pTask);
+        m_WhenWheel.Insert(pTask);
+    }
+    else if (TASK_IN_HEAP == pTask->m_iWhere)
+    {
+        m_PriorityHeap.Update(pTask, ComparePriority);
+    }
+}
+
 void CScheduler::ReadyTasks(const CLinearTimeAbsolute& ltaNow)
 {
-    // Move ready-to-run tasks off the WhenHeap and onto the PriorityHeap.
+    // Move ready-to-run tasks out of the WhenWheel and onto the PriorityHeap.
     //
-    PTASK_RECORD pTask = m_WhenHeap.PeekAtTopmost();
-    while (  pTask
-          && pTask->ltaWhen < ltaNow)
+    PTASK_RECORD pTask = m_WhenWheel.Expire(ltaNow);
+    while (pTask)
     {
-        pTask = m_WhenHeap.RemoveTopmost(CompareWhen);
-        if (pTask)
+        PTASK_RECORD pNext = pTask->m_pNext;
+        pTask->m_pNext = nullptr;
+        if (  nullptr == pTask->fpTask
+           || !m_PriorityHeap.Insert(pTask, ComparePriority))
         {
-            if (  nullptr == pTask->fpTask
-               || !m_PriorityHeap.Insert(pTask, ComparePriority))
-            {
-                delete pTask;
-            }
+            delete pTask;
         }
-        pTask = m_WhenHeap.PeekAtTopmost();
+        pTask = pNext;
     }
 }
 
@@ -640,21 +1147,21 @@ bool CScheduler::WhenNext(CLinearTimeAbsolute  *ltaWhen)
         }
     }
 
-    // Check the When Queue next.
+    // Check the When Wheel next.
     //
-    pTask = m_WhenHeap.PeekAtTopmost();
-    if (pTask)
-    {
-        *ltaWhen = pTask->ltaWhen;
-        return true;
-    }
-    return false;
+    return m_WhenWheel.WhenNext(ltaWhen);
 }
 
 #define HEAP_LEFT_CHILD(x) (2*(x)+1)
 #define HEAP_RIGHT_CHILD(x) (2*(x)+2)
 #define HEAP_PARENT(x) (((x)-1)/2)
 
+inline void CTaskHeap::Place(int iNode, PTASK_RECORD pTask)
+{
+    m_pHeap[iNode] = pTask;
+    pTask->m_iIndex = iNode;
+}
+
 void CTaskHeap::SiftDown(int iSubRoot, SCHCMP *pfCompare)
 {
     int parent = iSubRoot;
@@ -675,11 +1182,11 @@ void CTaskHeap::SiftDown(int iSubRoot, SCHCMP *pfCompare)
         if (pfCompare(Ref, m_pHeap[child]) <= 0)
             break;
 
-        m_pHeap[parent] = m_pHeap[child];
+        Place(parent, m_pHeap[child]);
         parent = child;
         child = HEAP_LEFT_CHILD(parent);
     }
-    m_pHeap[parent] = Ref;
+    Place(parent, Ref);
 }
 
 void CTaskHeap::SiftUp(int child, SCHCMP *pfCompare)
@@ -692,8 +1199,8 @@ void CTaskHeap::SiftUp(int child, SCHCMP *pfCompare)
 
         PTASK_RECORD Tmp;
         Tmp = m_pHeap[child];
-        m_pHeap[child] = m_pHeap[parent];
-        m_pHeap[parent] = Tmp;
+        Place(child, m_pHeap[parent]);
+        Place(parent, Tmp);
 
         child = parent;
     }
@@ -706,140 +1213,169 @@ PTASK_RECORD CTaskHeap::Remove(int iNode, SCHCMP *pfCompare)
     PTASK_RECORD pTask = m_pHeap[iNode];
 
     m_nCurrent--;
-    m_pHeap[iNode] = m_pHeap[m_nCurrent];
-    SiftDown(iNode, pfCompare);
-    SiftUp(iNode, pfCompare);
+    if (iNode < m_nCurrent)
+    {
+        Place(iNode, m_pHeap[m_nCurrent]);
+        SiftDown(iNode, pfCompare);
+        SiftUp(iNode, pfCompare);
+    }
+    pTask->m_iWhere = TASK_IN_NONE;
 
     return pTask;
 }
 
-void CTaskHeap::Update(int iNode, SCHCMP *pfCompare)
+static int DCL_CDECL task_when_comp(const void *s1, const void *s2)
 {
-    if (iNode < 0 || m_nCurrent <= iNode)
-    {
-        return;
-    }
+    return CompareWhen(*(PTASK_RECORD *)s1, *(PTASK_RECORD *)s2);
+}
 
-    SiftDown(iNode, pfCompare);
-    SiftUp(iNode, pfCompare);
+static int DCL_CDECL task_priority_comp(const void *s1, const void *s2)
+{
+    return ComparePriority(*(PTASK_RECORD *)s1, *(PTASK_RECORD *)s2);
 }
 
-void CScheduler::TraverseUnordered(SCHLOOK *pfLook)
+static int DCL_CDECL task_order_comp(const void *s1, const void *s2)
 {
-    if (m_WhenHeap.TraverseUnordered(pfLook, CompareWhen))
+    PTASK_RECORD pTaskA = *(PTASK_RECORD *)s1;
+    PTASK_RECORD pTaskB = *(PTASK_RECORD *)s2;
+    if (pTaskA->m_iWhere != pTaskB->m_iWhere)
+    {
+        return (TASK_IN_HEAP == pTaskA->m_iWhere) ? -1 : 1;
+    }
+    else if (TASK_IN_HEAP == pTaskA->m_iWhere)
     {
-        m_PriorityHeap.TraverseUnordered(pfLook, ComparePriority);
+        return ComparePriority(pTaskA, pTaskB);
+    }
+    else
+    {
+        return CompareWhen(pTaskA, pTaskB);
     }
 }
 
-void CScheduler::TraverseOrdered(SCHLOOK *pfLook)
+// Puts a set of tasks in the order that TraverseOrdered() would visit them.
+//
+void CScheduler::Sort(PTASK_RECORD *aTasks, int nTasks)
 {
-    m_PriorityHeap.TraverseOrdered(pfLook, ComparePriority);
-    m_WhenHeap.TraverseOrdered(pfLook, CompareWhen);
+    qsort(aTasks, nTasks, sizeof(PTASK_RECORD), task_order_comp);
 }
 
-// The following guarantees that in spite of any changes to the heap
-// we will visit every record exactly once. It does not attempt to
-// visit these records in any particular order.
+// Copies the tasks so that a traversal is not disturbed by changes to the
+// wheel or heap.  Ordered, the ready tasks come first in Priority-order,
+// followed by the waiting tasks in When-order.
 //
-int CTaskHeap::TraverseUnordered(SCHLOOK *pfLook, SCHCMP *pfCompare)
+PTASK_RECORD *CScheduler::Snapshot(bool bOrdered, int *pnTasks)
 {
-    // Indicate that everything has not been visited.
-    //
-    m_iVisitedMark++;
-    if (m_iVisitedMark == 0)
+    const int nWhen = m_WhenWheel.Count();
+    const int nPriority = m_PriorityHeap.Count();
+    PTASK_RECORD *aTasks = nullptr;
+    try
     {
-        // We rolled over. Yeah, this code will probably never run, but
-        // let's go ahead and mark all the records as visited anyway.
-        //
-        for (int i = 0; i < m_nCurrent; i++)
-        {
-            PTASK_RECORD p = m_pHeap[i];
-            p->m_iVisitedMark = m_iVisitedMark;
-        }
-        m_iVisitedMark++;
+        aTasks = new PTASK_RECORD[nWhen + nPriority + 1];
     }
-
-    int bUnvisitedRecords;
-    do
+    catch (...)
     {
-        bUnvisitedRecords = false;
-        for (int i = 0; i < m_nCurrent; i++)
-        {
-            PTASK_RECORD p = m_pHeap[i];
-
-            if (p->m_iVisitedMark == m_iVisitedMark)
-            {
-                // We have already seen this one.
-                //
-                continue;
-            }
-            bUnvisitedRecords = true;
-            p->m_iVisitedMark = m_iVisitedMark;
+        ; // Nothing.
+    }
 
-            int cmd = pfLook(p);
-            switch (cmd)
-            {
-            case IU_REMOVE_TASK:
-                Remove(i, pfCompare);
-                break;
+    if (nullptr == aTasks)
+    {
+        *pnTasks = 0;
+        return nullptr;
+    }
 
-            case IU_DONE:
-                return false;
+    if (bOrdered)
+    {
+        m_PriorityHeap.Collect(aTasks);
+        qsort(aTasks, nPriority, sizeof(PTASK_RECORD), task_priority_comp);
+        m_WhenWheel.Collect(aTasks + nPriority);
+        qsort(aTasks + nPriority, nWhen, sizeof(PTASK_RECORD), task_when_comp);
+    }
+    else
+    {
+        m_WhenWheel.Collect(aTasks);
+        m_PriorityHeap.Collect(aTasks + nWhen);
+    }
+    *pnTasks = nWhen + nPriority;
+    return aTasks;
+}
 
-            case IU_UPDATE_TASK:
-                Update(i, pfCompare);
-                break;
-            }
-        }
-    } while (bUnvisitedRecords);
-    return true;
+void CScheduler::Discard(PTASK_RECORD pTask)
+{
+    if (TASK_IN_WHEEL == pTask->m_iWhere)
+    {
+        m_WhenWheel.Remove(pTask);
+    }
+    else if (TASK_IN_HEAP == pTask->m_iWhere)
+    {
+        m_PriorityHeap.Remove(pTask, ComparePriority);
+    }
+    delete pTask;
 }
 
-// The following does not allow for changes during the traversal, but
-// but it does visit each record in sorted order (When-order or
-// Priority-order depending on the heap).
+// The following guarantees that in spite of any changes to the wheel or
+// heap, we will visit every record present at the start exactly once.
+// Tasks may be removed (IU_REMOVE_TASK) or changed (IU_UPDATE_TASK) by the
+// callback.
 //
-int CTaskHeap::TraverseOrdered(SCHLOOK *pfLook, SCHCMP *pfCompare)
+void CScheduler::Traverse(SCHLOOK *pfLook, bool bOrdered)
 {
-    Sort(pfCompare);
+    int nTasks;
+    PTASK_RECORD *aTasks = Snapshot(bOrdered, &nTasks);
+    if (nullptr == aTasks)
+    {
+        return;
+    }
 
-    for (int i = m_nCurrent-1; i >= 0; i--)
+    m_nTraversing++;
+    for (int i = 0; i < nTasks; i++)
     {
-        PTASK_RECORD p = m_pHeap[i];
+        PTASK_RECORD p = aTasks[i];
+        if (nullptr == p->fpTask)
+        {
+            continue;
+        }
+
         int cmd = pfLook(p);
         if (IU_DONE == cmd)
         {
             break;
         }
+        else if (IU_REMOVE_TASK == cmd)
+        {
+            // Nested traversals may still refer to it.
+            //
+            p->fpTask = nullptr;
+        }
+        else if (IU_UPDATE_TASK == cmd)
+        {
+            UpdateTask(p);
+        }
     }
+    m_nTraversing--;
 
-    Remake(pfCompare);
-    return true;
+    if (0 == m_nTraversing)
+    {
+        // Remove tasks which were removed or cancelled along the way.
+        //
+        for (int i = 0; i < nTasks; i++)
+        {
+            if (nullptr == aTasks[i]->fpTask)
+            {
+                Discard(aTasks[i]);
+            }
+        }
+    }
+    delete [] aTasks;
 }
 
-void CTaskHeap::Sort(SCHCMP *pfCompare)
+void CScheduler::TraverseUnordered(SCHLOOK *pfLook)
 {
-    int s_nCurrent = m_nCurrent;
-    while (m_nCurrent--)
-    {
-        PTASK_RECORD p = m_pHeap[m_nCurrent];
-        m_pHeap[m_nCurrent] = m_pHeap[0];
-        m_pHeap[0] = p;
-        SiftDown(0, pfCompare);
-    }
-    m_nCurrent = s_nCurrent;
+    Traverse(pfLook, false);
 }
 
-void CTaskHeap::Remake(SCHCMP *pfCompare)
+void CScheduler::TraverseOrdered(SCHLOOK *pfLook)
 {
-    int s_nCurrent = m_nCurrent;
-    m_nCurrent = 0;
-    while (s_nCurrent--)
-    {
-        m_nCurrent++;
-        SiftUp(m_nCurrent-1, pfCompare);
-    }
+    Traverse(pfLook, true);
 }
 
 void CScheduler::SetMinPriority(int arg_minPriority)
@@ -849,6 +1385,5 @@ void CScheduler::SetMinPriority(int arg_minPriority)
 
 void CScheduler::Shrink(void)
 {
-    m_WhenHeap.Shrink();
     m_PriorityHeap.Shrink();
 }
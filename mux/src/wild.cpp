@@ -21,440 +21,452 @@
 
 #include "mathutil.h"
 
-#define EQUAL(a,b) (mux_tolower_ascii(a) == mux_tolower_ascii(b))
-#define NOTEQUAL(a,b) (mux_tolower_ascii(a) != mux_tolower_ascii(b))
-
-// Argument return space and size.
+// A pattern is compiled once into a string of lowercased literal bytes and the
+// opcodes below.  None of the opcodes can appear in valid UTF-8, so
+// WILD_QUOTE is only needed to carry such bytes through from malformed text.
 //
-static UTF8 **arglist;
-static int numargs;
-
+// Matching does not backtrack.  The text between '*'s is placed at its
+// earliest position, left to right, which gives each '*' the shortest match
+// that still lets the rest of the pattern match.  The text after the last
+// '*' is anchored to the end of the data.  The work is bounded by the length
+// of the data times the length of the pattern.
 //
+#define WILD_QUOTE  0xFD
+#define WILD_STAR   0xFE
+#define WILD_ANY    0xFF
+
+typedef struct
+{
+    const UTF8 *pData;
+    size_t      nData;
+    int         nArgs;
+    size_t      aStart[NUM_ENV_VARS];
+    size_t      aLen[NUM_ENV_VARS];
+} WILD_STATE;
+
 // ---------------------------------------------------------------------------
-// quick_wild: do a wildcard match, without remembering the wild data.
+// wild_compile: Compile a wildcard pattern.
 //
-// This routine will cause crashes if fed nullptrs instead of strings.
+// Returns the size of the compiled pattern including its terminating '\0',
+// or 0 if it does not fit in nCompiled bytes.
 //
-bool quick_wild(const UTF8 *tstr, const UTF8 *dstr)
+size_t wild_compile(const UTF8 *tstr, UTF8 *pCompiled, size_t nCompiled)
 {
-    if (mudstate.wild_invk_ctr >= mudconf.wild_invk_lim)
+    size_t i = 0;
+    while ('\0' != *tstr)
     {
-        return false;
-    }
-    mudstate.wild_invk_ctr++;
-
-    while (*tstr != '*')
-    {
-        switch (*tstr)
+        UTF8 ch = *tstr++;
+        if ('*' == ch)
         {
-        case '?':
-
-            // Single character match.  Return false if at end of data.
-            //
-            if (!*dstr)
+            ch = WILD_STAR;
+        }
+        else if ('?' == ch)
+        {
+            ch = WILD_ANY;
+        }
+        else
+        {
+            if ('\\' == ch)
             {
-                return false;
+                // Escape character.  Force a literal match of the next
+                // character.  A trailing backslash matches nothing.
+                //
+                ch = *tstr;
+                if ('\0' == ch)
+                {
+                    break;
+                }
+                tstr++;
             }
-            break;
-
-        case '\\':
-
-            // Escape character.  Move up, and force literal match of next
-            // character.
-            //
-            tstr++;
-
-            // FALL THROUGH
-
-        default:
 
-            // Literal character.  Check for a match. If matching end of data,
-            // return true.
-            //
-            if (NOTEQUAL(*dstr, *tstr))
-            {
-                return false;
-            }
-            if (!*dstr)
+            ch = mux_tolower_ascii(ch);
+            if (WILD_QUOTE <= ch)
             {
-                return true;
+                if (nCompiled <= i + 1)
+                {
+                    return 0;
+                }
+                pCompiled[i++] = WILD_QUOTE;
             }
         }
-        tstr++;
-        dstr++;
-    }
-
-    // Skip over '*'.
-    //
-    tstr++;
-
-    // Return true on trailing '*'.
-    //
-    if (!*tstr)
-    {
-        return true;
-    }
 
-    // Skip over wildcards.
-    //
-    while (  *tstr == '?'
-          || *tstr == '*')
-    {
-        if (*tstr == '?')
+        if (nCompiled <= i + 1)
         {
-            if (!*dstr)
-            {
-                return false;
-            }
-            dstr++;
+            return 0;
         }
-        tstr++;
+        pCompiled[i++] = ch;
     }
+    pCompiled[i++] = '\0';
+    return i;
+}
 
-    // Skip over a backslash in the pattern string if it is there.
-    //
-    if (*tstr == '\\')
+// ---------------------------------------------------------------------------
+// wild_point: Return the size of the code point at iData, or 0 if there is
+// not a complete one there.
+//
+static size_t wild_point(const WILD_STATE *pws, size_t iData)
+{
+    if (pws->nData <= iData)
     {
-        tstr++;
+        return 0;
     }
 
-    // Return true on trailing '*'.
-    //
-    if (!*tstr)
+    const UTF8 *p = pws->pData + iData;
+    size_t t = utf8_FirstByte[p[0]];
+    if (  UTF8_CONTINUE <= t
+       || pws->nData - iData < t)
     {
-        return true;
+        return 0;
     }
 
-    // Scan for possible matches.
-    //
-    while (*dstr)
+    for (size_t j = 1; j < t; j++)
     {
-        if (  EQUAL(*dstr, *tstr)
-           && quick_wild(tstr + 1, dstr + 1))
+        if (UTF8_CONTINUE != utf8_FirstByte[p[j]])
         {
-            return true;
+            return 0;
         }
-        dstr++;
     }
-    return false;
+    return t;
 }
 
-// ---------------------------------------------------------------------------
-// wild1: INTERNAL: do a wildcard match, remembering the wild data.
-//
-// DO NOT CALL THIS FUNCTION DIRECTLY - DOING SO MAY RESULT IN SERVER CRASHES
-// AND IMPROPER ARGUMENT RETURN.
-//
-// Side Effect: this routine modifies the 'arglist' static global variable.
-//
-static bool wild1(UTF8 *tstr, UTF8 *dstr, int arg)
+static void wild_capture(WILD_STATE *pws, int iArg, size_t iStart, size_t nLen)
 {
-    if (mudstate.wild_invk_ctr >= mudconf.wild_invk_lim)
+    if (iArg < pws->nArgs)
     {
-        return false;
+        pws->aStart[iArg] = iStart;
+        pws->aLen[iArg] = nLen;
     }
-    mudstate.wild_invk_ctr++;
+}
 
-    UTF8 *datapos;
-    int argpos, numextra;
+// ---------------------------------------------------------------------------
+// wild_segment: INTERNAL: Match the literals and '?'s up to the next '*' or
+// the end of the pattern at iData.
+//
+// On success, *ppc and *piData are moved past the segment and its '?'s are
+// captured.  On failure, nothing is moved, but captures may be left behind.
+//
+static bool wild_segment(WILD_STATE *pws, const UTF8 **ppc, size_t *piData,
+    int *piArg)
+{
+    const UTF8 *pc = *ppc;
+    size_t iData = *piData;
+    int iArg = *piArg;
 
-    while (*tstr != '*')
+    while (  '\0' != *pc
+          && WILD_STAR != *pc)
     {
-        switch (*tstr)
+        if (WILD_ANY == *pc)
         {
-        case '?':
-
-            // Single character match.  Return false if at end of data.
-            //
-            size_t t;
-            if (  '\0' == dstr[0]
-               || UTF8_CONTINUE <= (t = utf8_FirstByte[*dstr]))
+            size_t t = wild_point(pws, iData);
+            if (0 == t)
             {
                 return false;
             }
-
-            size_t j;
-            for (j = 1; j < t; j++)
-            {
-                if (  '\0' == dstr[j]
-                   || UTF8_CONTINUE != utf8_FirstByte[dstr[j]])
-                {
-                    return false;
-                }
-            }
-
-            memcpy(arglist[arg], dstr, t);
-            arglist[arg][t] = '\0';
-            arg++;
-
-            // Jump to the fast routine if we can.
-            //
-            if (arg >= numargs)
+            wild_capture(pws, iArg++, iData, t);
+            iData += t;
+        }
+        else
+        {
+            if (WILD_QUOTE == *pc)
             {
-                return quick_wild(tstr + 1, dstr + t);
+                pc++;
             }
-            dstr += t;
-            break;
-
-        case '\\':
-
-            // Escape character.  Move up, and force literal match of next
-            // character.
-            //
-            tstr++;
 
-            // FALL THROUGH
-
-        default:
-
-            // Literal character.  Check for a match. If matching end of data,
-            // return true.
-            //
-            if (NOTEQUAL(*dstr, *tstr))
+            if (  pws->nData <= iData
+               || mux_tolower_ascii(pws->pData[iData]) != *pc)
             {
                 return false;
             }
-            if (!*dstr)
-            {
-                return true;
-            }
-            dstr++;
-            break;
+            iData++;
         }
-        tstr++;
+        pc++;
     }
 
-    // If at end of pattern, slurp the rest, and leave.
+    *ppc = pc;
+    *piData = iData;
+    *piArg = iArg;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// wild_exec: INTERNAL: Match a compiled pattern against the data.
+//
+static bool wild_exec(WILD_STATE *pws, const UTF8 *pc)
+{
+    size_t iData = 0;
+    int iArg = 0;
+
+    // Everything before the first '*' is anchored to the beginning.
     //
-    if (!tstr[1])
+    if (!wild_segment(pws, &pc, &iData, &iArg))
     {
-        mux_strncpy(arglist[arg], dstr, LBUF_SIZE-1);
-        return true;
+        return false;
     }
 
-    // Remember current position for filling in the '*' return.
-    //
-    datapos = dstr;
-    argpos = arg;
-
-    // Scan forward until we find a non-wildcard.
-    //
-    do
+    while (WILD_STAR == *pc)
     {
-        if (argpos < arg)
+        // Collect the run of '*'s and '?'s.  Only the last '*' in the run
+        // takes any text.  The '?'s on either side of it take the code points
+        // at the edges of the gap.
+        //
+        const UTF8 *pRun = pc;
+        int nStars = 0;
+        size_t nBefore = 0;
+        size_t nAfter = 0;
+        while (  WILD_STAR == *pc
+              || WILD_ANY == *pc)
         {
-            // Fill in arguments if someone put another '*' before a fixed
-            // string.
-            //
-            arglist[argpos][0] = '\0';
-            argpos++;
-
-            // Jump to the fast routine if we can.
-            //
-            if (argpos >= numargs)
+            if (WILD_STAR == *pc)
             {
-                return quick_wild(tstr, dstr);
+                nStars++;
+                nBefore += nAfter;
+                nAfter = 0;
             }
-
-            // Fill in any intervening '?'s
-            //
-            while (argpos < arg)
+            else
             {
-                arglist[argpos][0] = *datapos;
-                arglist[argpos][1] = '\0';
-                datapos++;
-                argpos++;
-
-                // Jump to the fast routine if we can.
-                //
-                if (argpos >= numargs)
-                {
-                    return quick_wild(tstr, dstr);
-                }
+                nAfter++;
             }
+            pc++;
         }
 
-        // Skip over the '*' for now...
-        //
-        tstr++;
-        arg++;
-
-        // Skip over '?'s for now...
-        //
-        numextra = 0;
-        while (*tstr == '?')
+        size_t iMin = iData;
+        for (size_t j = 0; j < nBefore + nAfter; j++)
         {
-            if (!*dstr)
+            size_t t = wild_point(pws, iMin);
+            if (0 == t)
             {
                 return false;
             }
-            tstr++;
-            dstr++;
-            arg++;
-            numextra++;
+            iMin += t;
         }
-    } while (*tstr == '*');
-
-    // Skip over a backslash in the pattern string if it is there.
-    //
-    if (*tstr == '\\')
-    {
-        tstr++;
-    }
 
-    // Check for possible matches.  This loop terminates either at end of data
-    // (resulting in failure), or at a successful match.
-    //
-    for (;;)
-    {
-        // Scan forward until first character matches.
+        // Measure the segment which follows the run.
         //
-        if (*tstr)
+        size_t nLiteral = 0;
+        size_t nAny = 0;
+        const UTF8 *q = pc;
+        while (  '\0' != *q
+              && WILD_STAR != *q)
         {
-            while (NOTEQUAL(*dstr, *tstr))
+            if (WILD_ANY == *q)
+            {
+                nAny++;
+            }
+            else
             {
-                if (!*dstr)
+                if (WILD_QUOTE == *q)
                 {
-                    return false;
+                    q++;
                 }
-                dstr++;
+                nLiteral++;
             }
+            q++;
         }
-        else
+
+        const UTF8 *pcNext = pc;
+        size_t iNext = iData;
+        int iArgNext = iArg + static_cast<int>(pc - pRun);
+        size_t iGapEnd;
+        bool bFound = false;
+
+        if (pc == q)
         {
-            while (*dstr)
+            // The run ends the pattern, so it takes the rest of the data.
+            //
+            iGapEnd = pws->nData;
+            iNext = pws->nData;
+            bFound = true;
+        }
+        else if ('\0' == *q)
+        {
+            // The last segment is anchored to the end.  A '?' covers one to
+            // four bytes, so only a few places can work.
+            //
+            if (pws->nData < nLiteral + nAny)
             {
-                dstr++;
+                return false;
+            }
+            iGapEnd = iMin;
+            if (iGapEnd + nLiteral + 4*nAny < pws->nData)
+            {
+                iGapEnd = pws->nData - nLiteral - 4*nAny;
+            }
+            for ( ; iGapEnd + nLiteral + nAny <= pws->nData; iGapEnd++)
+            {
+                pcNext = pc;
+                iNext = iGapEnd;
+                iArgNext = iArg + static_cast<int>(pc - pRun);
+                if (  wild_segment(pws, &pcNext, &iNext, &iArgNext)
+                   && pws->nData == iNext)
+                {
+                    bFound = true;
+                    break;
+                }
             }
         }
-
-        // The first character matches, now.  Check if the rest does, using
-        // the fastest method, as usual.
-        //
-        if (  !*dstr
-           || ((arg < numargs) ? wild1(tstr + 1, dstr + 1, arg)
-                               : quick_wild(tstr + 1, dstr + 1)))
+        else
         {
-            // Found a match!  Fill in all remaining arguments. First do the
-            // '*'...
+            // A segment between two runs is placed at its earliest position.
+            // It always begins with a literal.
             //
-            mux_strncpy(arglist[argpos], datapos, (dstr - datapos) - numextra);
-            datapos = dstr - numextra;
-            argpos++;
-
-            // Fill in any trailing '?'s that are left.
-            //
-            while (numextra)
+            UTF8 chFirst = (WILD_QUOTE == pc[0]) ? pc[1] : pc[0];
+            for (iGapEnd = iMin; iGapEnd + nLiteral + nAny <= pws->nData; iGapEnd++)
             {
-                if (argpos >= numargs)
+                if (mux_tolower_ascii(pws->pData[iGapEnd]) != chFirst)
+                {
+                    continue;
+                }
+
+                pcNext = pc;
+                iNext = iGapEnd;
+                iArgNext = iArg + static_cast<int>(pc - pRun);
+                if (wild_segment(pws, &pcNext, &iNext, &iArgNext))
                 {
-                    return true;
+                    bFound = true;
+                    break;
                 }
-                arglist[argpos][0] = *datapos;
-                arglist[argpos][1] = '\0';
-                datapos++;
-                argpos++;
-                numextra--;
             }
+        }
 
-            // It's done!
-            //
-            return true;
+        if (!bFound)
+        {
+            return false;
         }
-        else
+
+        // Find where the '?'s after the last '*' begin.
+        //
+        size_t iAfter = iGapEnd;
+        for (size_t j = 0; j < nAfter; j++)
         {
-            dstr++;
+            do
+            {
+                iAfter--;
+            } while (  iData < iAfter
+                    && UTF8_CONTINUE == utf8_FirstByte[pws->pData[iAfter]]);
+        }
+
+        // Fill in the run's captures.
+        //
+        size_t iPos = iData;
+        int iStar = 0;
+        for (const UTF8 *p = pRun; p < pc; p++)
+        {
+            if (WILD_ANY == *p)
+            {
+                size_t t = wild_point(pws, iPos);
+                wild_capture(pws, iArg++, iPos, t);
+                iPos += t;
+            }
+            else if (++iStar < nStars)
+            {
+                wild_capture(pws, iArg++, iPos, 0);
+            }
+            else
+            {
+                wild_capture(pws, iArg++, iPos, iAfter - iPos);
+                iPos = iAfter;
+            }
         }
+
+        pc = pcNext;
+        iData = iNext;
+        iArg = iArgNext;
     }
+    return (pws->nData == iData);
 }
 
 // ---------------------------------------------------------------------------
-// wild: do a wildcard match, remembering the wild data.
-//
-// This routine will cause crashes if fed nullptrs instead of strings.
+// wild_compiled: do a wildcard match with a compiled pattern, remembering the
+// wild data.
 //
-// Side Effect: this routine modifies the 'arglist' and 'numargs' static
-// global variables.
-//
-bool wild(UTF8 *tstr, UTF8 *dstr, UTF8 *args[], int nargs)
+bool wild_compiled(const UTF8 *pCompiled, const UTF8 *dstr, UTF8 *args[],
+    int nargs)
 {
-    mudstate.wild_invk_ctr = 0;
-
     int i;
-    UTF8 *scan;
-
-    // Initialize the return array.
-    //
     for (i = 0; i < nargs; i++)
     {
         args[i] = nullptr;
     }
 
-    // Do fast match.
-    //
-    while (  *tstr != '*'
-          && *tstr != '?')
+    WILD_STATE ws;
+    ws.pData = dstr;
+    ws.nData = strlen((const char *)dstr);
+    ws.nArgs = (NUM_ENV_VARS < nargs) ? NUM_ENV_VARS : nargs;
+    for (i = 0; i < ws.nArgs; i++)
     {
-        if (*tstr == '\\')
-        {
-            tstr++;
-        }
-        if (NOTEQUAL(*dstr, *tstr))
-        {
-            return false;
-        }
-        if (!*dstr)
-        {
-            return true;
-        }
-        tstr++;
-        dstr++;
+        ws.aLen[i] = 0;
     }
 
-    // Allocate space for the return args.
+    if (!wild_exec(&ws, pCompiled))
+    {
+        return false;
+    }
+
+    // Empty matches are left as nullptr.
     //
-    i = 0;
-    scan = tstr;
-    while (  *scan
-          && i < nargs)
+    for (i = 0; i < ws.nArgs; i++)
     {
-        switch (*scan)
+        if (0 < ws.aLen[i])
         {
-        case '?':
-
-            args[i] = alloc_lbuf("wild.?");
-            i++;
-            break;
-
-        case '*':
-
-            args[i] = alloc_lbuf("wild.*");
-            i++;
+            args[i] = alloc_lbuf("wild_compiled");
+            memcpy(args[i], dstr + ws.aStart[i], ws.aLen[i]);
+            args[i][ws.aLen[i]] = '\0';
         }
-        scan++;
     }
+    return true;
+}
 
-    // Put stuff in globals for quick recursion.
-    //
-    arglist = args;
-    numargs = nargs;
+// ---------------------------------------------------------------------------
+// quick_wild: do a wildcard match, without remembering the wild data.
+//
+// This routine will cause crashes if fed nullptrs instead of strings.
+//
+bool quick_wild(const UTF8 *tstr, const UTF8 *dstr)
+{
+    UTF8 *pCompiled = alloc_lbuf("quick_wild");
+    bool value = false;
+    if (0 != wild_compile(tstr, pCompiled, LBUF_SIZE))
+    {
+        value = quick_wild_compiled(pCompiled, dstr);
+    }
+    free_lbuf(pCompiled);
+    return value;
+}
 
-    // Do the match.
-    //
-    bool value = nargs ? wild1(tstr, dstr, 0) : quick_wild(tstr, dstr);
+// ---------------------------------------------------------------------------
+// quick_wild_compiled: do a wildcard match with a compiled pattern, without
+// remembering the wild data.
+//
+bool quick_wild_compiled(const UTF8 *pCompiled, const UTF8 *dstr)
+{
+    WILD_STATE ws;
+    ws.pData = dstr;
+    ws.nData = strlen((const char *)dstr);
+    ws.nArgs = 0;
+    return wild_exec(&ws, pCompiled);
+}
 
-    // Clean out any fake match data left by wild1.
-    //
-    for (i = 0; i < nargs; i++)
+// ---------------------------------------------------------------------------
+// wild: do a wildcard match, remembering the wild data.
+//
+// This routine will cause crashes if fed nullptrs instead of strings.
+//
+bool wild(UTF8 *tstr, UTF8 *dstr, UTF8 *args[], int nargs)
+{
+    UTF8 *pCompiled = alloc_lbuf("wild");
+    bool value = false;
+    if (0 != wild_compile(tstr, pCompiled, LBUF_SIZE))
+    {
+        value = wild_compiled(pCompiled, dstr, args, nargs);
+    }
+    else
     {
-        if (  args[i] != nullptr
-           && (  !*args[i]
-              || !value))
+        for (int i = 0; i < nargs; i++)
         {
-            free_lbuf(args[i]);
             args[i] = nullptr;
         }
     }
+    free_lbuf(pCompiled);
     return value;
 }
 
@@ -495,6 +507,5 @@ bool wild_match(UTF8 *tstr, const UTF8 *dstr)
             return (strcmp((char *)dstr, (char *)tstr) > 0);
         }
     }
-    mudstate.wild_invk_ctr = 0;
     return quick_wild(tstr, dstr);
 }
@@ -432,6 +432,7 @@ void do_toad
         //
         count = chown_all(victim, recipient, executor, CHOWN_NOZONE);
         s_Owner(victim, recipient);
+        chown_que(victim);
         s_Zone(victim, NOTHING);
     }
     s_Flags(victim, FLAG_WORD1, TYPE_THING | HALT);
@@ -477,6 +478,27 @@ void do_toad
     notify_quiet(executor, buf);
 }
 
+static void newpassword_done(dbref victim, bool bValid, void *pContext, int executor)
+{
+    UNUSED_PARAMETER(pContext);
+
+    if (!Good_obj(executor))
+    {
+        return;
+    }
+    else if (!bValid)
+    {
+        notify_quiet(executor, T("No such player."));
+        return;
+    }
+    notify_quiet(executor, T("Password changed."));
+    UTF8 *buf = alloc_lbuf("do_newpassword");
+    UTF8 *bp = buf;
+    safe_tprintf_str(buf, &bp, T("Your password has been changed by %s."), Moniker(executor));
+    notify_quiet(victim, buf);
+    free_lbuf(buf);
+}
+
 void do_newpassword
 (
     dbref executor,
@@ -548,13 +570,7 @@ void do_newpassword
 
     // It's ok, do it.
     //
-    ChangePassword(victim, password);
-    notify_quiet(executor, T("Password changed."));
-    UTF8 *buf = alloc_lbuf("do_newpassword");
-    UTF8 *bp = buf;
-    safe_tprintf_str(buf, &bp, T("Your password has been changed by %s."), Moniker(executor));
-    notify_quiet(victim, buf);
-    free_lbuf(buf);
+    ChangePasswordLater(victim, password, newpassword_done, nullptr, executor);
 }
 
 void do_boot(dbref executor, dbref caller, dbref enactor, int eval, int key, UTF8 *name, const UTF8 *cargs[], int ncargs)